@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// A reader for the block log written by absolutetimestamps format=blocks, see gstabstsformat.h for
+// the layout.
+//
+// The file is memory-mapped. Opening it checks only the last block, walking back over any that are
+// torn, which after a crash is where the damage is. Every other block is checked as it's read.
+
+#include "gstabstsblocks.h"
+#include "gstabstsreader.h"
+
+struct _GstAbstsBlockReader
+{
+  GMappedFile *mapped_file;
+  const guint8 *contents;
+  gsize length;
+  GstAbstsHeader header;
+  gsize n_blocks;
+};
+
+GstAbstsBlockReader *
+gst_absts_block_reader_open (const gchar * filename, GError ** error)
+{
+  GstAbstsBlockReader *reader;
+  GMappedFile *mapped_file;
+  GstAbstsHeader header;
+  const guint8 *contents;
+  gsize length, n_blocks;
+  guint32 count;
+
+  mapped_file = g_mapped_file_new (filename, FALSE, error);
+  if (mapped_file == NULL)
+    return NULL;
+
+  contents = (const guint8 *) g_mapped_file_get_contents (mapped_file);
+  length = g_mapped_file_get_length (mapped_file);
+
+  if (length < GST_ABSTS_HEADER_SIZE ||
+      !gst_absts_header_read_with_magic (contents, GST_ABSTS_BLOCK_LOG_MAGIC, &header)) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_FORMAT,
+        "\"%s\" is not a block timestamp log", filename);
+    g_mapped_file_unref (mapped_file);
+    return NULL;
+  }
+
+  if (header.version < 1 || header.header_size != GST_ABSTS_BLOCK_SIZE ||
+      header.record_size < GST_ABSTS_RECORD_SIZE) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_VERSION,
+        "\"%s\" has an unsupported layout (version %u, header %u bytes, record %u bytes)",
+        filename, header.version, header.header_size, header.record_size);
+    g_mapped_file_unref (mapped_file);
+    return NULL;
+  }
+
+  // Whatever follows the last whole block is a torn write, as is any block that doesn't check out.
+  n_blocks = length > header.header_size ? (length - header.header_size) / GST_ABSTS_BLOCK_SIZE : 0;
+  while (n_blocks > 0 && !gst_absts_block_check (contents + header.header_size +
+          (n_blocks - 1) * GST_ABSTS_BLOCK_SIZE, n_blocks - 1, header.record_size, &count))
+    n_blocks--;
+
+  reader = g_new0 (GstAbstsBlockReader, 1);
+  reader->mapped_file = mapped_file;
+  reader->contents = contents;
+  reader->length = length;
+  reader->header = header;
+  reader->n_blocks = n_blocks;
+
+  return reader;
+}
+
+void
+gst_absts_block_reader_close (GstAbstsBlockReader * reader)
+{
+  g_mapped_file_unref (reader->mapped_file);
+  g_free (reader);
+}
+
+const GstAbstsHeader *
+gst_absts_block_reader_get_header (GstAbstsBlockReader * reader)
+{
+  return &reader->header;
+}
+
+// The number of blocks up to and including the last intact one.
+gsize
+gst_absts_block_reader_get_n_blocks (GstAbstsBlockReader * reader)
+{
+  return reader->n_blocks;
+}
+
+// How much of the file is the header and the intact blocks, i.e. where a writer resuming the log
+// would continue. Anything after it was torn.
+guint64
+gst_absts_block_reader_get_valid_length (GstAbstsBlockReader * reader)
+{
+  return reader->header.header_size + (guint64) reader->n_blocks * GST_ABSTS_BLOCK_SIZE;
+}
+
+// Copies the records of block index into records, which must have room for
+// GST_ABSTS_BLOCK_MAX_RECORDS, and their fields into fields, GST_ABSTS_N_FIELDS values per record,
+// unless it's NULL (see gst_absts_fields_read). Returns the number of records, or -1 if the block is
+// corrupt.
+gssize
+gst_absts_block_reader_read_block (GstAbstsBlockReader * reader, gsize index,
+    GstAbstsRecord * records, guint64 * fields, GError ** error)
+{
+  guint16 record_size = reader->header.record_size;
+  const guint8 *block;
+  guint32 count, i;
+
+  g_return_val_if_fail (index < reader->n_blocks, -1);
+
+  block = reader->contents + reader->header.header_size + index * GST_ABSTS_BLOCK_SIZE;
+  if (!gst_absts_block_check (block, index, record_size, &count)) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_FORMAT,
+        "Block %" G_GSIZE_FORMAT " is corrupt", index);
+    return -1;
+  }
+
+  for (i = 0; i < count; i++) {
+    const guint8 *record = block + GST_ABSTS_BLOCK_HEADER_SIZE + i * record_size;
+
+    gst_absts_record_read (record, &records[i]);
+    if (fields)
+      gst_absts_fields_read (record, reader->header.flags, fields + i * GST_ABSTS_N_FIELDS);
+  }
+
+  return count;
+}
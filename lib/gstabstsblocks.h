@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSTS_BLOCKS_H_
+#define _GST_ABSTS_BLOCKS_H_
+
+#include <glib.h>
+
+#include "gstabstsformat.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstAbstsBlockReader GstAbstsBlockReader;
+
+GstAbstsBlockReader *gst_absts_block_reader_open (const gchar * filename, GError ** error);
+void gst_absts_block_reader_close (GstAbstsBlockReader * reader);
+
+const GstAbstsHeader *gst_absts_block_reader_get_header (GstAbstsBlockReader * reader);
+gsize gst_absts_block_reader_get_n_blocks (GstAbstsBlockReader * reader);
+guint64 gst_absts_block_reader_get_valid_length (GstAbstsBlockReader * reader);
+
+gssize gst_absts_block_reader_read_block (GstAbstsBlockReader * reader, gsize index,
+    GstAbstsRecord * records, guint64 * fields, GError ** error);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// A reader for the columnar log written by absolutetimestamps format=columnar, see gstabstsformat.h
+// for the layout.
+//
+// Like GstAbstsReader, the file is memory-mapped. Opening it only reads the footer, which says where
+// the row groups are and what range of pts and wallclock each covers, so a scan can skip whole groups
+// without touching them. The groups it does want it decodes a column at a time into plain arrays,
+// ready for vectorized processing - and columns it doesn't ask for are never even read.
+//
+// A file whose writer didn't get to write the footer, e.g. because it was killed, is indexed instead
+// by walking the row group headers from the start of the file. A torn last group is ignored.
+
+#include "gstabstscolumnar.h"
+#include "gstabstsreader.h"
+
+struct _GstAbstsColumnarReader
+{
+  GMappedFile *mapped_file;
+  const guint8 *contents;
+  gsize length;
+  GstAbstsHeader header;
+  gboolean complete;
+
+  GstAbstsRowGroup *row_groups;
+  gsize n_row_groups;
+};
+
+static gboolean
+read_footer (GstAbstsColumnarReader * reader)
+{
+  guint64 footer_offset;
+  guint32 n_groups;
+  gsize i;
+
+  if (reader->length < reader->header.header_size + GST_ABSTS_COLUMNAR_TRAILER_SIZE ||
+      !gst_absts_columnar_trailer_read (reader->contents + reader->length -
+          GST_ABSTS_COLUMNAR_TRAILER_SIZE, &footer_offset, &n_groups))
+    return FALSE;
+
+  if (footer_offset < reader->header.header_size ||
+      footer_offset + (guint64) n_groups * GST_ABSTS_ROW_GROUP_ENTRY_SIZE +
+      GST_ABSTS_COLUMNAR_TRAILER_SIZE != reader->length)
+    return FALSE;
+
+  reader->row_groups = g_new0 (GstAbstsRowGroup, MAX (n_groups, 1));
+  reader->n_row_groups = n_groups;
+
+  for (i = 0; i < n_groups; i++) {
+    GstAbstsRowGroup *group = &reader->row_groups[i];
+
+    gst_absts_row_group_entry_read (reader->contents + footer_offset +
+        i * GST_ABSTS_ROW_GROUP_ENTRY_SIZE, group);
+    if (group->offset + GST_ABSTS_ROW_GROUP_HEADER_SIZE > footer_offset)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+walk_row_groups (GstAbstsColumnarReader * reader)
+{
+  gsize offset = reader->header.header_size, allocated = 0;
+
+  reader->n_row_groups = 0;
+
+  while (offset + GST_ABSTS_ROW_GROUP_HEADER_SIZE <= reader->length) {
+    GstAbstsRowGroup group;
+    guint64 size = GST_ABSTS_ROW_GROUP_HEADER_SIZE;
+    guint i;
+
+    if (!gst_absts_row_group_header_read (reader->contents + offset, &group))
+      break;
+    for (i = 0; i < GST_ABSTS_N_COLUMNS; i++)
+      size += group.sizes[i];
+    if (offset + size > reader->length)
+      break;
+
+    if (reader->n_row_groups == allocated) {
+      allocated = MAX (allocated * 2, 16);
+      reader->row_groups = g_renew (GstAbstsRowGroup, reader->row_groups, allocated);
+    }
+    group.offset = offset;
+    reader->row_groups[reader->n_row_groups++] = group;
+
+    offset += size;
+  }
+}
+
+GstAbstsColumnarReader *
+gst_absts_columnar_reader_open (const gchar * filename, GError ** error)
+{
+  GstAbstsColumnarReader *reader;
+  GMappedFile *mapped_file;
+  GstAbstsHeader header;
+  const guint8 *contents;
+  gsize length;
+
+  mapped_file = g_mapped_file_new (filename, FALSE, error);
+  if (mapped_file == NULL)
+    return NULL;
+
+  contents = (const guint8 *) g_mapped_file_get_contents (mapped_file);
+  length = g_mapped_file_get_length (mapped_file);
+
+  if (length < GST_ABSTS_HEADER_SIZE ||
+      !gst_absts_header_read_with_magic (contents, GST_ABSTS_COLUMNAR_MAGIC, &header)) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_FORMAT,
+        "\"%s\" is not a columnar timestamp log", filename);
+    g_mapped_file_unref (mapped_file);
+    return NULL;
+  }
+
+  if (header.version < 1 || header.header_size < GST_ABSTS_HEADER_SIZE || header.header_size > length) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_VERSION,
+        "\"%s\" has an unsupported layout (version %u, header %u bytes)", filename,
+        header.version, header.header_size);
+    g_mapped_file_unref (mapped_file);
+    return NULL;
+  }
+
+  reader = g_new0 (GstAbstsColumnarReader, 1);
+  reader->mapped_file = mapped_file;
+  reader->contents = contents;
+  reader->length = length;
+  reader->header = header;
+
+  reader->complete = read_footer (reader);
+  if (!reader->complete) {
+    g_free (reader->row_groups);
+    reader->row_groups = NULL;
+    walk_row_groups (reader);
+  }
+
+  return reader;
+}
+
+void
+gst_absts_columnar_reader_close (GstAbstsColumnarReader * reader)
+{
+  g_mapped_file_unref (reader->mapped_file);
+  g_free (reader->row_groups);
+  g_free (reader);
+}
+
+const GstAbstsHeader *
+gst_absts_columnar_reader_get_header (GstAbstsColumnarReader * reader)
+{
+  return &reader->header;
+}
+
+// Whether the file has its footer, i.e. the writer closed it properly.
+gboolean
+gst_absts_columnar_reader_is_complete (GstAbstsColumnarReader * reader)
+{
+  return reader->complete;
+}
+
+gsize
+gst_absts_columnar_reader_get_n_row_groups (GstAbstsColumnarReader * reader)
+{
+  return reader->n_row_groups;
+}
+
+// The offset, count and statistics of a row group, in file order. The column sizes are only known
+// once it has been decoded, if the file has a footer.
+const GstAbstsRowGroup *
+gst_absts_columnar_reader_get_row_group (GstAbstsColumnarReader * reader, gsize index)
+{
+  g_return_val_if_fail (index < reader->n_row_groups, NULL);
+
+  return &reader->row_groups[index];
+}
+
+static gboolean
+decode_deltas (const guint8 * p, const guint8 * end, guint32 n, guint64 * values)
+{
+  guint64 value, delta, dod, run;
+  guint32 i;
+
+  if ((p = gst_absts_varint_read (p, end, &value)) == NULL)
+    return FALSE;
+  values[0] = value;
+  if (n < 2)
+    return TRUE;
+
+  if ((p = gst_absts_varint_read (p, end, &delta)) == NULL)
+    return FALSE;
+  delta = gst_absts_zigzag_decode (delta);
+  value += delta;
+  values[1] = value;
+
+  for (i = 2; i < n;) {
+    if ((p = gst_absts_varint_read (p, end, &dod)) == NULL)
+      return FALSE;
+    delta += gst_absts_zigzag_decode (dod);
+    value += delta;
+    values[i++] = value;
+
+    if (dod == 0) {
+      if ((p = gst_absts_varint_read (p, end, &run)) == NULL || run > n - i)
+        return FALSE;
+      for (; run > 0; run--) {
+        value += delta;
+        values[i++] = value;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+decode_runs (const guint8 * p, const guint8 * end, guint32 n, guint32 * values)
+{
+  guint32 i = 0;
+
+  while (i < n) {
+    guint64 run, value;
+
+    if ((p = gst_absts_varint_read (p, end, &run)) == NULL ||
+        (p = gst_absts_varint_read (p, end, &value)) == NULL || run == 0 || run > n - i)
+      return FALSE;
+    for (; run > 0; run--)
+      values[i++] = (guint32) value;
+  }
+
+  return TRUE;
+}
+
+// Decodes the columns of row group index into arrays with room for the group's count values each.
+// Any of the arrays may be NULL, those columns are skipped.
+gboolean
+gst_absts_columnar_reader_decode (GstAbstsColumnarReader * reader, gsize index, guint64 * pts,
+    gint64 * wallclock, guint32 * flags, guint32 * stream_ids, GError ** error)
+{
+  GstAbstsRowGroup *group;
+  const guint8 *column;
+  gboolean ok = TRUE;
+  guint64 size = GST_ABSTS_ROW_GROUP_HEADER_SIZE;
+  GstAbstsRowGroup header;
+  guint i;
+
+  g_return_val_if_fail (index < reader->n_row_groups, FALSE);
+  group = &reader->row_groups[index];
+
+  if (!gst_absts_row_group_header_read (reader->contents + group->offset, &header) ||
+      header.count != group->count)
+    goto corrupt;
+  for (i = 0; i < GST_ABSTS_N_COLUMNS; i++)
+    size += header.sizes[i];
+  if (group->offset + size > reader->length)
+    goto corrupt;
+  memcpy (group->sizes, header.sizes, sizeof (group->sizes));
+
+  if (group->count == 0)
+    return TRUE;
+
+  column = reader->contents + group->offset + GST_ABSTS_ROW_GROUP_HEADER_SIZE;
+  if (pts)
+    ok = ok && decode_deltas (column, column + header.sizes[GST_ABSTS_COLUMN_PTS], group->count,
+        pts);
+  column += header.sizes[GST_ABSTS_COLUMN_PTS];
+  // The cast is fine, wallclocks are encoded as u64 and converted back on the way out exactly as by
+  // a cast.
+  if (wallclock)
+    ok = ok && decode_deltas (column, column + header.sizes[GST_ABSTS_COLUMN_WALLCLOCK],
+        group->count, (guint64 *) wallclock);
+  column += header.sizes[GST_ABSTS_COLUMN_WALLCLOCK];
+  if (flags)
+    ok = ok && decode_runs (column, column + header.sizes[GST_ABSTS_COLUMN_FLAGS], group->count,
+        flags);
+  column += header.sizes[GST_ABSTS_COLUMN_FLAGS];
+  if (stream_ids)
+    ok = ok && decode_runs (column, column + header.sizes[GST_ABSTS_COLUMN_STREAM_ID],
+        group->count, stream_ids);
+
+  if (ok)
+    return TRUE;
+
+corrupt:
+  g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_FORMAT,
+      "Row group %" G_GSIZE_FORMAT " at offset %" G_GUINT64_FORMAT " is corrupt", index,
+      group->offset);
+  return FALSE;
+}
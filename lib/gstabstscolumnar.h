@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSTS_COLUMNAR_H_
+#define _GST_ABSTS_COLUMNAR_H_
+
+#include <glib.h>
+
+#include "gstabstsformat.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstAbstsColumnarReader GstAbstsColumnarReader;
+
+GstAbstsColumnarReader *gst_absts_columnar_reader_open (const gchar * filename, GError ** error);
+void gst_absts_columnar_reader_close (GstAbstsColumnarReader * reader);
+
+const GstAbstsHeader *gst_absts_columnar_reader_get_header (GstAbstsColumnarReader * reader);
+gboolean gst_absts_columnar_reader_is_complete (GstAbstsColumnarReader * reader);
+gsize gst_absts_columnar_reader_get_n_row_groups (GstAbstsColumnarReader * reader);
+const GstAbstsRowGroup *gst_absts_columnar_reader_get_row_group (GstAbstsColumnarReader * reader,
+    gsize index);
+
+gboolean gst_absts_columnar_reader_decode (GstAbstsColumnarReader * reader, gsize index,
+    guint64 * pts, gint64 * wallclock, guint32 * flags, guint32 * stream_ids, GError ** error);
+
+G_END_DECLS
+
+#endif
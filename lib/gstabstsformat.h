@@ -0,0 +1,892 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSTS_FORMAT_H_
+#define _GST_ABSTS_FORMAT_H_
+
+#include <string.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// The binary timestamp log written by absolutetimestamps format=binary.
+//
+// A file consists of a fixed header followed by fixed-size records. All values are little-endian.
+// Readers must use header_size and record_size from the header, rather than the sizes below, to
+// locate records - this allows fields to be appended to both in later versions without breaking
+// existing readers.
+//
+// Header:
+//   0  magic[8]     "ABSTSLOG"
+//   8  version      u16
+//  10  header_size  u16 - offset of the first record
+//  12  record_size  u16
+//  14  clock        u16 - GstAbstsClockSource the wallclocks were sampled from
+//  16  flags        u32 - GST_ABSTS_HEADER_FLAG_*
+//  20  mode         u32 - GstAbstsMode, which buffers have a record
+//  24  created      i64 - wallclock, in nanoseconds since the epoch, at which the file was started
+//
+// Record:
+//   0  pts          u64 - GST_BUFFER_PTS of the buffer
+//   8  wallclock    i64 - nanoseconds since the epoch
+//  16  flags        u32 - GST_ABSTS_RECORD_FLAG_* and, in the top 8 bits, the record type
+//  20  stream_id    u32 - which stream the record belongs to, 0 unless GST_ABSTS_HEADER_FLAG_STREAM_IDS
+//
+// A record of type GST_ABSTS_RECORD_TYPE_MODEL is a snapshot of the element's fit of wallclock
+// against pts rather than a sample: wallclock is the fitted wallclock at pts, and the low 23 bits of
+// flags hold the fitted drift, i.e. slope - 1, in signed parts per billion (see gst_absts_model_read).
+//
+// Records of type GST_ABSTS_RECORD_TYPE_SEGMENT and GST_ABSTS_RECORD_TYPE_FLUSH mark where a new
+// segment started or where the stream was flushed, e.g. by a seek. pts is where the new segment
+// starts (G_MAXUINT64 for a flush) and wallclock is when the marker was seen. Samples are only
+// ordered between two markers, see gst_absts_reader_select_segment.
+//
+// A record of type GST_ABSTS_RECORD_TYPE_MODE marks where the element changed which buffers it
+// records, as absolutetimestamps adaptive=true does under pressure from a backlog of records: from
+// the next sample on the mode is the GstAbstsMode in the low 8 bits of flags rather than the
+// header's, until the next such record. The next 8 bits hold the GstAbstsPressure that caused it.
+// pts and wallclock are those of the next sample. See gst_absts_mode_flags.
+//
+// A record of type GST_ABSTS_RECORD_TYPE_SYNC reports how well the host's clock was synchronised, as
+// sampled by absolutetimestamps clock-sync: pts holds how far ahead of its reference the clock was
+// estimated to be, in signed nanoseconds, and the low 23 bits of flags a bound on the error of the
+// clock in microseconds, all ones if it wasn't synchronised. The next bit is the GstAbstsSyncSource.
+// wallclock is that of the next sample. See gst_absts_sync_read.
+//
+// A GST_ABSTS_HEADER_FLAG_ROWS file, written by multiabsolutetimestamps, is a table of several streams
+// sampled together: each row is a run of samples, one per stream that had a buffer in it, sharing a
+// single wallclock reading. The first sample of a row has GST_ABSTS_RECORD_FLAG_ROW, and stream_id is
+// the index of the stream's pad.
+//
+// By default pts is the buffer's GST_BUFFER_PTS. With GST_ABSTS_HEADER_FLAG_RUNNING_TIME or
+// GST_ABSTS_HEADER_FLAG_STREAM_TIME it's the buffer's running time or stream time instead.
+//
+// Further fields of the buffer, chosen with absolutetimestamps fields, follow the stream_id as u64s.
+// Each is only there if its header flag is set, and those that are come in this order, so that
+// record_size is GST_ABSTS_RECORD_SIZE plus 8 for each:
+//
+//      dts          u64 - GST_BUFFER_DTS, with GST_ABSTS_HEADER_FLAG_DTS
+//      duration     u64 - GST_BUFFER_DURATION, with GST_ABSTS_HEADER_FLAG_DURATION
+//      offset       u64 - GST_BUFFER_OFFSET, with GST_ABSTS_HEADER_FLAG_OFFSET
+//      size         u64 - gst_buffer_get_size, with GST_ABSTS_HEADER_FLAG_SIZE
+//
+// They're G_MAXUINT64 where the buffer didn't have one and in anything but samples. See
+// gst_absts_fields_read.
+
+// Seek index, written next to a log as "<log>.idx" by absolutetimestamps seek-index=true. It holds
+// one entry for roughly every seek-index-interval of wallclock, so that a text log, whose lines vary
+// in length, can be entered near any point in time without scanning it:
+//
+// Header:
+//   0  magic[8]     "ABSTSIDX"
+//   8  version      u16
+//  10  header_size  u16 - offset of the first entry
+//  12  entry_size   u16
+//  14  log_format   u16 - GstAbstsLogFormat of the log
+//
+// Entry:
+//   0  wallclock    i64 - of the record at offset
+//   8  pts          u64 - of the record at offset
+//  16  offset       u64 - byte offset in the log of the record, i.e. the start of its line in text
+
+// Columnar log, written by absolutetimestamps format=columnar for bulk analysis. It holds the same
+// records as a binary log, but in row groups of up to GST_ABSTS_ROW_GROUP_MAX_RECORDS records that are
+// each stored column by column and delta-encoded. A header like a log's, under its own magic and with
+// record_size 0, is followed by the row groups and, once the writer has closed the file, a footer
+// indexing them:
+//
+// Row group:
+//   0  magic[4]       "ABRG"
+//   4  count          u32 - number of records
+//   8  min_pts        u64 - of the samples in the group, G_MAXUINT64 if there are none
+//  16  max_pts        u64 - 0 if there are no samples
+//  24  min_wallclock  i64 - of all the records
+//  32  max_wallclock  i64
+//  40  sizes          u32[4] - bytes taken by each of the pts, wallclock, flags and stream_id
+//                     columns, which follow the header in that order
+//
+// The pts and wallclock columns hold the first value as a varint, then the difference between the
+// first two as a zigzag varint and then, for each further value, the difference between its delta
+// and the previous one (its delta-of-delta) as a zigzag varint. A delta-of-delta of 0 is followed by
+// a varint count of how many more of the following values also have a delta-of-delta of 0, so a
+// stream whose pts advance by a constant step costs a few bytes per row group. All arithmetic is on
+// u64 and wraps around. The flags and stream_id columns are runs: the number of consecutive records
+// with the same value, then the value, both as varints.
+//
+// Varints are little-endian base 128, 7 bits per byte with the top bit set on all but the last,
+// and zigzag maps signed values to unsigned ones as 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+//
+// Footer entry, one per row group:
+//   0  offset         u64 - of the row group's header in the file
+//   8  count          u32
+//  12  reserved       u32
+//  16  min_pts ...    to max_wallclock as in the row group header
+//
+// Trailer, the last GST_ABSTS_COLUMNAR_TRAILER_SIZE bytes of a complete file:
+//   0  footer_offset  u64 - of the first footer entry
+//   8  n_groups       u32
+//  12  magic[4]       "ABCF"
+//
+// A file without a trailer, e.g. one whose writer was killed, can still be read by walking the row
+// groups from the header, see gst_absts_columnar_reader_open.
+//
+// Block log, written by absolutetimestamps format=blocks for recordings that have to survive the
+// recorder being killed. It holds the same records as a binary log, but framed in blocks of
+// GST_ABSTS_BLOCK_SIZE bytes that are each checksummed, so that a torn write is detected without
+// scanning the file. A header like a log's, under its own magic and padded to a whole block (i.e.
+// header_size is GST_ABSTS_BLOCK_SIZE), is followed by the blocks:
+//
+// Block:
+//   0  magic[4]     "ABBK"
+//   4  crc          u32 - CRC-32, as in zlib and gzip, of the rest of the block from byte 8 on
+//   8  sequence     u32 - number of the block in the file, counting from 0
+//  12  count        u32 - number of records, at most GST_ABSTS_BLOCK_CAPACITY (record_size)
+//  16  records      as in a log, followed by zeros up to the end of the block
+//
+// A block is only ever written whole and appended, so after a crash only the blocks at the end of
+// the file can be torn: a reader walks back from the last block to the first one that is intact and
+// ignores everything after it, see gst_absts_block_reader_open. Any block but the last may be
+// partially filled, as every flush ends a block.
+
+// Datagram, sent by absolutetimestamps sink=udp and sink=unix. Each holds a batch of up to
+// GST_ABSTS_DATAGRAM_MAX_RECORDS records, encoded as in a log, after a header like a log's:
+//
+// Header:
+//   0  magic[8]     "ABSTSDGM"
+//   8  ...          version to mode as in a log header
+//  24  sequence     u64 - how many records were sent before the first of this datagram, so that a
+//                         gap shows how many were lost
+//
+// Shared memory ring, created by absolutetimestamps sink=shm as a POSIX shared memory object. The
+// element is the only writer and overwrites the oldest record once the ring is full, consumers only
+// ever read, see gst_absts_shm_reader_next. head and the slot sequences are updated atomically
+// and so are in host byte order, the ring never leaves the machine:
+//
+// Header:
+//   0  magic[8]     "ABSTSSHM"
+//   8  ...          version to created as in a log header, with header_size the offset of the first slot
+//  32  capacity     u32 - number of slots, a power of two
+//  36  slot_size    u32
+//  64  head         u32 - sequence number of the next record to be written, on a cache line of its own
+//  68  closed       u32 - non-zero once the writer has gone, a new ring may since have replaced this one
+//
+// Slot, record n lives in slot n % capacity:
+//   0  sequence     u32 - n + 1 once record n is complete, anything else while it's being written
+//   4  reserved     u32
+//   8  record       as in a log
+//
+// Sequence numbers run freely and wrap around at 2^32.
+
+#define GST_ABSTS_MAGIC "ABSTSLOG"
+#define GST_ABSTS_MAGIC_SIZE 8
+#define GST_ABSTS_VERSION 1
+
+#define GST_ABSTS_HEADER_SIZE 32
+#define GST_ABSTS_RECORD_SIZE 24
+
+#define GST_ABSTS_INDEX_MAGIC "ABSTSIDX"
+#define GST_ABSTS_INDEX_VERSION 1
+#define GST_ABSTS_INDEX_HEADER_SIZE 16
+#define GST_ABSTS_INDEX_ENTRY_SIZE 24
+
+#define GST_ABSTS_COLUMNAR_MAGIC "ABSTSCOL"
+#define GST_ABSTS_ROW_GROUP_MAGIC "ABRG"
+#define GST_ABSTS_ROW_GROUP_MAGIC_SIZE 4
+#define GST_ABSTS_ROW_GROUP_HEADER_SIZE 56
+#define GST_ABSTS_ROW_GROUP_MAX_RECORDS 4096
+#define GST_ABSTS_ROW_GROUP_ENTRY_SIZE 48
+#define GST_ABSTS_COLUMNAR_TRAILER_MAGIC "ABCF"
+#define GST_ABSTS_COLUMNAR_TRAILER_SIZE 16
+// The longest u64 varint.
+#define GST_ABSTS_VARINT_MAX_SIZE 10
+
+typedef enum
+{
+  GST_ABSTS_COLUMN_PTS = 0,
+  GST_ABSTS_COLUMN_WALLCLOCK = 1,
+  GST_ABSTS_COLUMN_FLAGS = 2,
+  GST_ABSTS_COLUMN_STREAM_ID = 3,
+  GST_ABSTS_N_COLUMNS = 4
+} GstAbstsColumn;
+
+#define GST_ABSTS_BLOCK_LOG_MAGIC "ABSTSBLK"
+#define GST_ABSTS_BLOCK_MAGIC "ABBK"
+#define GST_ABSTS_BLOCK_MAGIC_SIZE 4
+// A page, so that blocks stay aligned for direct I/O.
+#define GST_ABSTS_BLOCK_SIZE 4096
+#define GST_ABSTS_BLOCK_HEADER_SIZE 16
+#define GST_ABSTS_BLOCK_CAPACITY(record_size) ((GST_ABSTS_BLOCK_SIZE - GST_ABSTS_BLOCK_HEADER_SIZE) / (record_size))
+// Of records without any fields, the most a block can hold.
+#define GST_ABSTS_BLOCK_MAX_RECORDS GST_ABSTS_BLOCK_CAPACITY (GST_ABSTS_RECORD_SIZE)
+
+#define GST_ABSTS_DATAGRAM_MAGIC "ABSTSDGM"
+// Keeps a datagram within a single 1500 byte Ethernet frame, even over IPv6.
+#define GST_ABSTS_DATAGRAM_MAX_RECORDS 58
+#define GST_ABSTS_DATAGRAM_MAX_SIZE (GST_ABSTS_HEADER_SIZE + GST_ABSTS_DATAGRAM_MAX_RECORDS * GST_ABSTS_RECORD_SIZE)
+
+#define GST_ABSTS_SHM_MAGIC "ABSTSSHM"
+#define GST_ABSTS_SHM_HEADER_SIZE 128
+#define GST_ABSTS_SHM_SLOT_SIZE 32
+#define GST_ABSTS_SHM_CAPACITY_OFFSET 32
+#define GST_ABSTS_SHM_SLOT_SIZE_OFFSET 36
+#define GST_ABSTS_SHM_HEAD_OFFSET 64
+#define GST_ABSTS_SHM_CLOSED_OFFSET 68
+#define GST_ABSTS_SHM_SLOT_RECORD_OFFSET 8
+
+// Records from several streams are interleaved in the file, see absolutetimestamps writer-group.
+// Within each stream pts and wallclock grow as usual, but not across the file as a whole.
+#define GST_ABSTS_HEADER_FLAG_STREAM_IDS  (1 << 0)
+// GST_ABSTS_RECORD_TYPE_MODEL records are interleaved with the samples.
+#define GST_ABSTS_HEADER_FLAG_MODELS      (1 << 1)
+// GST_ABSTS_RECORD_TYPE_SEGMENT and GST_ABSTS_RECORD_TYPE_FLUSH records are interleaved with the samples.
+#define GST_ABSTS_HEADER_FLAG_MARKERS     (1 << 2)
+#define GST_ABSTS_HEADER_FLAG_RUNNING_TIME (1 << 3)
+#define GST_ABSTS_HEADER_FLAG_STREAM_TIME (1 << 4)
+// Samples come in rows sharing one wallclock, see GST_ABSTS_RECORD_FLAG_ROW. Implies STREAM_IDS.
+#define GST_ABSTS_HEADER_FLAG_ROWS        (1 << 5)
+// Which fields follow the stream_id of every record.
+#define GST_ABSTS_HEADER_FLAG_DTS         (1 << 6)
+#define GST_ABSTS_HEADER_FLAG_DURATION    (1 << 7)
+#define GST_ABSTS_HEADER_FLAG_OFFSET      (1 << 8)
+#define GST_ABSTS_HEADER_FLAG_SIZE        (1 << 9)
+// GST_ABSTS_RECORD_TYPE_MODE records may change the mode of the header along the way.
+#define GST_ABSTS_HEADER_FLAG_MODES       (1 << 10)
+// GST_ABSTS_RECORD_TYPE_SYNC records are interleaved with the samples.
+#define GST_ABSTS_HEADER_FLAG_SYNC        (1 << 11)
+#define GST_ABSTS_HEADER_FIELDS_SHIFT 6
+#define GST_ABSTS_HEADER_FIELDS_MASK (0xfU << GST_ABSTS_HEADER_FIELDS_SHIFT)
+#define GST_ABSTS_FIELD_BYTES 8
+
+#define GST_ABSTS_RECORD_FLAG_DISCONT     (1 << 0)
+#define GST_ABSTS_RECORD_FLAG_DELTA_UNIT  (1 << 1)
+// The first sample of a row in a GST_ABSTS_HEADER_FLAG_ROWS file.
+#define GST_ABSTS_RECORD_FLAG_ROW         (1 << 2)
+
+#define GST_ABSTS_RECORD_TYPE_SHIFT 24
+#define GST_ABSTS_RECORD_TYPE_MASK (0xffU << GST_ABSTS_RECORD_TYPE_SHIFT)
+#define GST_ABSTS_RECORD_TYPE(flags) (((flags) & GST_ABSTS_RECORD_TYPE_MASK) >> GST_ABSTS_RECORD_TYPE_SHIFT)
+
+typedef enum
+{
+  GST_ABSTS_RECORD_TYPE_SAMPLE = 0,
+  GST_ABSTS_RECORD_TYPE_MODEL = 1,
+  GST_ABSTS_RECORD_TYPE_SEGMENT = 2,
+  GST_ABSTS_RECORD_TYPE_FLUSH = 3,
+  GST_ABSTS_RECORD_TYPE_MODE = 4,
+  GST_ABSTS_RECORD_TYPE_SYNC = 5
+} GstAbstsRecordType;
+
+// How far behind the writer was when a GST_ABSTS_RECORD_TYPE_MODE record was written.
+typedef enum
+{
+  GST_ABSTS_PRESSURE_NONE = 0,
+  GST_ABSTS_PRESSURE_ELEVATED = 1,
+  GST_ABSTS_PRESSURE_CRITICAL = 2
+} GstAbstsPressure;
+
+#define GST_ABSTS_MODE_RECORD_MODE(flags) ((GstAbstsMode) ((flags) & 0xff))
+#define GST_ABSTS_MODE_RECORD_PRESSURE(flags) ((GstAbstsPressure) (((flags) >> 8) & 0xff))
+
+// What the estimates of a GST_ABSTS_RECORD_TYPE_SYNC record were taken from.
+typedef enum
+{
+  GST_ABSTS_SYNC_SOURCE_KERNEL = 0,     /* the kernel's NTP state, see adjtimex(2) */
+  GST_ABSTS_SYNC_SOURCE_PTP = 1         /* the statistics of GStreamer's PTP clock */
+} GstAbstsSyncSource;
+
+#define GST_ABSTS_SYNC_ERROR_BITS 23
+#define GST_ABSTS_SYNC_ERROR_MAX ((1U << GST_ABSTS_SYNC_ERROR_BITS) - 1)
+
+#define GST_ABSTS_MODEL_DRIFT_BITS 23
+#define GST_ABSTS_MODEL_DRIFT_MAX ((1 << (GST_ABSTS_MODEL_DRIFT_BITS - 1)) - 1)
+#define GST_ABSTS_MODEL_DRIFT_MASK ((1U << GST_ABSTS_MODEL_DRIFT_BITS) - 1)
+
+// The timescale of the wallclock values in a log. All are nanoseconds since the epoch except monotonic-raw
+// (since boot) and pipeline (whatever the pipeline clock uses, e.g. the PTP epoch for a GstPtpClock).
+typedef enum
+{
+  GST_ABSTS_CLOCK_SOURCE_REALTIME = 0,
+  GST_ABSTS_CLOCK_SOURCE_PIPELINE = 1,
+  GST_ABSTS_CLOCK_SOURCE_MONOTONIC_RAW = 2,
+  GST_ABSTS_CLOCK_SOURCE_TAI = 3,
+  GST_ABSTS_CLOCK_SOURCE_RUNNING_TIME = 4
+} GstAbstsClockSource;
+
+// Which buffers were recorded. Unless every buffer was, the wallclock of those in between the
+// records has to be reconstructed, see gst_absts_reader_interpolate_wallclock.
+typedef enum
+{
+  GST_ABSTS_MODE_EVERY_BUFFER = 0,
+  GST_ABSTS_MODE_EVERY_NTH = 1,         /* every n'th buffer, interpolate between records */
+  GST_ABSTS_MODE_KEYFRAMES_ONLY = 2,    /* buffers without DELTA_UNIT, interpolate between records */
+  GST_ABSTS_MODE_DRIFT_ONLY = 3         /* only once wallclock - pts drifts, extrapolate from the last record */
+} GstAbstsMode;
+
+typedef enum
+{
+  GST_ABSTS_LOG_FORMAT_TEXT = 0,
+  GST_ABSTS_LOG_FORMAT_BINARY = 1,
+  GST_ABSTS_LOG_FORMAT_COLUMNAR = 2,
+  GST_ABSTS_LOG_FORMAT_BLOCKS = 3
+} GstAbstsLogFormat;
+
+// Indices into the values of gst_absts_fields_read, bit i of the fields is
+// GST_ABSTS_HEADER_FLAG_DTS << i.
+typedef enum
+{
+  GST_ABSTS_FIELD_DTS = 0,
+  GST_ABSTS_FIELD_DURATION = 1,
+  GST_ABSTS_FIELD_OFFSET = 2,
+  GST_ABSTS_FIELD_SIZE = 3,
+  GST_ABSTS_N_FIELDS = 4
+} GstAbstsField;
+
+typedef struct _GstAbstsHeader GstAbstsHeader;
+typedef struct _GstAbstsRecord GstAbstsRecord;
+typedef struct _GstAbstsModel GstAbstsModel;
+typedef struct _GstAbstsSync GstAbstsSync;
+typedef struct _GstAbstsIndexEntry GstAbstsIndexEntry;
+typedef struct _GstAbstsRowGroup GstAbstsRowGroup;
+
+struct _GstAbstsHeader
+{
+  guint16 version;
+  guint16 header_size;
+  guint16 record_size;
+  guint16 clock_source;
+  guint32 flags;
+  guint32 mode;
+  gint64 created;
+};
+
+struct _GstAbstsRecord
+{
+  guint64 pts;
+  gint64 wallclock;
+  guint32 flags;
+  guint32 stream_id;
+};
+
+struct _GstAbstsIndexEntry
+{
+  gint64 wallclock;
+  guint64 pts;
+  guint64 offset;
+};
+
+// A row group header or footer entry. offset is only part of an entry and sizes only of a header.
+struct _GstAbstsRowGroup
+{
+  guint64 offset;
+  guint32 count;
+  guint64 min_pts;
+  guint64 max_pts;
+  gint64 min_wallclock;
+  gint64 max_wallclock;
+  guint32 sizes[GST_ABSTS_N_COLUMNS];
+};
+
+// wallclock = anchor_wallclock + (pts - anchor_pts) * (1 + drift_ppb / 1e9)
+struct _GstAbstsModel
+{
+  guint64 anchor_pts;
+  gint64 anchor_wallclock;
+  gint32 drift_ppb;
+};
+
+// max_error is G_MAXUINT64 if the clock wasn't synchronised.
+struct _GstAbstsSync
+{
+  gint64 wallclock;
+  gint64 offset;
+  guint64 max_error;
+  GstAbstsSyncSource source;
+};
+
+static inline void
+gst_absts_write_uint16_le (guint8 * dest, guint16 value)
+{
+  value = GUINT16_TO_LE (value);
+  memcpy (dest, &value, sizeof (value));
+}
+
+static inline void
+gst_absts_write_uint32_le (guint8 * dest, guint32 value)
+{
+  value = GUINT32_TO_LE (value);
+  memcpy (dest, &value, sizeof (value));
+}
+
+static inline void
+gst_absts_write_uint64_le (guint8 * dest, guint64 value)
+{
+  value = GUINT64_TO_LE (value);
+  memcpy (dest, &value, sizeof (value));
+}
+
+static inline guint16
+gst_absts_read_uint16_le (const guint8 * src)
+{
+  guint16 value;
+
+  memcpy (&value, src, sizeof (value));
+  return GUINT16_FROM_LE (value);
+}
+
+static inline guint32
+gst_absts_read_uint32_le (const guint8 * src)
+{
+  guint32 value;
+
+  memcpy (&value, src, sizeof (value));
+  return GUINT32_FROM_LE (value);
+}
+
+static inline guint64
+gst_absts_read_uint64_le (const guint8 * src)
+{
+  guint64 value;
+
+  memcpy (&value, src, sizeof (value));
+  return GUINT64_FROM_LE (value);
+}
+
+// The size of a record with the fields of header flags.
+static inline guint16
+gst_absts_record_size (guint32 flags)
+{
+  guint32 fields = (flags & GST_ABSTS_HEADER_FIELDS_MASK) >> GST_ABSTS_HEADER_FIELDS_SHIFT;
+  guint16 size = GST_ABSTS_RECORD_SIZE;
+
+  for (; fields != 0; fields >>= 1)
+    size += (fields & 1) * GST_ABSTS_FIELD_BYTES;
+
+  return size;
+}
+
+// dest must have room for GST_ABSTS_HEADER_SIZE bytes. Datagrams and the shared memory ring start
+// with the same header under a magic of their own.
+static inline void
+gst_absts_header_write_with_magic (guint8 * dest, const gchar * magic, gint64 created,
+    GstAbstsClockSource clock_source, guint32 flags, GstAbstsMode mode)
+{
+  memset (dest, 0, GST_ABSTS_HEADER_SIZE);
+  memcpy (dest, magic, GST_ABSTS_MAGIC_SIZE);
+  gst_absts_write_uint16_le (dest + 8, GST_ABSTS_VERSION);
+  gst_absts_write_uint16_le (dest + 10, GST_ABSTS_HEADER_SIZE);
+  gst_absts_write_uint16_le (dest + 12, gst_absts_record_size (flags));
+  gst_absts_write_uint16_le (dest + 14, clock_source);
+  gst_absts_write_uint32_le (dest + 16, flags);
+  gst_absts_write_uint32_le (dest + 20, mode);
+  gst_absts_write_uint64_le (dest + 24, (guint64) created);
+}
+
+static inline void
+gst_absts_header_write (guint8 * dest, gint64 created, GstAbstsClockSource clock_source,
+    guint32 flags, GstAbstsMode mode)
+{
+  gst_absts_header_write_with_magic (dest, GST_ABSTS_MAGIC, created, clock_source, flags, mode);
+}
+
+// src must point at no fewer than GST_ABSTS_HEADER_SIZE bytes. Returns FALSE if the magic doesn't match.
+static inline gboolean
+gst_absts_header_read_with_magic (const guint8 * src, const gchar * magic, GstAbstsHeader * header)
+{
+  if (memcmp (src, magic, GST_ABSTS_MAGIC_SIZE) != 0)
+    return FALSE;
+
+  header->version = gst_absts_read_uint16_le (src + 8);
+  header->header_size = gst_absts_read_uint16_le (src + 10);
+  header->record_size = gst_absts_read_uint16_le (src + 12);
+  header->clock_source = gst_absts_read_uint16_le (src + 14);
+  header->flags = gst_absts_read_uint32_le (src + 16);
+  header->mode = gst_absts_read_uint32_le (src + 20);
+  header->created = (gint64) gst_absts_read_uint64_le (src + 24);
+
+  return TRUE;
+}
+
+static inline gboolean
+gst_absts_header_read (const guint8 * src, GstAbstsHeader * header)
+{
+  return gst_absts_header_read_with_magic (src, GST_ABSTS_MAGIC, header);
+}
+
+// The header of a datagram of n records, the records follow at GST_ABSTS_HEADER_SIZE.
+static inline void
+gst_absts_datagram_header_write (guint8 * dest, GstAbstsClockSource clock_source, guint32 flags,
+    GstAbstsMode mode, guint64 sequence)
+{
+  gst_absts_header_write_with_magic (dest, GST_ABSTS_DATAGRAM_MAGIC, 0, clock_source, flags, mode);
+  gst_absts_write_uint64_le (dest + 24, sequence);
+}
+
+// Returns the number of records in a datagram of length bytes, or -1 if it isn't one. Record i is at
+// src + header->header_size + i * header->record_size and has sequence number *sequence + i.
+static inline gssize
+gst_absts_datagram_read (const guint8 * src, gsize length, GstAbstsHeader * header,
+    guint64 * sequence)
+{
+  if (length < GST_ABSTS_HEADER_SIZE ||
+      !gst_absts_header_read_with_magic (src, GST_ABSTS_DATAGRAM_MAGIC, header) ||
+      header->header_size > length || header->record_size < GST_ABSTS_RECORD_SIZE)
+    return -1;
+
+  *sequence = gst_absts_read_uint64_le (src + 24);
+  header->created = 0;
+
+  return (gssize) ((length - header->header_size) / header->record_size);
+}
+
+// dest must have room for GST_ABSTS_RECORD_SIZE bytes.
+static inline void
+gst_absts_record_write (guint8 * dest, guint64 pts, gint64 wallclock, guint32 flags,
+    guint32 stream_id)
+{
+  gst_absts_write_uint64_le (dest, pts);
+  gst_absts_write_uint64_le (dest + 8, (guint64) wallclock);
+  gst_absts_write_uint32_le (dest + 16, flags);
+  gst_absts_write_uint32_le (dest + 20, stream_id);
+}
+
+static inline void
+gst_absts_record_read (const guint8 * src, GstAbstsRecord * record)
+{
+  record->pts = gst_absts_read_uint64_le (src);
+  record->wallclock = (gint64) gst_absts_read_uint64_le (src + 8);
+  record->flags = gst_absts_read_uint32_le (src + 16);
+  record->stream_id = gst_absts_read_uint32_le (src + 20);
+}
+
+// Writes the fields of header flags out of values, indexed by GstAbstsField, after the record at
+// dest. Returns how many bytes they took.
+static inline gsize
+gst_absts_fields_write (guint8 * dest, guint32 flags, const guint64 * values)
+{
+  guint8 *p = dest + GST_ABSTS_RECORD_SIZE;
+  guint i;
+
+  for (i = 0; i < GST_ABSTS_N_FIELDS; i++) {
+    if (flags & (GST_ABSTS_HEADER_FLAG_DTS << i)) {
+      gst_absts_write_uint64_le (p, values[i]);
+      p += GST_ABSTS_FIELD_BYTES;
+    }
+  }
+
+  return p - dest - GST_ABSTS_RECORD_SIZE;
+}
+
+// Reads the fields of the record at src into values, which has room for GST_ABSTS_N_FIELDS.
+// Fields that aren't in the file are G_MAXUINT64.
+static inline void
+gst_absts_fields_read (const guint8 * src, guint32 flags, guint64 * values)
+{
+  const guint8 *p = src + GST_ABSTS_RECORD_SIZE;
+  guint i;
+
+  for (i = 0; i < GST_ABSTS_N_FIELDS; i++) {
+    values[i] = G_MAXUINT64;
+    if (flags & (GST_ABSTS_HEADER_FLAG_DTS << i)) {
+      values[i] = gst_absts_read_uint64_le (p);
+      p += GST_ABSTS_FIELD_BYTES;
+    }
+  }
+}
+
+// dest must have room for GST_ABSTS_INDEX_HEADER_SIZE bytes.
+static inline void
+gst_absts_index_header_write (guint8 * dest, GstAbstsLogFormat log_format)
+{
+  memcpy (dest, GST_ABSTS_INDEX_MAGIC, GST_ABSTS_MAGIC_SIZE);
+  gst_absts_write_uint16_le (dest + 8, GST_ABSTS_INDEX_VERSION);
+  gst_absts_write_uint16_le (dest + 10, GST_ABSTS_INDEX_HEADER_SIZE);
+  gst_absts_write_uint16_le (dest + 12, GST_ABSTS_INDEX_ENTRY_SIZE);
+  gst_absts_write_uint16_le (dest + 14, log_format);
+}
+
+// dest must have room for GST_ABSTS_INDEX_ENTRY_SIZE bytes.
+static inline void
+gst_absts_index_entry_write (guint8 * dest, gint64 wallclock, guint64 pts, guint64 offset)
+{
+  gst_absts_write_uint64_le (dest, (guint64) wallclock);
+  gst_absts_write_uint64_le (dest + 8, pts);
+  gst_absts_write_uint64_le (dest + 16, offset);
+}
+
+static inline void
+gst_absts_index_entry_read (const guint8 * src, GstAbstsIndexEntry * entry)
+{
+  entry->wallclock = (gint64) gst_absts_read_uint64_le (src);
+  entry->pts = gst_absts_read_uint64_le (src + 8);
+  entry->offset = gst_absts_read_uint64_le (src + 16);
+}
+
+// Writes value as a varint, dest must have room for GST_ABSTS_VARINT_MAX_SIZE bytes. Returns the end.
+static inline guint8 *
+gst_absts_varint_write (guint8 * dest, guint64 value)
+{
+  while (value >= 0x80) {
+    *dest++ = (guint8) (value | 0x80);
+    value >>= 7;
+  }
+  *dest++ = (guint8) value;
+
+  return dest;
+}
+
+// Reads a varint from src, which ends at end. Returns the byte after it, or NULL if it's truncated or
+// too long.
+static inline const guint8 *
+gst_absts_varint_read (const guint8 * src, const guint8 * end, guint64 * value)
+{
+  guint64 result = 0;
+  guint shift;
+
+  for (shift = 0; src < end && shift < 64; shift += 7) {
+    guint8 byte = *src++;
+
+    result |= (guint64) (byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return src;
+    }
+  }
+
+  return NULL;
+}
+
+static inline guint64
+gst_absts_zigzag_encode (guint64 value)
+{
+  return (value << 1) ^ (guint64) ((gint64) value >> 63);
+}
+
+static inline guint64
+gst_absts_zigzag_decode (guint64 value)
+{
+  return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+// dest must have room for GST_ABSTS_ROW_GROUP_HEADER_SIZE bytes.
+static inline void
+gst_absts_row_group_header_write (guint8 * dest, const GstAbstsRowGroup * group)
+{
+  guint i;
+
+  memcpy (dest, GST_ABSTS_ROW_GROUP_MAGIC, GST_ABSTS_ROW_GROUP_MAGIC_SIZE);
+  gst_absts_write_uint32_le (dest + 4, group->count);
+  gst_absts_write_uint64_le (dest + 8, group->min_pts);
+  gst_absts_write_uint64_le (dest + 16, group->max_pts);
+  gst_absts_write_uint64_le (dest + 24, (guint64) group->min_wallclock);
+  gst_absts_write_uint64_le (dest + 32, (guint64) group->max_wallclock);
+  for (i = 0; i < GST_ABSTS_N_COLUMNS; i++)
+    gst_absts_write_uint32_le (dest + 40 + i * 4, group->sizes[i]);
+}
+
+// src must point at no fewer than GST_ABSTS_ROW_GROUP_HEADER_SIZE bytes. Returns FALSE if the magic
+// doesn't match.
+static inline gboolean
+gst_absts_row_group_header_read (const guint8 * src, GstAbstsRowGroup * group)
+{
+  guint i;
+
+  if (memcmp (src, GST_ABSTS_ROW_GROUP_MAGIC, GST_ABSTS_ROW_GROUP_MAGIC_SIZE) != 0)
+    return FALSE;
+
+  group->count = gst_absts_read_uint32_le (src + 4);
+  group->min_pts = gst_absts_read_uint64_le (src + 8);
+  group->max_pts = gst_absts_read_uint64_le (src + 16);
+  group->min_wallclock = (gint64) gst_absts_read_uint64_le (src + 24);
+  group->max_wallclock = (gint64) gst_absts_read_uint64_le (src + 32);
+  for (i = 0; i < GST_ABSTS_N_COLUMNS; i++)
+    group->sizes[i] = gst_absts_read_uint32_le (src + 40 + i * 4);
+
+  return TRUE;
+}
+
+// dest must have room for GST_ABSTS_ROW_GROUP_ENTRY_SIZE bytes.
+static inline void
+gst_absts_row_group_entry_write (guint8 * dest, const GstAbstsRowGroup * group)
+{
+  gst_absts_write_uint64_le (dest, group->offset);
+  gst_absts_write_uint32_le (dest + 8, group->count);
+  gst_absts_write_uint32_le (dest + 12, 0);
+  gst_absts_write_uint64_le (dest + 16, group->min_pts);
+  gst_absts_write_uint64_le (dest + 24, group->max_pts);
+  gst_absts_write_uint64_le (dest + 32, (guint64) group->min_wallclock);
+  gst_absts_write_uint64_le (dest + 40, (guint64) group->max_wallclock);
+}
+
+static inline void
+gst_absts_row_group_entry_read (const guint8 * src, GstAbstsRowGroup * group)
+{
+  memset (group, 0, sizeof (*group));
+  group->offset = gst_absts_read_uint64_le (src);
+  group->count = gst_absts_read_uint32_le (src + 8);
+  group->min_pts = gst_absts_read_uint64_le (src + 16);
+  group->max_pts = gst_absts_read_uint64_le (src + 24);
+  group->min_wallclock = (gint64) gst_absts_read_uint64_le (src + 32);
+  group->max_wallclock = (gint64) gst_absts_read_uint64_le (src + 40);
+}
+
+// dest must have room for GST_ABSTS_COLUMNAR_TRAILER_SIZE bytes.
+static inline void
+gst_absts_columnar_trailer_write (guint8 * dest, guint64 footer_offset, guint32 n_groups)
+{
+  gst_absts_write_uint64_le (dest, footer_offset);
+  gst_absts_write_uint32_le (dest + 8, n_groups);
+  memcpy (dest + 12, GST_ABSTS_COLUMNAR_TRAILER_MAGIC, GST_ABSTS_ROW_GROUP_MAGIC_SIZE);
+}
+
+// Returns FALSE if src isn't a trailer.
+static inline gboolean
+gst_absts_columnar_trailer_read (const guint8 * src, guint64 * footer_offset, guint32 * n_groups)
+{
+  if (memcmp (src + 12, GST_ABSTS_COLUMNAR_TRAILER_MAGIC, GST_ABSTS_ROW_GROUP_MAGIC_SIZE) != 0)
+    return FALSE;
+
+  *footer_offset = gst_absts_read_uint64_le (src);
+  *n_groups = gst_absts_read_uint32_le (src + 8);
+
+  return TRUE;
+}
+
+// CRC-32 with the polynomial of zlib and gzip, so that blocks can be checked with any tool. crc is
+// the CRC of the data before, 0 to start.
+static inline guint32
+gst_absts_crc32 (guint32 crc, const guint8 * data, gsize length)
+{
+  static guint32 table[256];
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    guint32 i, j, value;
+
+    for (i = 0; i < 256; i++) {
+      for (value = i, j = 0; j < 8; j++)
+        value = value & 1 ? 0xedb88320U ^ (value >> 1) : value >> 1;
+      table[i] = value;
+    }
+    g_once_init_leave (&initialized, 1);
+  }
+
+  crc = ~crc;
+  while (length-- > 0)
+    crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+// Fills in the header of the block at dest, whose count records have already been written after
+// GST_ABSTS_BLOCK_HEADER_SIZE and the rest of which must be zeroed.
+static inline void
+gst_absts_block_seal (guint8 * dest, guint32 sequence, guint32 count)
+{
+  memcpy (dest, GST_ABSTS_BLOCK_MAGIC, GST_ABSTS_BLOCK_MAGIC_SIZE);
+  gst_absts_write_uint32_le (dest + 8, sequence);
+  gst_absts_write_uint32_le (dest + 12, count);
+  gst_absts_write_uint32_le (dest + 4, gst_absts_crc32 (0, dest + 8, GST_ABSTS_BLOCK_SIZE - 8));
+}
+
+// Checks the GST_ABSTS_BLOCK_SIZE bytes at src. Returns FALSE unless they're an intact block with
+// the given sequence number, otherwise sets *count to its number of records of record_size bytes.
+static inline gboolean
+gst_absts_block_check (const guint8 * src, guint32 sequence, guint16 record_size, guint32 * count)
+{
+  if (memcmp (src, GST_ABSTS_BLOCK_MAGIC, GST_ABSTS_BLOCK_MAGIC_SIZE) != 0 ||
+      gst_absts_read_uint32_le (src + 8) != sequence ||
+      gst_absts_read_uint32_le (src + 12) > GST_ABSTS_BLOCK_CAPACITY (record_size) ||
+      gst_absts_read_uint32_le (src + 4) != gst_absts_crc32 (0, src + 8, GST_ABSTS_BLOCK_SIZE - 8))
+    return FALSE;
+
+  *count = gst_absts_read_uint32_le (src + 12);
+
+  return TRUE;
+}
+
+// The flags of a GST_ABSTS_RECORD_TYPE_MODE record.
+static inline guint32
+gst_absts_mode_flags (GstAbstsMode mode, GstAbstsPressure pressure)
+{
+  return ((guint32) GST_ABSTS_RECORD_TYPE_MODE << GST_ABSTS_RECORD_TYPE_SHIFT) |
+      ((guint32) pressure & 0xff) << 8 | ((guint32) mode & 0xff);
+}
+
+// The flags of a GST_ABSTS_RECORD_TYPE_SYNC record. max_error, in nanoseconds, is rounded up to whole
+// microseconds so that it stays a bound, and G_MAXUINT64 means the clock isn't synchronised.
+static inline guint32
+gst_absts_sync_flags (GstAbstsSyncSource source, guint64 max_error)
+{
+  guint32 error_us = max_error == G_MAXUINT64 ? GST_ABSTS_SYNC_ERROR_MAX :
+      (guint32) MIN (max_error / 1000 + (max_error % 1000 != 0), GST_ABSTS_SYNC_ERROR_MAX - 1);
+
+  return ((guint32) GST_ABSTS_RECORD_TYPE_SYNC << GST_ABSTS_RECORD_TYPE_SHIFT) |
+      ((guint32) source & 1) << GST_ABSTS_SYNC_ERROR_BITS | error_us;
+}
+
+static inline void
+gst_absts_sync_read (const GstAbstsRecord * record, GstAbstsSync * sync)
+{
+  guint32 error_us = record->flags & GST_ABSTS_SYNC_ERROR_MAX;
+
+  sync->wallclock = record->wallclock;
+  sync->offset = (gint64) record->pts;
+  sync->max_error = error_us == GST_ABSTS_SYNC_ERROR_MAX ? G_MAXUINT64 : (guint64) error_us * 1000;
+  sync->source = (GstAbstsSyncSource) ((record->flags >> GST_ABSTS_SYNC_ERROR_BITS) & 1);
+}
+
+// The flags of a GST_ABSTS_RECORD_TYPE_MODEL record, drift_ppb is clamped to what fits.
+static inline guint32
+gst_absts_model_flags (gint32 drift_ppb)
+{
+  drift_ppb = CLAMP (drift_ppb, -GST_ABSTS_MODEL_DRIFT_MAX, GST_ABSTS_MODEL_DRIFT_MAX);
+
+  return ((guint32) GST_ABSTS_RECORD_TYPE_MODEL << GST_ABSTS_RECORD_TYPE_SHIFT) |
+      ((guint32) drift_ppb & GST_ABSTS_MODEL_DRIFT_MASK);
+}
+
+static inline void
+gst_absts_model_read (const GstAbstsRecord * record, GstAbstsModel * model)
+{
+  guint32 drift = record->flags & GST_ABSTS_MODEL_DRIFT_MASK;
+
+  model->anchor_pts = record->pts;
+  model->anchor_wallclock = record->wallclock;
+  // Sign-extend from GST_ABSTS_MODEL_DRIFT_BITS.
+  model->drift_ppb = (gint32) (drift ^ (1U << (GST_ABSTS_MODEL_DRIFT_BITS - 1))) -
+      (1 << (GST_ABSTS_MODEL_DRIFT_BITS - 1));
+}
+
+static inline gint64
+gst_absts_model_predict_wallclock (const GstAbstsModel * model, guint64 pts)
+{
+  gint64 elapsed = (gint64) (pts - model->anchor_pts);
+
+  return model->anchor_wallclock + elapsed + (gint64) ((gdouble) elapsed * model->drift_ppb / 1e9);
+}
+
+static inline guint64
+gst_absts_model_predict_pts (const GstAbstsModel * model, gint64 wallclock)
+{
+  gdouble elapsed = (gdouble) (wallclock - model->anchor_wallclock) / (1.0 + model->drift_ppb / 1e9);
+
+  return model->anchor_pts + (guint64) (gint64) elapsed;
+}
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// A reader for the seek index written next to a log by absolutetimestamps seek-index=true. Like the
+// log reader it memory-maps the file, and as entries are fixed-size and in order of wallclock (and,
+// within a segment, of pts), finding the entry to start reading the log from is a binary search.
+
+#include "gstabstsindex.h"
+#include "gstabstsreader.h"
+
+struct _GstAbstsIndex
+{
+  GMappedFile *mapped_file;
+  const guint8 *entries;
+  gsize n_entries;
+  guint16 entry_size;
+  GstAbstsLogFormat log_format;
+};
+
+GstAbstsIndex *
+gst_absts_index_open (const gchar * filename, GError ** error)
+{
+  GstAbstsIndex *index;
+  GMappedFile *mapped_file;
+  const guint8 *contents;
+  gsize length;
+  guint16 header_size, entry_size;
+
+  mapped_file = g_mapped_file_new (filename, FALSE, error);
+  if (mapped_file == NULL)
+    return NULL;
+
+  contents = (const guint8 *) g_mapped_file_get_contents (mapped_file);
+  length = g_mapped_file_get_length (mapped_file);
+
+  if (length < GST_ABSTS_INDEX_HEADER_SIZE ||
+      memcmp (contents, GST_ABSTS_INDEX_MAGIC, GST_ABSTS_MAGIC_SIZE) != 0) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_FORMAT,
+        "\"%s\" is not a timestamp log index", filename);
+    goto fail;
+  }
+
+  header_size = gst_absts_read_uint16_le (contents + 10);
+  entry_size = gst_absts_read_uint16_le (contents + 12);
+
+  if (gst_absts_read_uint16_le (contents + 8) < 1 || header_size < GST_ABSTS_INDEX_HEADER_SIZE ||
+      entry_size < GST_ABSTS_INDEX_ENTRY_SIZE || header_size > length) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_VERSION,
+        "\"%s\" has an unsupported layout (header %u bytes, entry %u bytes)", filename,
+        header_size, entry_size);
+    goto fail;
+  }
+
+  index = g_new0 (GstAbstsIndex, 1);
+  index->mapped_file = mapped_file;
+  index->entries = contents + header_size;
+  index->n_entries = (length - header_size) / entry_size;
+  index->entry_size = entry_size;
+  index->log_format = (GstAbstsLogFormat) gst_absts_read_uint16_le (contents + 14);
+
+  return index;
+
+fail:
+  g_mapped_file_unref (mapped_file);
+  return NULL;
+}
+
+void
+gst_absts_index_close (GstAbstsIndex * index)
+{
+  g_mapped_file_unref (index->mapped_file);
+  g_free (index);
+}
+
+GstAbstsLogFormat
+gst_absts_index_get_log_format (GstAbstsIndex * index)
+{
+  return index->log_format;
+}
+
+gsize
+gst_absts_index_get_n_entries (GstAbstsIndex * index)
+{
+  return index->n_entries;
+}
+
+gboolean
+gst_absts_index_get_entry (GstAbstsIndex * index, gsize i, GstAbstsIndexEntry * entry)
+{
+  if (i >= index->n_entries)
+    return FALSE;
+
+  gst_absts_index_entry_read (index->entries + i * index->entry_size, entry);
+
+  return TRUE;
+}
+
+// Returns the last entry whose wallclock is no later than wallclock, or -1 if there is none - the
+// log has to be read from its start then.
+gssize
+gst_absts_index_find_wallclock (GstAbstsIndex * index, gint64 wallclock)
+{
+  gsize low = 0, high = index->n_entries;
+
+  while (low < high) {
+    gsize mid = low + (high - low) / 2;
+
+    if ((gint64) gst_absts_read_uint64_le (index->entries + mid * index->entry_size) <= wallclock)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return (gssize) low - 1;
+}
+
+// Returns the last entry whose pts is no later than pts, or -1 if there is none.
+gssize
+gst_absts_index_find_pts (GstAbstsIndex * index, guint64 pts)
+{
+  gsize low = 0, high = index->n_entries;
+
+  while (low < high) {
+    gsize mid = low + (high - low) / 2;
+
+    if (gst_absts_read_uint64_le (index->entries + mid * index->entry_size + 8) <= pts)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return (gssize) low - 1;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSTS_INDEX_H_
+#define _GST_ABSTS_INDEX_H_
+
+#include <glib.h>
+
+#include "gstabstsformat.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstAbstsIndex GstAbstsIndex;
+
+GstAbstsIndex *gst_absts_index_open (const gchar * filename, GError ** error);
+void gst_absts_index_close (GstAbstsIndex * index);
+
+GstAbstsLogFormat gst_absts_index_get_log_format (GstAbstsIndex * index);
+gsize gst_absts_index_get_n_entries (GstAbstsIndex * index);
+gboolean gst_absts_index_get_entry (GstAbstsIndex * index, gsize i, GstAbstsIndexEntry * entry);
+
+gssize gst_absts_index_find_wallclock (GstAbstsIndex * index, gint64 wallclock);
+gssize gst_absts_index_find_pts (GstAbstsIndex * index, guint64 pts);
+
+G_END_DECLS
+
+#endif
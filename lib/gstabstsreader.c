@@ -0,0 +1,544 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// A reader for the binary timestamp log written by absolutetimestamps format=binary.
+//
+// The file is memory-mapped rather than read, so opening even a multi-day log is cheap and only the
+// pages touched by a lookup are ever faulted in. As records are fixed-size, and both pts and
+// wallclock only ever grow, any record can be addressed directly and lookups in either direction
+// are a binary search.
+//
+// That only holds per stream, so for a file with GST_ABSTS_HEADER_FLAG_STREAM_IDS a stream has to be
+// selected first - the reader then works through an index of that stream's records instead. The same
+// index keeps the model snapshots of a GST_ABSTS_HEADER_FLAG_MODELS file out of the way of lookups,
+// and the mode changes of a GST_ABSTS_HEADER_FLAG_MODES file, which decide how to interpolate, as
+// well as the clock-sync reports of a GST_ABSTS_HEADER_FLAG_SYNC file.
+//
+// Likewise pts only grow within a segment, so after a seek or flush, a narrower selection is needed
+// still: a segment of the stream, as delimited by the markers of a GST_ABSTS_HEADER_FLAG_MARKERS file.
+//
+// Indexing a file costs a scan of it, so it's left to the first call that needs the index rather
+// than done on open.
+
+#include "gstabstsreader.h"
+
+struct _GstAbstsReader
+{
+  GMappedFile *mapped_file;
+  const guint8 *records;
+  gsize n_records;
+  GstAbstsHeader header;
+
+  gsize n_file_records;
+  gboolean index_pending;       /* the file needs an index that hasn't been built yet */
+  gsize *selection;             /* file indices of the selected stream's records, or NULL */
+  gsize n_selected;
+  gsize window;                 /* index into selection of the selected segment's first record */
+  gsize *segments;              /* indices into selection at which each segment starts */
+  gsize n_segments;
+
+  gsize *models;                /* file indices of the selected stream's model snapshots */
+  gsize n_models;
+  gsize *modes;                 /* file indices of the selected stream's mode changes */
+  gsize n_modes;
+  gsize *syncs;                 /* file indices of the selected stream's clock-sync reports */
+  gsize n_syncs;
+};
+
+G_DEFINE_QUARK (gst-absts-reader-error-quark, gst_absts_reader_error)
+
+static void gst_absts_reader_index (GstAbstsReader * reader, gboolean one_stream,
+    guint32 stream_id);
+
+static inline void
+gst_absts_reader_ensure_index (GstAbstsReader * reader)
+{
+  if (G_UNLIKELY (reader->index_pending))
+    gst_absts_reader_index (reader, FALSE, 0);
+}
+
+GstAbstsReader *
+gst_absts_reader_open (const gchar * filename, GError ** error)
+{
+  GstAbstsReader *reader;
+  GMappedFile *mapped_file;
+  GstAbstsHeader header;
+  const guint8 *contents;
+  gsize length;
+
+  mapped_file = g_mapped_file_new (filename, FALSE, error);
+  if (mapped_file == NULL)
+    return NULL;
+
+  contents = (const guint8 *) g_mapped_file_get_contents (mapped_file);
+  length = g_mapped_file_get_length (mapped_file);
+
+  if (length < GST_ABSTS_HEADER_SIZE || !gst_absts_header_read (contents, &header)) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_FORMAT,
+        "\"%s\" is not a binary timestamp log", filename);
+    goto fail;
+  }
+
+  // Later versions may append fields to the header and to each record but never move existing ones.
+  if (header.version < 1 || header.header_size < GST_ABSTS_HEADER_SIZE ||
+      header.record_size < GST_ABSTS_RECORD_SIZE || header.header_size > length) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_VERSION,
+        "\"%s\" has an unsupported layout (version %u, header %u bytes, record %u bytes)",
+        filename, header.version, header.header_size, header.record_size);
+    goto fail;
+  }
+
+  reader = g_new0 (GstAbstsReader, 1);
+  reader->mapped_file = mapped_file;
+  reader->header = header;
+  reader->records = contents + header.header_size;
+  // A torn final record, e.g. from a writer that was killed, is simply ignored.
+  reader->n_file_records = (length - header.header_size) / header.record_size;
+  reader->n_records = reader->n_file_records;
+
+  reader->index_pending = (header.flags & (GST_ABSTS_HEADER_FLAG_MODELS |
+          GST_ABSTS_HEADER_FLAG_MARKERS | GST_ABSTS_HEADER_FLAG_MODES |
+          GST_ABSTS_HEADER_FLAG_SYNC)) != 0;
+
+  return reader;
+
+fail:
+  g_mapped_file_unref (mapped_file);
+  return NULL;
+}
+
+void
+gst_absts_reader_close (GstAbstsReader * reader)
+{
+  g_mapped_file_unref (reader->mapped_file);
+  g_free (reader->selection);
+  g_free (reader->models);
+  g_free (reader->modes);
+  g_free (reader->syncs);
+  g_free (reader->segments);
+  g_free (reader);
+}
+
+const GstAbstsHeader *
+gst_absts_reader_get_header (GstAbstsReader * reader)
+{
+  return &reader->header;
+}
+
+gsize
+gst_absts_reader_get_n_records (GstAbstsReader * reader)
+{
+  gst_absts_reader_ensure_index (reader);
+
+  return reader->n_records;
+}
+
+static inline const guint8 *
+gst_absts_reader_record_at (GstAbstsReader * reader, gsize index)
+{
+  if (reader->selection)
+    index = reader->selection[reader->window + index];
+
+  return reader->records + index * reader->header.record_size;
+}
+
+// Appends value to a sparse array, growing it in powers of two.
+static void
+gst_absts_reader_append (gsize ** array, gsize * length, gsize value)
+{
+  if ((*length & (*length - 1)) == 0)
+    *array = g_renew (gsize, *array, MAX (*length * 2, 16));
+  (*array)[(*length)++] = value;
+}
+
+// Splits the samples, of one stream or of all of them, from the model snapshots and markers, and
+// notes where each segment starts.
+static void
+gst_absts_reader_index (GstAbstsReader * reader, gboolean one_stream, guint32 stream_id)
+{
+  gsize i, n = 0;
+
+  reader->index_pending = FALSE;
+  g_free (reader->selection);
+  g_free (reader->models);
+  g_free (reader->modes);
+  g_free (reader->syncs);
+  g_free (reader->segments);
+  reader->selection = g_new (gsize, MAX (reader->n_file_records, 1));
+  reader->models = NULL;
+  reader->n_models = 0;
+  reader->modes = NULL;
+  reader->n_modes = 0;
+  reader->syncs = NULL;
+  reader->n_syncs = 0;
+  reader->segments = NULL;
+  reader->n_segments = 0;
+  // Whatever precedes the first marker, e.g. in a file started by rotation, is a segment too.
+  gst_absts_reader_append (&reader->segments, &reader->n_segments, 0);
+
+  for (i = 0; i < reader->n_file_records; i++) {
+    const guint8 *record = reader->records + i * reader->header.record_size;
+    guint32 type = GST_ABSTS_RECORD_TYPE (gst_absts_read_uint32_le (record + 16));
+
+    if (one_stream && gst_absts_read_uint32_le (record + 20) != stream_id)
+      continue;
+
+    if (type == GST_ABSTS_RECORD_TYPE_SAMPLE) {
+      reader->selection[n++] = i;
+    } else if (type == GST_ABSTS_RECORD_TYPE_MODEL) {
+      gst_absts_reader_append (&reader->models, &reader->n_models, i);
+    } else if (type == GST_ABSTS_RECORD_TYPE_MODE) {
+      gst_absts_reader_append (&reader->modes, &reader->n_modes, i);
+    } else if (type == GST_ABSTS_RECORD_TYPE_SYNC) {
+      gst_absts_reader_append (&reader->syncs, &reader->n_syncs, i);
+    } else if (type == GST_ABSTS_RECORD_TYPE_SEGMENT || type == GST_ABSTS_RECORD_TYPE_FLUSH) {
+      // A flush is usually followed by a segment, don't leave an empty one between them.
+      if (reader->segments[reader->n_segments - 1] != n)
+        gst_absts_reader_append (&reader->segments, &reader->n_segments, n);
+    }
+  }
+
+  reader->n_selected = n;
+  reader->n_records = n;
+  reader->window = 0;
+}
+
+// Restricts all other calls to the records of a single stream and returns how many there are.
+// Selecting a stream costs a scan of the whole file.
+gsize
+gst_absts_reader_select_stream (GstAbstsReader * reader, guint32 stream_id)
+{
+  gst_absts_reader_index (reader, TRUE, stream_id);
+
+  return reader->n_records;
+}
+
+gboolean
+gst_absts_reader_get_record (GstAbstsReader * reader, gsize index,
+    GstAbstsRecord * record)
+{
+  gst_absts_reader_ensure_index (reader);
+
+  if (index >= reader->n_records)
+    return FALSE;
+
+  gst_absts_record_read (gst_absts_reader_record_at (reader, index), record);
+
+  return TRUE;
+}
+
+// Reads the fields of record index, as chosen with absolutetimestamps fields, into values, which has
+// room for GST_ABSTS_N_FIELDS and is indexed by GstAbstsField. Those the log doesn't have are
+// G_MAXUINT64.
+gboolean
+gst_absts_reader_get_fields (GstAbstsReader * reader, gsize index, guint64 * values)
+{
+  gst_absts_reader_ensure_index (reader);
+
+  if (index >= reader->n_records)
+    return FALSE;
+
+  gst_absts_fields_read (gst_absts_reader_record_at (reader, index), reader->header.flags, values);
+
+  return TRUE;
+}
+
+// Returns the index of the last record whose pts is no later than pts, or -1 if there is none.
+gssize
+gst_absts_reader_find_pts (GstAbstsReader * reader, guint64 pts)
+{
+  gsize low = 0, high;
+
+  gst_absts_reader_ensure_index (reader);
+  high = reader->n_records;
+
+  while (low < high) {
+    gsize mid = low + (high - low) / 2;
+
+    if (gst_absts_read_uint64_le (gst_absts_reader_record_at (reader, mid)) <= pts)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return (gssize) low - 1;
+}
+
+// Returns the index of the last record whose wallclock is no later than wallclock, or -1 if there is none.
+gssize
+gst_absts_reader_find_wallclock (GstAbstsReader * reader, gint64 wallclock)
+{
+  gsize low = 0, high;
+
+  gst_absts_reader_ensure_index (reader);
+  high = reader->n_records;
+
+  while (low < high) {
+    gsize mid = low + (high - low) / 2;
+
+    if ((gint64) gst_absts_read_uint64_le (gst_absts_reader_record_at (reader, mid) + 8) <= wallclock)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return (gssize) low - 1;
+}
+
+// Looks up the wallclock of the frame showing at pts, i.e. that of the last record at or before it.
+gboolean
+gst_absts_reader_lookup_wallclock (GstAbstsReader * reader, guint64 pts,
+    gint64 * wallclock)
+{
+  GstAbstsRecord record;
+  gssize index = gst_absts_reader_find_pts (reader, pts);
+
+  if (index < 0)
+    return FALSE;
+
+  gst_absts_reader_get_record (reader, index, &record);
+  *wallclock = record.wallclock;
+
+  return TRUE;
+}
+
+// Looks up the pts of the frame that was current at wallclock, i.e. the last one seen at or before it.
+gboolean
+gst_absts_reader_lookup_pts (GstAbstsReader * reader, gint64 wallclock,
+    guint64 * pts)
+{
+  GstAbstsRecord record;
+  gssize index = gst_absts_reader_find_wallclock (reader, wallclock);
+
+  if (index < 0)
+    return FALSE;
+
+  gst_absts_reader_get_record (reader, index, &record);
+  *pts = record.pts;
+
+  return TRUE;
+}
+
+// How many of the n file indices in indices, which are sorted, come before record index.
+static gsize
+gst_absts_reader_count_before (GstAbstsReader * reader, const gsize * indices, gsize n, gsize index)
+{
+  gsize file_index = reader->selection[reader->window + index];
+  gsize low = 0, high = n;
+
+  while (low < high) {
+    gsize mid = low + (high - low) / 2;
+
+    if (indices[mid] < file_index)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+// Which buffers were being recorded at record index: the header's mode, unless a
+// GST_ABSTS_RECORD_TYPE_MODE record before it changed it.
+static GstAbstsMode
+gst_absts_reader_get_mode (GstAbstsReader * reader, gsize index)
+{
+  gsize n;
+
+  if (reader->n_modes == 0)
+    return (GstAbstsMode) reader->header.mode;
+
+  n = gst_absts_reader_count_before (reader, reader->modes, reader->n_modes, index);
+  if (n == 0)
+    return (GstAbstsMode) reader->header.mode;
+
+  return GST_ABSTS_MODE_RECORD_MODE (gst_absts_read_uint32_le (reader->records +
+          reader->modes[n - 1] * reader->header.record_size + 16));
+}
+
+// Whether the wallclock between record and next can be linearly interpolated, rather than
+// extrapolated from record alone.
+static gboolean
+gst_absts_reader_can_interpolate (GstAbstsReader * reader, gssize index, GstAbstsRecord * next)
+{
+  GstAbstsMode mode = gst_absts_reader_get_mode (reader, index);
+
+  if (mode != GST_ABSTS_MODE_EVERY_NTH && mode != GST_ABSTS_MODE_KEYFRAMES_ONLY)
+    return FALSE;
+
+  if (!gst_absts_reader_get_record (reader, index + 1, next))
+    return FALSE;
+
+  // Nothing can be assumed across a discontinuity.
+  return !(next->flags & GST_ABSTS_RECORD_FLAG_DISCONT);
+}
+
+// Reconstructs the wallclock at any pts, whichever mode the log was recorded in. Between two
+// records of a decimated (every-nth or keyframes-only) log it's interpolated, otherwise it's
+// extrapolated from the last record at or before pts, which for a drift-only log is within its
+// tolerance by construction.
+gboolean
+gst_absts_reader_interpolate_wallclock (GstAbstsReader * reader, guint64 pts,
+    gint64 * wallclock)
+{
+  GstAbstsRecord record, next;
+  gssize index = gst_absts_reader_find_pts (reader, pts);
+
+  if (index < 0)
+    return FALSE;
+
+  gst_absts_reader_get_record (reader, index, &record);
+
+  if (record.pts != pts && gst_absts_reader_can_interpolate (reader, index, &next) &&
+      next.pts > record.pts) {
+    gdouble fraction = (gdouble) (pts - record.pts) / (gdouble) (next.pts - record.pts);
+
+    *wallclock = record.wallclock + (gint64) (fraction * (gdouble) (next.wallclock - record.wallclock));
+  } else {
+    *wallclock = record.wallclock + (gint64) (pts - record.pts);
+  }
+
+  return TRUE;
+}
+
+// The inverse of gst_absts_reader_interpolate_wallclock.
+gboolean
+gst_absts_reader_interpolate_pts (GstAbstsReader * reader, gint64 wallclock, guint64 * pts)
+{
+  GstAbstsRecord record, next;
+  gssize index = gst_absts_reader_find_wallclock (reader, wallclock);
+
+  if (index < 0)
+    return FALSE;
+
+  gst_absts_reader_get_record (reader, index, &record);
+
+  if (record.wallclock != wallclock && gst_absts_reader_can_interpolate (reader, index, &next) &&
+      next.wallclock > record.wallclock) {
+    gdouble fraction = (gdouble) (wallclock - record.wallclock) /
+        (gdouble) (next.wallclock - record.wallclock);
+
+    *pts = record.pts + (guint64) (fraction * (gdouble) (next.pts - record.pts));
+  } else {
+    *pts = record.pts + (guint64) (wallclock - record.wallclock);
+  }
+
+  return TRUE;
+}
+
+gsize
+gst_absts_reader_get_n_models (GstAbstsReader * reader)
+{
+  gst_absts_reader_ensure_index (reader);
+
+  return reader->n_models;
+}
+
+// Gets the last model snapshot at or before pts, which gst_absts_model_predict_wallclock can then
+// evaluate for any pts up to the next one without touching the samples at all.
+gboolean
+gst_absts_reader_get_model (GstAbstsReader * reader, guint64 pts, GstAbstsModel * model)
+{
+  gsize low = 0, high;
+  GstAbstsRecord record;
+
+  gst_absts_reader_ensure_index (reader);
+  high = reader->n_models;
+
+  while (low < high) {
+    gsize mid = low + (high - low) / 2;
+
+    if (gst_absts_read_uint64_le (reader->records + reader->models[mid] * reader->header.record_size) <= pts)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  if (low == 0)
+    return FALSE;
+
+  gst_absts_record_read (reader->records + reader->models[low - 1] * reader->header.record_size,
+      &record);
+  gst_absts_model_read (&record, model);
+
+  return TRUE;
+}
+
+gsize
+gst_absts_reader_get_n_syncs (GstAbstsReader * reader)
+{
+  gst_absts_reader_ensure_index (reader);
+
+  return reader->n_syncs;
+}
+
+// Gets the clock-sync report in effect at record index, i.e. the last one before it, so that the
+// record can be weighted by how good the clock was, or rejected. FALSE if there's none.
+gboolean
+gst_absts_reader_get_sync (GstAbstsReader * reader, gsize index, GstAbstsSync * sync)
+{
+  GstAbstsRecord record;
+  gsize n;
+
+  gst_absts_reader_ensure_index (reader);
+
+  if (reader->n_syncs == 0 || index >= reader->n_records)
+    return FALSE;
+
+  n = gst_absts_reader_count_before (reader, reader->syncs, reader->n_syncs, index);
+  if (n == 0)
+    return FALSE;
+
+  gst_absts_record_read (reader->records + reader->syncs[n - 1] * reader->header.record_size,
+      &record);
+  gst_absts_sync_read (&record, sync);
+
+  return TRUE;
+}
+
+// How many segments the selected stream has, always at least one.
+gsize
+gst_absts_reader_get_n_segments (GstAbstsReader * reader)
+{
+  gst_absts_reader_ensure_index (reader);
+
+  return reader->selection ? reader->n_segments : 1;
+}
+
+// Restricts all other calls to the records of a single segment of the selected stream, within which pts
+// only grow, and returns how many there are. A segment of -1 selects the whole stream again.
+gsize
+gst_absts_reader_select_segment (GstAbstsReader * reader, gssize segment)
+{
+  gst_absts_reader_ensure_index (reader);
+
+  if (reader->selection == NULL)
+    return reader->n_records;
+
+  if (segment < 0 || (gsize) segment >= reader->n_segments) {
+    reader->window = 0;
+    reader->n_records = reader->n_selected;
+  } else {
+    gsize end = (gsize) segment + 1 < reader->n_segments ?
+        reader->segments[segment + 1] : reader->n_selected;
+
+    reader->window = reader->segments[segment];
+    reader->n_records = end - reader->window;
+  }
+
+  return reader->n_records;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSTS_READER_H_
+#define _GST_ABSTS_READER_H_
+
+#include <glib.h>
+
+#include "gstabstsformat.h"
+
+G_BEGIN_DECLS
+
+#define GST_ABSTS_READER_ERROR (gst_absts_reader_error_quark ())
+
+typedef enum
+{
+  GST_ABSTS_READER_ERROR_FORMAT,        /* not a binary timestamp log */
+  GST_ABSTS_READER_ERROR_VERSION        /* a version or layout this reader doesn't understand */
+} GstAbstsReaderError;
+
+typedef struct _GstAbstsReader GstAbstsReader;
+
+GQuark gst_absts_reader_error_quark (void);
+
+GstAbstsReader *gst_absts_reader_open (const gchar * filename, GError ** error);
+void gst_absts_reader_close (GstAbstsReader * reader);
+
+const GstAbstsHeader *gst_absts_reader_get_header (GstAbstsReader * reader);
+gsize gst_absts_reader_get_n_records (GstAbstsReader * reader);
+gboolean gst_absts_reader_get_record (GstAbstsReader * reader, gsize index,
+    GstAbstsRecord * record);
+gboolean gst_absts_reader_get_fields (GstAbstsReader * reader, gsize index, guint64 * values);
+
+gsize gst_absts_reader_select_stream (GstAbstsReader * reader, guint32 stream_id);
+gsize gst_absts_reader_get_n_segments (GstAbstsReader * reader);
+gsize gst_absts_reader_select_segment (GstAbstsReader * reader, gssize segment);
+
+gssize gst_absts_reader_find_pts (GstAbstsReader * reader, guint64 pts);
+gssize gst_absts_reader_find_wallclock (GstAbstsReader * reader, gint64 wallclock);
+
+gboolean gst_absts_reader_lookup_wallclock (GstAbstsReader * reader, guint64 pts,
+    gint64 * wallclock);
+gboolean gst_absts_reader_lookup_pts (GstAbstsReader * reader, gint64 wallclock,
+    guint64 * pts);
+
+gboolean gst_absts_reader_interpolate_wallclock (GstAbstsReader * reader, guint64 pts,
+    gint64 * wallclock);
+gboolean gst_absts_reader_interpolate_pts (GstAbstsReader * reader, gint64 wallclock,
+    guint64 * pts);
+
+gsize gst_absts_reader_get_n_models (GstAbstsReader * reader);
+gboolean gst_absts_reader_get_model (GstAbstsReader * reader, guint64 pts, GstAbstsModel * model);
+
+gsize gst_absts_reader_get_n_syncs (GstAbstsReader * reader);
+gboolean gst_absts_reader_get_sync (GstAbstsReader * reader, gsize index, GstAbstsSync * sync);
+
+G_END_DECLS
+
+#endif
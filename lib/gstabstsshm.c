@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// A consumer of the shared memory ring written by absolutetimestamps sink=shm, see gstabstsformat.h
+// for the layout. The ring is mapped read-only and reading it never makes a system call, so a
+// consumer can poll it as often as it likes without slowing the pipeline down.
+//
+// Each consumer keeps its own cursor, the sequence number of the next record it wants, and moves
+// it along with gst_absts_shm_reader_next. Start it at gst_absts_shm_reader_get_head for new records
+// only or at gst_absts_shm_reader_get_oldest for everything still in the ring. The writer never
+// waits for consumers, so one that falls more than a ring's worth behind loses records - they're
+// counted in lost rather than silently skipped.
+//
+// A slot is read like a seqlock: its sequence is checked before and after copying the record out,
+// and the copy is only used if both show the record a consumer asked for, i.e. it wasn't being
+// overwritten in the meantime.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gstabstsshm.h"
+#include "gstabstsreader.h"
+
+struct _GstAbstsShmReader
+{
+  const guint8 *map;
+  gsize length;
+  GstAbstsHeader header;
+  guint32 capacity;
+  guint32 slot_size;
+  volatile gint *head;
+  volatile gint *closed;
+};
+
+static inline volatile gint *
+slot_sequence (GstAbstsShmReader * reader, guint32 sequence)
+{
+  return (volatile gint *) (reader->map + reader->header.header_size +
+      (gsize) (sequence & (reader->capacity - 1)) * reader->slot_size);
+}
+
+// name is as given to absolutetimestamps location, e.g. "/timestamps".
+GstAbstsShmReader *
+gst_absts_shm_reader_open (const gchar * name, GError ** error)
+{
+  GstAbstsShmReader *reader;
+  gchar *object_name = name[0] == '/' ? g_strdup (name) : g_strconcat ("/", name, NULL);
+  struct stat st;
+  guint8 *map;
+  gint fd;
+
+  fd = shm_open (object_name, O_RDONLY, 0);
+  if (fd == -1) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not open shared memory \"%s\": %s", object_name, g_strerror (errno));
+    g_free (object_name);
+    return NULL;
+  }
+
+  if (fstat (fd, &st) != 0 || st.st_size < GST_ABSTS_SHM_HEADER_SIZE) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_FORMAT,
+        "\"%s\" is not a timestamp ring", object_name);
+    goto fail;
+  }
+
+  map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not map shared memory \"%s\": %s", object_name, g_strerror (errno));
+    goto fail;
+  }
+
+  reader = g_new0 (GstAbstsShmReader, 1);
+  reader->map = map;
+  reader->length = st.st_size;
+
+  if (!gst_absts_header_read_with_magic (map, GST_ABSTS_SHM_MAGIC, &reader->header)) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_FORMAT,
+        "\"%s\" is not a timestamp ring", object_name);
+    goto fail_unmap;
+  }
+
+  reader->capacity = gst_absts_read_uint32_le (map + GST_ABSTS_SHM_CAPACITY_OFFSET);
+  reader->slot_size = gst_absts_read_uint32_le (map + GST_ABSTS_SHM_SLOT_SIZE_OFFSET);
+
+  if (reader->header.version < 1 || reader->header.header_size < GST_ABSTS_SHM_HEADER_SIZE ||
+      reader->header.record_size < GST_ABSTS_RECORD_SIZE ||
+      reader->slot_size < GST_ABSTS_SHM_SLOT_RECORD_OFFSET + GST_ABSTS_RECORD_SIZE ||
+      reader->capacity == 0 || (reader->capacity & (reader->capacity - 1)) != 0 ||
+      reader->header.header_size + (guint64) reader->capacity * reader->slot_size > reader->length) {
+    g_set_error (error, GST_ABSTS_READER_ERROR, GST_ABSTS_READER_ERROR_VERSION,
+        "\"%s\" has an unsupported layout (%u slots of %u bytes)", object_name,
+        reader->capacity, reader->slot_size);
+    goto fail_unmap;
+  }
+
+  reader->head = (volatile gint *) (map + GST_ABSTS_SHM_HEAD_OFFSET);
+  reader->closed = (volatile gint *) (map + GST_ABSTS_SHM_CLOSED_OFFSET);
+
+  close (fd);
+  g_free (object_name);
+
+  return reader;
+
+fail_unmap:
+  munmap (map, st.st_size);
+  g_free (reader);
+fail:
+  close (fd);
+  g_free (object_name);
+  return NULL;
+}
+
+void
+gst_absts_shm_reader_close (GstAbstsShmReader * reader)
+{
+  munmap ((gpointer) reader->map, reader->length);
+  g_free (reader);
+}
+
+const GstAbstsHeader *
+gst_absts_shm_reader_get_header (GstAbstsShmReader * reader)
+{
+  return &reader->header;
+}
+
+guint32
+gst_absts_shm_reader_get_capacity (GstAbstsShmReader * reader)
+{
+  return reader->capacity;
+}
+
+// Once the element has stopped, nothing more is going to arrive. If it starts again it creates a new
+// ring, which has to be opened afresh to see it.
+gboolean
+gst_absts_shm_reader_is_closed (GstAbstsShmReader * reader)
+{
+  return g_atomic_int_get (reader->closed) != 0;
+}
+
+// The sequence number of the next record to be written.
+guint32
+gst_absts_shm_reader_get_head (GstAbstsShmReader * reader)
+{
+  return (guint32) g_atomic_int_get (reader->head);
+}
+
+// The sequence number of the oldest record that's still in the ring, or at least was just now.
+guint32
+gst_absts_shm_reader_get_oldest (GstAbstsShmReader * reader)
+{
+  guint32 head = gst_absts_shm_reader_get_head (reader);
+
+  return head > reader->capacity ? head - reader->capacity : 0;
+}
+
+// Copies record *cursor into record and advances *cursor past it. Returns FALSE if there is no new
+// record yet. Records that were overwritten before they could be read are skipped, and their number
+// is added to *lost if lost isn't NULL.
+gboolean
+gst_absts_shm_reader_next (GstAbstsShmReader * reader, guint32 * cursor, GstAbstsRecord * record,
+    guint32 * lost)
+{
+  for (;;) {
+    guint32 head = (guint32) g_atomic_int_get (reader->head);
+    guint32 missed = 0;
+    volatile gint *sequence;
+    gint before;
+
+    if (head == *cursor)
+      return FALSE;
+
+    // Lapped: everything before the last capacity records is gone already.
+    if (head - *cursor > reader->capacity)
+      missed = head - reader->capacity - *cursor;
+
+    *cursor += missed;
+    sequence = slot_sequence (reader, *cursor);
+
+    before = g_atomic_int_get (sequence);
+    if ((guint32) before == *cursor + 1) {
+      gst_absts_record_read ((const guint8 *) sequence + GST_ABSTS_SHM_SLOT_RECORD_OFFSET, record);
+
+      // The copy has to be complete before the sequence is checked again.
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+      if (g_atomic_int_get (sequence) == before) {
+        (*cursor)++;
+        if (lost)
+          *lost += missed;
+        return TRUE;
+      }
+    }
+
+    // Overwritten while being read, or even before.
+    (*cursor)++;
+    if (lost)
+      *lost += missed + 1;
+  }
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSTS_SHM_H_
+#define _GST_ABSTS_SHM_H_
+
+#include <glib.h>
+
+#include "gstabstsformat.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstAbstsShmReader GstAbstsShmReader;
+
+GstAbstsShmReader *gst_absts_shm_reader_open (const gchar * name, GError ** error);
+void gst_absts_shm_reader_close (GstAbstsShmReader * reader);
+
+const GstAbstsHeader *gst_absts_shm_reader_get_header (GstAbstsShmReader * reader);
+guint32 gst_absts_shm_reader_get_capacity (GstAbstsShmReader * reader);
+gboolean gst_absts_shm_reader_is_closed (GstAbstsShmReader * reader);
+
+guint32 gst_absts_shm_reader_get_head (GstAbstsShmReader * reader);
+guint32 gst_absts_shm_reader_get_oldest (GstAbstsShmReader * reader);
+gboolean gst_absts_shm_reader_next (GstAbstsShmReader * reader, guint32 * cursor,
+    GstAbstsRecord * record, guint32 * lost);
+
+G_END_DECLS
+
+#endif
@@ -32,16 +32,71 @@
 #include "config.h"
 #endif
 
+#include <math.h>
+#include <string.h>
+
 #include <glib/gstdio.h>
 
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
 #include "gstabsolutetimestamps.h"
+#include "gstabsolutetimestampstracer.h"
+#include "gstmultiabsolutetimestamps.h"
 
-GST_DEBUG_CATEGORY_STATIC (gst_absolutetimestamps_debug_category);
+GST_DEBUG_CATEGORY (gst_absolutetimestamps_debug_category);
 #define GST_CAT_DEFAULT gst_absolutetimestamps_debug_category
 
+// Logging from the per-buffer path is compiled out unless configured with
+// --enable-hot-path-debug, even a disabled category check shows up there.
+#ifdef ABSTS_HOT_PATH_DEBUG
+#define HOT_PATH_LOG_OBJECT GST_LOG_OBJECT
+#else
+#define HOT_PATH_LOG_OBJECT(...) G_STMT_START { } G_STMT_END
+#endif
+
+#define DEFAULT_OUTPUT_FLAGS GST_ABSOLUTETIMESTAMPS_OUTPUT_FILE
 #define DEFAULT_FILENAME "timestamps.log"
+#define DEFAULT_FORMAT GST_ABSOLUTETIMESTAMPS_FORMAT_TEXT
+#define DEFAULT_PRECISION GST_ABSOLUTETIMESTAMPS_PRECISION_MICROSECONDS
+#define DEFAULT_CLOCK_SOURCE GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_REALTIME
+#define DEFAULT_BUFFER_SIZE 65536
+#define DEFAULT_FLUSH_POLICY GST_ABSOLUTETIMESTAMPS_FLUSH_NONE
+#define DEFAULT_FLUSH_RECORDS 100
+#define DEFAULT_FLUSH_INTERVAL 1000
+#define DEFAULT_ASYNC_WRITE FALSE
+#define DEFAULT_RING_CAPACITY 4096
+#define DEFAULT_INSTRUMENTATION FALSE
+#define DEFAULT_STATS_INTERVAL 1000
+#define DEFAULT_MAX_SIZE_BYTES 0
+#define DEFAULT_MAX_SIZE_TIME 0
+#define DEFAULT_SPLIT_ON_FRAGMENT FALSE
+#define DEFAULT_WRITER_GROUP NULL
+#define DEFAULT_STREAM_ID -1
+#define DEFAULT_MODE GST_ABSOLUTETIMESTAMPS_MODE_EVERY_BUFFER
+#define DEFAULT_INTERVAL 30
+#define DEFAULT_DRIFT_TOLERANCE GST_MSECOND
+#define DEFAULT_MODEL FALSE
+#define DEFAULT_MODEL_INTERVAL GST_SECOND
+#define DEFAULT_PTS_DOMAIN GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_PTS
+#define DEFAULT_SEEK_INDEX FALSE
+#define DEFAULT_SEEK_INDEX_INTERVAL GST_SECOND
+#define DEFAULT_SINK GST_ABSOLUTETIMESTAMPS_SINK_FILE
+#define DEFAULT_SHM_CAPACITY 16384
+#define DEFAULT_APPEND FALSE
+#define DEFAULT_SYNC_WRITES FALSE
+#define DEFAULT_DIRECT_IO FALSE
+#define DEFAULT_FIELDS 0
+#define DEFAULT_MAX_HISTORY 0
+#define DEFAULT_MAX_HISTORY_BYTES 0
+#define DEFAULT_ADAPTIVE FALSE
+#define DEFAULT_PRESSURE_THRESHOLD 50
+#define DEFAULT_CAPTURE_TIME GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_ARRIVAL
+#define DEFAULT_CLOCK_SYNC GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_NONE
+#define DEFAULT_CLOCK_SYNC_INTERVAL 10
+#define DEFAULT_CLOCK_SYNC_DOMAIN 0
+
+// How long the writer thread sleeps before re-checking the ring if it's not woken explicitly.
+#define WRITER_WAIT_USEC (10 * G_TIME_SPAN_MILLISECOND)
 
 /* prototypes */
 
@@ -51,20 +106,190 @@ static void gst_absolutetimestamps_set_property (GObject * object,
 static void gst_absolutetimestamps_get_property (GObject * object,
     guint property_id, GValue * value, GParamSpec * pspec);
 static void gst_absolutetimestamps_dispose (GObject * object);
+static void gst_absolutetimestamps_finalize (GObject * object);
 
 static gboolean gst_absolutetimestamps_accept_caps (GstBaseTransform * trans,
     GstPadDirection direction, GstCaps * caps);
 static gboolean gst_absolutetimestamps_start (GstBaseTransform * trans);
 static gboolean gst_absolutetimestamps_stop (GstBaseTransform * trans);
+static gboolean gst_absolutetimestamps_sink_event (GstBaseTransform * trans, GstEvent * event);
+static gboolean gst_absolutetimestamps_src_event (GstBaseTransform * trans, GstEvent * event);
+static gboolean gst_absolutetimestamps_query (GstBaseTransform * trans, GstPadDirection direction,
+    GstQuery * query);
+static gint64 gst_absolutetimestamps_lookup_wallclock (GstAbsolutetimestamps * absolutetimestamps,
+    guint64 pts);
+static guint64 gst_absolutetimestamps_lookup_pts (GstAbsolutetimestamps * absolutetimestamps,
+    gint64 wallclock);
 static GstFlowReturn gst_absolutetimestamps_transform_ip (GstBaseTransform *
     trans, GstBuffer * buf);
+static GstFlowReturn gst_absolutetimestamps_chain_list (GstPad * pad,
+    GstObject * parent, GstBufferList * list);
 
 enum
 {
   PROP_0,
-  PROP_LOCATION
+  PROP_OUTPUT,
+  PROP_LOCATION,
+  PROP_FORMAT,
+  PROP_PRECISION,
+  PROP_CLOCK_SOURCE,
+  PROP_BUFFER_SIZE,
+  PROP_FLUSH_POLICY,
+  PROP_FLUSH_RECORDS,
+  PROP_FLUSH_INTERVAL,
+  PROP_ASYNC_WRITE,
+  PROP_RING_CAPACITY,
+  PROP_DROPPED,
+  PROP_INSTRUMENTATION,
+  PROP_STATS_INTERVAL,
+  PROP_STATS,
+  PROP_MAX_SIZE_BYTES,
+  PROP_MAX_SIZE_TIME,
+  PROP_SPLIT_ON_FRAGMENT,
+  PROP_WRITER_GROUP,
+  PROP_STREAM_ID,
+  PROP_MODE,
+  PROP_INTERVAL,
+  PROP_DRIFT_TOLERANCE,
+  PROP_MODEL,
+  PROP_MODEL_INTERVAL,
+  PROP_MODEL_SLOPE,
+  PROP_MODEL_OFFSET,
+  PROP_MODEL_RESIDUAL,
+  PROP_PTS_DOMAIN,
+  PROP_SEEK_INDEX,
+  PROP_SEEK_INDEX_INTERVAL,
+  PROP_SINK,
+  PROP_SHM_CAPACITY,
+  PROP_APPEND,
+  PROP_SYNC_WRITES,
+  PROP_DIRECT_IO,
+  PROP_FIELDS,
+  PROP_MAX_HISTORY,
+  PROP_MAX_HISTORY_BYTES,
+  PROP_ADAPTIVE,
+  PROP_PRESSURE_THRESHOLD,
+  PROP_PRESSURE,
+  PROP_CAPTURE_TIME,
+  PROP_UPSTREAM_LATENCY,
+  PROP_CLOCK_SYNC,
+  PROP_CLOCK_SYNC_INTERVAL,
+  PROP_CLOCK_SYNC_DOMAIN
+};
+
+enum
+{
+  SIGNAL_LOOKUP_WALLCLOCK,
+  SIGNAL_LOOKUP_PTS,
+  LAST_SIGNAL
 };
 
+static guint gst_absolutetimestamps_signals[LAST_SIGNAL] = { 0 };
+
+GType
+gst_absolutetimestamps_output_flags_get_type (void)
+{
+  static gsize output_flags_type = 0;
+
+  if (g_once_init_enter (&output_flags_type)) {
+    static const GFlagsValue output_flags[] = {
+      {GST_ABSOLUTETIMESTAMPS_OUTPUT_FILE, "Write the mapping to the sink given by sink and location", "file"},
+      {GST_ABSOLUTETIMESTAMPS_OUTPUT_META, "Attach a GstReferenceTimestampMeta to each buffer", "meta"},
+      {0, NULL, NULL}
+    };
+    GType type = g_flags_register_static ("GstAbsolutetimestampsOutputFlags", output_flags);
+
+    g_once_init_leave (&output_flags_type, type);
+  }
+
+  return output_flags_type;
+}
+
+GType
+gst_absolutetimestamps_mode_get_type (void)
+{
+  static gsize mode_type = 0;
+
+  if (g_once_init_enter (&mode_type)) {
+    static const GEnumValue modes[] = {
+      {GST_ABSOLUTETIMESTAMPS_MODE_EVERY_BUFFER, "Record every buffer", "every-buffer"},
+      {GST_ABSOLUTETIMESTAMPS_MODE_EVERY_NTH, "Record every interval'th buffer", "every-nth"},
+      {GST_ABSOLUTETIMESTAMPS_MODE_KEYFRAMES_ONLY, "Record only keyframes", "keyframes-only"},
+      {GST_ABSOLUTETIMESTAMPS_MODE_DRIFT_ONLY, "Record only when wallclock drifts from pts by more than drift-tolerance", "drift-only"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsMode", modes);
+
+    g_once_init_leave (&mode_type, type);
+  }
+
+  return mode_type;
+}
+
+GType
+gst_absolutetimestamps_pts_domain_get_type (void)
+{
+  static gsize pts_domain_type = 0;
+
+  if (g_once_init_enter (&pts_domain_type)) {
+    static const GEnumValue pts_domains[] = {
+      {GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_PTS, "The buffer's pts as-is", "pts"},
+      {GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_RUNNING_TIME, "The buffer's running time", "running-time"},
+      {GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_STREAM_TIME, "The buffer's stream time", "stream-time"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsPtsDomain", pts_domains);
+
+    g_once_init_leave (&pts_domain_type, type);
+  }
+
+  return pts_domain_type;
+}
+
+GType
+gst_absolutetimestamps_capture_time_get_type (void)
+{
+  static gsize capture_time_type = 0;
+
+  if (g_once_init_enter (&capture_time_type)) {
+    static const GEnumValue capture_times[] = {
+      {GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_ARRIVAL, "When the buffer arrives here", "arrival"},
+      {GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_UPSTREAM_LATENCY,
+          "When the buffer arrives here, less the latency upstream reports", "upstream-latency"},
+      {GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_REFERENCE_META,
+          "The GstReferenceTimestampMeta upstream attached, else when the buffer arrives here", "reference-meta"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsCaptureTime", capture_times);
+
+    g_once_init_leave (&capture_time_type, type);
+  }
+
+  return capture_time_type;
+}
+
+GType
+gst_absolutetimestamps_pressure_get_type (void)
+{
+  static gsize pressure_type = 0;
+
+  if (g_once_init_enter (&pressure_type)) {
+    static const GEnumValue pressures[] = {
+      {GST_ABSOLUTETIMESTAMPS_PRESSURE_NONE, "The writer is keeping up, recording in mode", "none"},
+      {GST_ABSOLUTETIMESTAMPS_PRESSURE_ELEVATED,
+          "The writer is falling behind, recording every interval'th buffer", "elevated"},
+      {GST_ABSOLUTETIMESTAMPS_PRESSURE_CRITICAL,
+          "The writer is far behind, recording only drift", "critical"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsPressure", pressures);
+
+    g_once_init_leave (&pressure_type, type);
+  }
+
+  return pressure_type;
+}
+
 /* pad templates */
 
 static GstStaticPadTemplate gst_absolutetimestamps_src_template =
@@ -111,27 +336,368 @@ gst_absolutetimestamps_class_init (GstAbsolutetimestampsClass * klass)
   gobject_class->set_property = gst_absolutetimestamps_set_property;
   gobject_class->get_property = gst_absolutetimestamps_get_property;
 
+  g_object_class_install_property (gobject_class, PROP_OUTPUT,
+      g_param_spec_flags ("output", "Output",
+          "Where to record the absolute time of each buffer", GST_TYPE_ABSOLUTETIMESTAMPS_OUTPUT_FLAGS,
+          DEFAULT_OUTPUT_FLAGS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class, PROP_LOCATION,
       g_param_spec_string ("location", "File Location",
           "Location of the timestamp mapping file to write", DEFAULT_FILENAME,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_FORMAT,
+      g_param_spec_enum ("format", "Format",
+          "Format of the timestamp mapping file", GST_TYPE_ABSOLUTETIMESTAMPS_FORMAT,
+          DEFAULT_FORMAT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PRECISION,
+      g_param_spec_enum ("precision", "Precision",
+          "Precision of the wallclock written in the text format", GST_TYPE_ABSOLUTETIMESTAMPS_PRECISION,
+          DEFAULT_PRECISION, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CLOCK_SOURCE,
+      g_param_spec_enum ("clock-source", "Clock source",
+          "Clock that the absolute time of each buffer is taken from",
+          GST_TYPE_ABSOLUTETIMESTAMPS_CLOCK_SOURCE, DEFAULT_CLOCK_SOURCE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BUFFER_SIZE,
+      g_param_spec_uint ("buffer-size", "Buffer size",
+          "Size in bytes of the buffer records are accumulated in before being written to the file",
+          4096, G_MAXINT, DEFAULT_BUFFER_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FLUSH_POLICY,
+      g_param_spec_enum ("flush-policy", "Flush policy",
+          "When to write buffered records to the file, other than when the buffer is full",
+          GST_TYPE_ABSOLUTETIMESTAMPS_FLUSH_POLICY, DEFAULT_FLUSH_POLICY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FLUSH_RECORDS,
+      g_param_spec_uint ("flush-records", "Flush records",
+          "Number of records between writes when flush-policy=every-n-records",
+          1, G_MAXUINT, DEFAULT_FLUSH_RECORDS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FLUSH_INTERVAL,
+      g_param_spec_uint ("flush-interval", "Flush interval",
+          "Milliseconds between writes when flush-policy=every-t-ms; without async-write or writer-group it's only checked when a record arrives",
+          1, G_MAXUINT, DEFAULT_FLUSH_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ASYNC_WRITE,
+      g_param_spec_boolean ("async-write", "Asynchronous write",
+          "Format and write records on a dedicated thread rather than on the streaming thread",
+          DEFAULT_ASYNC_WRITE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_RING_CAPACITY,
+      g_param_spec_uint ("ring-capacity", "Ring capacity",
+          "Number of records that can be queued for the writer thread when async-write is enabled (rounded up to a power of two)",
+          2, G_MAXINT / 2 + 1, DEFAULT_RING_CAPACITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DROPPED,
+      g_param_spec_uint64 ("dropped", "Dropped",
+          "Number of records dropped because the writer thread fell behind and the ring was full",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_INSTRUMENTATION,
+      g_param_spec_boolean ("instrumentation", "Instrumentation",
+          "Measure the time spent on each buffer, its skew against the pipeline clock and its jitter",
+          DEFAULT_INSTRUMENTATION, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Stats interval",
+          "Milliseconds between absolutetimestamps-stats element messages when instrumentation is enabled (0 = never)",
+          0, G_MAXUINT, DEFAULT_STATS_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Stats",
+          "Histogram summaries (in ns) of the measurements made when instrumentation is enabled",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_SIZE_BYTES,
+      g_param_spec_uint64 ("max-size-bytes", "Max size in bytes",
+          "Start a new file once the current one would exceed this size, location must contain e.g. %05d (0 = unlimited)",
+          0, G_MAXUINT64, DEFAULT_MAX_SIZE_BYTES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_SIZE_TIME,
+      g_param_spec_uint64 ("max-size-time", "Max size in time",
+          "Start a new file once the current one spans this much pts, location must contain e.g. %05d (0 = unlimited)",
+          0, G_MAXUINT64, DEFAULT_MAX_SIZE_TIME, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SPLIT_ON_FRAGMENT,
+      g_param_spec_boolean ("split-on-fragment", "Split on fragment",
+          "Start a new file whenever a splitmuxsink in the pipeline opens a new fragment, location must contain e.g. %05d",
+          DEFAULT_SPLIT_ON_FRAGMENT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_WRITER_GROUP,
+      g_param_spec_string ("writer-group", "Writer group",
+          "Share one writer thread and one file, interleaving records by stream-id, with every other element in the process with the same writer-group",
+          DEFAULT_WRITER_GROUP, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STREAM_ID,
+      g_param_spec_int ("stream-id", "Stream id",
+          "Id that this element's records are tagged with within its writer-group (-1 = the next unused one)",
+          -1, G_MAXINT, DEFAULT_STREAM_ID, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MODE,
+      g_param_spec_enum ("mode", "Mode",
+          "Which buffers to write a record for, buffers with DISCONT always get one",
+          GST_TYPE_ABSOLUTETIMESTAMPS_MODE, DEFAULT_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_INTERVAL,
+      g_param_spec_uint ("interval", "Interval",
+          "Record every interval'th buffer when mode=every-nth",
+          1, G_MAXUINT, DEFAULT_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DRIFT_TOLERANCE,
+      g_param_spec_uint64 ("drift-tolerance", "Drift tolerance",
+          "Nanoseconds the wallclock may drift from that predicted by the last record before a new one is written when mode=drift-only",
+          0, G_MAXUINT64, DEFAULT_DRIFT_TOLERANCE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MODEL,
+      g_param_spec_boolean ("model", "Model",
+          "Fit wallclock = slope * pts + offset by least squares and log snapshots of the fit",
+          DEFAULT_MODEL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MODEL_INTERVAL,
+      g_param_spec_uint64 ("model-interval", "Model interval",
+          "Nanoseconds of pts between snapshots of the fit, each logged, published and posted as an absolutetimestamps-model message (0 = never)",
+          0, G_MAXUINT64, DEFAULT_MODEL_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MODEL_SLOPE,
+      g_param_spec_double ("model-slope", "Model slope",
+          "Nanoseconds of wallclock per nanosecond of pts, as of the latest snapshot",
+          -G_MAXDOUBLE, G_MAXDOUBLE, 1.0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MODEL_OFFSET,
+      g_param_spec_int64 ("model-offset", "Model offset",
+          "The fitted wallclock at pts 0, as of the latest snapshot",
+          G_MININT64, G_MAXINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MODEL_RESIDUAL,
+      g_param_spec_double ("model-residual", "Model residual",
+          "Root mean square distance, in nanoseconds, of the samples from the fit, as of the latest snapshot",
+          0, G_MAXDOUBLE, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PTS_DOMAIN,
+      g_param_spec_enum ("pts-domain", "Pts domain",
+          "What to record as each buffer's pts, running time and stream time take the segment into account",
+          GST_TYPE_ABSOLUTETIMESTAMPS_PTS_DOMAIN, DEFAULT_PTS_DOMAIN,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SEEK_INDEX,
+      g_param_spec_boolean ("seek-index", "Seek index",
+          "Write a sparse index of the file, for jumping straight to a wallclock or pts, to <file>.idx",
+          DEFAULT_SEEK_INDEX, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SEEK_INDEX_INTERVAL,
+      g_param_spec_uint64 ("seek-index-interval", "Seek index interval",
+          "Nanoseconds of wallclock between entries of the seek index",
+          1, G_MAXUINT64, DEFAULT_SEEK_INDEX_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SINK,
+      g_param_spec_enum ("sink", "Sink",
+          "Where the mapping goes, location is a file, host:port, socket path or shared memory name accordingly",
+          GST_TYPE_ABSOLUTETIMESTAMPS_SINK, DEFAULT_SINK, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SHM_CAPACITY,
+      g_param_spec_uint ("shm-capacity", "Shared memory capacity",
+          "Number of records the shared memory ring of sink=shm holds (rounded up to a power of two)",
+          2, 1U << 30, DEFAULT_SHM_CAPACITY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_APPEND,
+      g_param_spec_boolean ("append", "Append",
+          "Resume an existing log, dropping any torn blocks at its end, rather than truncate it (format=blocks only)",
+          DEFAULT_APPEND, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SYNC_WRITES,
+      g_param_spec_boolean ("sync-writes", "Sync writes",
+          "Call fdatasync after each write to the file, so that flushed records survive a power loss",
+          DEFAULT_SYNC_WRITES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DIRECT_IO,
+      g_param_spec_boolean ("direct-io", "Direct I/O",
+          "Open the file O_DIRECT, bypassing the page cache, where the filesystem allows it (format=blocks only)",
+          DEFAULT_DIRECT_IO, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FIELDS,
+      g_param_spec_flags ("fields", "Fields",
+          "Which fields of each buffer to record besides its pts and flags (not with format=columnar or sink=udp/unix/shm)",
+          GST_TYPE_ABSOLUTETIMESTAMPS_FIELDS, DEFAULT_FIELDS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_HISTORY,
+      g_param_spec_uint ("max-history", "Max history",
+          "Number of recent records to keep in memory for lookup-wallclock, lookup-pts and the absolutetimestamps-lookup query, rounded up to a whole chunk of 64 (0 = no limit on records, only max-history-bytes; with both 0 nothing is kept)",
+          0, G_MAXINT / 2 + 1, DEFAULT_MAX_HISTORY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ADAPTIVE,
+      g_param_spec_boolean ("adaptive", "Adaptive",
+          "Record fewer buffers, rather than drop records, while the writer thread falls behind (with async-write or writer-group)",
+          DEFAULT_ADAPTIVE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PRESSURE_THRESHOLD,
+      g_param_spec_uint ("pressure-threshold", "Pressure threshold",
+          "Percentage of ring-capacity queued at which adaptive starts recording only every interval'th buffer, halfway from it to full only drift",
+          1, 100, DEFAULT_PRESSURE_THRESHOLD, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PRESSURE,
+      g_param_spec_enum ("pressure", "Pressure",
+          "How far behind the writer thread currently is, with adaptive",
+          GST_TYPE_ABSOLUTETIMESTAMPS_PRESSURE, GST_ABSOLUTETIMESTAMPS_PRESSURE_NONE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CLOCK_SYNC,
+      g_param_spec_enum ("clock-sync", "Clock sync",
+          "Where to sample how well the host's clock is synchronised from, every clock-sync-interval, to log with the records",
+          GST_TYPE_ABSOLUTETIMESTAMPS_CLOCK_SYNC, DEFAULT_CLOCK_SYNC,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CLOCK_SYNC_INTERVAL,
+      g_param_spec_uint ("clock-sync-interval", "Clock sync interval",
+          "Seconds between two samples of the clock's synchronisation, with clock-sync",
+          1, G_MAXUINT / 1000, DEFAULT_CLOCK_SYNC_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CLOCK_SYNC_DOMAIN,
+      g_param_spec_uint ("clock-sync-domain", "Clock sync domain",
+          "The PTP domain whose statistics clock-sync=ptp reports",
+          0, 255, DEFAULT_CLOCK_SYNC_DOMAIN, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_HISTORY_BYTES,
+      g_param_spec_uint64 ("max-history-bytes", "Max history bytes",
+          "Memory to set aside for the records kept for lookups (0 = no limit). With neither this nor max-history set, none are kept",
+          0, G_MAXUINT64, DEFAULT_MAX_HISTORY_BYTES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CAPTURE_TIME,
+      g_param_spec_enum ("capture-time", "Capture time",
+          "How to reconstruct when each buffer was captured, rather than when it reached this element",
+          GST_TYPE_ABSOLUTETIMESTAMPS_CAPTURE_TIME, DEFAULT_CAPTURE_TIME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_UPSTREAM_LATENCY,
+      g_param_spec_uint64 ("upstream-latency", "Upstream latency",
+          "Minimum latency, in nanoseconds, upstream last reported for capture-time=upstream-latency",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAbsolutetimestamps::lookup-wallclock:
+   * @absolutetimestamps: the element
+   * @pts: a pts, in the pts-domain of the element
+   *
+   * Looks up the wallclock of the frame at @pts in the records kept with max-history.
+   *
+   * Returns: the wallclock, in nanoseconds since the epoch, or -1 if @pts is older than the history.
+   */
+  gst_absolutetimestamps_signals[SIGNAL_LOOKUP_WALLCLOCK] =
+      g_signal_new ("lookup-wallclock", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstAbsolutetimestampsClass,
+          lookup_wallclock), NULL, NULL, NULL, G_TYPE_INT64, 1, G_TYPE_UINT64);
+
+  /**
+   * GstAbsolutetimestamps::lookup-pts:
+   * @absolutetimestamps: the element
+   * @wallclock: a wallclock, in nanoseconds since the epoch
+   *
+   * Looks up the pts of the frame that was current at @wallclock in the records kept with
+   * max-history.
+   *
+   * Returns: the pts, or GST_CLOCK_TIME_NONE if @wallclock is older than the history.
+   */
+  gst_absolutetimestamps_signals[SIGNAL_LOOKUP_PTS] =
+      g_signal_new ("lookup-pts", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstAbsolutetimestampsClass,
+          lookup_pts), NULL, NULL, NULL, G_TYPE_UINT64, 1, G_TYPE_INT64);
+
+  klass->lookup_wallclock = gst_absolutetimestamps_lookup_wallclock;
+  klass->lookup_pts = gst_absolutetimestamps_lookup_pts;
+
   gobject_class->dispose = gst_absolutetimestamps_dispose;
+  gobject_class->finalize = gst_absolutetimestamps_finalize;
   base_transform_class->accept_caps =
       GST_DEBUG_FUNCPTR (gst_absolutetimestamps_accept_caps);
   base_transform_class->start =
       GST_DEBUG_FUNCPTR (gst_absolutetimestamps_start);
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_absolutetimestamps_stop);
+  base_transform_class->sink_event = GST_DEBUG_FUNCPTR (gst_absolutetimestamps_sink_event);
+  base_transform_class->src_event = GST_DEBUG_FUNCPTR (gst_absolutetimestamps_src_event);
+  base_transform_class->query = GST_DEBUG_FUNCPTR (gst_absolutetimestamps_query);
   base_transform_class->transform_ip =
       GST_DEBUG_FUNCPTR (gst_absolutetimestamps_transform_ip);
 
+  // The element only observes buffers, so it needs calling even in passthrough mode, where
+  // GstBaseTransform hands over the upstream buffer untouched rather than making it writable.
+  // Passthrough is decided in start, depending on the output, rather than by passthrough_on_same_caps.
+  base_transform_class->transform_ip_on_passthrough = TRUE;
+
 }
 
 static void
 gst_absolutetimestamps_init (GstAbsolutetimestamps * absolutetimestamps)
 {
+  absolutetimestamps->output_flags = DEFAULT_OUTPUT_FLAGS;
   absolutetimestamps->filename = g_strdup(DEFAULT_FILENAME);
-  absolutetimestamps->file = NULL;
+  absolutetimestamps->format = DEFAULT_FORMAT;
+  absolutetimestamps->precision = DEFAULT_PRECISION;
+  absolutetimestamps->clock_source = DEFAULT_CLOCK_SOURCE;
+  gst_absolutetimestamps_clock_init (&absolutetimestamps->clock, DEFAULT_CLOCK_SOURCE);
+  absolutetimestamps->buffer_size = DEFAULT_BUFFER_SIZE;
+  absolutetimestamps->flush_policy = DEFAULT_FLUSH_POLICY;
+  absolutetimestamps->flush_records = DEFAULT_FLUSH_RECORDS;
+  absolutetimestamps->flush_interval = DEFAULT_FLUSH_INTERVAL;
+  absolutetimestamps->max_size_bytes = DEFAULT_MAX_SIZE_BYTES;
+  absolutetimestamps->max_size_time = DEFAULT_MAX_SIZE_TIME;
+  absolutetimestamps->split_on_fragment = DEFAULT_SPLIT_ON_FRAGMENT;
+  absolutetimestamps->split_bus = NULL;
+  absolutetimestamps->writer_group = g_strdup (DEFAULT_WRITER_GROUP);
+  absolutetimestamps->stream_id = DEFAULT_STREAM_ID;
+  absolutetimestamps->group_member = NULL;
+  absolutetimestamps->mode = DEFAULT_MODE;
+  absolutetimestamps->interval = DEFAULT_INTERVAL;
+  absolutetimestamps->drift_tolerance = DEFAULT_DRIFT_TOLERANCE;
+  absolutetimestamps->model = DEFAULT_MODEL;
+  absolutetimestamps->model_interval = DEFAULT_MODEL_INTERVAL;
+  absolutetimestamps->pts_domain = DEFAULT_PTS_DOMAIN;
+  absolutetimestamps->seek_index = DEFAULT_SEEK_INDEX;
+  absolutetimestamps->seek_index_interval = DEFAULT_SEEK_INDEX_INTERVAL;
+  absolutetimestamps->sink = DEFAULT_SINK;
+  absolutetimestamps->shm_capacity = DEFAULT_SHM_CAPACITY;
+  absolutetimestamps->append = DEFAULT_APPEND;
+  absolutetimestamps->sync_writes = DEFAULT_SYNC_WRITES;
+  absolutetimestamps->direct_io = DEFAULT_DIRECT_IO;
+  absolutetimestamps->fields = DEFAULT_FIELDS;
+  absolutetimestamps->max_history = DEFAULT_MAX_HISTORY;
+  absolutetimestamps->max_history_bytes = DEFAULT_MAX_HISTORY_BYTES;
+  absolutetimestamps->adaptive = DEFAULT_ADAPTIVE;
+  absolutetimestamps->pressure_threshold = DEFAULT_PRESSURE_THRESHOLD;
+  absolutetimestamps->capture_time = DEFAULT_CAPTURE_TIME;
+  absolutetimestamps->upstream_latency = 0;
+  absolutetimestamps->clock_sync = DEFAULT_CLOCK_SYNC;
+  absolutetimestamps->clock_sync_interval = DEFAULT_CLOCK_SYNC_INTERVAL;
+  absolutetimestamps->clock_sync_domain = DEFAULT_CLOCK_SYNC_DOMAIN;
+  absolutetimestamps->published_slope = 1.0;
+  absolutetimestamps->output = NULL;
+  absolutetimestamps->reference_caps = NULL;
+  absolutetimestamps->async_write = DEFAULT_ASYNC_WRITE;
+  absolutetimestamps->ring_capacity = DEFAULT_RING_CAPACITY;
+  absolutetimestamps->dropped = 0;
+  absolutetimestamps->ring = NULL;
+  absolutetimestamps->writer_thread = NULL;
+  g_mutex_init (&absolutetimestamps->writer_lock);
+  g_cond_init (&absolutetimestamps->writer_cond);
+  absolutetimestamps->instrumentation = DEFAULT_INSTRUMENTATION;
+  absolutetimestamps->stats_interval = DEFAULT_STATS_INTERVAL;
+  gst_absolutetimestamps_stats_reset (&absolutetimestamps->stats);
+
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (absolutetimestamps), TRUE);
+  gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (absolutetimestamps), TRUE);
+
+  // GstBaseTransform only handles single buffers, splitting up any lists it's given.
+  absolutetimestamps->base_chain =
+      GST_PAD_CHAINFUNC (GST_BASE_TRANSFORM_SINK_PAD (absolutetimestamps));
+  gst_pad_set_chain_list_function (GST_BASE_TRANSFORM_SINK_PAD (absolutetimestamps),
+      GST_DEBUG_FUNCPTR (gst_absolutetimestamps_chain_list));
 }
 
 void
@@ -145,11 +711,129 @@ gst_absolutetimestamps_set_property (GObject * object, guint property_id,
   const gchar *location;
 
   switch (property_id) {
+    case PROP_OUTPUT:
+      absolutetimestamps->output_flags = g_value_get_flags (value);
+      break;
     case PROP_LOCATION:
 	  location = g_value_get_string (value);
       g_free (absolutetimestamps->filename); // Free the value created in gst_absolutetimestamps_init.
       absolutetimestamps->filename = g_strdup (location);
       break;
+    case PROP_FORMAT:
+      absolutetimestamps->format = g_value_get_enum (value);
+      break;
+    case PROP_PRECISION:
+      absolutetimestamps->precision = g_value_get_enum (value);
+      break;
+    case PROP_CLOCK_SOURCE:
+      absolutetimestamps->clock_source = g_value_get_enum (value);
+      break;
+    case PROP_BUFFER_SIZE:
+      absolutetimestamps->buffer_size = g_value_get_uint (value);
+      break;
+    case PROP_FLUSH_POLICY:
+      absolutetimestamps->flush_policy = g_value_get_enum (value);
+      break;
+    case PROP_FLUSH_RECORDS:
+      absolutetimestamps->flush_records = g_value_get_uint (value);
+      break;
+    case PROP_FLUSH_INTERVAL:
+      absolutetimestamps->flush_interval = g_value_get_uint (value);
+      break;
+    case PROP_ASYNC_WRITE:
+      absolutetimestamps->async_write = g_value_get_boolean (value);
+      break;
+    case PROP_RING_CAPACITY:
+      absolutetimestamps->ring_capacity = g_value_get_uint (value);
+      break;
+    case PROP_INSTRUMENTATION:
+      absolutetimestamps->instrumentation = g_value_get_boolean (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      absolutetimestamps->stats_interval = g_value_get_uint (value);
+      break;
+    case PROP_MAX_SIZE_BYTES:
+      absolutetimestamps->max_size_bytes = g_value_get_uint64 (value);
+      break;
+    case PROP_MAX_SIZE_TIME:
+      absolutetimestamps->max_size_time = g_value_get_uint64 (value);
+      break;
+    case PROP_SPLIT_ON_FRAGMENT:
+      absolutetimestamps->split_on_fragment = g_value_get_boolean (value);
+      break;
+    case PROP_WRITER_GROUP:
+      g_free (absolutetimestamps->writer_group);
+      absolutetimestamps->writer_group = g_value_dup_string (value);
+      break;
+    case PROP_STREAM_ID:
+      absolutetimestamps->stream_id = g_value_get_int (value);
+      break;
+    case PROP_MODE:
+      absolutetimestamps->mode = g_value_get_enum (value);
+      break;
+    case PROP_INTERVAL:
+      absolutetimestamps->interval = g_value_get_uint (value);
+      break;
+    case PROP_DRIFT_TOLERANCE:
+      absolutetimestamps->drift_tolerance = g_value_get_uint64 (value);
+      break;
+    case PROP_MODEL:
+      absolutetimestamps->model = g_value_get_boolean (value);
+      break;
+    case PROP_MODEL_INTERVAL:
+      absolutetimestamps->model_interval = g_value_get_uint64 (value);
+      break;
+    case PROP_PTS_DOMAIN:
+      absolutetimestamps->pts_domain = g_value_get_enum (value);
+      break;
+    case PROP_SEEK_INDEX:
+      absolutetimestamps->seek_index = g_value_get_boolean (value);
+      break;
+    case PROP_SEEK_INDEX_INTERVAL:
+      absolutetimestamps->seek_index_interval = g_value_get_uint64 (value);
+      break;
+    case PROP_SINK:
+      absolutetimestamps->sink = g_value_get_enum (value);
+      break;
+    case PROP_SHM_CAPACITY:
+      absolutetimestamps->shm_capacity = g_value_get_uint (value);
+      break;
+    case PROP_APPEND:
+      absolutetimestamps->append = g_value_get_boolean (value);
+      break;
+    case PROP_SYNC_WRITES:
+      absolutetimestamps->sync_writes = g_value_get_boolean (value);
+      break;
+    case PROP_DIRECT_IO:
+      absolutetimestamps->direct_io = g_value_get_boolean (value);
+      break;
+    case PROP_FIELDS:
+      absolutetimestamps->fields = g_value_get_flags (value);
+      break;
+    case PROP_MAX_HISTORY:
+      absolutetimestamps->max_history = g_value_get_uint (value);
+      break;
+    case PROP_MAX_HISTORY_BYTES:
+      absolutetimestamps->max_history_bytes = g_value_get_uint64 (value);
+      break;
+    case PROP_ADAPTIVE:
+      absolutetimestamps->adaptive = g_value_get_boolean (value);
+      break;
+    case PROP_PRESSURE_THRESHOLD:
+      absolutetimestamps->pressure_threshold = g_value_get_uint (value);
+      break;
+    case PROP_CLOCK_SYNC:
+      absolutetimestamps->clock_sync = g_value_get_enum (value);
+      break;
+    case PROP_CLOCK_SYNC_INTERVAL:
+      absolutetimestamps->clock_sync_interval = g_value_get_uint (value);
+      break;
+    case PROP_CLOCK_SYNC_DOMAIN:
+      absolutetimestamps->clock_sync_domain = g_value_get_uint (value);
+      break;
+    case PROP_CAPTURE_TIME:
+      absolutetimestamps->capture_time = g_value_get_enum (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -165,9 +849,158 @@ gst_absolutetimestamps_get_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (absolutetimestamps, "get_property");
 
   switch (property_id) {
+    case PROP_OUTPUT:
+      g_value_set_flags (value, absolutetimestamps->output_flags);
+      break;
     case PROP_LOCATION:
       g_value_set_string (value, absolutetimestamps->filename);
       break;
+    case PROP_FORMAT:
+      g_value_set_enum (value, absolutetimestamps->format);
+      break;
+    case PROP_PRECISION:
+      g_value_set_enum (value, absolutetimestamps->precision);
+      break;
+    case PROP_CLOCK_SOURCE:
+      g_value_set_enum (value, absolutetimestamps->clock_source);
+      break;
+    case PROP_BUFFER_SIZE:
+      g_value_set_uint (value, absolutetimestamps->buffer_size);
+      break;
+    case PROP_FLUSH_POLICY:
+      g_value_set_enum (value, absolutetimestamps->flush_policy);
+      break;
+    case PROP_FLUSH_RECORDS:
+      g_value_set_uint (value, absolutetimestamps->flush_records);
+      break;
+    case PROP_FLUSH_INTERVAL:
+      g_value_set_uint (value, absolutetimestamps->flush_interval);
+      break;
+    case PROP_ASYNC_WRITE:
+      g_value_set_boolean (value, absolutetimestamps->async_write);
+      break;
+    case PROP_RING_CAPACITY:
+      g_value_set_uint (value, absolutetimestamps->ring_capacity);
+      break;
+    case PROP_DROPPED:
+      GST_OBJECT_LOCK (absolutetimestamps);
+      g_value_set_uint64 (value, absolutetimestamps->dropped);
+      GST_OBJECT_UNLOCK (absolutetimestamps);
+      break;
+    case PROP_INSTRUMENTATION:
+      g_value_set_boolean (value, absolutetimestamps->instrumentation);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, absolutetimestamps->stats_interval);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_absolutetimestamps_stats_to_structure (&absolutetimestamps->stats,
+              "absolutetimestamps-stats"));
+      break;
+    case PROP_MAX_SIZE_BYTES:
+      g_value_set_uint64 (value, absolutetimestamps->max_size_bytes);
+      break;
+    case PROP_MAX_SIZE_TIME:
+      g_value_set_uint64 (value, absolutetimestamps->max_size_time);
+      break;
+    case PROP_SPLIT_ON_FRAGMENT:
+      g_value_set_boolean (value, absolutetimestamps->split_on_fragment);
+      break;
+    case PROP_WRITER_GROUP:
+      g_value_set_string (value, absolutetimestamps->writer_group);
+      break;
+    case PROP_STREAM_ID:
+      g_value_set_int (value, absolutetimestamps->stream_id);
+      break;
+    case PROP_MODE:
+      g_value_set_enum (value, absolutetimestamps->mode);
+      break;
+    case PROP_INTERVAL:
+      g_value_set_uint (value, absolutetimestamps->interval);
+      break;
+    case PROP_DRIFT_TOLERANCE:
+      g_value_set_uint64 (value, absolutetimestamps->drift_tolerance);
+      break;
+    case PROP_MODEL:
+      g_value_set_boolean (value, absolutetimestamps->model);
+      break;
+    case PROP_MODEL_INTERVAL:
+      g_value_set_uint64 (value, absolutetimestamps->model_interval);
+      break;
+    case PROP_MODEL_SLOPE:
+      GST_OBJECT_LOCK (absolutetimestamps);
+      g_value_set_double (value, absolutetimestamps->published_slope);
+      GST_OBJECT_UNLOCK (absolutetimestamps);
+      break;
+    case PROP_MODEL_OFFSET:
+      GST_OBJECT_LOCK (absolutetimestamps);
+      g_value_set_int64 (value, absolutetimestamps->published_offset);
+      GST_OBJECT_UNLOCK (absolutetimestamps);
+      break;
+    case PROP_MODEL_RESIDUAL:
+      GST_OBJECT_LOCK (absolutetimestamps);
+      g_value_set_double (value, absolutetimestamps->published_residual);
+      GST_OBJECT_UNLOCK (absolutetimestamps);
+      break;
+    case PROP_PTS_DOMAIN:
+      g_value_set_enum (value, absolutetimestamps->pts_domain);
+      break;
+    case PROP_SEEK_INDEX:
+      g_value_set_boolean (value, absolutetimestamps->seek_index);
+      break;
+    case PROP_SEEK_INDEX_INTERVAL:
+      g_value_set_uint64 (value, absolutetimestamps->seek_index_interval);
+      break;
+    case PROP_SINK:
+      g_value_set_enum (value, absolutetimestamps->sink);
+      break;
+    case PROP_SHM_CAPACITY:
+      g_value_set_uint (value, absolutetimestamps->shm_capacity);
+      break;
+    case PROP_APPEND:
+      g_value_set_boolean (value, absolutetimestamps->append);
+      break;
+    case PROP_SYNC_WRITES:
+      g_value_set_boolean (value, absolutetimestamps->sync_writes);
+      break;
+    case PROP_DIRECT_IO:
+      g_value_set_boolean (value, absolutetimestamps->direct_io);
+      break;
+    case PROP_FIELDS:
+      g_value_set_flags (value, absolutetimestamps->fields);
+      break;
+    case PROP_MAX_HISTORY:
+      g_value_set_uint (value, absolutetimestamps->max_history);
+      break;
+    case PROP_MAX_HISTORY_BYTES:
+      g_value_set_uint64 (value, absolutetimestamps->max_history_bytes);
+      break;
+    case PROP_ADAPTIVE:
+      g_value_set_boolean (value, absolutetimestamps->adaptive);
+      break;
+    case PROP_PRESSURE_THRESHOLD:
+      g_value_set_uint (value, absolutetimestamps->pressure_threshold);
+      break;
+    case PROP_PRESSURE:
+      g_value_set_enum (value, g_atomic_int_get (&absolutetimestamps->pressure));
+      break;
+    case PROP_CLOCK_SYNC:
+      g_value_set_enum (value, absolutetimestamps->clock_sync);
+      break;
+    case PROP_CLOCK_SYNC_INTERVAL:
+      g_value_set_uint (value, absolutetimestamps->clock_sync_interval);
+      break;
+    case PROP_CLOCK_SYNC_DOMAIN:
+      g_value_set_uint (value, absolutetimestamps->clock_sync_domain);
+      break;
+    case PROP_CAPTURE_TIME:
+      g_value_set_enum (value, absolutetimestamps->capture_time);
+      break;
+    case PROP_UPSTREAM_LATENCY:
+      GST_OBJECT_LOCK (absolutetimestamps);
+      g_value_set_uint64 (value, absolutetimestamps->upstream_latency);
+      GST_OBJECT_UNLOCK (absolutetimestamps);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -187,6 +1020,21 @@ gst_absolutetimestamps_dispose (GObject * object)
 
   g_free (absolutetimestamps->filename);
   absolutetimestamps->filename = NULL;
+  g_free (absolutetimestamps->writer_group);
+  absolutetimestamps->writer_group = NULL;
+}
+
+void
+gst_absolutetimestamps_finalize (GObject * object)
+{
+  GstAbsolutetimestamps *absolutetimestamps = GST_ABSOLUTETIMESTAMPS (object);
+
+  GST_DEBUG_OBJECT (absolutetimestamps, "finalize");
+
+  g_mutex_clear (&absolutetimestamps->writer_lock);
+  g_cond_clear (&absolutetimestamps->writer_cond);
+
+  G_OBJECT_CLASS (gst_absolutetimestamps_parent_class)->finalize (object);
 }
 
 static gboolean
@@ -207,6 +1055,459 @@ gst_absolutetimestamps_accept_caps (GstBaseTransform * trans,
   return gst_pad_peer_query_accept_caps (pad, caps);
 }
 
+/* writing */
+
+static gboolean
+gst_absolutetimestamps_write_record (GstAbsolutetimestamps * absolutetimestamps,
+    const GstAbsolutetimestampsRecord * record)
+{
+  GError *error = NULL;
+
+  if (!gst_absolutetimestamps_output_write_record (absolutetimestamps->output, record, &error)) {
+    GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, WRITE,
+        ("Could not write to file \"%s\".", absolutetimestamps->filename),
+        ("%s", error->message));
+    g_error_free (error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_absolutetimestamps_flush_if_due (GstAbsolutetimestamps * absolutetimestamps)
+{
+  GError *error = NULL;
+
+  if (!gst_absolutetimestamps_output_flush_if_due (absolutetimestamps->output, &error)) {
+    GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, WRITE,
+        ("Could not write to file \"%s\".", absolutetimestamps->filename),
+        ("%s", error->message));
+    g_error_free (error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+// The writer thread drains the ring whenever it has anything in it. When the ring is empty it
+// advertises that it's about to sleep via writer_waiting, so that the streaming thread only has to
+// take writer_lock (to wake it up) in the case where it's actually asleep.
+static gpointer
+gst_absolutetimestamps_writer_thread (gpointer data)
+{
+  GstAbsolutetimestamps *absolutetimestamps = GST_ABSOLUTETIMESTAMPS (data);
+  GstAbsolutetimestampsRecord record;
+  gboolean ok = TRUE;
+
+  GST_DEBUG_OBJECT (absolutetimestamps, "writer thread started");
+
+  // After a write error there's nothing useful left to do except keep draining the ring until stopped.
+  for (;;) {
+    while (gst_absolutetimestamps_ring_pop (absolutetimestamps->ring, &record))
+      ok = ok && gst_absolutetimestamps_write_record (absolutetimestamps, &record);
+
+    if (g_atomic_int_get (&absolutetimestamps->writer_stopping)) {
+      // The streaming thread has stopped by now, so a final drain catches anything pushed since the last one.
+      while (gst_absolutetimestamps_ring_pop (absolutetimestamps->ring, &record))
+        ok = ok && gst_absolutetimestamps_write_record (absolutetimestamps, &record);
+      break;
+    }
+
+    ok = ok && gst_absolutetimestamps_flush_if_due (absolutetimestamps);
+
+    g_mutex_lock (&absolutetimestamps->writer_lock);
+    g_atomic_int_set (&absolutetimestamps->writer_waiting, 1);
+    if (gst_absolutetimestamps_ring_is_empty (absolutetimestamps->ring) &&
+        !g_atomic_int_get (&absolutetimestamps->writer_stopping))
+      g_cond_wait_until (&absolutetimestamps->writer_cond,
+          &absolutetimestamps->writer_lock, g_get_monotonic_time () + WRITER_WAIT_USEC);
+    g_atomic_int_set (&absolutetimestamps->writer_waiting, 0);
+    g_mutex_unlock (&absolutetimestamps->writer_lock);
+  }
+
+  GST_DEBUG_OBJECT (absolutetimestamps, "writer thread stopped");
+
+  return NULL;
+}
+
+static void
+gst_absolutetimestamps_wake_writer (GstAbsolutetimestamps * absolutetimestamps)
+{
+  g_mutex_lock (&absolutetimestamps->writer_lock);
+  g_cond_signal (&absolutetimestamps->writer_cond);
+  g_mutex_unlock (&absolutetimestamps->writer_lock);
+}
+
+// Called by the streaming thread after queuing records, whether the ring is drained by this
+// element's own writer or by its writer group's.
+static inline void
+gst_absolutetimestamps_wake_writer_if_waiting (GstAbsolutetimestamps * absolutetimestamps)
+{
+  if (absolutetimestamps->group_member)
+    gst_absolutetimestamps_writer_group_wake (absolutetimestamps->group_member->group);
+  else if (g_atomic_int_get (&absolutetimestamps->writer_waiting))
+    gst_absolutetimestamps_wake_writer (absolutetimestamps);
+}
+
+static gboolean
+gst_absolutetimestamps_start_writer (GstAbsolutetimestamps * absolutetimestamps)
+{
+  GError *error = NULL;
+
+  absolutetimestamps->ring = gst_absolutetimestamps_ring_new (absolutetimestamps->ring_capacity);
+  absolutetimestamps->writer_waiting = 0;
+  absolutetimestamps->writer_stopping = 0;
+
+  GST_DEBUG_OBJECT (absolutetimestamps, "starting writer with a ring of %u records",
+      gst_absolutetimestamps_ring_get_capacity (absolutetimestamps->ring));
+
+  absolutetimestamps->writer_thread = g_thread_try_new ("absts-writer",
+      gst_absolutetimestamps_writer_thread, absolutetimestamps, &error);
+
+  if (absolutetimestamps->writer_thread == NULL) {
+    GST_ELEMENT_ERROR (absolutetimestamps, CORE, THREAD,
+        ("Could not start writer thread."), ("%s", error->message));
+    g_error_free (error);
+    gst_absolutetimestamps_ring_free (absolutetimestamps->ring);
+    absolutetimestamps->ring = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_absolutetimestamps_stop_writer (GstAbsolutetimestamps * absolutetimestamps)
+{
+  if (absolutetimestamps->writer_thread == NULL)
+    return;
+
+  g_atomic_int_set (&absolutetimestamps->writer_stopping, 1);
+  gst_absolutetimestamps_wake_writer (absolutetimestamps);
+
+  g_thread_join (absolutetimestamps->writer_thread);
+  absolutetimestamps->writer_thread = NULL;
+
+  gst_absolutetimestamps_ring_free (absolutetimestamps->ring);
+  absolutetimestamps->ring = NULL;
+}
+
+/* rotation */
+
+// Called on whichever thread splitmuxsink posts from, so it only records the fragment's start and
+// leaves it to the streaming thread to mark the record the new file should begin with.
+static void
+gst_absolutetimestamps_on_sync_message (GstBus * bus, GstMessage * message, gpointer user_data)
+{
+  GstAbsolutetimestamps *absolutetimestamps = GST_ABSOLUTETIMESTAMPS (user_data);
+  const GstStructure *structure = gst_message_get_structure (message);
+  GstClockTime running_time = GST_CLOCK_TIME_NONE;
+
+  if (!gst_structure_has_name (structure, "splitmuxsink-fragment-opened"))
+    return;
+
+  gst_structure_get_clock_time (structure, "running-time", &running_time);
+
+  GST_DEBUG_OBJECT (absolutetimestamps, "fragment opened at %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (running_time));
+
+  GST_OBJECT_LOCK (absolutetimestamps);
+  absolutetimestamps->split_running_time = running_time;
+  GST_OBJECT_UNLOCK (absolutetimestamps);
+
+  g_atomic_int_set (&absolutetimestamps->split_pending, 1);
+}
+
+// splitmuxsink may be anywhere in the pipeline, so watch the bus of the top-level bin.
+static void
+gst_absolutetimestamps_watch_fragments (GstAbsolutetimestamps * absolutetimestamps)
+{
+  GstObject *top = gst_object_ref (absolutetimestamps);
+  GstObject *parent;
+
+  while ((parent = gst_object_get_parent (top)) != NULL) {
+    gst_object_unref (top);
+    top = parent;
+  }
+
+  absolutetimestamps->split_bus = gst_element_get_bus (GST_ELEMENT (top));
+  gst_object_unref (top);
+
+  if (absolutetimestamps->split_bus == NULL) {
+    GST_WARNING_OBJECT (absolutetimestamps, "no bus, split-on-fragment will have no effect");
+    return;
+  }
+
+  absolutetimestamps->split_pending = 0;
+  absolutetimestamps->split_running_time = GST_CLOCK_TIME_NONE;
+  absolutetimestamps->split_file_start = GST_CLOCK_TIME_NONE;
+
+  gst_bus_enable_sync_message_emission (absolutetimestamps->split_bus);
+  absolutetimestamps->split_handler = g_signal_connect (absolutetimestamps->split_bus,
+      "sync-message::element", G_CALLBACK (gst_absolutetimestamps_on_sync_message),
+      absolutetimestamps);
+}
+
+static void
+gst_absolutetimestamps_unwatch_fragments (GstAbsolutetimestamps * absolutetimestamps)
+{
+  if (absolutetimestamps->split_bus == NULL)
+    return;
+
+  g_signal_handler_disconnect (absolutetimestamps->split_bus, absolutetimestamps->split_handler);
+  gst_bus_disable_sync_message_emission (absolutetimestamps->split_bus);
+  gst_object_unref (absolutetimestamps->split_bus);
+  absolutetimestamps->split_bus = NULL;
+}
+
+// Marks record as the first of a new file if a fragment has been opened since the current file
+// started and the record belongs to it.
+static void
+gst_absolutetimestamps_check_fragment (GstAbsolutetimestamps * absolutetimestamps,
+    GstAbsolutetimestampsRecord * record)
+{
+  GstClockTime running_time, boundary;
+
+  running_time = gst_segment_to_running_time (&GST_BASE_TRANSFORM (absolutetimestamps)->segment,
+      GST_FORMAT_TIME, record->pts);
+
+  if (!GST_CLOCK_TIME_IS_VALID (absolutetimestamps->split_file_start))
+    absolutetimestamps->split_file_start = running_time;
+
+  if (!g_atomic_int_get (&absolutetimestamps->split_pending))
+    return;
+
+  GST_OBJECT_LOCK (absolutetimestamps);
+  boundary = absolutetimestamps->split_running_time;
+  GST_OBJECT_UNLOCK (absolutetimestamps);
+
+  // Records from before the fragment still belong in the current file, e.g. when this element is
+  // in a branch that runs behind the one feeding splitmuxsink.
+  if (GST_CLOCK_TIME_IS_VALID (boundary) && GST_CLOCK_TIME_IS_VALID (running_time) &&
+      running_time < boundary)
+    return;
+
+  g_atomic_int_set (&absolutetimestamps->split_pending, 0);
+
+  // The current file may already begin with the fragment, e.g. for the very first one.
+  if (GST_CLOCK_TIME_IS_VALID (boundary) &&
+      GST_CLOCK_TIME_IS_VALID (absolutetimestamps->split_file_start) &&
+      absolutetimestamps->split_file_start >= boundary)
+    return;
+
+  record->flags |= GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE;
+  absolutetimestamps->split_file_start = running_time;
+}
+
+static GstAbsolutetimestampsOutput *
+gst_absolutetimestamps_create_output (GstAbsolutetimestamps * absolutetimestamps)
+{
+  GstAbsolutetimestampsOutput *output = gst_absolutetimestamps_output_new ();
+
+  output->filename = g_strdup (absolutetimestamps->filename);
+  output->format = absolutetimestamps->format;
+  output->precision = absolutetimestamps->precision;
+  output->clock_source = absolutetimestamps->clock_source;
+  output->buffer_size = absolutetimestamps->buffer_size;
+  output->flush_policy = absolutetimestamps->flush_policy;
+  output->flush_records = absolutetimestamps->flush_records;
+  output->flush_interval = absolutetimestamps->flush_interval * GST_MSECOND;
+  output->max_size = absolutetimestamps->max_size_bytes;
+  output->max_duration = absolutetimestamps->max_size_time;
+  output->mode = (GstAbstsMode) absolutetimestamps->mode;
+  output->models = absolutetimestamps->model && absolutetimestamps->model_interval > 0;
+  output->markers = TRUE;
+  output->modes = absolutetimestamps->adaptive;
+  output->clock_sync = absolutetimestamps->clock_sync != GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_NONE;
+  output->pts_domain =
+      absolutetimestamps->pts_domain == GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_RUNNING_TIME ?
+      GST_ABSTS_HEADER_FLAG_RUNNING_TIME :
+      absolutetimestamps->pts_domain == GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_STREAM_TIME ?
+      GST_ABSTS_HEADER_FLAG_STREAM_TIME : 0;
+  output->seek_index = absolutetimestamps->seek_index;
+  output->seek_index_interval = absolutetimestamps->seek_index_interval;
+  output->sink = absolutetimestamps->sink;
+  output->shm_capacity = absolutetimestamps->shm_capacity;
+  output->append = absolutetimestamps->append;
+  output->sync_writes = absolutetimestamps->sync_writes;
+  output->direct_io = absolutetimestamps->direct_io;
+  output->fields = absolutetimestamps->fields;
+
+  return output;
+}
+
+// fields is a constant in each of the copies below, so that only the chosen fields are read from the
+// buffer and the rest of the tests fold away. Fields that weren't chosen are left as they are.
+static inline void
+fill_fields (GstAbsolutetimestampsRecord * record, GstBuffer * buf, const guint fields)
+{
+  if (fields & GST_ABSOLUTETIMESTAMPS_FIELD_DTS)
+    record->fields[GST_ABSTS_FIELD_DTS] = GST_BUFFER_DTS (buf);
+  if (fields & GST_ABSOLUTETIMESTAMPS_FIELD_DURATION)
+    record->fields[GST_ABSTS_FIELD_DURATION] = GST_BUFFER_DURATION (buf);
+  if (fields & GST_ABSOLUTETIMESTAMPS_FIELD_OFFSET)
+    record->fields[GST_ABSTS_FIELD_OFFSET] = GST_BUFFER_OFFSET (buf);
+  if (fields & GST_ABSOLUTETIMESTAMPS_FIELD_SIZE)
+    record->fields[GST_ABSTS_FIELD_SIZE] = gst_buffer_get_size (buf);
+}
+
+#define DEFINE_FILL_FIELDS(fields) \
+static void \
+fill_fields_##fields (GstAbsolutetimestampsRecord * record, GstBuffer * buf) \
+{ \
+  fill_fields (record, buf, fields); \
+}
+
+DEFINE_FILL_FIELDS (1)
+DEFINE_FILL_FIELDS (2)
+DEFINE_FILL_FIELDS (3)
+DEFINE_FILL_FIELDS (4)
+DEFINE_FILL_FIELDS (5)
+DEFINE_FILL_FIELDS (6)
+DEFINE_FILL_FIELDS (7)
+DEFINE_FILL_FIELDS (8)
+DEFINE_FILL_FIELDS (9)
+DEFINE_FILL_FIELDS (10)
+DEFINE_FILL_FIELDS (11)
+DEFINE_FILL_FIELDS (12)
+DEFINE_FILL_FIELDS (13)
+DEFINE_FILL_FIELDS (14)
+DEFINE_FILL_FIELDS (15)
+
+// Indexed by GstAbsolutetimestampsFields, NULL when there's nothing to capture.
+static const GstAbsolutetimestampsFillFields fill_fields_funcs[] = {
+  NULL, fill_fields_1, fill_fields_2, fill_fields_3, fill_fields_4, fill_fields_5, fill_fields_6,
+  fill_fields_7, fill_fields_8, fill_fields_9, fill_fields_10, fill_fields_11, fill_fields_12,
+  fill_fields_13, fill_fields_14, fill_fields_15
+};
+
+// In a writer group the group's first member decides the file and its settings, and records always
+// go through a ring to the group's thread, whatever async-write says.
+static gboolean
+gst_absolutetimestamps_join_writer_group (GstAbsolutetimestamps * absolutetimestamps)
+{
+  GError *error = NULL;
+
+  if (absolutetimestamps->split_on_fragment) {
+    GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, SETTINGS,
+        ("split-on-fragment can't be used with writer-group, the file is shared."), (NULL));
+    return FALSE;
+  }
+
+  absolutetimestamps->group_member =
+      gst_absolutetimestamps_writer_group_join (absolutetimestamps->writer_group,
+      GST_ELEMENT (absolutetimestamps), gst_absolutetimestamps_create_output (absolutetimestamps),
+      absolutetimestamps->ring_capacity, absolutetimestamps->stream_id, &error);
+
+  if (absolutetimestamps->group_member == NULL) {
+    GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, OPEN_WRITE,
+        ("Could not join writer group \"%s\".", absolutetimestamps->writer_group),
+        ("%s", error->message));
+    g_error_free (error);
+    return FALSE;
+  }
+
+  absolutetimestamps->ring = absolutetimestamps->group_member->ring;
+  absolutetimestamps->fill_fields = fill_fields_funcs[absolutetimestamps->group_member->fields];
+
+  return TRUE;
+}
+
+static gboolean
+gst_absolutetimestamps_open_output (GstAbsolutetimestamps * absolutetimestamps)
+{
+  GError *error = NULL;
+
+  if (absolutetimestamps->sink == GST_ABSOLUTETIMESTAMPS_SINK_FILE &&
+      (absolutetimestamps->max_size_bytes > 0 || absolutetimestamps->max_size_time > 0 ||
+          absolutetimestamps->split_on_fragment) && strchr (absolutetimestamps->filename, '%') == NULL) {
+    GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, SETTINGS,
+        ("Location \"%s\" needs a pattern such as %%05d to split the output into several files.",
+            absolutetimestamps->filename), (NULL));
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (absolutetimestamps);
+  absolutetimestamps->dropped = 0;
+  GST_OBJECT_UNLOCK (absolutetimestamps);
+
+  if (absolutetimestamps->writer_group != NULL && absolutetimestamps->writer_group[0] != '\0')
+    return gst_absolutetimestamps_join_writer_group (absolutetimestamps);
+
+  absolutetimestamps->output = gst_absolutetimestamps_create_output (absolutetimestamps);
+
+  if (!gst_absolutetimestamps_output_open (absolutetimestamps->output, &error)) {
+    GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, OPEN_WRITE,
+        ("Could not open \"%s\" for writing.", absolutetimestamps->filename),
+        ("%s", error->message));
+    g_error_free (error);
+    gst_absolutetimestamps_output_free (absolutetimestamps->output);
+    absolutetimestamps->output = NULL;
+    return FALSE;
+  }
+
+  // The output drops the fields it can't write, so only those it kept are captured.
+  absolutetimestamps->fill_fields = fill_fields_funcs[absolutetimestamps->output->fields];
+
+  if (absolutetimestamps->output->io != NULL)
+    GST_INFO_OBJECT (absolutetimestamps, "Writing \"%s\" with %s", absolutetimestamps->filename,
+        gst_absolutetimestamps_io_get_backend (absolutetimestamps->output->io));
+
+  if (absolutetimestamps->async_write && !gst_absolutetimestamps_start_writer (absolutetimestamps)) {
+    gst_absolutetimestamps_output_free (absolutetimestamps->output);
+    absolutetimestamps->output = NULL;
+    return FALSE;
+  }
+
+  if (absolutetimestamps->split_on_fragment)
+    gst_absolutetimestamps_watch_fragments (absolutetimestamps);
+
+  return TRUE;
+}
+
+/* instrumentation */
+
+static gint64
+gst_absolutetimestamps_get_monotonic_time (void)
+{
+  return gst_absolutetimestamps_clock_get_time (CLOCK_MONOTONIC);
+}
+
+// Called at the end of transform_ip with the monotonic time at which the buffer arrived. The
+// histograms are only touched here, on the streaming thread, while readers of the stats property
+// may look at them from any thread.
+static void
+gst_absolutetimestamps_measure (GstAbsolutetimestamps * absolutetimestamps, GstClockTime pts,
+    gint64 arrival, gboolean traced)
+{
+  GstAbsolutetimestampsStats *stats = &absolutetimestamps->stats;
+  gint64 now = gst_absolutetimestamps_get_monotonic_time ();
+  guint64 self_time = (guint64) (now - arrival);
+  GstClockTimeDiff skew = 0;
+  guint64 jitter;
+
+  gst_absolutetimestamps_histogram_add (&stats->self_time, self_time);
+  jitter = gst_absolutetimestamps_stats_add_arrival (stats, pts, arrival);
+  if (gst_absolutetimestamps_clock_get_skew (GST_BASE_TRANSFORM (absolutetimestamps), pts, &skew))
+    gst_absolutetimestamps_stats_add_skew (stats, skew);
+
+  if (traced)
+    gst_absolutetimestamps_tracer_log_buffer (GST_ELEMENT (absolutetimestamps), pts, self_time,
+        skew, jitter);
+
+  if (absolutetimestamps->instrumentation && absolutetimestamps->stats_interval > 0 &&
+      now - absolutetimestamps->last_stats_message >=
+      (gint64) absolutetimestamps->stats_interval * GST_MSECOND) {
+    GstStructure *structure = gst_absolutetimestamps_stats_to_structure (stats,
+        "absolutetimestamps-stats");
+
+    absolutetimestamps->last_stats_message = now;
+    gst_element_post_message (GST_ELEMENT (absolutetimestamps),
+        gst_message_new_element (GST_OBJECT (absolutetimestamps), structure));
+  }
+}
+
 /* states */
 static gboolean
 gst_absolutetimestamps_start (GstBaseTransform * trans)
@@ -215,15 +1516,78 @@ gst_absolutetimestamps_start (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (absolutetimestamps, "start");
 
-  absolutetimestamps->file = g_fopen (absolutetimestamps->filename, "wb");
+  gst_absolutetimestamps_clock_init (&absolutetimestamps->clock, absolutetimestamps->clock_source);
+
+  gst_absolutetimestamps_stats_reset (&absolutetimestamps->stats);
+  absolutetimestamps->last_stats_message = gst_absolutetimestamps_get_monotonic_time ();
+  absolutetimestamps->carried_flags = 0;
+  absolutetimestamps->n_held = 0;
+  absolutetimestamps->mode_count = 0;
+  absolutetimestamps->last_kept_pts = GST_CLOCK_TIME_NONE;
+  absolutetimestamps->last_kept_wallclock = 0;
+  gst_absolutetimestamps_model_reset (&absolutetimestamps->fit);
+  absolutetimestamps->next_snapshot_pts = GST_CLOCK_TIME_NONE;
+  absolutetimestamps->latency_pending = 1;
+  absolutetimestamps->fill_fields = NULL;
+  g_atomic_int_set (&absolutetimestamps->pressure, GST_ABSOLUTETIMESTAMPS_PRESSURE_NONE);
+
+  // Allocated whole up front, the streaming thread only ever copies records into it.
+  if (absolutetimestamps->max_history > 0 || absolutetimestamps->max_history_bytes > 0) {
+    GError *error = NULL;
+    GstAbsolutetimestampsHistory *history =
+        gst_absolutetimestamps_history_new (absolutetimestamps->max_history,
+        absolutetimestamps->max_history_bytes,
+        absolutetimestamps->mode == GST_ABSOLUTETIMESTAMPS_MODE_EVERY_NTH ||
+        absolutetimestamps->mode == GST_ABSOLUTETIMESTAMPS_MODE_KEYFRAMES_ONLY, &error);
+
+    if (history == NULL) {
+      GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, NO_SPACE_LEFT,
+          ("Not enough memory for the history set by max-history and max-history-bytes."),
+          ("%s", error->message));
+      g_error_free (error);
+      gst_absolutetimestamps_stop (trans);
+      return FALSE;
+    }
+
+    GST_OBJECT_LOCK (absolutetimestamps);
+    absolutetimestamps->history = history;
+    GST_OBJECT_UNLOCK (absolutetimestamps);
+  }
 
-  if (absolutetimestamps->file == NULL) {
-    GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, OPEN_WRITE,
-        ("Could not open file \"%s\" for writing.", absolutetimestamps->filename),
-        GST_ERROR_SYSTEM);
+  // GstBaseTransform doesn't call stop after a failed start, so whatever was set up is undone here.
+  if (absolutetimestamps->output_flags & GST_ABSOLUTETIMESTAMPS_OUTPUT_FILE &&
+      !gst_absolutetimestamps_open_output (absolutetimestamps)) {
+    gst_absolutetimestamps_stop (trans);
     return FALSE;
   }
 
+  if (absolutetimestamps->clock_sync != GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_NONE) {
+    GError *error = NULL;
+
+    absolutetimestamps->sync_sampler =
+        gst_absolutetimestamps_sync_sampler_new (GST_ELEMENT (absolutetimestamps),
+        absolutetimestamps->clock_sync, absolutetimestamps->clock_sync_interval * GST_SECOND,
+        absolutetimestamps->clock_sync_domain, &error);
+
+    if (absolutetimestamps->sync_sampler == NULL) {
+      GST_ELEMENT_ERROR (absolutetimestamps, CORE, THREAD,
+          ("Could not start clock-sync thread."), ("%s", error->message));
+      g_error_free (error);
+      gst_absolutetimestamps_stop (trans);
+      return FALSE;
+    }
+  }
+
+  // Only adding a meta needs a writable buffer. Even then GstBaseTransform just makes a shallow copy
+  // of a buffer that isn't writable - the memory, i.e. the frame, is shared rather than copied.
+  if (absolutetimestamps->output_flags & GST_ABSOLUTETIMESTAMPS_OUTPUT_META) {
+    absolutetimestamps->reference_caps =
+        gst_absolutetimestamps_clock_source_get_reference (absolutetimestamps->clock_source);
+    gst_base_transform_set_passthrough (trans, FALSE);
+  } else {
+    gst_base_transform_set_passthrough (trans, TRUE);
+  }
+
   return TRUE;
 }
 
@@ -235,50 +1599,813 @@ static gboolean
 gst_absolutetimestamps_stop (GstBaseTransform * trans)
 {
   GstAbsolutetimestamps *absolutetimestamps = GST_ABSOLUTETIMESTAMPS (trans);
+  GError *error = NULL;
 
   GST_DEBUG_OBJECT (absolutetimestamps, "stop");
 
-  if (absolutetimestamps->file) {
-    if (fclose (absolutetimestamps->file) != 0)
+  gst_absolutetimestamps_unwatch_fragments (absolutetimestamps);
+
+  if (absolutetimestamps->sync_sampler) {
+    gst_absolutetimestamps_sync_sampler_free (absolutetimestamps->sync_sampler);
+    absolutetimestamps->sync_sampler = NULL;
+  }
+
+  // Join the writer before closing the file it's writing to.
+  gst_absolutetimestamps_stop_writer (absolutetimestamps);
+
+  if (absolutetimestamps->group_member) {
+    if (!gst_absolutetimestamps_writer_group_leave (absolutetimestamps->group_member, &error)) {
       GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, CLOSE,
-          ("Error closing file \"%s\".", absolutetimestamps->filename), GST_ERROR_SYSTEM);
+          ("Error closing file of writer group \"%s\".", absolutetimestamps->writer_group),
+          ("%s", error->message));
+      g_clear_error (&error);
+    }
+    absolutetimestamps->group_member = NULL;
+    absolutetimestamps->ring = NULL;
+  }
+
+  if (absolutetimestamps->output) {
+    if (!gst_absolutetimestamps_output_close (absolutetimestamps->output, &error)) {
+      GST_ELEMENT_ERROR (absolutetimestamps, RESOURCE, CLOSE,
+          ("Error closing file \"%s\".", absolutetimestamps->filename), ("%s", error->message));
+      g_error_free (error);
+    }
+
+    gst_absolutetimestamps_output_free (absolutetimestamps->output);
+    absolutetimestamps->output = NULL;
+  }
+
+  gst_absolutetimestamps_clock_clear (&absolutetimestamps->clock);
+
+  GST_OBJECT_LOCK (absolutetimestamps);
+  if (absolutetimestamps->history) {
+    gst_absolutetimestamps_history_free (absolutetimestamps->history);
+    absolutetimestamps->history = NULL;
+  }
+  GST_OBJECT_UNLOCK (absolutetimestamps);
+
+  if (absolutetimestamps->reference_caps) {
+    gst_caps_unref (absolutetimestamps->reference_caps);
+    absolutetimestamps->reference_caps = NULL;
+  }
+
+  return TRUE;
+}
+
+// Maps a buffer's pts to what pts-domain says to record, GST_CLOCK_TIME_NONE if it's outside the segment.
+static inline GstClockTime
+gst_absolutetimestamps_to_pts_domain (GstAbsolutetimestamps * absolutetimestamps, GstClockTime pts)
+{
+  GstSegment *segment = &GST_BASE_TRANSFORM (absolutetimestamps)->segment;
+
+  switch (absolutetimestamps->pts_domain) {
+    case GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_RUNNING_TIME:
+      return gst_segment_to_running_time (segment, GST_FORMAT_TIME, pts);
+    case GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_STREAM_TIME:
+      return gst_segment_to_stream_time (segment, GST_FORMAT_TIME, pts);
+    default:
+      return pts;
+  }
+}
+
+static void
+gst_absolutetimestamps_fill_record (GstAbsolutetimestamps * absolutetimestamps,
+    GstAbsolutetimestampsRecord * record, GstBuffer * buf, gint64 wallclock)
+{
+  record->pts = GST_BUFFER_PTS (buf);
+  record->wallclock = wallclock;
+  record->flags = 0;
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DISCONT))
+    record->flags |= GST_ABSTS_RECORD_FLAG_DISCONT;
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT))
+    record->flags |= GST_ABSTS_RECORD_FLAG_DELTA_UNIT;
+
+  if (absolutetimestamps->split_bus)
+    gst_absolutetimestamps_check_fragment (absolutetimestamps, record);
+
+  record->flags |= absolutetimestamps->carried_flags;
+  absolutetimestamps->carried_flags = 0;
+
+  record->stream_id = absolutetimestamps->group_member ? absolutetimestamps->group_member->stream_id : 0;
+
+  if (absolutetimestamps->fill_fields) {
+    // Left at none unless dts is among the fields, so that it's only mapped if it was read.
+    record->fields[GST_ABSTS_FIELD_DTS] = GST_CLOCK_TIME_NONE;
+    absolutetimestamps->fill_fields (record, buf);
+    // The dts goes in the same time base as the pts, none if it's outside the segment.
+    if (GST_CLOCK_TIME_IS_VALID (record->fields[GST_ABSTS_FIELD_DTS]))
+      record->fields[GST_ABSTS_FIELD_DTS] = gst_absolutetimestamps_to_pts_domain (absolutetimestamps,
+          record->fields[GST_ABSTS_FIELD_DTS]);
+  }
+
+  // Only now, the above all work with the raw pts.
+  record->pts = gst_absolutetimestamps_to_pts_domain (absolutetimestamps, record->pts);
+}
+
+// The mode in effect: the mode property, unless pressure calls for a coarser one.
+static GstAbsolutetimestampsMode
+gst_absolutetimestamps_get_mode (GstAbsolutetimestamps * absolutetimestamps)
+{
+  switch (absolutetimestamps->pressure) {
+    case GST_ABSOLUTETIMESTAMPS_PRESSURE_CRITICAL:
+      return GST_ABSOLUTETIMESTAMPS_MODE_DRIFT_ONLY;
+    case GST_ABSOLUTETIMESTAMPS_PRESSURE_ELEVATED:
+      // Keyframes and drift only are already sparser than every interval'th buffer.
+      return MAX (absolutetimestamps->mode, GST_ABSOLUTETIMESTAMPS_MODE_EVERY_NTH);
+    default:
+      return absolutetimestamps->mode;
+  }
+}
+
+// Decides whether the mode calls for record to be written. Discontinuities and rotations are
+// always kept, or carried to the next record if this one has no pts to keep, as is the first
+// buffer, so that the reader never interpolates across them and every file starts with a record.
+static gboolean
+gst_absolutetimestamps_keep_record (GstAbsolutetimestamps * absolutetimestamps,
+    const GstAbsolutetimestampsRecord * record)
+{
+  GstAbsolutetimestampsMode mode;
+  guint64 count;
+  gboolean keep;
+
+  // E.g. a buffer outside the segment in running time, there's nothing to map it to. Its
+  // discontinuity or rotation goes with the next record instead.
+  if (!GST_CLOCK_TIME_IS_VALID (record->pts)) {
+    absolutetimestamps->carried_flags |= record->flags & (GST_ABSTS_RECORD_FLAG_DISCONT |
+        GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE);
+    return FALSE;
+  }
+
+  mode = gst_absolutetimestamps_get_mode (absolutetimestamps);
+  if (mode == GST_ABSOLUTETIMESTAMPS_MODE_EVERY_BUFFER)
+    return TRUE;
+
+  count = absolutetimestamps->mode_count++;
+
+  switch (mode) {
+    case GST_ABSOLUTETIMESTAMPS_MODE_EVERY_NTH:
+      keep = count % absolutetimestamps->interval == 0;
+      break;
+    case GST_ABSOLUTETIMESTAMPS_MODE_KEYFRAMES_ONLY:
+      keep = !(record->flags & GST_ABSTS_RECORD_FLAG_DELTA_UNIT);
+      break;
+    case GST_ABSOLUTETIMESTAMPS_MODE_DRIFT_ONLY:
+      // The model is the last record kept: wallclock advancing exactly in step with pts.
+      keep = !GST_CLOCK_TIME_IS_VALID (absolutetimestamps->last_kept_pts) ||
+          (guint64) ABS (record->wallclock - (absolutetimestamps->last_kept_wallclock +
+              GST_CLOCK_DIFF (absolutetimestamps->last_kept_pts, record->pts))) >
+          absolutetimestamps->drift_tolerance;
+      break;
+    default:
+      keep = TRUE;
+      break;
+  }
+
+  keep = keep || count == 0 || (record->flags & (GST_ABSTS_RECORD_FLAG_DISCONT |
+          GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE));
+
+  if (keep) {
+    absolutetimestamps->last_kept_pts = record->pts;
+    absolutetimestamps->last_kept_wallclock = record->wallclock;
+  }
+
+  return keep;
+}
+
+// Whether record is kept back for later rather than dropped when the ring is full. Losing a mode
+// change would have the reader interpolate the records after it by the wrong mode, losing a
+// clock-sync report would have it weigh them by an earlier one.
+static inline gboolean
+gst_absolutetimestamps_is_undroppable (const GstAbsolutetimestampsRecord * record)
+{
+  guint type = GST_ABSTS_RECORD_TYPE (record->flags);
+
+  return type == GST_ABSTS_RECORD_TYPE_MODE || type == GST_ABSTS_RECORD_TYPE_SYNC;
+}
+
+// Keeps record back until the ring has room again. A later record of the same type replaces it, as
+// only the latest one still holds.
+static void
+gst_absolutetimestamps_hold_record (GstAbsolutetimestamps * absolutetimestamps,
+    const GstAbsolutetimestampsRecord * record)
+{
+  guint i;
+
+  for (i = 0; i < absolutetimestamps->n_held; i++)
+    if (GST_ABSTS_RECORD_TYPE (absolutetimestamps->held[i].flags) ==
+        GST_ABSTS_RECORD_TYPE (record->flags))
+      break;
+
+  g_assert (i < G_N_ELEMENTS (absolutetimestamps->held));
+  absolutetimestamps->held[i] = *record;
+  if (i == absolutetimestamps->n_held)
+    absolutetimestamps->n_held++;
+}
+
+// Queues the held records ahead of record. They were meant to go just before a sample since lost,
+// so they now take on record's wallclock, and a mode change its pts too, if record is a sample.
+// Returns FALSE if the ring is still too full for them all.
+static gboolean
+gst_absolutetimestamps_push_held (GstAbsolutetimestamps * absolutetimestamps,
+    const GstAbsolutetimestampsRecord * record)
+{
+  gboolean sample = GST_ABSTS_RECORD_TYPE (record->flags) == GST_ABSTS_RECORD_TYPE_SAMPLE;
+  guint i;
+
+  for (i = 0; i < absolutetimestamps->n_held; i++) {
+    GstAbsolutetimestampsRecord held = absolutetimestamps->held[i];
+
+    if (sample) {
+      held.wallclock = record->wallclock;
+      if (GST_ABSTS_RECORD_TYPE (held.flags) == GST_ABSTS_RECORD_TYPE_MODE)
+        held.pts = record->pts;
+    }
+    if (!gst_absolutetimestamps_ring_push (absolutetimestamps->ring, &held))
+      break;
+  }
+
+  absolutetimestamps->n_held -= i;
+  memmove (absolutetimestamps->held, absolutetimestamps->held + i,
+      absolutetimestamps->n_held * sizeof (GstAbsolutetimestampsRecord));
+
+  return absolutetimestamps->n_held == 0;
+}
 
-    absolutetimestamps->file = NULL;
+// Hands record to the output, either directly or through the ring of a writer thread - this
+// element's own or its writer group's. If wake is FALSE the caller is responsible for waking the
+// writer once it's done queuing records.
+static gboolean
+gst_absolutetimestamps_output_record (GstAbsolutetimestamps * absolutetimestamps,
+    const GstAbsolutetimestampsRecord * record, gboolean wake)
+{
+  // Only ever set or cleared while the streaming thread is stopped.
+  if (absolutetimestamps->history)
+    gst_absolutetimestamps_history_add (absolutetimestamps->history, record);
+
+  if (absolutetimestamps->ring == NULL) {
+    // Without an output, there's only the meta. A record on its own is a batch of its own.
+    if (absolutetimestamps->output)
+      return gst_absolutetimestamps_write_record (absolutetimestamps, record) &&
+          (!wake || gst_absolutetimestamps_flush_if_due (absolutetimestamps));
+  } else if ((absolutetimestamps->n_held == 0 ||
+          gst_absolutetimestamps_push_held (absolutetimestamps, record)) &&
+      gst_absolutetimestamps_ring_push (absolutetimestamps->ring, record)) {
+    if (wake)
+      gst_absolutetimestamps_wake_writer_if_waiting (absolutetimestamps);
+  } else if (gst_absolutetimestamps_is_undroppable (record)) {
+    gst_absolutetimestamps_hold_record (absolutetimestamps, record);
+    HOT_PATH_LOG_OBJECT (absolutetimestamps, "ring full, holding record for %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (record->pts));
+  } else {
+    // Never block the streaming thread on the writer - count the record as lost instead.
+    GST_OBJECT_LOCK (absolutetimestamps);
+    absolutetimestamps->dropped++;
+    GST_OBJECT_UNLOCK (absolutetimestamps);
+    // Neither a discontinuity nor a rotation may be lost with the sample that had it.
+    if (GST_ABSTS_RECORD_TYPE (record->flags) == GST_ABSTS_RECORD_TYPE_SAMPLE)
+      absolutetimestamps->carried_flags |= record->flags & (GST_ABSTS_RECORD_FLAG_DISCONT |
+          GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE);
+    HOT_PATH_LOG_OBJECT (absolutetimestamps, "ring full, dropped record for %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (record->pts));
   }
 
   return TRUE;
 }
 
+/* pressure */
+
+// With adaptive, checks before each sample how much of the ring is still waiting for the writer and
+// moves between the pressure levels: to elevated once pressure-threshold percent of it is queued,
+// to critical halfway from there to full, and back down to each level below only once the backlog
+// has drained to half of what it took to go up, so that it doesn't flap. Each change is logged as a
+// GST_ABSTS_RECORD_TYPE_MODE record, and posted as an absolutetimestamps-pressure message, just
+// before sample - which is always kept as the starting point for the new mode. Without a ring the
+// output is written directly, there's never a backlog. Returns FALSE only if logging failed.
+static gboolean
+gst_absolutetimestamps_update_pressure (GstAbsolutetimestamps * absolutetimestamps,
+    const GstAbsolutetimestampsRecord * sample, gboolean wake)
+{
+  GstAbsolutetimestampsRing *ring = absolutetimestamps->ring;
+  guint elevated = absolutetimestamps->pressure_threshold;
+  guint critical = (elevated + 100) / 2;
+  gint pressure = absolutetimestamps->pressure;
+  GstAbsolutetimestampsRecord record;
+  guint queued, capacity, fill;
+  GstAbsolutetimestampsMode mode;
+
+  if (ring == NULL || !GST_CLOCK_TIME_IS_VALID (sample->pts))
+    return TRUE;
+
+  queued = gst_absolutetimestamps_ring_get_length (ring);
+  capacity = gst_absolutetimestamps_ring_get_capacity (ring);
+  fill = (guint) ((guint64) queued * 100 / capacity);
+
+  if (fill >= critical)
+    pressure = GST_ABSOLUTETIMESTAMPS_PRESSURE_CRITICAL;
+  else if (fill >= elevated && pressure == GST_ABSOLUTETIMESTAMPS_PRESSURE_NONE)
+    pressure = GST_ABSOLUTETIMESTAMPS_PRESSURE_ELEVATED;
+  else if (pressure == GST_ABSOLUTETIMESTAMPS_PRESSURE_CRITICAL && fill < critical / 2)
+    pressure = fill < elevated / 2 ? GST_ABSOLUTETIMESTAMPS_PRESSURE_NONE :
+        GST_ABSOLUTETIMESTAMPS_PRESSURE_ELEVATED;
+  else if (pressure == GST_ABSOLUTETIMESTAMPS_PRESSURE_ELEVATED && fill < elevated / 2)
+    pressure = GST_ABSOLUTETIMESTAMPS_PRESSURE_NONE;
+
+  if (pressure == absolutetimestamps->pressure)
+    return TRUE;
+
+  g_atomic_int_set (&absolutetimestamps->pressure, pressure);
+  mode = gst_absolutetimestamps_get_mode (absolutetimestamps);
+  absolutetimestamps->mode_count = 0;
+
+  GST_INFO_OBJECT (absolutetimestamps, "%u of %u records queued, pressure %d, mode %d", queued,
+      capacity, pressure, mode);
+
+  gst_element_post_message (GST_ELEMENT (absolutetimestamps),
+      gst_message_new_element (GST_OBJECT (absolutetimestamps),
+          gst_structure_new ("absolutetimestamps-pressure",
+              "pressure", GST_TYPE_ABSOLUTETIMESTAMPS_PRESSURE, pressure,
+              "mode", GST_TYPE_ABSOLUTETIMESTAMPS_MODE, mode,
+              "queued", G_TYPE_UINT, queued,
+              "capacity", G_TYPE_UINT, capacity,
+              "pts", G_TYPE_UINT64, sample->pts,
+              "wallclock", G_TYPE_INT64, sample->wallclock, NULL)));
+
+  record.pts = sample->pts;
+  record.wallclock = sample->wallclock;
+  record.flags = gst_absts_mode_flags ((GstAbstsMode) mode, (GstAbstsPressure) pressure);
+  record.stream_id = sample->stream_id;
+
+  return gst_absolutetimestamps_output_record (absolutetimestamps, &record, wake);
+}
+
+/* clock sync */
+
+// Logs the latest clock-sync report, if there's a new one, as a GST_ABSTS_RECORD_TYPE_SYNC record
+// just before sample, whose wallclock it shares. The report was sampled by the sync sampler's own
+// thread, this only copies it out. Returns FALSE only if logging failed.
+static gboolean
+gst_absolutetimestamps_log_clock_sync (GstAbsolutetimestamps * absolutetimestamps,
+    const GstAbsolutetimestampsRecord * sample, gboolean wake)
+{
+  GstAbsolutetimestampsRecord record;
+  GstAbstsSync sync;
+
+  if (!GST_CLOCK_TIME_IS_VALID (sample->pts) ||
+      !gst_absolutetimestamps_sync_sampler_take (absolutetimestamps->sync_sampler, &sync))
+    return TRUE;
+
+  record.pts = (guint64) sync.offset;
+  record.wallclock = sample->wallclock;
+  record.flags = gst_absts_sync_flags (sync.source, sync.max_error);
+  record.stream_id = sample->stream_id;
+
+  return gst_absolutetimestamps_output_record (absolutetimestamps, &record, wake);
+}
+
+/* segments */
+
+// Logs a GST_ABSTS_RECORD_TYPE_SEGMENT or _FLUSH marker. What follows starts afresh: the first buffer
+// after it is always recorded and the model fit restarts.
+static gboolean
+gst_absolutetimestamps_mark (GstAbsolutetimestamps * absolutetimestamps, GstAbstsRecordType type,
+    GstClockTime start)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (absolutetimestamps);
+  GstAbsolutetimestampsRecord record;
+
+  absolutetimestamps->mode_count = 0;
+  absolutetimestamps->last_kept_pts = GST_CLOCK_TIME_NONE;
+  gst_absolutetimestamps_model_reset (&absolutetimestamps->fit);
+  absolutetimestamps->next_snapshot_pts = GST_CLOCK_TIME_NONE;
+
+  record.pts = type == GST_ABSTS_RECORD_TYPE_FLUSH ? GST_CLOCK_TIME_NONE :
+      gst_absolutetimestamps_to_pts_domain (absolutetimestamps, start);
+  record.wallclock = gst_absolutetimestamps_clock_sample (&absolutetimestamps->clock,
+      GST_ELEMENT (trans), &trans->segment, start);
+  record.flags = (guint32) type << GST_ABSTS_RECORD_TYPE_SHIFT;
+  record.stream_id = absolutetimestamps->group_member ? absolutetimestamps->group_member->stream_id : 0;
+
+  GST_DEBUG_OBJECT (absolutetimestamps, "marking %s at %" GST_TIME_FORMAT,
+      type == GST_ABSTS_RECORD_TYPE_FLUSH ? "flush" : "segment", GST_TIME_ARGS (record.pts));
+
+  return gst_absolutetimestamps_output_record (absolutetimestamps, &record, TRUE);
+}
+
+// Both events are serialized, so the markers are queued by the streaming thread (or with its stream
+// lock held) in order with the records around them. Chaining up first means trans->segment is
+// already the new one.
+static gboolean
+gst_absolutetimestamps_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstAbsolutetimestamps *absolutetimestamps = GST_ABSOLUTETIMESTAMPS (trans);
+  GstEventType type = GST_EVENT_TYPE (event);
+  gboolean ret;
+
+  ret = GST_BASE_TRANSFORM_CLASS (gst_absolutetimestamps_parent_class)->sink_event (trans, event);
+
+  switch (type) {
+    case GST_EVENT_CAPS:
+      // New caps, e.g. a new frame rate, usually come with a new latency upstream.
+      g_atomic_int_set (&absolutetimestamps->latency_pending, 1);
+      break;
+    case GST_EVENT_SEGMENT:
+      if (!gst_absolutetimestamps_mark (absolutetimestamps, GST_ABSTS_RECORD_TYPE_SEGMENT,
+              trans->segment.start))
+        ret = FALSE;
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      if (!gst_absolutetimestamps_mark (absolutetimestamps, GST_ABSTS_RECORD_TYPE_FLUSH,
+              GST_CLOCK_TIME_NONE))
+        ret = FALSE;
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+// A LATENCY event on its way upstream means the pipeline has just redistributed its latency, so
+// what upstream reports may have changed too.
+static gboolean
+gst_absolutetimestamps_src_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstAbsolutetimestamps *absolutetimestamps = GST_ABSOLUTETIMESTAMPS (trans);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_LATENCY)
+    g_atomic_int_set (&absolutetimestamps->latency_pending, 1);
+
+  return GST_BASE_TRANSFORM_CLASS (gst_absolutetimestamps_parent_class)->src_event (trans, event);
+}
+
+/* lookups */
+
+// The history is only there while the element is started, so it's held onto under GST_OBJECT_LOCK
+// for the lookup. The lookup itself never waits for more than the history's own lock.
+static gint64
+gst_absolutetimestamps_lookup_wallclock (GstAbsolutetimestamps * absolutetimestamps, guint64 pts)
+{
+  gint64 wallclock = -1;
+
+  GST_OBJECT_LOCK (absolutetimestamps);
+  if (absolutetimestamps->history == NULL ||
+      !gst_absolutetimestamps_history_lookup_wallclock (absolutetimestamps->history, pts, &wallclock))
+    wallclock = -1;
+  GST_OBJECT_UNLOCK (absolutetimestamps);
+
+  return wallclock;
+}
+
+static guint64
+gst_absolutetimestamps_lookup_pts (GstAbsolutetimestamps * absolutetimestamps, gint64 wallclock)
+{
+  GstClockTime pts = GST_CLOCK_TIME_NONE;
+
+  GST_OBJECT_LOCK (absolutetimestamps);
+  if (absolutetimestamps->history == NULL ||
+      !gst_absolutetimestamps_history_lookup_pts (absolutetimestamps->history, wallclock, &pts))
+    pts = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (absolutetimestamps);
+
+  return pts;
+}
+
+// Answers a GST_ABSOLUTETIMESTAMPS_LOOKUP_QUERY from either direction, from the history. If the
+// history can't answer it, it's passed on, so it can get to another absolutetimestamps that can.
+static gboolean
+gst_absolutetimestamps_query (GstBaseTransform * trans, GstPadDirection direction, GstQuery * query)
+{
+  GstAbsolutetimestamps *absolutetimestamps = GST_ABSOLUTETIMESTAMPS (trans);
+  const GstStructure *structure = gst_query_get_structure (query);
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_CUSTOM && structure != NULL &&
+      gst_structure_has_name (structure, GST_ABSOLUTETIMESTAMPS_LOOKUP_QUERY)) {
+    guint64 pts;
+    gint64 wallclock;
+
+    if (gst_structure_get_uint64 (structure, "pts", &pts)) {
+      wallclock = gst_absolutetimestamps_lookup_wallclock (absolutetimestamps, pts);
+      if (wallclock != -1) {
+        gst_structure_set (gst_query_writable_structure (query), "wallclock", G_TYPE_INT64, wallclock,
+            NULL);
+        return TRUE;
+      }
+    } else if (gst_structure_get_int64 (structure, "wallclock", &wallclock)) {
+      pts = gst_absolutetimestamps_lookup_pts (absolutetimestamps, wallclock);
+      if (GST_CLOCK_TIME_IS_VALID (pts)) {
+        gst_structure_set (gst_query_writable_structure (query), "pts", G_TYPE_UINT64, pts, NULL);
+        return TRUE;
+      }
+    }
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_absolutetimestamps_parent_class)->query (trans, direction,
+      query);
+}
+
+/* capture time */
+
+// Asks upstream how late its buffers are by the time they reach this element. Only a live upstream's
+// latency says anything about capture, otherwise it's taken to be 0.
+static void
+gst_absolutetimestamps_query_latency (GstAbsolutetimestamps * absolutetimestamps)
+{
+  GstQuery *query = gst_query_new_latency ();
+  GstClockTime min = 0, max = GST_CLOCK_TIME_NONE;
+  gboolean live = FALSE;
+
+  g_atomic_int_set (&absolutetimestamps->latency_pending, 0);
+
+  if (gst_pad_peer_query (GST_BASE_TRANSFORM_SINK_PAD (absolutetimestamps), query))
+    gst_query_parse_latency (query, &live, &min, &max);
+  gst_query_unref (query);
+
+  if (!live || !GST_CLOCK_TIME_IS_VALID (min))
+    min = 0;
+
+  GST_DEBUG_OBJECT (absolutetimestamps, "upstream latency %" GST_TIME_FORMAT " (live %d)",
+      GST_TIME_ARGS (min), live);
+
+  GST_OBJECT_LOCK (absolutetimestamps);
+  absolutetimestamps->upstream_latency = min;
+  GST_OBJECT_UNLOCK (absolutetimestamps);
+}
+
+// The wallclock of buf, by default the clock reading as it arrives here. That includes however long
+// the buffer spent in queues and upstream processing, which varies with load, so capture-time can
+// try to get closer to when it was actually captured by taking off the latency upstream reports or
+// by using the time upstream attached to it.
+static gint64
+gst_absolutetimestamps_sample (GstAbsolutetimestamps * absolutetimestamps, GstBuffer * buf,
+    GstClockTime pts)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (absolutetimestamps);
+  gint64 wallclock;
+
+  switch (absolutetimestamps->capture_time) {
+    case GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_UPSTREAM_LATENCY:
+      if (g_atomic_int_get (&absolutetimestamps->latency_pending))
+        gst_absolutetimestamps_query_latency (absolutetimestamps);
+      return gst_absolutetimestamps_clock_sample (&absolutetimestamps->clock,
+          GST_ELEMENT (trans), &trans->segment, pts) - (gint64) absolutetimestamps->upstream_latency;
+    case GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_REFERENCE_META:
+      if (gst_absolutetimestamps_clock_get_reference_time (absolutetimestamps->clock_source, buf,
+              &wallclock))
+        return wallclock;
+      break;
+    default:
+      break;
+  }
+
+  return gst_absolutetimestamps_clock_sample (&absolutetimestamps->clock, GST_ELEMENT (trans),
+      &trans->segment, pts);
+}
+
+/* model */
+
+// Adds a sample to the fit and, once model-interval has passed, takes a snapshot: publishes it for the
+// model-* properties, posts it on the bus and logs it as a GST_ABSTS_RECORD_TYPE_MODEL record after
+// the sample. Returns FALSE only if logging it failed.
+static gboolean
+gst_absolutetimestamps_update_model (GstAbsolutetimestamps * absolutetimestamps,
+    const GstAbsolutetimestampsRecord * sample, gboolean wake)
+{
+  GstAbsolutetimestampsModel *fit = &absolutetimestamps->fit;
+  GstAbsolutetimestampsRecord record;
+  gdouble slope, residual;
+  gint64 offset;
+
+  if (!GST_CLOCK_TIME_IS_VALID (sample->pts))
+    return TRUE;
+
+  // The pts before and after a discontinuity aren't on the same line.
+  if (sample->flags & GST_ABSTS_RECORD_FLAG_DISCONT) {
+    gst_absolutetimestamps_model_reset (fit);
+    absolutetimestamps->next_snapshot_pts = GST_CLOCK_TIME_NONE;
+  }
+
+  gst_absolutetimestamps_model_add (fit, sample->pts, sample->wallclock);
+
+  if (absolutetimestamps->model_interval == 0)
+    return TRUE;
+
+  if (!GST_CLOCK_TIME_IS_VALID (absolutetimestamps->next_snapshot_pts))
+    absolutetimestamps->next_snapshot_pts = sample->pts + absolutetimestamps->model_interval;
+
+  if (sample->pts < absolutetimestamps->next_snapshot_pts ||
+      !gst_absolutetimestamps_model_get_slope (fit, &slope))
+    return TRUE;
+
+  absolutetimestamps->next_snapshot_pts = sample->pts + absolutetimestamps->model_interval;
+
+  offset = gst_absolutetimestamps_model_predict (fit, 0);
+  residual = gst_absolutetimestamps_model_get_residual (fit);
+
+  GST_OBJECT_LOCK (absolutetimestamps);
+  absolutetimestamps->published_slope = slope;
+  absolutetimestamps->published_offset = offset;
+  absolutetimestamps->published_residual = residual;
+  GST_OBJECT_UNLOCK (absolutetimestamps);
+
+  record.pts = sample->pts;
+  record.wallclock = gst_absolutetimestamps_model_predict (fit, sample->pts);
+  record.flags = gst_absts_model_flags ((gint32) lround (CLAMP ((slope - 1.0) * 1e9,
+              -GST_ABSTS_MODEL_DRIFT_MAX, GST_ABSTS_MODEL_DRIFT_MAX)));
+  record.stream_id = sample->stream_id;
+
+  gst_element_post_message (GST_ELEMENT (absolutetimestamps),
+      gst_message_new_element (GST_OBJECT (absolutetimestamps),
+          gst_structure_new ("absolutetimestamps-model",
+              "pts", G_TYPE_UINT64, record.pts,
+              "wallclock", G_TYPE_INT64, record.wallclock,
+              "slope", G_TYPE_DOUBLE, slope,
+              "offset", G_TYPE_INT64, offset,
+              "residual", G_TYPE_DOUBLE, residual,
+              "samples", G_TYPE_UINT64, fit->n, NULL)));
+
+  return gst_absolutetimestamps_output_record (absolutetimestamps, &record, wake);
+}
+
 static GstFlowReturn
 gst_absolutetimestamps_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
 {
   GstAbsolutetimestamps *absolutetimestamps = GST_ABSOLUTETIMESTAMPS (trans);
 
-  GST_DEBUG_OBJECT (absolutetimestamps, "transform_ip");
+  HOT_PATH_LOG_OBJECT (absolutetimestamps, "transform_ip");
 
   GstClockTime timestamp = GST_BUFFER_TIMESTAMP (buf);
+  GstFlowReturn ret = GST_FLOW_OK;
 
   if (timestamp != GST_CLOCK_TIME_NONE) {
-      GTimeVal real_time;
+      GstAbsolutetimestampsRecord record;
+      gboolean traced = gst_absolutetimestamps_tracer_is_active ();
+      gint64 arrival = 0;
+
+      // Measuring costs a couple of clock reads per buffer so it's off unless asked for.
+      if (absolutetimestamps->instrumentation || traced)
+        arrival = gst_absolutetimestamps_get_monotonic_time ();
+
+      gst_absolutetimestamps_fill_record (absolutetimestamps, &record, buf,
+          gst_absolutetimestamps_sample (absolutetimestamps, buf, timestamp));
+
+      if (absolutetimestamps->reference_caps)
+        gst_buffer_add_reference_timestamp_meta (buf, absolutetimestamps->reference_caps,
+            (GstClockTime) record.wallclock, GST_CLOCK_TIME_NONE);
+
+      if (absolutetimestamps->adaptive &&
+          !gst_absolutetimestamps_update_pressure (absolutetimestamps, &record, TRUE))
+        ret = GST_FLOW_ERROR;
+
+      // A clock-sync report waits for a sample that's kept, whose wallclock it shares.
+      if (gst_absolutetimestamps_keep_record (absolutetimestamps, &record) &&
+          ((absolutetimestamps->sync_sampler &&
+                  !gst_absolutetimestamps_log_clock_sync (absolutetimestamps, &record, TRUE)) ||
+              !gst_absolutetimestamps_output_record (absolutetimestamps, &record, TRUE)))
+        ret = GST_FLOW_ERROR;
+
+      if (absolutetimestamps->model &&
+          !gst_absolutetimestamps_update_model (absolutetimestamps, &record, TRUE))
+        ret = GST_FLOW_ERROR;
+
+      if (absolutetimestamps->instrumentation || traced)
+        gst_absolutetimestamps_measure (absolutetimestamps, timestamp, arrival, traced);
+  }
 
-      g_get_current_time (&real_time);
+  return ret;
+}
+
+/* buffer lists */
+
+// The batch path below bypasses GstBaseTransform's chain function, so leave anything that needs it
+// to the per-buffer path: renegotiation, QoS and per-buffer instrumentation.
+static gboolean
+gst_absolutetimestamps_can_batch (GstAbsolutetimestamps * absolutetimestamps)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (absolutetimestamps);
 
-      gchar *s = g_time_val_to_iso8601 (&real_time);
+  if (absolutetimestamps->instrumentation || gst_absolutetimestamps_tracer_is_active ())
+    return FALSE;
 
-      g_fprintf (absolutetimestamps->file, "%" GST_TIME_FORMAT " %s\n", GST_TIME_ARGS (timestamp), s);
+  if (!gst_base_transform_is_passthrough (trans) && absolutetimestamps->reference_caps == NULL)
+    return FALSE;
 
-      g_free (s);
+  return !gst_pad_needs_reconfigure (GST_BASE_TRANSFORM_SRC_PAD (trans)) &&
+      !gst_base_transform_is_qos_enabled (trans);
+}
+
+static GstFlowReturn
+gst_absolutetimestamps_chain_list_per_buffer (GstAbsolutetimestamps * absolutetimestamps,
+    GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint i, n = gst_buffer_list_length (list);
+
+  for (i = 0; i < n && ret == GST_FLOW_OK; i++)
+    ret = absolutetimestamps->base_chain (pad, parent, gst_buffer_ref (gst_buffer_list_get (list, i)));
+
+  gst_buffer_list_unref (list);
+
+  return ret;
+}
+
+// Lists typically hold packets that arrived together, e.g. from rtpjitterbuffer or a network source,
+// so the clock is read once per list and each buffer's wallclock is interpolated from its pts
+// relative to the first. The records are all queued before the writer is woken, and as the output
+// only writes when its buffer fills up or its flush policy says so, the list ends up in a single
+// write.
+static GstFlowReturn
+gst_absolutetimestamps_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  GstAbsolutetimestamps *absolutetimestamps = GST_ABSOLUTETIMESTAMPS (parent);
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (parent);
+  GstClockTime first_pts = GST_CLOCK_TIME_NONE;
+  gint64 first_wallclock = 0;
+  guint i, n;
+
+  if (!gst_absolutetimestamps_can_batch (absolutetimestamps))
+    return gst_absolutetimestamps_chain_list_per_buffer (absolutetimestamps, pad, parent, list);
+
+  HOT_PATH_LOG_OBJECT (absolutetimestamps, "chain_list with %u buffers", gst_buffer_list_length (list));
+
+  if (absolutetimestamps->reference_caps)
+    list = gst_buffer_list_make_writable (list);
+
+  n = gst_buffer_list_length (list);
+  for (i = 0; i < n; i++) {
+    GstBuffer *buf = gst_buffer_list_get (list, i);
+    GstClockTime pts = GST_BUFFER_PTS (buf);
+    GstAbsolutetimestampsRecord record;
+    gboolean sampled = FALSE;
+    gint64 wallclock;
+
+    if (!GST_CLOCK_TIME_IS_VALID (pts))
+      continue;
+
+    if (!GST_CLOCK_TIME_IS_VALID (first_pts)) {
+      sampled = TRUE;
+      first_pts = pts;
+      first_wallclock = gst_absolutetimestamps_sample (absolutetimestamps, buf, pts);
+      wallclock = first_wallclock;
+    } else if (absolutetimestamps->capture_time == GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_REFERENCE_META &&
+        gst_absolutetimestamps_clock_get_reference_time (absolutetimestamps->clock_source, buf,
+            &wallclock)) {
+      // Each packet's own capture time beats interpolating from the first's.
+      sampled = TRUE;
+    } else {
+      wallclock = first_wallclock + GST_CLOCK_DIFF (first_pts, pts);
+    }
+
+    gst_absolutetimestamps_fill_record (absolutetimestamps, &record, buf, wallclock);
+
+    if (absolutetimestamps->reference_caps)
+      gst_buffer_add_reference_timestamp_meta (gst_buffer_list_get_writable (list, i),
+          absolutetimestamps->reference_caps, (GstClockTime) record.wallclock, GST_CLOCK_TIME_NONE);
+
+    if (absolutetimestamps->adaptive &&
+        !gst_absolutetimestamps_update_pressure (absolutetimestamps, &record, FALSE)) {
+      gst_buffer_list_unref (list);
+      return GST_FLOW_ERROR;
+    }
+
+    if (gst_absolutetimestamps_keep_record (absolutetimestamps, &record) &&
+        ((absolutetimestamps->sync_sampler &&
+                !gst_absolutetimestamps_log_clock_sync (absolutetimestamps, &record, FALSE)) ||
+            !gst_absolutetimestamps_output_record (absolutetimestamps, &record, FALSE))) {
+      gst_buffer_list_unref (list);
+      return GST_FLOW_ERROR;
+    }
+
+    // Only the clock reading goes into the fit, the interpolated wallclocks would just pull it to 1.
+    if (sampled && absolutetimestamps->model &&
+        !gst_absolutetimestamps_update_model (absolutetimestamps, &record, FALSE)) {
+      gst_buffer_list_unref (list);
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  if (absolutetimestamps->ring) {
+    gst_absolutetimestamps_wake_writer_if_waiting (absolutetimestamps);
+  } else if (absolutetimestamps->output && !gst_absolutetimestamps_flush_if_due (absolutetimestamps)) {
+    gst_buffer_list_unref (list);
+    return GST_FLOW_ERROR;
   }
 
-  return GST_FLOW_OK;
+  return gst_pad_push_list (GST_BASE_TRANSFORM_SRC_PAD (trans), list);
 }
 
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
+  if (!gst_tracer_register (plugin, "absolutetimestamps", GST_TYPE_ABSOLUTETIMESTAMPS_TRACER))
+    return FALSE;
+
+  // Registered first, as it initializes the debug category the shared modules log to.
+  if (!gst_element_register (plugin, "absolutetimestamps", GST_RANK_NONE,
+          GST_TYPE_ABSOLUTETIMESTAMPS))
+    return FALSE;
 
-  return gst_element_register (plugin, "absolutetimestamps", GST_RANK_NONE,
-      GST_TYPE_ABSOLUTETIMESTAMPS);
+  return gst_element_register (plugin, "multiabsolutetimestamps", GST_RANK_NONE,
+      GST_TYPE_MULTIABSOLUTETIMESTAMPS);
 }
 
 #ifndef VERSION
@@ -20,6 +20,15 @@
 
 #include <gst/base/gstbasetransform.h>
 
+#include "gstabsolutetimestampsclock.h"
+#include "gstabsolutetimestampshistory.h"
+#include "gstabsolutetimestampsmodel.h"
+#include "gstabsolutetimestampsoutput.h"
+#include "gstabsolutetimestampsring.h"
+#include "gstabsolutetimestampsstats.h"
+#include "gstabsolutetimestampssync.h"
+#include "gstabsolutetimestampswritergroup.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_ABSOLUTETIMESTAMPS   (gst_absolutetimestamps_get_type())
@@ -28,6 +37,55 @@ G_BEGIN_DECLS
 #define GST_IS_ABSOLUTETIMESTAMPS(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_ABSOLUTETIMESTAMPS))
 #define GST_IS_ABSOLUTETIMESTAMPS_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_ABSOLUTETIMESTAMPS))
 
+#define GST_TYPE_ABSOLUTETIMESTAMPS_OUTPUT_FLAGS (gst_absolutetimestamps_output_flags_get_type())
+#define GST_TYPE_ABSOLUTETIMESTAMPS_MODE (gst_absolutetimestamps_mode_get_type())
+#define GST_TYPE_ABSOLUTETIMESTAMPS_PTS_DOMAIN (gst_absolutetimestamps_pts_domain_get_type())
+#define GST_TYPE_ABSOLUTETIMESTAMPS_CAPTURE_TIME (gst_absolutetimestamps_capture_time_get_type())
+#define GST_TYPE_ABSOLUTETIMESTAMPS_PRESSURE (gst_absolutetimestamps_pressure_get_type())
+
+// Copies the chosen fields of buf into record, see gst_absolutetimestamps_fill_record.
+typedef void (*GstAbsolutetimestampsFillFields) (GstAbsolutetimestampsRecord * record,
+    GstBuffer * buf);
+
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_OUTPUT_FILE = (1 << 0),
+  GST_ABSOLUTETIMESTAMPS_OUTPUT_META = (1 << 1)
+} GstAbsolutetimestampsOutputFlags;
+
+// The values match GstAbstsMode so that they can be recorded as-is in binary logs.
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_MODE_EVERY_BUFFER = GST_ABSTS_MODE_EVERY_BUFFER,
+  GST_ABSOLUTETIMESTAMPS_MODE_EVERY_NTH = GST_ABSTS_MODE_EVERY_NTH,
+  GST_ABSOLUTETIMESTAMPS_MODE_KEYFRAMES_ONLY = GST_ABSTS_MODE_KEYFRAMES_ONLY,
+  GST_ABSOLUTETIMESTAMPS_MODE_DRIFT_ONLY = GST_ABSTS_MODE_DRIFT_ONLY
+} GstAbsolutetimestampsMode;
+
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_PTS,
+  GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_RUNNING_TIME,
+  GST_ABSOLUTETIMESTAMPS_PTS_DOMAIN_STREAM_TIME
+} GstAbsolutetimestampsPtsDomain;
+
+// How the wallclock of a buffer is arrived at, see gst_absolutetimestamps_sample.
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_ARRIVAL,
+  GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_UPSTREAM_LATENCY,
+  GST_ABSOLUTETIMESTAMPS_CAPTURE_TIME_REFERENCE_META
+} GstAbsolutetimestampsCaptureTime;
+
+// How far the writer has fallen behind, see gst_absolutetimestamps_update_pressure. The values match
+// GstAbstsPressure, as recorded in mode records.
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_PRESSURE_NONE = GST_ABSTS_PRESSURE_NONE,
+  GST_ABSOLUTETIMESTAMPS_PRESSURE_ELEVATED = GST_ABSTS_PRESSURE_ELEVATED,
+  GST_ABSOLUTETIMESTAMPS_PRESSURE_CRITICAL = GST_ABSTS_PRESSURE_CRITICAL
+} GstAbsolutetimestampsPressure;
+
 typedef struct _GstAbsolutetimestamps GstAbsolutetimestamps;
 typedef struct _GstAbsolutetimestampsClass GstAbsolutetimestampsClass;
 
@@ -35,16 +93,129 @@ struct _GstAbsolutetimestamps
 {
   GstBaseTransform base_absolutetimestamps;
 
+  GstAbsolutetimestampsOutputFlags output_flags;
   gchar *filename;
-  FILE *file;
+  GstAbsolutetimestampsFormat format;
+  GstAbsolutetimestampsPrecision precision;
+  GstAbsolutetimestampsClockSource clock_source;
+  guint buffer_size;
+  GstAbsolutetimestampsFlushPolicy flush_policy;
+  guint flush_records;
+  guint flush_interval;
+  GstAbsolutetimestampsMode mode;
+  guint interval;
+  GstClockTime drift_tolerance;
+  GstAbsolutetimestampsPtsDomain pts_domain;
+  gboolean seek_index;
+  GstClockTime seek_index_interval;
+  guint64 max_size_bytes;
+  GstClockTime max_size_time;
+  gboolean split_on_fragment;
+  GstAbsolutetimestampsSink sink;
+  guint shm_capacity;
+  gboolean append;
+  gboolean sync_writes;
+  gboolean direct_io;
+  GstAbsolutetimestampsFields fields;
+  guint max_history;
+  guint64 max_history_bytes;
+  GstAbsolutetimestampsCaptureTime capture_time;
+
+  GstPadChainFunction base_chain;
+
+  // Which records to keep, see gst_absolutetimestamps_keep_record. With adaptive, pressure (only
+  // written by the streaming thread) coarsens the mode while the writer is behind.
+  gboolean adaptive;
+  guint pressure_threshold;
+  volatile gint pressure;
+  guint64 mode_count;
+  GstClockTime last_kept_pts;
+  gint64 last_kept_wallclock;
+  GstAbsolutetimestampsClock clock;
+
+  // Records that mustn't be lost but found the ring full, at most one of each type, queued ahead of
+  // the next record that fits. See gst_absolutetimestamps_output_record.
+  GstAbsolutetimestampsRecord held[2];
+  guint n_held;
+
+  // For capture-time=upstream-latency: the latency upstream last reported (guarded by GST_OBJECT_LOCK
+  // for the property, only written by the streaming thread), queried again whenever latency_pending
+  // is raised.
+  GstClockTime upstream_latency;
+  volatile gint latency_pending;
+
+  GstCaps *reference_caps;
+  GstAbsolutetimestampsOutput *output;
+  // For the fields the output writes, set once it's open.
+  GstAbsolutetimestampsFillFields fill_fields;
+
+  // The recent records lookups are answered from, NULL unless max-history or max-history-bytes is
+  // set. Only set and cleared under GST_OBJECT_LOCK by start and stop, see
+  // gst_absolutetimestamps_lookup_wallclock.
+  GstAbsolutetimestampsHistory *history;
+
+  gboolean async_write;
+  guint ring_capacity;
+  guint64 dropped;
+  gchar *writer_group;
+  gint stream_id;
+  GstAbsolutetimestampsWriterGroupMember *group_member;
+
+  GstAbsolutetimestampsRing *ring;
+  GThread *writer_thread;
+  GMutex writer_lock;
+  GCond writer_cond;
+  volatile gint writer_waiting;
+  volatile gint writer_stopping;
+
+  gboolean instrumentation;
+  guint stats_interval;
+  GstAbsolutetimestampsStats stats;
+  gint64 last_stats_message;
+
+  // The fit is only touched on the streaming thread, the published_* values of its latest snapshot
+  // are guarded by GST_OBJECT_LOCK.
+  gboolean model;
+  GstClockTime model_interval;
+  GstAbsolutetimestampsModel fit;
+  GstClockTime next_snapshot_pts;
+  gdouble published_slope;
+  gint64 published_offset;
+  gdouble published_residual;
+
+  // For split-on-fragment: the bus splitmuxsink's messages are watched on and the running time of
+  // the latest fragment (guarded by GST_OBJECT_LOCK), picked up by the streaming thread when
+  // split_pending is raised.
+  GstBus *split_bus;
+  gulong split_handler;
+  volatile gint split_pending;
+  GstClockTime split_running_time;
+  GstClockTime split_file_start;
+  guint32 carried_flags;
+
+  // For clock-sync: samples the clock on a thread of its own, each report is logged with the next
+  // sample, see gst_absolutetimestamps_log_clock_sync.
+  GstAbsolutetimestampsClockSync clock_sync;
+  guint clock_sync_interval;
+  guint clock_sync_domain;
+  GstAbsolutetimestampsSyncSampler *sync_sampler;
 };
 
 struct _GstAbsolutetimestampsClass
 {
   GstBaseTransformClass base_absolutetimestamps_class;
+
+  /* actions */
+  gint64 (*lookup_wallclock) (GstAbsolutetimestamps * absolutetimestamps, guint64 pts);
+  guint64 (*lookup_pts) (GstAbsolutetimestamps * absolutetimestamps, gint64 wallclock);
 };
 
 GType gst_absolutetimestamps_get_type (void);
+GType gst_absolutetimestamps_output_flags_get_type (void);
+GType gst_absolutetimestamps_mode_get_type (void);
+GType gst_absolutetimestamps_pts_domain_get_type (void);
+GType gst_absolutetimestamps_capture_time_get_type (void);
+GType gst_absolutetimestamps_pressure_get_type (void);
 
 G_END_DECLS
 
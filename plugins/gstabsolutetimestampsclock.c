@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstabsolutetimestampsclock.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gst_absolutetimestamps_debug_category);
+#define GST_CAT_DEFAULT gst_absolutetimestamps_debug_category
+
+// CLOCK_MONOTONIC_RAW and CLOCK_TAI are Linux-specific, fall back to their nearest equivalents elsewhere.
+#ifdef CLOCK_MONOTONIC_RAW
+#define ABSTS_CLOCK_MONOTONIC_RAW CLOCK_MONOTONIC_RAW
+#else
+#define ABSTS_CLOCK_MONOTONIC_RAW CLOCK_MONOTONIC
+#endif
+
+#ifdef CLOCK_TAI
+#define ABSTS_CLOCK_TAI CLOCK_TAI
+#else
+#define ABSTS_CLOCK_TAI CLOCK_REALTIME
+#endif
+
+// From 1900-01-01, the NTP epoch, to 1970-01-01.
+#define NTP_TO_UNIX_EPOCH (G_GUINT64_CONSTANT (2208988800) * GST_SECOND)
+
+GType
+gst_absolutetimestamps_clock_source_get_type (void)
+{
+  static gsize clock_source_type = 0;
+
+  if (g_once_init_enter (&clock_source_type)) {
+    static const GEnumValue clock_sources[] = {
+      {GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_REALTIME, "System wallclock (CLOCK_REALTIME)", "realtime"},
+      {GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_PIPELINE, "The pipeline clock, e.g. a GstPtpClock or GstNtpClock", "pipeline"},
+      {GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_MONOTONIC_RAW, "Hardware clock unaffected by NTP (CLOCK_MONOTONIC_RAW)", "monotonic-raw"},
+      {GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_TAI, "International Atomic Time (CLOCK_TAI)", "tai"},
+      {GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_RUNNING_TIME, "Wallclock computed from base_time + running_time", "running-time"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsClockSource", clock_sources);
+
+    g_once_init_leave (&clock_source_type, type);
+  }
+
+  return clock_source_type;
+}
+
+static const gchar *
+get_reference_name (GstAbsolutetimestampsClockSource source)
+{
+  switch (source) {
+    case GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_PIPELINE:
+      return "timestamp/x-gst-pipeline-clock";
+    case GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_MONOTONIC_RAW:
+      return "timestamp/x-monotonic-raw";
+    case GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_TAI:
+      return "timestamp/x-tai";
+    default:
+      // Both realtime and running-time are nanoseconds on the CLOCK_REALTIME timescale.
+      return "timestamp/x-unix";
+  }
+}
+
+// The reference caps to use for a GstReferenceTimestampMeta carrying times from source.
+GstCaps *
+gst_absolutetimestamps_clock_source_get_reference (GstAbsolutetimestampsClockSource source)
+{
+  return gst_caps_new_empty_simple (get_reference_name (source));
+}
+
+void
+gst_absolutetimestamps_clock_init (GstAbsolutetimestampsClock * clock,
+    GstAbsolutetimestampsClockSource source)
+{
+  clock->source = source;
+  clock->clock = NULL;
+  clock->realtime_offset = 0;
+}
+
+void
+gst_absolutetimestamps_clock_clear (GstAbsolutetimestampsClock * clock)
+{
+  if (clock->clock) {
+    gst_object_unref (clock->clock);
+    clock->clock = NULL;
+  }
+}
+
+static gint64
+sample_pipeline_clock (GstElement * element)
+{
+  GstClock *pipeline_clock = gst_element_get_clock (element);
+  GstClockTime now;
+
+  // Without a clock, e.g. outside of a pipeline, the best we can do is the system wallclock.
+  if (pipeline_clock == NULL)
+    return gst_absolutetimestamps_clock_get_real_time ();
+
+  now = gst_clock_get_time (pipeline_clock);
+  gst_object_unref (pipeline_clock);
+
+  return (gint64) now;
+}
+
+// A buffer's position on the pipeline clock is base_time + running_time - so given a single
+// measurement of where that clock is relative to CLOCK_REALTIME, the wallclock of each buffer is
+// just a couple of additions, free of scheduling jitter. This is the time at which the buffer is due
+// to be rendered rather than when it happened to arrive here.
+static gint64
+sample_running_time (GstAbsolutetimestampsClock * clock, GstElement * element,
+    const GstSegment * segment, GstClockTime pts)
+{
+  GstClockTime running_time, base_time;
+
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME, pts);
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return gst_absolutetimestamps_clock_get_real_time ();
+
+  // A single uncontended lock per buffer - the clock itself is only read when it changes.
+  GST_OBJECT_LOCK (element);
+  if (GST_ELEMENT_CLOCK (element) == NULL) {
+    GST_OBJECT_UNLOCK (element);
+    return gst_absolutetimestamps_clock_get_real_time ();
+  }
+
+  if (GST_ELEMENT_CLOCK (element) != clock->clock) {
+    gst_absolutetimestamps_clock_clear (clock);
+    clock->clock = gst_object_ref (GST_ELEMENT_CLOCK (element));
+    clock->realtime_offset = gst_absolutetimestamps_clock_get_real_time () -
+        (gint64) gst_clock_get_time (clock->clock);
+
+    GST_INFO_OBJECT (element, "CLOCK_REALTIME is %" G_GINT64_FORMAT "ns ahead of the pipeline clock",
+        clock->realtime_offset);
+  }
+  base_time = element->base_time;
+  GST_OBJECT_UNLOCK (element);
+
+  return clock->realtime_offset + (gint64) (base_time + running_time);
+}
+
+// element is the one sampling, and segment that of the stream pts is in, which only the running-time
+// source needs.
+gint64
+gst_absolutetimestamps_clock_sample (GstAbsolutetimestampsClock * clock,
+    GstElement * element, const GstSegment * segment, GstClockTime pts)
+{
+  switch (clock->source) {
+    case GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_PIPELINE:
+      return sample_pipeline_clock (element);
+    case GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_MONOTONIC_RAW:
+      return gst_absolutetimestamps_clock_get_time (ABSTS_CLOCK_MONOTONIC_RAW);
+    case GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_TAI:
+      return gst_absolutetimestamps_clock_get_time (ABSTS_CLOCK_TAI);
+    case GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_RUNNING_TIME:
+      return sample_running_time (clock, element, segment, pts);
+    default:
+      return gst_absolutetimestamps_clock_get_real_time ();
+  }
+}
+
+// The time, on source's timescale, of the first GstReferenceTimestampMeta on buf that can be put on
+// that timescale - typically attached by the source at capture, e.g. by rtpjitterbuffer with
+// add-reference-timestamp-meta=true from the sender's RTCP NTP time, or by an absolutetimestamps
+// further upstream. Returns FALSE if there is none.
+gboolean
+gst_absolutetimestamps_clock_get_reference_time (GstAbsolutetimestampsClockSource source,
+    GstBuffer * buf, gint64 * wallclock)
+{
+  const gchar *own_name = get_reference_name (source);
+  gboolean unix_timescale = g_str_equal (own_name, "timestamp/x-unix");
+  gboolean found = FALSE;
+  gpointer state = NULL;
+  GstMeta *meta;
+
+  while (!found && (meta = gst_buffer_iterate_meta (buf, &state)) != NULL) {
+    GstReferenceTimestampMeta *reference;
+    const gchar *name;
+
+    if (meta->info->api != GST_REFERENCE_TIMESTAMP_META_API_TYPE)
+      continue;
+
+    reference = (GstReferenceTimestampMeta *) meta;
+    if (reference->reference == NULL || gst_caps_is_empty (reference->reference) ||
+        !GST_CLOCK_TIME_IS_VALID (reference->timestamp))
+      continue;
+
+    name = gst_structure_get_name (gst_caps_get_structure (reference->reference, 0));
+
+    if (g_str_equal (name, own_name)) {
+      *wallclock = (gint64) reference->timestamp;
+      found = TRUE;
+    } else if (unix_timescale && g_str_equal (name, "timestamp/x-ntp") &&
+        reference->timestamp >= NTP_TO_UNIX_EPOCH) {
+      *wallclock = (gint64) (reference->timestamp - NTP_TO_UNIX_EPOCH);
+      found = TRUE;
+    }
+  }
+
+  return found;
+}
+
+// How late (positive) or early (negative) a buffer is arriving here relative to when it's due to be
+// rendered against the pipeline clock. Returns FALSE if there's no clock or running time to compare with.
+gboolean
+gst_absolutetimestamps_clock_get_skew (GstBaseTransform * trans, GstClockTime pts,
+    GstClockTimeDiff * skew)
+{
+  GstElement *element = GST_ELEMENT (trans);
+  GstClockTime running_time, base_time, now;
+  GstClock *pipeline_clock;
+
+  running_time = gst_segment_to_running_time (&trans->segment, GST_FORMAT_TIME, pts);
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return FALSE;
+
+  GST_OBJECT_LOCK (element);
+  pipeline_clock = GST_ELEMENT_CLOCK (element);
+  if (pipeline_clock == NULL) {
+    GST_OBJECT_UNLOCK (element);
+    return FALSE;
+  }
+  gst_object_ref (pipeline_clock);
+  base_time = element->base_time;
+  GST_OBJECT_UNLOCK (element);
+
+  now = gst_clock_get_time (pipeline_clock);
+  gst_object_unref (pipeline_clock);
+
+  *skew = GST_CLOCK_DIFF (base_time + running_time, now);
+
+  return TRUE;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_CLOCK_H_
+#define _GST_ABSOLUTETIMESTAMPS_CLOCK_H_
+
+#include <time.h>
+
+#include <gst/base/gstbasetransform.h>
+
+#include "gstabstsformat.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ABSOLUTETIMESTAMPS_CLOCK_SOURCE (gst_absolutetimestamps_clock_source_get_type())
+
+// The values match GstAbstsClockSource so that they can be recorded as-is in binary logs.
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_REALTIME = GST_ABSTS_CLOCK_SOURCE_REALTIME,
+  GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_PIPELINE = GST_ABSTS_CLOCK_SOURCE_PIPELINE,
+  GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_MONOTONIC_RAW = GST_ABSTS_CLOCK_SOURCE_MONOTONIC_RAW,
+  GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_TAI = GST_ABSTS_CLOCK_SOURCE_TAI,
+  GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_RUNNING_TIME = GST_ABSTS_CLOCK_SOURCE_RUNNING_TIME
+} GstAbsolutetimestampsClockSource;
+
+typedef struct _GstAbsolutetimestampsClock GstAbsolutetimestampsClock;
+
+// Where the "absolute" time of each buffer comes from. Only used from the streaming thread.
+struct _GstAbsolutetimestampsClock
+{
+  GstAbsolutetimestampsClockSource source;
+
+  // For the running-time source: the clock that base_time + running_time is measured against and
+  // the offset from it to CLOCK_REALTIME, sampled once when that clock is first seen.
+  GstClock *clock;
+  gint64 realtime_offset;
+};
+
+GType gst_absolutetimestamps_clock_source_get_type (void);
+
+GstCaps *gst_absolutetimestamps_clock_source_get_reference (GstAbsolutetimestampsClockSource source);
+
+void gst_absolutetimestamps_clock_init (GstAbsolutetimestampsClock * clock,
+    GstAbsolutetimestampsClockSource source);
+void gst_absolutetimestamps_clock_clear (GstAbsolutetimestampsClock * clock);
+
+gint64 gst_absolutetimestamps_clock_sample (GstAbsolutetimestampsClock * clock,
+    GstElement * element, const GstSegment * segment, GstClockTime pts);
+
+gboolean gst_absolutetimestamps_clock_get_skew (GstBaseTransform * trans, GstClockTime pts,
+    GstClockTimeDiff * skew);
+
+gboolean gst_absolutetimestamps_clock_get_reference_time (GstAbsolutetimestampsClockSource source,
+    GstBuffer * buf, gint64 * wallclock);
+
+static inline gint64
+gst_absolutetimestamps_clock_get_time (clockid_t id)
+{
+  struct timespec ts;
+
+  clock_gettime (id, &ts);
+
+  return (gint64) ts.tv_sec * GST_SECOND + ts.tv_nsec;
+}
+
+static inline gint64
+gst_absolutetimestamps_clock_get_real_time (void)
+{
+  return gst_absolutetimestamps_clock_get_time (CLOCK_REALTIME);
+}
+
+G_END_DECLS
+
+#endif
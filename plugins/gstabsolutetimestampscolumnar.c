@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstabsolutetimestampscolumnar.h"
+
+// Encodes row groups as laid out in gstabstsformat.h, gst_absts_columnar_reader_decode is the other half.
+
+static inline guint64
+column_value (const GstAbsolutetimestampsRecord * record, GstAbstsColumn column)
+{
+  switch (column) {
+    case GST_ABSTS_COLUMN_PTS:
+      return record->pts;
+    case GST_ABSTS_COLUMN_WALLCLOCK:
+      return (guint64) record->wallclock;
+    case GST_ABSTS_COLUMN_FLAGS:
+      return record->flags & ~GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE;
+    default:
+      return record->stream_id;
+  }
+}
+
+// The first value, the first delta and then delta-of-deltas, with runs of zero delta-of-deltas
+// collapsed into a count.
+static guint8 *
+encode_deltas (guint8 * p, const GstAbsolutetimestampsRecord * records, guint n_records,
+    GstAbstsColumn column)
+{
+  guint64 previous, delta;
+  guint i;
+
+  previous = column_value (&records[0], column);
+  p = gst_absts_varint_write (p, previous);
+  if (n_records < 2)
+    return p;
+
+  delta = column_value (&records[1], column) - previous;
+  previous += delta;
+  p = gst_absts_varint_write (p, gst_absts_zigzag_encode (delta));
+
+  for (i = 2; i < n_records; i++) {
+    guint64 value = column_value (&records[i], column);
+    guint64 dod = (value - previous) - delta;
+
+    p = gst_absts_varint_write (p, gst_absts_zigzag_encode (dod));
+    delta = value - previous;
+    previous = value;
+
+    if (dod == 0) {
+      guint run = 0;
+
+      while (i + 1 < n_records && column_value (&records[i + 1], column) - previous == delta) {
+        previous += delta;
+        run++;
+        i++;
+      }
+      p = gst_absts_varint_write (p, run);
+    }
+  }
+
+  return p;
+}
+
+static guint8 *
+encode_runs (guint8 * p, const GstAbsolutetimestampsRecord * records, guint n_records,
+    GstAbstsColumn column)
+{
+  guint i, start;
+
+  for (start = 0; start < n_records; start = i) {
+    guint64 value = column_value (&records[start], column);
+
+    for (i = start + 1; i < n_records && column_value (&records[i], column) == value; i++);
+    p = gst_absts_varint_write (p, i - start);
+    p = gst_absts_varint_write (p, value);
+  }
+
+  return p;
+}
+
+// Encodes records, of which there must be at least one, as a row group into dest, which must have
+// room for GST_ABSOLUTETIMESTAMPS_ROW_GROUP_MAX_SIZE (n_records). Fills in all of group but its
+// offset and returns the size of the encoding.
+gsize
+gst_absolutetimestamps_columnar_encode (guint8 * dest,
+    const GstAbsolutetimestampsRecord * records, guint n_records, GstAbstsRowGroup * group)
+{
+  guint8 *p = dest + GST_ABSTS_ROW_GROUP_HEADER_SIZE;
+  guint i;
+
+  group->count = n_records;
+  group->min_pts = G_MAXUINT64;
+  group->max_pts = 0;
+  group->min_wallclock = G_MAXINT64;
+  group->max_wallclock = G_MININT64;
+
+  for (i = 0; i < n_records; i++) {
+    const GstAbsolutetimestampsRecord *record = &records[i];
+
+    if (GST_ABSTS_RECORD_TYPE (record->flags) == GST_ABSTS_RECORD_TYPE_SAMPLE &&
+        GST_CLOCK_TIME_IS_VALID (record->pts)) {
+      group->min_pts = MIN (group->min_pts, record->pts);
+      group->max_pts = MAX (group->max_pts, record->pts);
+    }
+    group->min_wallclock = MIN (group->min_wallclock, record->wallclock);
+    group->max_wallclock = MAX (group->max_wallclock, record->wallclock);
+  }
+
+  for (i = 0; i < GST_ABSTS_N_COLUMNS; i++) {
+    guint8 *start = p;
+
+    if (i == GST_ABSTS_COLUMN_PTS || i == GST_ABSTS_COLUMN_WALLCLOCK)
+      p = encode_deltas (p, records, n_records, (GstAbstsColumn) i);
+    else
+      p = encode_runs (p, records, n_records, (GstAbstsColumn) i);
+    group->sizes[i] = p - start;
+  }
+
+  gst_absts_row_group_header_write (dest, group);
+
+  return p - dest;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_COLUMNAR_H_
+#define _GST_ABSOLUTETIMESTAMPS_COLUMNAR_H_
+
+#include "gstabsolutetimestampsrecord.h"
+
+G_BEGIN_DECLS
+
+// A bound on the encoding of a row group of n records: no value takes more than two varints, nor
+// does any run.
+#define GST_ABSOLUTETIMESTAMPS_ROW_GROUP_MAX_SIZE(n) \
+    (GST_ABSTS_ROW_GROUP_HEADER_SIZE + (gsize) (n) * GST_ABSTS_N_COLUMNS * 2 * GST_ABSTS_VARINT_MAX_SIZE)
+
+gsize gst_absolutetimestamps_columnar_encode (guint8 * dest,
+    const GstAbsolutetimestampsRecord * records, guint n_records, GstAbstsRowGroup * group);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,404 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <time.h>
+
+#include "gstabsolutetimestampsformat.h"
+
+#define NO_SECOND G_MININT64
+
+GType
+gst_absolutetimestamps_format_get_type (void)
+{
+  static gsize format_type = 0;
+
+  if (g_once_init_enter (&format_type)) {
+    static const GEnumValue formats[] = {
+      {GST_ABSOLUTETIMESTAMPS_FORMAT_TEXT, "One line of text per record", "text"},
+      {GST_ABSOLUTETIMESTAMPS_FORMAT_BINARY, "Fixed-size little-endian binary records", "binary"},
+      {GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR,
+          "Row groups of delta-encoded columns with a footer index", "columnar"},
+      {GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS, "Binary records in checksummed blocks, for crash safety",
+          "blocks"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsFormat", formats);
+
+    g_once_init_leave (&format_type, type);
+  }
+
+  return format_type;
+}
+
+GType
+gst_absolutetimestamps_precision_get_type (void)
+{
+  static gsize precision_type = 0;
+
+  if (g_once_init_enter (&precision_type)) {
+    static const GEnumValue precisions[] = {
+      {GST_ABSOLUTETIMESTAMPS_PRECISION_MICROSECONDS, "Microseconds", "microseconds"},
+      {GST_ABSOLUTETIMESTAMPS_PRECISION_NANOSECONDS, "Nanoseconds", "nanoseconds"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsPrecision", precisions);
+
+    g_once_init_leave (&precision_type, type);
+  }
+
+  return precision_type;
+}
+
+GType
+gst_absolutetimestamps_fields_get_type (void)
+{
+  static gsize fields_type = 0;
+
+  if (g_once_init_enter (&fields_type)) {
+    static const GFlagsValue fields[] = {
+      {GST_ABSOLUTETIMESTAMPS_FIELD_DTS, "Decoding timestamp", "dts"},
+      {GST_ABSOLUTETIMESTAMPS_FIELD_DURATION, "Duration", "duration"},
+      {GST_ABSOLUTETIMESTAMPS_FIELD_OFFSET, "Offset, e.g. the frame number", "offset"},
+      {GST_ABSOLUTETIMESTAMPS_FIELD_SIZE, "Size in bytes", "size"},
+      {0, NULL, NULL}
+    };
+    GType type = g_flags_register_static ("GstAbsolutetimestampsFields", fields);
+
+    g_once_init_leave (&fields_type, type);
+  }
+
+  return fields_type;
+}
+
+void
+gst_absolutetimestamps_text_formatter_init (GstAbsolutetimestampsTextFormatter * formatter,
+    GstAbsolutetimestampsPrecision precision)
+{
+  formatter->precision = precision;
+  formatter->cached_second = NO_SECOND;
+  formatter->prefix[0] = '\0';
+  formatter->line_is_sample = FALSE;
+}
+
+static const gchar digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Writes value as exactly width decimal digits, keeping only the least significant ones. Two digits
+// at a time, which halves the divisions - with a constant width the loop unrolls completely.
+static inline void
+format_digits (gchar * dest, guint value, gint width)
+{
+  while (width >= 2) {
+    width -= 2;
+    memcpy (dest + width, digit_pairs + (value % 100) * 2, 2);
+    value /= 100;
+  }
+  if (width > 0)
+    dest[0] = '0' + value % 10;
+}
+
+// Writes value with as many digits as it takes, returning the end.
+static inline gchar *
+format_unsigned (gchar * dest, guint value)
+{
+  gint width = 1;
+  guint rest;
+
+  for (rest = value / 10; rest > 0; rest /= 10)
+    width++;
+  format_digits (dest, value, width);
+
+  return dest + width;
+}
+
+static inline gchar *
+format_unsigned64 (gchar * dest, guint64 value)
+{
+  gchar digits[20];
+  gint n = 0;
+
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  while (n > 0)
+    *dest++ = digits[--n];
+
+  return dest;
+}
+
+static void
+update_prefix (GstAbsolutetimestampsTextFormatter * formatter, gint64 second)
+{
+  time_t t = (time_t) second;
+  struct tm tm;
+
+  if (formatter->cached_second != NO_SECOND && second >= 0 && formatter->cached_second >= 0 &&
+      second / 60 == formatter->cached_second / 60) {
+    format_digits (formatter->prefix + 17, (guint) (second % 60), 2);
+  } else {
+    gmtime_r (&t, &tm);
+    format_digits (formatter->prefix, (guint) tm.tm_year + 1900, 4);
+    formatter->prefix[4] = '-';
+    format_digits (formatter->prefix + 5, (guint) tm.tm_mon + 1, 2);
+    formatter->prefix[7] = '-';
+    format_digits (formatter->prefix + 8, (guint) tm.tm_mday, 2);
+    formatter->prefix[10] = 'T';
+    format_digits (formatter->prefix + 11, (guint) tm.tm_hour, 2);
+    formatter->prefix[13] = ':';
+    format_digits (formatter->prefix + 14, (guint) tm.tm_min, 2);
+    formatter->prefix[16] = ':';
+    format_digits (formatter->prefix + 17, (guint) tm.tm_sec, 2);
+    formatter->prefix[19] = '\0';
+  }
+
+  formatter->cached_second = second;
+}
+
+static const gchar *const record_prefixes[] = {
+  [GST_ABSTS_RECORD_TYPE_SAMPLE] = "",
+  [GST_ABSTS_RECORD_TYPE_MODEL] = "# model ",
+  [GST_ABSTS_RECORD_TYPE_SEGMENT] = "# segment ",
+  [GST_ABSTS_RECORD_TYPE_FLUSH] = "# flush ",
+  [GST_ABSTS_RECORD_TYPE_MODE] = "# mode ",
+  [GST_ABSTS_RECORD_TYPE_SYNC] = "# sync ",
+  "# unknown "
+};
+
+// The nicks of GstAbsolutetimestampsMode, for the mode records.
+static const gchar *const mode_names[] = {
+  [GST_ABSTS_MODE_EVERY_BUFFER] = "every-buffer",
+  [GST_ABSTS_MODE_EVERY_NTH] = "every-nth",
+  [GST_ABSTS_MODE_KEYFRAMES_ONLY] = "keyframes-only",
+  [GST_ABSTS_MODE_DRIFT_ONLY] = "drift-only",
+  "unknown"
+};
+
+// The same as GST_TIME_FORMAT, i.e. H:MM:SS.nnnnnnnnn and 99:99:99.999999999 for GST_CLOCK_TIME_NONE.
+static inline gchar *
+format_pts (gchar * p, GstClockTime pts)
+{
+  guint64 second;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts)) {
+    memcpy (p, "99:99:99.999999999", 18);
+    return p + 18;
+  }
+
+  second = pts / GST_SECOND;
+  p = format_unsigned (p, (guint) (second / 3600));
+  *p++ = ':';
+  format_digits (p, (guint) (second / 60 % 60), 2);
+  p += 2;
+  *p++ = ':';
+  format_digits (p, (guint) (second % 60), 2);
+  p += 2;
+  *p++ = '.';
+  format_digits (p, (guint) (pts % GST_SECOND), 9);
+
+  return p + 9;
+}
+
+// Formats into the rest of formatter->line at p, cut short if need be so that the newline after it
+// still fits. Returns the end of what was written.
+static gchar *
+append_printf (GstAbsolutetimestampsTextFormatter * formatter, gchar * p, const gchar * format, ...)
+    G_GNUC_PRINTF (3, 4);
+
+static gchar *
+append_printf (GstAbsolutetimestampsTextFormatter * formatter, gchar * p, const gchar * format, ...)
+{
+  gsize size = formatter->line + sizeof (formatter->line) - p;
+  va_list args;
+  gint n;
+
+  va_start (args, format);
+  n = g_vsnprintf (p, size, format, args);
+  va_end (args);
+
+  return p + MIN ((gsize) MAX (n, 0), size - 1);
+}
+
+// fraction_digits is a constant in both callers, so each precision gets a copy of its own with the
+// digit loops unrolled.
+static inline gsize
+format_record (GstAbsolutetimestampsTextFormatter * formatter,
+    const GstAbsolutetimestampsRecord * record, const gint fraction_digits)
+{
+  guint type = GST_ABSTS_RECORD_TYPE (record->flags);
+  gint64 second = record->wallclock / (gint64) GST_SECOND;
+  guint nanos = (guint) (record->wallclock % (gint64) GST_SECOND);
+  guint fraction;
+  gchar *p;
+
+  // Timestamps are never before the epoch but keep the arithmetic correct if one is.
+  if (record->wallclock < 0 && nanos != 0) {
+    second--;
+    nanos = (guint) ((gint64) nanos + (gint64) GST_SECOND);
+  }
+  fraction = fraction_digits == 9 ? nanos : nanos / 1000;
+
+  if (type == GST_ABSTS_RECORD_TYPE_SAMPLE && formatter->line_is_sample &&
+      second == formatter->line_wallclock_second && GST_CLOCK_TIME_IS_VALID (record->pts) &&
+      record->pts / GST_SECOND == formatter->line_pts_second) {
+    format_digits (formatter->line + formatter->pts_fraction, (guint) (record->pts % GST_SECOND), 9);
+    format_digits (formatter->line + formatter->wallclock_fraction, fraction, fraction_digits);
+    return formatter->length;
+  }
+
+  if (second != formatter->cached_second)
+    update_prefix (formatter, second);
+
+  // Anything but a sample is marked as a comment so that naive parsers of the pts/wallclock columns skip it.
+  p = g_stpcpy (formatter->line, record_prefixes[MIN (type, G_N_ELEMENTS (record_prefixes) - 1)]);
+  // A clock-sync report has no pts, its offset and error bound follow the wallclock instead.
+  p = format_pts (p, type == GST_ABSTS_RECORD_TYPE_SYNC ? GST_CLOCK_TIME_NONE : record->pts);
+  formatter->pts_fraction = p - 9 - formatter->line;
+  *p++ = ' ';
+
+  memcpy (p, formatter->prefix, 19);
+  p += 19;
+  *p++ = '.';
+  formatter->wallclock_fraction = p - formatter->line;
+  format_digits (p, fraction, fraction_digits);
+  p += fraction_digits;
+  *p++ = 'Z';
+  if (type == GST_ABSTS_RECORD_TYPE_MODEL) {
+    GstAbstsRecord sample = { record->pts, record->wallclock, record->flags, record->stream_id };
+    GstAbstsModel model;
+
+    gst_absts_model_read (&sample, &model);
+    p = append_printf (formatter, p, " %+dppb", model.drift_ppb);
+  } else if (type == GST_ABSTS_RECORD_TYPE_MODE) {
+    *p++ = ' ';
+    p = g_stpcpy (p, mode_names[MIN (GST_ABSTS_MODE_RECORD_MODE (record->flags),
+                G_N_ELEMENTS (mode_names) - 1)]);
+  } else if (type == GST_ABSTS_RECORD_TYPE_SYNC) {
+    GstAbstsRecord report = { record->pts, record->wallclock, record->flags, record->stream_id };
+    GstAbstsSync sync;
+
+    gst_absts_sync_read (&report, &sync);
+    p = g_stpcpy (p, sync.source == GST_ABSTS_SYNC_SOURCE_PTP ? " ptp " : " kernel ");
+    if (sync.max_error == G_MAXUINT64)
+      p = g_stpcpy (p, "unsynchronised");
+    else
+      p = append_printf (formatter, p, "%+" G_GINT64_FORMAT "ns %" G_GUINT64_FORMAT "us",
+          sync.offset, sync.max_error / 1000);
+  }
+  *p++ = '\n';
+
+  formatter->line_is_sample = type == GST_ABSTS_RECORD_TYPE_SAMPLE &&
+      GST_CLOCK_TIME_IS_VALID (record->pts);
+  formatter->line_pts_second = record->pts / GST_SECOND;
+  formatter->line_wallclock_second = second;
+  formatter->length = p - formatter->line;
+
+  return formatter->length;
+}
+
+// Formats record into formatter->line, returning the length of the line (which ends in a newline but
+// is not NUL-terminated). The line stays valid until the next call.
+gsize
+gst_absolutetimestamps_text_formatter_format (GstAbsolutetimestampsTextFormatter * formatter,
+    const GstAbsolutetimestampsRecord * record)
+{
+  if (formatter->precision == GST_ABSOLUTETIMESTAMPS_PRECISION_NANOSECONDS)
+    return format_record (formatter, record, 9);
+
+  return format_record (formatter, record, 6);
+}
+
+// Formats a row of several streams sampled at the same wallclock into dest, which must have room for
+// GST_ABSOLUTETIMESTAMPS_ROW_SIZE (n_columns): the wallclock first, then the pts of each column in
+// order, "-" for a column without one. Returns the length of the line, which ends in a newline.
+gsize
+gst_absolutetimestamps_text_formatter_format_row (GstAbsolutetimestampsTextFormatter * formatter,
+    gchar * dest, gint64 wallclock, const GstAbsolutetimestampsRecord * columns, guint n_columns)
+{
+  gint fraction_digits = formatter->precision == GST_ABSOLUTETIMESTAMPS_PRECISION_NANOSECONDS ? 9 : 6;
+  gint64 second = wallclock / (gint64) GST_SECOND;
+  guint nanos = (guint) (wallclock % (gint64) GST_SECOND);
+  gchar *p = dest;
+  guint i;
+
+  if (wallclock < 0 && nanos != 0) {
+    second--;
+    nanos = (guint) ((gint64) nanos + (gint64) GST_SECOND);
+  }
+
+  if (second != formatter->cached_second)
+    update_prefix (formatter, second);
+
+  memcpy (p, formatter->prefix, 19);
+  p += 19;
+  *p++ = '.';
+  format_digits (p, fraction_digits == 9 ? nanos : nanos / 1000, fraction_digits);
+  p += fraction_digits;
+  *p++ = 'Z';
+
+  for (i = 0; i < n_columns; i++) {
+    *p++ = ' ';
+    if (GST_CLOCK_TIME_IS_VALID (columns[i].pts))
+      p = format_pts (p, columns[i].pts);
+    else
+      *p++ = '-';
+  }
+  *p++ = '\n';
+
+  return p - dest;
+}
+
+static const gchar *const field_names[GST_ABSTS_N_FIELDS] = {
+  [GST_ABSTS_FIELD_DTS] = " dts=",
+  [GST_ABSTS_FIELD_DURATION] = " duration=",
+  [GST_ABSTS_FIELD_OFFSET] = " offset=",
+  [GST_ABSTS_FIELD_SIZE] = " size=",
+};
+
+// Formats the fields of record chosen by fields (GstAbsolutetimestampsFields) into dest, which must
+// have room for GST_ABSOLUTETIMESTAMPS_FIELDS_SIZE: times like pts, offset and size in decimal and
+// "-" for a value the buffer didn't have. Returns the length, without a newline.
+gsize
+gst_absolutetimestamps_format_fields (gchar * dest, guint fields,
+    const GstAbsolutetimestampsRecord * record)
+{
+  gchar *p = dest;
+  guint i;
+
+  for (i = 0; i < GST_ABSTS_N_FIELDS; i++) {
+    guint64 value = record->fields[i];
+
+    if (!(fields & (1 << i)))
+      continue;
+
+    p = g_stpcpy (p, field_names[i]);
+    if (value == G_MAXUINT64)
+      *p++ = '-';
+    else if (i == GST_ABSTS_FIELD_DTS || i == GST_ABSTS_FIELD_DURATION)
+      p = format_pts (p, value);
+    else
+      p = format_unsigned64 (p, value);
+  }
+
+  return p - dest;
+}
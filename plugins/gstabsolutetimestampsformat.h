@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_FORMAT_H_
+#define _GST_ABSOLUTETIMESTAMPS_FORMAT_H_
+
+#include "gstabsolutetimestampsrecord.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ABSOLUTETIMESTAMPS_FORMAT (gst_absolutetimestamps_format_get_type())
+#define GST_TYPE_ABSOLUTETIMESTAMPS_PRECISION (gst_absolutetimestamps_precision_get_type())
+#define GST_TYPE_ABSOLUTETIMESTAMPS_FIELDS (gst_absolutetimestamps_fields_get_type())
+
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_FORMAT_TEXT,
+  GST_ABSOLUTETIMESTAMPS_FORMAT_BINARY,
+  GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR,
+  GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS
+} GstAbsolutetimestampsFormat;
+
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_PRECISION_MICROSECONDS,
+  GST_ABSOLUTETIMESTAMPS_PRECISION_NANOSECONDS
+} GstAbsolutetimestampsPrecision;
+
+// Bit i is GstAbstsField i, and shifted by GST_ABSTS_HEADER_FIELDS_SHIFT they're the header flags.
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_FIELD_DTS = (1 << GST_ABSTS_FIELD_DTS),
+  GST_ABSOLUTETIMESTAMPS_FIELD_DURATION = (1 << GST_ABSTS_FIELD_DURATION),
+  GST_ABSOLUTETIMESTAMPS_FIELD_OFFSET = (1 << GST_ABSTS_FIELD_OFFSET),
+  GST_ABSOLUTETIMESTAMPS_FIELD_SIZE = (1 << GST_ABSTS_FIELD_SIZE)
+} GstAbsolutetimestampsFields;
+
+// Long enough for "H:MM:SS.nnnnnnnnn YYYY-MM-DDTHH:MM:SS.nnnnnnnnnZ\n" with room for a very large hour count.
+#define GST_ABSOLUTETIMESTAMPS_LINE_SIZE 128
+
+// Room for all of " dts=... duration=... offset=... size=...", with the longest possible values.
+#define GST_ABSOLUTETIMESTAMPS_FIELDS_SIZE 128
+
+// Room for a row of n columns: the wallclock and, for each column, a space and the longest possible
+// pts, i.e. with the 7 digit hour count of G_MAXUINT64 - 1.
+#define GST_ABSOLUTETIMESTAMPS_ROW_SIZE(n) (32 + (gsize) (n) * 24)
+
+typedef struct _GstAbsolutetimestampsTextFormatter GstAbsolutetimestampsTextFormatter;
+
+// Formats records as lines of text without allocating. The "YYYY-MM-DDTHH:MM:SS" part of the wallclock
+// is cached and only regenerated when the second rolls over - and then only the seconds digits unless
+// the minute has rolled over too.
+//
+// Consecutive samples almost always fall within the same second of both pts and wallclock, so the
+// previous line is kept and, when that's the case, only its two fractions are rewritten in place.
+struct _GstAbsolutetimestampsTextFormatter
+{
+  GstAbsolutetimestampsPrecision precision;
+
+  gint64 cached_second;
+  gchar prefix[20];
+
+  // What line currently holds: valid only if it's a sample, with the offsets of its fractions.
+  gboolean line_is_sample;
+  guint64 line_pts_second;
+  gint64 line_wallclock_second;
+  gsize pts_fraction;
+  gsize wallclock_fraction;
+  gsize length;
+
+  gchar line[GST_ABSOLUTETIMESTAMPS_LINE_SIZE];
+};
+
+GType gst_absolutetimestamps_format_get_type (void);
+GType gst_absolutetimestamps_precision_get_type (void);
+GType gst_absolutetimestamps_fields_get_type (void);
+
+void gst_absolutetimestamps_text_formatter_init (GstAbsolutetimestampsTextFormatter * formatter,
+    GstAbsolutetimestampsPrecision precision);
+gsize gst_absolutetimestamps_text_formatter_format (GstAbsolutetimestampsTextFormatter * formatter,
+    const GstAbsolutetimestampsRecord * record);
+gsize gst_absolutetimestamps_text_formatter_format_row (GstAbsolutetimestampsTextFormatter * formatter,
+    gchar * dest, gint64 wallclock, const GstAbsolutetimestampsRecord * columns, guint n_columns);
+gsize gst_absolutetimestamps_format_fields (gchar * dest, guint fields,
+    const GstAbsolutetimestampsRecord * record);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// The most recent records kept in memory, so that the pts of a frame can be mapped to its wallclock
+// and back while the element is running, without going to the file.
+//
+// The records are the very ones handed to the output, copied as they are into an arena allocated up
+// front and cut into chunks of CHUNK_RECORDS. The chunks are filled in turn and once they're all in
+// use the oldest is dropped as a whole to make room, so adding a record never allocates and
+// eviction is O(1), and however long the element runs the history never takes more than the arena.
+//
+// As in a log, pts and wallclock both only grow from one record to the next, so a lookup is a
+// binary search. To keep that from touching a cache line per step across the whole arena, the pts
+// and wallclock of the first record of each chunk are also kept in a sparse summary: a lookup first
+// searches the summary for the chunk and then only that chunk.
+//
+// The streaming thread adds records while lookups come from any thread, so both take the lock. It's
+// only ever held for a few dozen comparisons.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstabsolutetimestampshistory.h"
+
+#define CHUNK_RECORDS GST_ABSOLUTETIMESTAMPS_HISTORY_CHUNK_RECORDS
+
+// Set on the copy of each sample kept while the mode in effect left gaps to interpolate across.
+// The records never leave the history, so the flag is never seen outside it.
+#define HISTORY_FLAG_INTERPOLATE (1 << 22)
+
+typedef struct _GstAbsolutetimestampsHistoryKey GstAbsolutetimestampsHistoryKey;
+
+struct _GstAbsolutetimestampsHistoryKey
+{
+  GstClockTime pts;
+  gint64 wallclock;
+};
+
+struct _GstAbsolutetimestampsHistory
+{
+  GMutex lock;
+
+  guint n_chunks;
+  gboolean interpolate;         /* between records, as for a decimated log, in the current mode */
+  gboolean restart;             /* a flush or segment came, the pts may start over */
+
+  // Count records since the history last started over. tail is always at the start of a chunk, the
+  // chunk of position p is chunk (p / CHUNK_RECORDS) % n_chunks of the arena.
+  guint64 head;                 /* the next record */
+  guint64 tail;                 /* the oldest record still kept */
+
+  GstAbsolutetimestampsRecord *arena;
+  GstAbsolutetimestampsRecord *chunk;   /* the one head is in */
+  GstAbsolutetimestampsHistoryKey *summary;     /* of the first record of each chunk of the arena */
+};
+
+static inline GstAbsolutetimestampsRecord *
+record_at (GstAbsolutetimestampsHistory * history, guint64 position)
+{
+  return &history->arena[(position / CHUNK_RECORDS) % history->n_chunks * CHUNK_RECORDS +
+      position % CHUNK_RECORDS];
+}
+
+// Keeps at most max_records records, if that's not 0, in at most max_bytes, if that's not 0
+// either. Either way the history takes whole chunks, at least two so that dropping one never empties
+// it. With interpolate, lookups between two records interpolate between them rather than
+// extrapolate from the earlier, as gst_absts_reader_interpolate_wallclock does for logs recorded
+// with mode=every-nth or keyframes-only. That's only where the history starts: mode records added
+// later switch it, as they do for the reader. Both limits come from the user, so a history too big to
+// allocate is an error rather than an abort.
+GstAbsolutetimestampsHistory *
+gst_absolutetimestamps_history_new (guint max_records, guint64 max_bytes, gboolean interpolate,
+    GError ** error)
+{
+  GstAbsolutetimestampsHistory *history;
+  guint64 n_chunks = G_MAXINT / CHUNK_RECORDS;
+
+  if (max_records > 0)
+    n_chunks = MIN (n_chunks, ((guint64) max_records + CHUNK_RECORDS - 1) / CHUNK_RECORDS);
+  if (max_bytes > 0)
+    n_chunks = MIN (n_chunks, max_bytes / GST_ABSOLUTETIMESTAMPS_HISTORY_CHUNK_SIZE);
+
+  history = g_new0 (GstAbsolutetimestampsHistory, 1);
+  g_mutex_init (&history->lock);
+  history->n_chunks = MAX (n_chunks, 2);
+  history->interpolate = interpolate;
+  history->arena = g_try_new (GstAbsolutetimestampsRecord,
+      (gsize) history->n_chunks * CHUNK_RECORDS);
+  history->summary = g_try_new (GstAbsolutetimestampsHistoryKey, history->n_chunks);
+
+  if (history->arena == NULL || history->summary == NULL) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM,
+        "Could not allocate %" G_GUINT64_FORMAT " bytes for %u chunks of history",
+        (guint64) history->n_chunks * GST_ABSOLUTETIMESTAMPS_HISTORY_CHUNK_SIZE, history->n_chunks);
+    gst_absolutetimestamps_history_free (history);
+    return NULL;
+  }
+
+  return history;
+}
+
+void
+gst_absolutetimestamps_history_free (GstAbsolutetimestampsHistory * history)
+{
+  g_mutex_clear (&history->lock);
+  g_free (history->arena);
+  g_free (history->summary);
+  g_free (history);
+}
+
+// Only samples are kept, marked with whether the mode of the last mode record, if any, calls for
+// interpolating after them. One that goes back in pts or wallclock, e.g. a reordered frame, is
+// skipped, unless it's a discontinuity or follows a flush or segment, in which case the history
+// starts over from it.
+void
+gst_absolutetimestamps_history_add (GstAbsolutetimestampsHistory * history,
+    const GstAbsolutetimestampsRecord * record)
+{
+  guint type = GST_ABSTS_RECORD_TYPE (record->flags);
+  guint chunk;
+
+  if (type == GST_ABSTS_RECORD_TYPE_FLUSH || type == GST_ABSTS_RECORD_TYPE_SEGMENT)
+    history->restart = TRUE;
+  if (type == GST_ABSTS_RECORD_TYPE_MODE) {
+    GstAbstsMode mode = GST_ABSTS_MODE_RECORD_MODE (record->flags);
+
+    history->interpolate = mode == GST_ABSTS_MODE_EVERY_NTH || mode == GST_ABSTS_MODE_KEYFRAMES_ONLY;
+  }
+  if (type != GST_ABSTS_RECORD_TYPE_SAMPLE || !GST_CLOCK_TIME_IS_VALID (record->pts))
+    return;
+
+  g_mutex_lock (&history->lock);
+
+  if (history->head != history->tail) {
+    const GstAbsolutetimestampsRecord *last = record_at (history, history->head - 1);
+
+    if (record->pts < last->pts || record->wallclock < last->wallclock) {
+      if (!history->restart && !(record->flags & GST_ABSTS_RECORD_FLAG_DISCONT)) {
+        g_mutex_unlock (&history->lock);
+        return;
+      }
+      history->head = history->tail = 0;
+    }
+  }
+  history->restart = FALSE;
+
+  if (history->head % CHUNK_RECORDS == 0) {
+    if (history->head - history->tail == (guint64) history->n_chunks * CHUNK_RECORDS)
+      history->tail += CHUNK_RECORDS;
+
+    chunk = (history->head / CHUNK_RECORDS) % history->n_chunks;
+    history->chunk = &history->arena[(gsize) chunk * CHUNK_RECORDS];
+    history->summary[chunk].pts = record->pts;
+    history->summary[chunk].wallclock = record->wallclock;
+  }
+
+  history->chunk[history->head % CHUNK_RECORDS] = *record;
+  if (history->interpolate)
+    history->chunk[history->head % CHUNK_RECORDS].flags |= HISTORY_FLAG_INTERPOLATE;
+  history->head++;
+
+  g_mutex_unlock (&history->lock);
+}
+
+// Returns the position of the last record whose pts (or wallclock) is no later than the one given,
+// or -1 if there's none. by_wallclock is a constant in both callers, so each gets a copy of its own.
+static inline gint64
+find (GstAbsolutetimestampsHistory * history, GstClockTime pts, gint64 wallclock,
+    const gboolean by_wallclock)
+{
+  guint64 first, low, high;
+
+  if (history->head == history->tail)
+    return -1;
+
+  first = history->tail / CHUNK_RECORDS;
+  low = first;
+  high = (history->head - 1) / CHUNK_RECORDS + 1;
+  while (low < high) {
+    guint64 mid = low + (high - low) / 2;
+    const GstAbsolutetimestampsHistoryKey *key = &history->summary[mid % history->n_chunks];
+
+    if (by_wallclock ? key->wallclock > wallclock : key->pts > pts)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+  if (low == first)
+    return -1;
+
+  // The first record of the chunk is no later, so the answer is in it.
+  low = (low - 1) * CHUNK_RECORDS;
+  high = MIN (low + CHUNK_RECORDS, history->head);
+  while (low < high) {
+    guint64 mid = low + (high - low) / 2;
+    const GstAbsolutetimestampsRecord *record = record_at (history, mid);
+
+    if (by_wallclock ? record->wallclock > wallclock : record->pts > pts)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+
+  return (gint64) low - 1;
+}
+
+// The record after position, if it can be interpolated to, see gst_absolutetimestamps_history_new.
+static const GstAbsolutetimestampsRecord *
+get_next (GstAbsolutetimestampsHistory * history, gint64 position)
+{
+  const GstAbsolutetimestampsRecord *next;
+
+  if (!(record_at (history, position)->flags & HISTORY_FLAG_INTERPOLATE) ||
+      (guint64) position + 1 >= history->head)
+    return NULL;
+
+  next = record_at (history, position + 1);
+
+  // Nothing can be assumed across a discontinuity.
+  return next->flags & GST_ABSTS_RECORD_FLAG_DISCONT ? NULL : next;
+}
+// The wallclock of the frame at pts, from the last record at or before it. Returns FALSE if pts is
+// before the oldest record still in the history.
+gboolean
+gst_absolutetimestamps_history_lookup_wallclock (GstAbsolutetimestampsHistory * history,
+    GstClockTime pts, gint64 * wallclock)
+{
+  const GstAbsolutetimestampsRecord *entry, *next;
+  gint64 position;
+
+  g_mutex_lock (&history->lock);
+
+  position = find (history, pts, 0, FALSE);
+  if (position < 0) {
+    g_mutex_unlock (&history->lock);
+    return FALSE;
+  }
+
+  entry = record_at (history, position);
+  next = entry->pts != pts ? get_next (history, position) : NULL;
+  if (next && next->pts > entry->pts) {
+    gdouble fraction = (gdouble) (pts - entry->pts) / (gdouble) (next->pts - entry->pts);
+
+    *wallclock = entry->wallclock + (gint64) (fraction * (gdouble) (next->wallclock - entry->wallclock));
+  } else {
+    *wallclock = entry->wallclock + (gint64) (pts - entry->pts);
+  }
+
+  g_mutex_unlock (&history->lock);
+
+  return TRUE;
+}
+
+// The inverse of gst_absolutetimestamps_history_lookup_wallclock.
+gboolean
+gst_absolutetimestamps_history_lookup_pts (GstAbsolutetimestampsHistory * history,
+    gint64 wallclock, GstClockTime * pts)
+{
+  const GstAbsolutetimestampsRecord *entry, *next;
+  gint64 position;
+
+  g_mutex_lock (&history->lock);
+
+  position = find (history, 0, wallclock, TRUE);
+  if (position < 0) {
+    g_mutex_unlock (&history->lock);
+    return FALSE;
+  }
+
+  entry = record_at (history, position);
+  next = entry->wallclock != wallclock ? get_next (history, position) : NULL;
+  if (next && next->wallclock > entry->wallclock) {
+    gdouble fraction = (gdouble) (wallclock - entry->wallclock) /
+        (gdouble) (next->wallclock - entry->wallclock);
+
+    *pts = entry->pts + (guint64) (fraction * (gdouble) (next->pts - entry->pts));
+  } else {
+    *pts = entry->pts + (guint64) (wallclock - entry->wallclock);
+  }
+
+  g_mutex_unlock (&history->lock);
+
+  return TRUE;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_HISTORY_H_
+#define _GST_ABSOLUTETIMESTAMPS_HISTORY_H_
+
+#include "gstabsolutetimestampsrecord.h"
+
+G_BEGIN_DECLS
+
+// The custom query answered from the history, see gst_absolutetimestamps_query. It's sent with
+// either a "pts" (G_TYPE_UINT64) or a "wallclock" (G_TYPE_INT64) field and answered by setting the
+// other one.
+#define GST_ABSOLUTETIMESTAMPS_LOOKUP_QUERY "absolutetimestamps-lookup"
+
+// The history is kept, and dropped, in chunks of this many records.
+#define GST_ABSOLUTETIMESTAMPS_HISTORY_CHUNK_RECORDS 64
+// The memory each chunk takes, with its summary entry.
+#define GST_ABSOLUTETIMESTAMPS_HISTORY_CHUNK_SIZE \
+    (GST_ABSOLUTETIMESTAMPS_HISTORY_CHUNK_RECORDS * sizeof (GstAbsolutetimestampsRecord) + 16)
+
+typedef struct _GstAbsolutetimestampsHistory GstAbsolutetimestampsHistory;
+
+GstAbsolutetimestampsHistory *gst_absolutetimestamps_history_new (guint max_records,
+    guint64 max_bytes, gboolean interpolate, GError ** error);
+void gst_absolutetimestamps_history_free (GstAbsolutetimestampsHistory * history);
+
+void gst_absolutetimestamps_history_add (GstAbsolutetimestampsHistory * history,
+    const GstAbsolutetimestampsRecord * record);
+
+gboolean gst_absolutetimestamps_history_lookup_wallclock (GstAbsolutetimestampsHistory * history,
+    GstClockTime pts, gint64 * wallclock);
+gboolean gst_absolutetimestamps_history_lookup_pts (GstAbsolutetimestampsHistory * history,
+    gint64 wallclock, GstClockTime * pts);
+
+G_END_DECLS
+
+#endif
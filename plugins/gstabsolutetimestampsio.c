@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Writes the buffers of a GstAbsolutetimestampsOutput to its file.
+//
+// Where io_uring is available (see --with-io-uring in configure.ac) a write is submitted to the
+// kernel and the caller goes on filling a second buffer while it completes, so the writer thread
+// only blocks on the disk if it fills a whole buffer before the previous one is written. The two
+// buffers are registered with the ring, which saves the kernel mapping them on every write. Without
+// io_uring, or if the kernel doesn't have it, each write is a plain blocking pwrite from a single
+// buffer.
+//
+// There is never more than one write in flight, so they land in the order they were made, which
+// matters for files opened O_APPEND. Buffers are page-aligned either way so that the file can be
+// opened O_DIRECT.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// For O_DIRECT.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <sys/uio.h>
+#include <liburing.h>
+#endif
+
+#include "gstabsolutetimestampsio.h"
+
+struct _GstAbsolutetimestampsIo
+{
+  gsize buffer_size;
+  guint8 *buffers[2];
+  guint n_buffers;
+  guint current;                /* the buffer being filled */
+
+#ifdef HAVE_LIBURING
+  gboolean uring;
+  gboolean registered;          /* buffers registered with the ring, e.g. not over RLIMIT_MEMLOCK */
+  struct io_uring ring;
+
+  gboolean in_flight;
+  gint in_flight_fd;
+  const gchar *in_flight_filename;
+  guint in_flight_buffer;
+  gsize in_flight_length;
+  guint64 in_flight_offset;
+#endif
+};
+
+// Once a write has come up short, what's left of it is no longer aligned, which an O_DIRECT file
+// refuses. So the flag is dropped for the rest of it, and the file status flags to restore
+// afterwards returned, or -1 if there's nothing to restore.
+static gint
+drop_direct_io (gint fd)
+{
+#ifdef O_DIRECT
+  gint flags = fcntl (fd, F_GETFL);
+
+  if (flags != -1 && (flags & O_DIRECT) && fcntl (fd, F_SETFL, flags & ~O_DIRECT) == 0)
+    return flags;
+#endif
+
+  return -1;
+}
+
+// With resume, data is the rest of a write that came up short.
+static gboolean
+pwrite_fully (gint fd, const gchar * filename, const guint8 * data, gsize length,
+    guint64 offset, gboolean resume, GError ** error)
+{
+  gint restore_flags = resume ? drop_direct_io (fd) : -1;
+  gboolean result = TRUE;
+
+  while (length > 0) {
+    gssize written = pwrite (fd, data, length, offset);
+
+    if (written < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+          "Error while writing to file \"%s\": %s", filename, g_strerror (errno));
+      result = FALSE;
+      break;
+    }
+
+    data += written;
+    length -= written;
+    offset += written;
+
+    if (length > 0 && restore_flags == -1)
+      restore_flags = drop_direct_io (fd);
+  }
+
+  // The whole write is in, so the file ends on an aligned offset again.
+  if (restore_flags != -1)
+    fcntl (fd, F_SETFL, restore_flags);
+
+  return result;
+}
+
+// buffer_size is rounded up to GST_ABSOLUTETIMESTAMPS_IO_ALIGNMENT.
+GstAbsolutetimestampsIo *
+gst_absolutetimestamps_io_new (gsize buffer_size)
+{
+  GstAbsolutetimestampsIo *io = g_new0 (GstAbsolutetimestampsIo, 1);
+  guint i;
+
+  io->buffer_size = (buffer_size + GST_ABSOLUTETIMESTAMPS_IO_ALIGNMENT - 1) /
+      GST_ABSOLUTETIMESTAMPS_IO_ALIGNMENT * GST_ABSOLUTETIMESTAMPS_IO_ALIGNMENT;
+  io->n_buffers = 1;
+
+#ifdef HAVE_LIBURING
+  // Two entries are plenty with a single write in flight.
+  io->uring = io_uring_queue_init (2, &io->ring, 0) == 0;
+  if (io->uring)
+    io->n_buffers = 2;
+#endif
+
+  for (i = 0; i < io->n_buffers; i++) {
+    gpointer buffer;
+
+    if (posix_memalign (&buffer, GST_ABSOLUTETIMESTAMPS_IO_ALIGNMENT, io->buffer_size) != 0)
+      g_error ("Could not allocate %" G_GSIZE_FORMAT " bytes", io->buffer_size);
+    io->buffers[i] = buffer;
+  }
+
+#ifdef HAVE_LIBURING
+  if (io->uring) {
+    struct iovec iovecs[2];
+
+    for (i = 0; i < io->n_buffers; i++) {
+      iovecs[i].iov_base = io->buffers[i];
+      iovecs[i].iov_len = io->buffer_size;
+    }
+    io->registered = io_uring_register_buffers (&io->ring, iovecs, io->n_buffers) == 0;
+  }
+#endif
+
+  return io;
+}
+
+// Waits for a write still in flight, but doesn't report its errors.
+void
+gst_absolutetimestamps_io_free (GstAbsolutetimestampsIo * io)
+{
+  guint i;
+
+#ifdef HAVE_LIBURING
+  if (io->uring) {
+    gst_absolutetimestamps_io_wait (io, NULL);
+    io_uring_queue_exit (&io->ring);
+  }
+#endif
+
+  for (i = 0; i < io->n_buffers; i++)
+    free (io->buffers[i]);
+  g_free (io);
+}
+
+// "io_uring" or "pwrite", for the logs.
+const gchar *
+gst_absolutetimestamps_io_get_backend (GstAbsolutetimestampsIo * io)
+{
+#ifdef HAVE_LIBURING
+  if (io->uring)
+    return "io_uring";
+#endif
+
+  return "pwrite";
+}
+
+// The buffer to fill for the next write, of the buffer_size given to gst_absolutetimestamps_io_new
+// rounded up. It changes with every write.
+guint8 *
+gst_absolutetimestamps_io_get_buffer (GstAbsolutetimestampsIo * io)
+{
+  return io->buffers[io->current];
+}
+
+// Writes the first length bytes of the current buffer to fd at offset. With io_uring the write may
+// still be in flight when this returns, in which case its errors are reported by the next write or
+// wait.
+gboolean
+gst_absolutetimestamps_io_write (GstAbsolutetimestampsIo * io, gint fd, const gchar * filename,
+    gsize length, guint64 offset, GError ** error)
+{
+#ifdef HAVE_LIBURING
+  if (io->uring) {
+    struct io_uring_sqe *sqe;
+    gint result;
+
+    if (!gst_absolutetimestamps_io_wait (io, error))
+      return FALSE;
+    if (length == 0)
+      return TRUE;
+
+    sqe = io_uring_get_sqe (&io->ring);
+    if (io->registered)
+      io_uring_prep_write_fixed (sqe, fd, io->buffers[io->current], length, offset, io->current);
+    else
+      io_uring_prep_write (sqe, fd, io->buffers[io->current], length, offset);
+
+    result = io_uring_submit (&io->ring);
+    if (result < 0) {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (-result),
+          "Error while writing to file \"%s\": %s", filename, g_strerror (-result));
+      return FALSE;
+    }
+
+    io->in_flight = TRUE;
+    io->in_flight_fd = fd;
+    io->in_flight_filename = filename;
+    io->in_flight_buffer = io->current;
+    io->in_flight_length = length;
+    io->in_flight_offset = offset;
+    io->current = (io->current + 1) % io->n_buffers;
+
+    return TRUE;
+  }
+#endif
+
+  return pwrite_fully (fd, filename, io->buffers[io->current], length, offset, FALSE, error);
+}
+
+// Writes data from elsewhere than the buffers, once the write in flight is done.
+gboolean
+gst_absolutetimestamps_io_pwrite (GstAbsolutetimestampsIo * io, gint fd, const gchar * filename,
+    const guint8 * data, gsize length, guint64 offset, GError ** error)
+{
+  return gst_absolutetimestamps_io_wait (io, error) &&
+      pwrite_fully (fd, filename, data, length, offset, FALSE, error);
+}
+
+// Waits for the write in flight, if any, to complete. The file mustn't be closed, or written to any
+// other way, before this has been called.
+gboolean
+gst_absolutetimestamps_io_wait (GstAbsolutetimestampsIo * io, GError ** error)
+{
+#ifdef HAVE_LIBURING
+  struct io_uring_cqe *cqe;
+  gint result;
+
+  if (!io->uring || !io->in_flight)
+    return TRUE;
+
+  do
+    result = io_uring_wait_cqe (&io->ring, &cqe);
+  while (result == -EINTR);
+  if (result < 0) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (-result),
+        "Error while writing to file \"%s\": %s", io->in_flight_filename, g_strerror (-result));
+    return FALSE;
+  }
+
+  result = cqe->res;
+  io_uring_cqe_seen (&io->ring, cqe);
+  io->in_flight = FALSE;
+
+  if (result < 0) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (-result),
+        "Error while writing to file \"%s\": %s", io->in_flight_filename, g_strerror (-result));
+    return FALSE;
+  }
+
+  // A short write, e.g. on a full disk, is finished the slow way to get at its error.
+  if ((gsize) result < io->in_flight_length)
+    return pwrite_fully (io->in_flight_fd, io->in_flight_filename,
+        io->buffers[io->in_flight_buffer] + result, io->in_flight_length - result,
+        io->in_flight_offset + result, TRUE, error);
+#endif
+
+  return TRUE;
+}
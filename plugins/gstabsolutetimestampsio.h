@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_IO_H_
+#define _GST_ABSOLUTETIMESTAMPS_IO_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Of the buffers and, for direct I/O, of the offsets and lengths written. A page covers what
+// O_DIRECT asks for on all common filesystems.
+#define GST_ABSOLUTETIMESTAMPS_IO_ALIGNMENT 4096
+
+typedef struct _GstAbsolutetimestampsIo GstAbsolutetimestampsIo;
+
+GstAbsolutetimestampsIo *gst_absolutetimestamps_io_new (gsize buffer_size);
+void gst_absolutetimestamps_io_free (GstAbsolutetimestampsIo * io);
+
+const gchar *gst_absolutetimestamps_io_get_backend (GstAbsolutetimestampsIo * io);
+guint8 *gst_absolutetimestamps_io_get_buffer (GstAbsolutetimestampsIo * io);
+
+gboolean gst_absolutetimestamps_io_write (GstAbsolutetimestampsIo * io, gint fd,
+    const gchar * filename, gsize length, guint64 offset, GError ** error);
+gboolean gst_absolutetimestamps_io_pwrite (GstAbsolutetimestampsIo * io, gint fd,
+    const gchar * filename, const guint8 * data, gsize length, guint64 offset, GError ** error);
+gboolean gst_absolutetimestamps_io_wait (GstAbsolutetimestampsIo * io, GError ** error);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+
+#include "gstabsolutetimestampsmodel.h"
+
+void
+gst_absolutetimestamps_model_reset (GstAbsolutetimestampsModel * model)
+{
+  model->n = 0;
+  model->origin_pts = GST_CLOCK_TIME_NONE;
+  model->origin_wallclock = 0;
+  model->mean_x = 0;
+  model->mean_y = 0;
+  model->sxx = 0;
+  model->sxy = 0;
+  model->syy = 0;
+}
+
+void
+gst_absolutetimestamps_model_add (GstAbsolutetimestampsModel * model, GstClockTime pts,
+    gint64 wallclock)
+{
+  gdouble x, y, dx, dy;
+
+  if (model->n == 0) {
+    model->origin_pts = pts;
+    model->origin_wallclock = wallclock;
+  }
+
+  x = (gdouble) GST_CLOCK_DIFF (model->origin_pts, pts);
+  y = (gdouble) (wallclock - model->origin_wallclock);
+
+  model->n++;
+  dx = x - model->mean_x;
+  dy = y - model->mean_y;
+  model->mean_x += dx / model->n;
+  model->mean_y += dy / model->n;
+  model->sxx += dx * (x - model->mean_x);
+  model->sxy += dx * (y - model->mean_y);
+  model->syy += dy * (y - model->mean_y);
+}
+
+// Returns FALSE until there are samples at two distinct pts.
+gboolean
+gst_absolutetimestamps_model_get_slope (GstAbsolutetimestampsModel * model, gdouble * slope)
+{
+  if (model->n < 2 || model->sxx <= 0)
+    return FALSE;
+
+  *slope = model->sxy / model->sxx;
+
+  return TRUE;
+}
+
+// The fitted wallclock at pts, or with fewer than two samples that of the first sample extrapolated
+// at a slope of 1.
+gint64
+gst_absolutetimestamps_model_predict (GstAbsolutetimestampsModel * model, GstClockTime pts)
+{
+  gdouble slope = 1.0;
+  gdouble x = (gdouble) GST_CLOCK_DIFF (model->origin_pts, pts);
+
+  if (model->n == 0)
+    return 0;
+
+  gst_absolutetimestamps_model_get_slope (model, &slope);
+
+  return model->origin_wallclock + (gint64) llround (model->mean_y + slope * (x - model->mean_x));
+}
+
+// The root mean square, in nanoseconds, of how far the samples are from the fitted line.
+gdouble
+gst_absolutetimestamps_model_get_residual (GstAbsolutetimestampsModel * model)
+{
+  gdouble unexplained;
+
+  if (model->n < 2 || model->sxx <= 0)
+    return 0;
+
+  unexplained = model->syy - model->sxy * model->sxy / model->sxx;
+
+  return unexplained > 0 ? sqrt (unexplained / model->n) : 0;
+}
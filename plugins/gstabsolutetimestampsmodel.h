@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_MODEL_H_
+#define _GST_ABSOLUTETIMESTAMPS_MODEL_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstAbsolutetimestampsModel GstAbsolutetimestampsModel;
+
+// An incremental least-squares fit of wallclock = slope * pts + offset. Each sample costs a handful
+// of floating point operations and no memory. To keep the doubles precise over days of nanosecond
+// values, both axes are taken relative to the first sample and the sums are kept centered on the
+// running means (Welford's method) rather than as raw sums of squares.
+struct _GstAbsolutetimestampsModel
+{
+  guint64 n;
+  GstClockTime origin_pts;
+  gint64 origin_wallclock;
+
+  gdouble mean_x;
+  gdouble mean_y;
+  gdouble sxx;
+  gdouble sxy;
+  gdouble syy;
+};
+
+void gst_absolutetimestamps_model_reset (GstAbsolutetimestampsModel * model);
+void gst_absolutetimestamps_model_add (GstAbsolutetimestampsModel * model, GstClockTime pts,
+    gint64 wallclock);
+
+gboolean gst_absolutetimestamps_model_get_slope (GstAbsolutetimestampsModel * model,
+    gdouble * slope);
+gint64 gst_absolutetimestamps_model_predict (GstAbsolutetimestampsModel * model, GstClockTime pts);
+gdouble gst_absolutetimestamps_model_get_residual (GstAbsolutetimestampsModel * model);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,1184 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// For O_DIRECT.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include "gstabsolutetimestampsoutput.h"
+#include "gstabsolutetimestampscolumnar.h"
+
+// Big enough for any single encoded record.
+#define MIN_BUFFER_SIZE 4096
+// A flush ends the columnar row group, and groups of a few records take more space per record than
+// the binary format, so flush-policy only flushes a columnar file once the group has this many.
+#define MIN_COLUMNAR_FLUSH_RECORDS 256
+
+GType
+gst_absolutetimestamps_flush_policy_get_type (void)
+{
+  static gsize flush_policy_type = 0;
+
+  if (g_once_init_enter (&flush_policy_type)) {
+    static const GEnumValue flush_policies[] = {
+      {GST_ABSOLUTETIMESTAMPS_FLUSH_NONE, "Only when the buffer is full", "none"},
+      {GST_ABSOLUTETIMESTAMPS_FLUSH_RECORDS, "Every flush-records records", "every-n-records"},
+      {GST_ABSOLUTETIMESTAMPS_FLUSH_INTERVAL, "Every flush-interval milliseconds", "every-t-ms"},
+      {GST_ABSOLUTETIMESTAMPS_FLUSH_KEYFRAME, "After every keyframe", "on-keyframe"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsFlushPolicy", flush_policies);
+
+    g_once_init_leave (&flush_policy_type, type);
+  }
+
+  return flush_policy_type;
+}
+
+GType
+gst_absolutetimestamps_sink_get_type (void)
+{
+  static gsize sink_type = 0;
+
+  if (g_once_init_enter (&sink_type)) {
+    static const GEnumValue sinks[] = {
+      {GST_ABSOLUTETIMESTAMPS_SINK_FILE, "Write to the file given by location", "file"},
+      {GST_ABSOLUTETIMESTAMPS_SINK_UDP, "Send datagrams to the host:port given by location", "udp"},
+      {GST_ABSOLUTETIMESTAMPS_SINK_UNIX, "Send datagrams to the Unix domain socket given by location",
+          "unix"},
+      {GST_ABSOLUTETIMESTAMPS_SINK_SHM,
+          "Publish a ring in the POSIX shared memory object given by location", "shm"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsSink", sinks);
+
+    g_once_init_leave (&sink_type, type);
+  }
+
+  return sink_type;
+}
+
+static inline gboolean
+is_socket (GstAbsolutetimestampsOutput * output)
+{
+  return output->sink == GST_ABSOLUTETIMESTAMPS_SINK_UDP ||
+      output->sink == GST_ABSOLUTETIMESTAMPS_SINK_UNIX;
+}
+
+static inline gint64
+get_monotonic_time (void)
+{
+  return g_get_monotonic_time () * GST_USECOND;
+}
+
+GstAbsolutetimestampsOutput *
+gst_absolutetimestamps_output_new (void)
+{
+  GstAbsolutetimestampsOutput *output = g_new0 (GstAbsolutetimestampsOutput, 1);
+
+  output->fd = -1;
+  output->seek_index_fd = -1;
+
+  return output;
+}
+
+void
+gst_absolutetimestamps_output_free (GstAbsolutetimestampsOutput * output)
+{
+  if (output->fd != -1)
+    gst_absolutetimestamps_output_close (output, NULL);
+
+  g_free (output->filename);
+  g_free (output->current);
+  g_free (output->seek_index_current);
+  g_free (output->address);
+  g_free (output->shm_name);
+  g_free (output);
+}
+
+// Files are written from the buffers of output->io, the other sinks have one of their own.
+static void
+free_buffer (GstAbsolutetimestampsOutput * output)
+{
+  if (output->io) {
+    gst_absolutetimestamps_io_free (output->io);
+    output->io = NULL;
+  } else {
+    g_free (output->buffer);
+  }
+  output->buffer = NULL;
+}
+
+static void
+free_row_group (GstAbsolutetimestampsOutput * output)
+{
+  g_clear_pointer (&output->group_records, g_free);
+  if (output->footer) {
+    g_byte_array_unref (output->footer);
+    output->footer = NULL;
+  }
+}
+
+static gboolean
+write_fully (gint fd, const gchar * filename, const guint8 * data, gsize length, GError ** error)
+{
+  while (length > 0) {
+    gssize written = write (fd, data, length);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      // A non-blocking fd that's full, wait until it has room rather than spin.
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+
+        if (poll (&pfd, 1, -1) >= 0 || errno == EINTR)
+          continue;
+      }
+
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+          "Error while writing to file \"%s\": %s", filename, g_strerror (errno));
+      return FALSE;
+    }
+
+    data += written;
+    length -= written;
+  }
+
+  return TRUE;
+}
+
+// Like multifilesink, the pattern is used as a format string as-is.
+static gchar *
+format_filename (const gchar * pattern, guint index)
+{
+  if (strchr (pattern, '%') == NULL)
+    return g_strdup (pattern);
+
+  return g_strdup_printf (pattern, index);
+}
+
+static guint32
+header_flags (GstAbsolutetimestampsOutput * output)
+{
+  return (output->stream_ids || output->rows ? GST_ABSTS_HEADER_FLAG_STREAM_IDS : 0) |
+      (output->rows ? GST_ABSTS_HEADER_FLAG_ROWS : 0) |
+      (output->models ? GST_ABSTS_HEADER_FLAG_MODELS : 0) |
+      (output->markers ? GST_ABSTS_HEADER_FLAG_MARKERS : 0) |
+      (output->modes ? GST_ABSTS_HEADER_FLAG_MODES : 0) |
+      (output->clock_sync ? GST_ABSTS_HEADER_FLAG_SYNC : 0) | output->pts_domain |
+      output->fields << GST_ABSTS_HEADER_FIELDS_SHIFT;
+}
+
+// Sets file_first_pts to that of the first sample in the first n_blocks blocks of the file, which
+// are intact. It's nearly always in the very first one.
+static void
+resume_first_pts (GstAbsolutetimestampsOutput * output, guint64 n_blocks)
+{
+  guint64 block;
+  guint32 count, i;
+
+  for (block = 0; block < n_blocks; block++) {
+    if (pread (output->fd, output->buffer, GST_ABSTS_BLOCK_SIZE,
+            (off_t) (block + 1) * GST_ABSTS_BLOCK_SIZE) != GST_ABSTS_BLOCK_SIZE ||
+        !gst_absts_block_check (output->buffer, block, output->record_size, &count))
+      return;
+
+    for (i = 0; i < count; i++) {
+      const guint8 *record = output->buffer + GST_ABSTS_BLOCK_HEADER_SIZE + i * output->record_size;
+      guint64 pts = gst_absts_read_uint64_le (record);
+
+      if (GST_ABSTS_RECORD_TYPE (gst_absts_read_uint32_le (record + 16)) ==
+          GST_ABSTS_RECORD_TYPE_SAMPLE && GST_CLOCK_TIME_IS_VALID (pts)) {
+        output->file_first_pts = pts;
+        return;
+      }
+    }
+  }
+}
+
+// Whether the n bytes at the start of a file shorter than a block are what a writer killed while
+// writing the header block could have left: the start of the header, or zeros where the filesystem
+// extended the file before the data landed. Such a file has no records yet.
+static gboolean
+is_torn_header (const guint8 * data, gssize n)
+{
+  gssize i;
+
+  if (n < 0)
+    return FALSE;
+
+  if (memcmp (data, GST_ABSTS_BLOCK_LOG_MAGIC, MIN (n, GST_ABSTS_MAGIC_SIZE)) == 0)
+    return TRUE;
+
+  for (i = 0; i < n; i++)
+    if (data[i] != 0)
+      return FALSE;
+
+  return TRUE;
+}
+
+// Picks up a block log where an earlier run left it off: whatever is torn at its end is cut off and
+// the blocks are numbered on from the last intact one. Only that one is read, unless it's torn too.
+// A file whose header block never got written whole is started afresh.
+static gboolean
+resume_block_log (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  GstAbstsHeader header;
+  off_t length;
+  gssize n_read;
+  guint64 n_blocks;
+  guint32 count;
+
+  length = lseek (output->fd, 0, SEEK_END);
+  if (length == -1) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not read file \"%s\": %s", output->current, g_strerror (errno));
+    return FALSE;
+  }
+  if (length == 0)
+    return TRUE;
+
+  // output->buffer is empty and always has room for a block. Whole blocks are read for O_DIRECT.
+  n_read = pread (output->fd, output->buffer, GST_ABSTS_BLOCK_SIZE, 0);
+  if (length < GST_ABSTS_BLOCK_SIZE && is_torn_header (output->buffer, n_read)) {
+    if (ftruncate (output->fd, 0) == -1) {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+          "Could not truncate file \"%s\": %s", output->current, g_strerror (errno));
+      return FALSE;
+    }
+    return TRUE;
+  }
+  if (n_read < GST_ABSTS_HEADER_SIZE ||
+      !gst_absts_header_read_with_magic (output->buffer, GST_ABSTS_BLOCK_LOG_MAGIC, &header) ||
+      header.header_size != GST_ABSTS_BLOCK_SIZE) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+        "Could not append to file \"%s\": not a block timestamp log", output->current);
+    return FALSE;
+  }
+  // Different fields of the same size would come out mislabelled, so it's the field bits that count.
+  if (header.record_size != output->record_size ||
+      (header.flags & GST_ABSTS_HEADER_FIELDS_MASK) >> GST_ABSTS_HEADER_FIELDS_SHIFT != output->fields) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+        "Could not append to file \"%s\": it was written with other fields", output->current);
+    return FALSE;
+  }
+  // The header describes every record in the file, so the records of this run must fit it too.
+  if (header.flags != header_flags (output) || header.clock_source != output->clock_source ||
+      header.mode != output->mode) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+        "Could not append to file \"%s\": it was written with another clock-source, mode, "
+        "pts-domain or other record types", output->current);
+    return FALSE;
+  }
+
+  for (n_blocks = length > GST_ABSTS_BLOCK_SIZE ? (length - GST_ABSTS_BLOCK_SIZE) /
+      GST_ABSTS_BLOCK_SIZE : 0; n_blocks > 0; n_blocks--) {
+    if (pread (output->fd, output->buffer, GST_ABSTS_BLOCK_SIZE,
+            (off_t) n_blocks * GST_ABSTS_BLOCK_SIZE) == GST_ABSTS_BLOCK_SIZE &&
+        gst_absts_block_check (output->buffer, n_blocks - 1, output->record_size, &count))
+      break;
+  }
+
+  output->file_size = (n_blocks + 1) * GST_ABSTS_BLOCK_SIZE;
+  output->file_resumed = n_blocks > 0;
+  output->block_sequence = n_blocks;
+
+  // max-size-time counts from the start of the file, not from the restart.
+  if (output->max_duration > 0)
+    resume_first_pts (output, n_blocks);
+
+  if ((guint64) length != output->file_size && ftruncate (output->fd, output->file_size) == -1) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not truncate file \"%s\": %s", output->current, g_strerror (errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+// Opens the file for the current index. output->buffer must be empty.
+static gboolean
+open_file (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  gint flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+  g_free (output->current);
+  output->current = format_filename (output->filename, output->index);
+
+  // A block log is only ever appended to, with append=true even across runs.
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS)
+    flags = output->append ? O_RDWR | O_CREAT | O_APPEND : O_WRONLY | O_CREAT | O_TRUNC | O_APPEND;
+
+#ifdef O_DIRECT
+  // Only block logs are written in whole, aligned blocks. Filesystems that don't support it, e.g.
+  // tmpfs, refuse the flag, in which case the page cache it is.
+  if (output->direct_io && output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS) {
+    output->fd = g_open (output->current, flags | O_DIRECT, 0666);
+    if (output->fd == -1 && errno == EINVAL)
+      output->fd = g_open (output->current, flags, 0666);
+  } else
+#endif
+    output->fd = g_open (output->current, flags, 0666);
+
+  if (output->fd == -1) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not open file \"%s\" for writing: %s", output->current, g_strerror (errno));
+    return FALSE;
+  }
+
+  output->file_size = 0;
+  output->file_records = 0;
+  output->file_resumed = FALSE;
+  output->file_first_pts = GST_CLOCK_TIME_NONE;
+  output->block_count = 0;
+  output->block_sequence = 0;
+
+  // Every file is self-contained, so each one gets its own header.
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BINARY) {
+    gst_absts_header_write (output->buffer, gst_absolutetimestamps_clock_get_real_time (),
+        (GstAbstsClockSource) output->clock_source, header_flags (output), output->mode);
+    output->buffer_used = GST_ABSTS_HEADER_SIZE;
+  } else if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR) {
+    gst_absts_header_write_with_magic (output->buffer, GST_ABSTS_COLUMNAR_MAGIC,
+        gst_absolutetimestamps_clock_get_real_time (), (GstAbstsClockSource) output->clock_source,
+        header_flags (output), output->mode);
+    // Records are stored column by column in row groups rather than one by one.
+    gst_absts_write_uint16_le (output->buffer + 12, 0);
+    output->buffer_used = GST_ABSTS_HEADER_SIZE;
+    g_byte_array_set_size (output->footer, 0);
+  } else if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS) {
+    if (output->append && !resume_block_log (output, error)) {
+      close (output->fd);
+      output->fd = -1;
+      return FALSE;
+    }
+    // The header takes up a whole block, so that the blocks are aligned.
+    if (output->file_size == 0) {
+      memset (output->buffer, 0, GST_ABSTS_BLOCK_SIZE);
+      gst_absts_header_write_with_magic (output->buffer, GST_ABSTS_BLOCK_LOG_MAGIC,
+          gst_absolutetimestamps_clock_get_real_time (),
+          (GstAbstsClockSource) output->clock_source, header_flags (output), output->mode);
+      gst_absts_write_uint16_le (output->buffer + 10, GST_ABSTS_BLOCK_SIZE);
+      output->buffer_used = GST_ABSTS_BLOCK_SIZE;
+    }
+  }
+
+  if (output->seek_index) {
+    g_free (output->seek_index_current);
+    output->seek_index_current = g_strconcat (output->current, ".idx", NULL);
+
+    output->seek_index_fd = g_open (output->seek_index_current, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (output->seek_index_fd == -1) {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+          "Could not open file \"%s\" for writing: %s", output->seek_index_current,
+          g_strerror (errno));
+      close (output->fd);
+      output->fd = -1;
+      return FALSE;
+    }
+
+    gst_absts_index_header_write (output->seek_index_buffer,
+        (GstAbstsLogFormat) output->format);
+    output->seek_index_used = GST_ABSTS_INDEX_HEADER_SIZE;
+    output->next_seek_index_wallclock = G_MININT64;
+  }
+
+  return TRUE;
+}
+
+// Writes out the buffer, and then the seek index entries pointing into it, to the current file.
+static gboolean
+write_buffer (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  gboolean result;
+
+  result = gst_absolutetimestamps_io_write (output->io, output->fd, output->current,
+      output->buffer_used, output->file_size, error);
+  output->buffer = gst_absolutetimestamps_io_get_buffer (output->io);
+
+  output->file_size += output->buffer_used;
+  output->buffer_used = 0;
+  output->pending_records = 0;
+  output->last_flush = get_monotonic_time ();
+
+  if (result && output->sync_writes) {
+    result = gst_absolutetimestamps_io_wait (output->io, error);
+    if (result && fdatasync (output->fd) == -1) {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+          "Could not sync file \"%s\": %s", output->current, g_strerror (errno));
+      result = FALSE;
+    }
+  }
+
+  // Only once the records are written, so that the index never gets ahead of the log.
+  if (result && output->seek_index_used > 0) {
+    result = gst_absolutetimestamps_io_wait (output->io, error) &&
+        write_fully (output->seek_index_fd, output->seek_index_current, output->seek_index_buffer,
+        output->seek_index_used, error);
+    output->seek_index_used = 0;
+  }
+
+  return result;
+}
+
+/* blocks */
+
+// Starts a block at the end of the buffer.
+static gboolean
+open_block (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  if (output->buffer_size - output->buffer_used < GST_ABSTS_BLOCK_SIZE &&
+      !write_buffer (output, error))
+    return FALSE;
+
+  memset (output->buffer + output->buffer_used, 0, GST_ABSTS_BLOCK_SIZE);
+  output->block_start = output->buffer_used;
+  output->buffer_used += GST_ABSTS_BLOCK_HEADER_SIZE;
+
+  return TRUE;
+}
+
+// Ends the current block, which then takes up a whole GST_ABSTS_BLOCK_SIZE however full it is.
+static void
+seal_block (GstAbsolutetimestampsOutput * output)
+{
+  gst_absts_block_seal (output->buffer + output->block_start, output->block_sequence++,
+      output->block_count);
+  output->buffer_used = output->block_start + GST_ABSTS_BLOCK_SIZE;
+  output->block_count = 0;
+}
+
+/* columnar */
+
+// Encodes the records collected so far as a row group at the end of the buffer, and notes it for
+// the footer.
+static gboolean
+finish_row_group (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  guint8 entry[GST_ABSTS_ROW_GROUP_ENTRY_SIZE];
+  GstAbstsRowGroup group;
+
+  if (output->group_used == 0)
+    return TRUE;
+
+  if (output->buffer_size - output->buffer_used <
+      GST_ABSOLUTETIMESTAMPS_ROW_GROUP_MAX_SIZE (output->group_used) && !write_buffer (output, error))
+    return FALSE;
+
+  group.offset = output->file_size + output->buffer_used;
+  output->buffer_used += gst_absolutetimestamps_columnar_encode (output->buffer +
+      output->buffer_used, output->group_records, output->group_used, &group);
+  output->group_used = 0;
+
+  gst_absts_row_group_entry_write (entry, &group);
+  g_byte_array_append (output->footer, entry, sizeof (entry));
+
+  return TRUE;
+}
+
+// The footer goes at the very end, once everything else has been written.
+static gboolean
+write_footer (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  guint8 trailer[GST_ABSTS_COLUMNAR_TRAILER_SIZE];
+  gboolean result;
+
+  gst_absts_columnar_trailer_write (trailer, output->file_size,
+      output->footer->len / GST_ABSTS_ROW_GROUP_ENTRY_SIZE);
+  g_byte_array_append (output->footer, trailer, sizeof (trailer));
+
+  result = gst_absolutetimestamps_io_pwrite (output->io, output->fd, output->current,
+      output->footer->data, output->footer->len, output->file_size, error);
+  output->file_size += output->footer->len;
+  g_byte_array_set_size (output->footer, 0);
+
+  return result;
+}
+
+static gboolean
+close_file (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  gboolean result = TRUE;
+
+  if (output->buffer_used > 0 || output->group_used > 0)
+    result = gst_absolutetimestamps_output_flush (output, error);
+
+  if (result && output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR)
+    result = write_footer (output, error);
+
+  if (!gst_absolutetimestamps_io_wait (output->io, result ? error : NULL))
+    result = FALSE;
+
+  if (close (output->fd) != 0 && result) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Error closing file \"%s\": %s", output->current, g_strerror (errno));
+    result = FALSE;
+  }
+
+  output->fd = -1;
+
+  if (output->seek_index_fd != -1) {
+    if (close (output->seek_index_fd) != 0 && result) {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+          "Error closing file \"%s\": %s", output->seek_index_current, g_strerror (errno));
+      result = FALSE;
+    }
+
+    output->seek_index_fd = -1;
+  }
+
+  return result;
+}
+
+/* sockets */
+
+// Resolves the location, "host:port" for udp ("[address]:port" for a literal IPv6 address) or a
+// socket path for unix. Datagrams are sent with sendto() rather than on a connected socket, so that a
+// receiver that's missing at first, or restarts, picks up from the next datagram.
+static gboolean
+open_socket (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  gint family;
+
+  if (output->sink == GST_ABSOLUTETIMESTAMPS_SINK_UNIX) {
+    struct sockaddr_un *address;
+
+    if (strlen (output->filename) >= sizeof (address->sun_path)) {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NAMETOOLONG,
+          "Socket path \"%s\" is too long", output->filename);
+      return FALSE;
+    }
+
+    address = g_new0 (struct sockaddr_un, 1);
+    address->sun_family = AF_UNIX;
+    strcpy (address->sun_path, output->filename);
+    output->address = address;
+    output->address_length = sizeof (struct sockaddr_un);
+    family = AF_UNIX;
+  } else {
+    struct addrinfo hints = { 0 }, *result;
+    const gchar *colon = strrchr (output->filename, ':');
+    gchar *host;
+    gint status;
+
+    if (colon == NULL || colon == output->filename || colon[1] == '\0') {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+          "Location \"%s\" is not a host:port", output->filename);
+      return FALSE;
+    }
+
+    if (output->filename[0] == '[' && colon[-1] == ']')
+      host = g_strndup (output->filename + 1, colon - output->filename - 2);
+    else
+      host = g_strndup (output->filename, colon - output->filename);
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    status = getaddrinfo (host, colon + 1, &hints, &result);
+    g_free (host);
+
+    if (status != 0) {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+          "Could not resolve \"%s\": %s", output->filename, gai_strerror (status));
+      return FALSE;
+    }
+
+    output->address = g_malloc (result->ai_addrlen);
+    memcpy (output->address, result->ai_addr, result->ai_addrlen);
+    output->address_length = result->ai_addrlen;
+    family = result->ai_family;
+    freeaddrinfo (result);
+  }
+
+  output->fd = socket (family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+
+  if (output->fd == -1) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not create a socket for \"%s\": %s", output->filename, g_strerror (errno));
+    g_free (output->address);
+    output->address = NULL;
+    return FALSE;
+  }
+
+  output->datagram_sequence = 0;
+  output->buffer_start = GST_ABSTS_HEADER_SIZE;
+  output->buffer_used = output->buffer_start;
+
+  return TRUE;
+}
+
+// Sends the records in the buffer as one datagram. The writer must never wait for a receiver, so a
+// datagram that can't be delivered right now - no receiver yet, or one whose queue is full - is
+// dropped. Receivers can tell from the sequence numbers.
+static gboolean
+send_datagram (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  gssize sent;
+
+  gst_absts_datagram_header_write (output->buffer, (GstAbstsClockSource) output->clock_source,
+      header_flags (output), output->mode, output->datagram_sequence);
+
+  do {
+    sent = sendto (output->fd, output->buffer, output->buffer_used, MSG_DONTWAIT,
+        output->address, output->address_length);
+  } while (sent < 0 && errno == EINTR);
+
+  if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS &&
+      errno != ECONNREFUSED && errno != ENOENT) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Error while sending to \"%s\": %s", output->filename, g_strerror (errno));
+    return FALSE;
+  }
+
+  output->datagram_sequence += output->pending_records;
+  output->buffer_used = output->buffer_start;
+  output->pending_records = 0;
+  output->last_flush = get_monotonic_time ();
+
+  return TRUE;
+}
+
+/* shared memory */
+
+// Always a new object, so that consumers still attached to the ring of an earlier run see it closed
+// rather than having it change under them.
+static gboolean
+open_shm (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  guint32 capacity = 2;
+  gint fd;
+
+  while (capacity < output->shm_capacity && capacity < (1U << 30))
+    capacity <<= 1;
+
+  g_free (output->shm_name);
+  output->shm_name = output->filename[0] == '/' ? g_strdup (output->filename) :
+      g_strconcat ("/", output->filename, NULL);
+  output->shm_size = GST_ABSTS_SHM_HEADER_SIZE + (gsize) capacity * GST_ABSTS_SHM_SLOT_SIZE;
+
+  shm_unlink (output->shm_name);
+  fd = shm_open (output->shm_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+
+  if (fd == -1) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not create shared memory \"%s\": %s", output->shm_name, g_strerror (errno));
+    return FALSE;
+  }
+
+  if (ftruncate (fd, output->shm_size) != 0 ||
+      (output->shm = mmap (NULL, output->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))
+      == MAP_FAILED) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not map shared memory \"%s\": %s", output->shm_name, g_strerror (errno));
+    output->shm = NULL;
+    close (fd);
+    shm_unlink (output->shm_name);
+    return FALSE;
+  }
+
+  // A new object is all zeroes, so head and every slot's sequence start out as 0 - no record yet.
+  gst_absts_header_write_with_magic (output->shm, GST_ABSTS_SHM_MAGIC,
+      gst_absolutetimestamps_clock_get_real_time (), (GstAbstsClockSource) output->clock_source,
+      header_flags (output), output->mode);
+  gst_absts_write_uint16_le (output->shm + 10, GST_ABSTS_SHM_HEADER_SIZE);
+  gst_absts_write_uint32_le (output->shm + GST_ABSTS_SHM_CAPACITY_OFFSET, capacity);
+  gst_absts_write_uint32_le (output->shm + GST_ABSTS_SHM_SLOT_SIZE_OFFSET, GST_ABSTS_SHM_SLOT_SIZE);
+
+  output->fd = fd;
+  output->shm_mask = capacity - 1;
+  output->shm_head = 0;
+
+  return TRUE;
+}
+
+// The writer's half of the seqlock in gst_absts_shm_reader_next: the slot's sequence is n, which a
+// reader never expects in slot n % capacity, while the record is written, and n + 1 once it's done.
+static void
+push_shm (GstAbsolutetimestampsOutput * output, const GstAbsolutetimestampsRecord * record)
+{
+  guint32 n = output->shm_head;
+  guint8 *slot = output->shm + GST_ABSTS_SHM_HEADER_SIZE + (gsize) (n & output->shm_mask) *
+      GST_ABSTS_SHM_SLOT_SIZE;
+  volatile gint *sequence = (volatile gint *) slot;
+
+  g_atomic_int_set (sequence, (gint) n);
+  // Nothing of the new record may become visible before the slot is marked as being written.
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+
+  gst_absts_record_write (slot + GST_ABSTS_SHM_SLOT_RECORD_OFFSET, record->pts, record->wallclock,
+      record->flags & ~GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE, record->stream_id);
+
+  g_atomic_int_set (sequence, (gint) (n + 1));
+  output->shm_head = n + 1;
+  g_atomic_int_set ((volatile gint *) (output->shm + GST_ABSTS_SHM_HEAD_OFFSET), (gint) (n + 1));
+}
+
+// The object itself is left behind, consumers can still read the last records and the next run
+// replaces it.
+static gboolean
+close_shm (GstAbsolutetimestampsOutput * output)
+{
+  g_atomic_int_set ((volatile gint *) (output->shm + GST_ABSTS_SHM_CLOSED_OFFSET), 1);
+
+  munmap (output->shm, output->shm_size);
+  output->shm = NULL;
+  close (output->fd);
+  output->fd = -1;
+
+  return TRUE;
+}
+
+gboolean
+gst_absolutetimestamps_output_open (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  gboolean result;
+
+  output->buffer_start = 0;
+  output->buffer_used = 0;
+  output->pending_records = 0;
+  output->last_flush = get_monotonic_time ();
+  output->index = 0;
+
+  // Consumers of the other sinks get the binary records as they are, and there are no files to
+  // split or index.
+  if (output->sink != GST_ABSOLUTETIMESTAMPS_SINK_FILE) {
+    output->format = GST_ABSOLUTETIMESTAMPS_FORMAT_BINARY;
+    output->seek_index = FALSE;
+    output->max_size = 0;
+    output->max_duration = 0;
+    output->fields = 0;
+  }
+
+  // Row groups only have columns for the records themselves.
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR)
+    output->fields = 0;
+  output->record_size = gst_absts_record_size (header_flags (output));
+
+  // The footer of a columnar file is its index, and a block log is meant to be read back whole.
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR ||
+      output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS)
+    output->seek_index = FALSE;
+
+  // Carry on from the last file of an earlier run rather than the first.
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS && output->append &&
+      strchr (output->filename, '%') != NULL) {
+    while (TRUE) {
+      gchar *next = format_filename (output->filename, output->index + 1);
+      gboolean exists = g_file_test (next, G_FILE_TEST_EXISTS);
+
+      g_free (next);
+      if (!exists)
+        break;
+      output->index++;
+    }
+  }
+
+  gst_absolutetimestamps_text_formatter_init (&output->formatter, output->precision);
+
+  switch (output->sink) {
+    case GST_ABSOLUTETIMESTAMPS_SINK_UDP:
+    case GST_ABSOLUTETIMESTAMPS_SINK_UNIX:
+      output->buffer_size = GST_ABSTS_DATAGRAM_MAX_SIZE;
+      output->buffer = g_malloc (output->buffer_size);
+      result = open_socket (output, error);
+      break;
+    case GST_ABSOLUTETIMESTAMPS_SINK_SHM:
+      // Records go straight into the ring, there's nothing to buffer.
+      result = open_shm (output, error);
+      break;
+    default:
+      output->buffer_size = MAX (output->buffer_size, MIN_BUFFER_SIZE);
+      if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR) {
+        // A full row group has to fit in the buffer.
+        output->buffer_size = MAX (output->buffer_size,
+            GST_ABSOLUTETIMESTAMPS_ROW_GROUP_MAX_SIZE (GST_ABSTS_ROW_GROUP_MAX_RECORDS));
+        output->group_records = g_new (GstAbsolutetimestampsRecord, GST_ABSTS_ROW_GROUP_MAX_RECORDS);
+        output->group_used = 0;
+        output->footer = g_byte_array_new ();
+      } else if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS) {
+        // Blocks have to end exactly at the end of the buffer.
+        output->buffer_size = output->buffer_size / GST_ABSTS_BLOCK_SIZE * GST_ABSTS_BLOCK_SIZE;
+      }
+      output->io = gst_absolutetimestamps_io_new (output->buffer_size);
+      output->buffer = gst_absolutetimestamps_io_get_buffer (output->io);
+      result = open_file (output, error);
+      break;
+  }
+
+  if (!result) {
+    free_buffer (output);
+    free_row_group (output);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+// Closes the current file and starts the next one in the sequence.
+gboolean
+gst_absolutetimestamps_output_rotate (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  if (!close_file (output, error))
+    return FALSE;
+
+  output->index++;
+
+  return open_file (output, error);
+}
+
+// In a columnar file or a block log, a flush also ends the row group or block, so that everything
+// flushed can be read back.
+gboolean
+gst_absolutetimestamps_output_flush (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  if (is_socket (output))
+    return send_datagram (output, error);
+  if (output->sink == GST_ABSOLUTETIMESTAMPS_SINK_SHM)
+    return TRUE;
+
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR && !finish_row_group (output, error))
+    return FALSE;
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS && output->block_count > 0)
+    seal_block (output);
+
+  return write_buffer (output, error);
+}
+
+// Only evaluated when records are written, and by gst_absolutetimestamps_output_flush_if_due().
+// Only a writer thread calls that while no records arrive; on the streaming thread an every-t-ms
+// flush waits for the next record.
+static inline gboolean
+flush_is_due (GstAbsolutetimestampsOutput * output, const GstAbsolutetimestampsRecord * record)
+{
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR &&
+      output->group_used < MIN_COLUMNAR_FLUSH_RECORDS)
+    return FALSE;
+
+  switch (output->flush_policy) {
+    case GST_ABSOLUTETIMESTAMPS_FLUSH_RECORDS:
+      return output->pending_records >= output->flush_records;
+    case GST_ABSOLUTETIMESTAMPS_FLUSH_INTERVAL:
+      return get_monotonic_time () - output->last_flush >= (gint64) output->flush_interval;
+    case GST_ABSOLUTETIMESTAMPS_FLUSH_KEYFRAME:
+      return record != NULL && GST_ABSTS_RECORD_TYPE (record->flags) == GST_ABSTS_RECORD_TYPE_SAMPLE &&
+          !(record->flags & GST_ABSTS_RECORD_FLAG_DELTA_UNIT);
+    default:
+      return FALSE;
+  }
+}
+
+static inline gboolean
+rotation_is_due (GstAbsolutetimestampsOutput * output, const GstAbsolutetimestampsRecord * record)
+{
+  gsize record_size;
+
+  // Markers and model snapshots stay in the same file as the samples around them.
+  if (output->sink != GST_ABSOLUTETIMESTAMPS_SINK_FILE ||
+      (output->file_records == 0 && !output->file_resumed) ||
+      GST_ABSTS_RECORD_TYPE (record->flags) != GST_ABSTS_RECORD_TYPE_SAMPLE)
+    return FALSE;
+
+  if (record->flags & GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE)
+    return TRUE;
+
+  if (output->max_duration > 0 && GST_CLOCK_TIME_IS_VALID (output->file_first_pts) &&
+      record->pts >= output->file_first_pts &&
+      record->pts - output->file_first_pts >= output->max_duration)
+    return TRUE;
+
+  // For columnar the records still waiting for their row group aren't counted, so a file can go
+  // over max-size by up to one row group.
+  if (output->max_size > 0) {
+    record_size = output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_TEXT ?
+        GST_ABSOLUTETIMESTAMPS_LINE_SIZE + (output->fields ? GST_ABSOLUTETIMESTAMPS_FIELDS_SIZE : 0) :
+        output->record_size;
+    if (output->file_size + output->buffer_used + record_size > output->max_size)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+// Points an index entry at the record about to be encoded at the end of the buffer.
+static gboolean
+add_seek_index_entry (GstAbsolutetimestampsOutput * output,
+    const GstAbsolutetimestampsRecord * record, GError ** error)
+{
+  gint64 interval = (gint64) MAX (output->seek_index_interval, 1);
+
+  if (output->seek_index_used + GST_ABSTS_INDEX_ENTRY_SIZE > sizeof (output->seek_index_buffer) &&
+      !gst_absolutetimestamps_output_flush (output, error))
+    return FALSE;
+
+  gst_absts_index_entry_write (output->seek_index_buffer + output->seek_index_used,
+      record->wallclock, record->pts, output->file_size + output->buffer_used);
+  output->seek_index_used += GST_ABSTS_INDEX_ENTRY_SIZE;
+
+  // On whole multiples of the interval, e.g. at the start of every second.
+  output->next_seek_index_wallclock = (record->wallclock / interval + 1) * interval;
+
+  return TRUE;
+}
+
+// Appends record to the buffer in the binary encoding, with its fields if there are any. Only samples
+// have them, the fields of anything else are written as G_MAXUINT64.
+static inline void
+encode_record (GstAbsolutetimestampsOutput * output, const GstAbsolutetimestampsRecord * record)
+{
+  static const guint64 no_fields[GST_ABSTS_N_FIELDS] = { G_MAXUINT64, G_MAXUINT64, G_MAXUINT64,
+    G_MAXUINT64
+  };
+  guint8 *dest = output->buffer + output->buffer_used;
+
+  gst_absts_record_write (dest, record->pts, record->wallclock,
+      record->flags & ~GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE, record->stream_id);
+  if (output->fields)
+    gst_absts_fields_write (dest, output->fields << GST_ABSTS_HEADER_FIELDS_SHIFT,
+        GST_ABSTS_RECORD_TYPE (record->flags) == GST_ABSTS_RECORD_TYPE_SAMPLE ? record->fields :
+        no_fields);
+  output->buffer_used += output->record_size;
+}
+
+// Within a row, rotation and flushing are left to write_row so that the row stays in one piece.
+static gboolean
+write_record (GstAbsolutetimestampsOutput * output, const GstAbsolutetimestampsRecord * record,
+    gboolean in_row, GError ** error)
+{
+  if (output->sink == GST_ABSOLUTETIMESTAMPS_SINK_SHM) {
+    push_shm (output, record);
+    return TRUE;
+  }
+
+  if (!in_row && rotation_is_due (output, record) &&
+      !gst_absolutetimestamps_output_rotate (output, error))
+    return FALSE;
+
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_COLUMNAR) {
+    output->group_records[output->group_used++] = *record;
+    if (output->group_used == GST_ABSTS_ROW_GROUP_MAX_RECORDS &&
+        !finish_row_group (output, error))
+      return FALSE;
+    goto done;
+  }
+
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BLOCKS) {
+    if (output->block_count == 0 && !open_block (output, error))
+      return FALSE;
+    encode_record (output, record);
+    if (++output->block_count == GST_ABSTS_BLOCK_CAPACITY (output->record_size))
+      seal_block (output);
+    goto done;
+  }
+
+  // Make sure there's room for the longest possible encoding before encoding straight into the buffer.
+  if (output->buffer_size - output->buffer_used <
+      (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BINARY ? output->record_size :
+          GST_ABSOLUTETIMESTAMPS_LINE_SIZE + GST_ABSOLUTETIMESTAMPS_FIELDS_SIZE) &&
+      !gst_absolutetimestamps_output_flush (output, error))
+    return FALSE;
+
+  if (output->seek_index && record->wallclock >= output->next_seek_index_wallclock &&
+      GST_ABSTS_RECORD_TYPE (record->flags) == GST_ABSTS_RECORD_TYPE_SAMPLE &&
+      !add_seek_index_entry (output, record, error))
+    return FALSE;
+
+  if (output->format == GST_ABSOLUTETIMESTAMPS_FORMAT_BINARY) {
+    encode_record (output, record);
+  } else {
+    gsize length = gst_absolutetimestamps_text_formatter_format (&output->formatter, record);
+
+    // In text, the stream is a leading column.
+    if (output->stream_ids)
+      output->buffer_used += g_snprintf ((gchar *) output->buffer + output->buffer_used,
+          output->buffer_size - output->buffer_used, "%u ", record->stream_id);
+
+    memcpy (output->buffer + output->buffer_used, output->formatter.line, length);
+    output->buffer_used += length;
+
+    // The fields go at the end of the line, in place of its newline.
+    if (output->fields && GST_ABSTS_RECORD_TYPE (record->flags) == GST_ABSTS_RECORD_TYPE_SAMPLE) {
+      gchar *end = (gchar *) output->buffer + output->buffer_used - 1;
+
+      end += gst_absolutetimestamps_format_fields (end, output->fields, record);
+      *end++ = '\n';
+      output->buffer_used = (guint8 *) end - output->buffer;
+    }
+  }
+
+done:
+  output->pending_records++;
+  output->file_records++;
+  if (!GST_CLOCK_TIME_IS_VALID (output->file_first_pts) &&
+      GST_ABSTS_RECORD_TYPE (record->flags) == GST_ABSTS_RECORD_TYPE_SAMPLE)
+    output->file_first_pts = record->pts;
+
+  if (!in_row && flush_is_due (output, record))
+    return gst_absolutetimestamps_output_flush (output, error);
+
+  return TRUE;
+}
+
+gboolean
+gst_absolutetimestamps_output_write_record (GstAbsolutetimestampsOutput * output,
+    const GstAbsolutetimestampsRecord * record, GError ** error)
+{
+  return write_record (output, record, FALSE, error);
+}
+
+// Writes columns, each with its stream_id set, as one row sampled at wallclock. Columns whose pts is
+// GST_CLOCK_TIME_NONE had no buffer in the row: they're left blank in text and leave no record in
+// binary. The row as a whole is treated like its first record for rotation and the flush policy.
+gboolean
+gst_absolutetimestamps_output_write_row (GstAbsolutetimestampsOutput * output, gint64 wallclock,
+    const GstAbsolutetimestampsRecord * columns, guint n_columns, GError ** error)
+{
+  GstAbsolutetimestampsRecord row = { GST_CLOCK_TIME_NONE, wallclock, 0, 0 };
+  guint i;
+
+  for (i = 0; i < n_columns && !GST_CLOCK_TIME_IS_VALID (row.pts); i++) {
+    row.pts = columns[i].pts;
+    row.flags = columns[i].flags;
+    row.stream_id = columns[i].stream_id;
+  }
+  if (!GST_CLOCK_TIME_IS_VALID (row.pts))
+    return TRUE;
+
+  if (rotation_is_due (output, &row) && !gst_absolutetimestamps_output_rotate (output, error))
+    return FALSE;
+
+  if (output->format != GST_ABSOLUTETIMESTAMPS_FORMAT_TEXT) {
+    gboolean first = TRUE;
+
+    for (i = 0; i < n_columns; i++) {
+      GstAbsolutetimestampsRecord record = columns[i];
+
+      if (!GST_CLOCK_TIME_IS_VALID (record.pts))
+        continue;
+
+      record.wallclock = wallclock;
+      record.flags &= ~GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE;
+      if (first)
+        record.flags |= GST_ABSTS_RECORD_FLAG_ROW;
+      first = FALSE;
+
+      if (!write_record (output, &record, TRUE, error))
+        return FALSE;
+    }
+  } else {
+    gsize size = GST_ABSOLUTETIMESTAMPS_ROW_SIZE (n_columns);
+
+    if (output->buffer_size - output->buffer_used < size) {
+      if (!gst_absolutetimestamps_output_flush (output, error))
+        return FALSE;
+      // Only for a very wide row, the buffer is normally far bigger than any row.
+      if (output->buffer_size < size) {
+        if (!gst_absolutetimestamps_io_wait (output->io, error))
+          return FALSE;
+        gst_absolutetimestamps_io_free (output->io);
+        output->io = gst_absolutetimestamps_io_new (size);
+        output->buffer = gst_absolutetimestamps_io_get_buffer (output->io);
+        output->buffer_size = size;
+      }
+    }
+
+    if (output->seek_index && wallclock >= output->next_seek_index_wallclock &&
+        !add_seek_index_entry (output, &row, error))
+      return FALSE;
+
+    output->buffer_used += gst_absolutetimestamps_text_formatter_format_row (&output->formatter,
+        (gchar *) output->buffer + output->buffer_used, wallclock, columns, n_columns);
+
+    output->pending_records++;
+    output->file_records++;
+    if (!GST_CLOCK_TIME_IS_VALID (output->file_first_pts))
+      output->file_first_pts = row.pts;
+  }
+
+  if (flush_is_due (output, &row))
+    return gst_absolutetimestamps_output_flush (output, error);
+
+  return TRUE;
+}
+
+// For callers that wake up periodically, e.g. the writer thread, so that a time-based flush still
+// happens if the stream stalls. Also called at the end of each batch of records, which for the socket
+// sinks is when a datagram goes out.
+gboolean
+gst_absolutetimestamps_output_flush_if_due (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  if (output->buffer_used == output->buffer_start && output->group_used == 0)
+    return TRUE;
+
+  if (is_socket (output))
+    return send_datagram (output, error);
+
+  if (output->flush_policy != GST_ABSOLUTETIMESTAMPS_FLUSH_INTERVAL)
+    return TRUE;
+
+  if (!flush_is_due (output, NULL))
+    return TRUE;
+
+  return gst_absolutetimestamps_output_flush (output, error);
+}
+
+gboolean
+gst_absolutetimestamps_output_close (GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  gboolean result;
+
+  if (output->fd == -1)
+    return TRUE;
+
+  switch (output->sink) {
+    case GST_ABSOLUTETIMESTAMPS_SINK_UDP:
+    case GST_ABSOLUTETIMESTAMPS_SINK_UNIX:
+      result = output->buffer_used == output->buffer_start || send_datagram (output, error);
+      close (output->fd);
+      output->fd = -1;
+      break;
+    case GST_ABSOLUTETIMESTAMPS_SINK_SHM:
+      result = close_shm (output);
+      break;
+    default:
+      result = close_file (output, error);
+      break;
+  }
+
+  free_buffer (output);
+  free_row_group (output);
+
+  return result;
+}
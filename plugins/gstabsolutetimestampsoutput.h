@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_OUTPUT_H_
+#define _GST_ABSOLUTETIMESTAMPS_OUTPUT_H_
+
+#include "gstabsolutetimestampsclock.h"
+#include "gstabsolutetimestampsformat.h"
+#include "gstabsolutetimestampsio.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ABSOLUTETIMESTAMPS_FLUSH_POLICY (gst_absolutetimestamps_flush_policy_get_type())
+
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_FLUSH_NONE,
+  GST_ABSOLUTETIMESTAMPS_FLUSH_RECORDS,
+  GST_ABSOLUTETIMESTAMPS_FLUSH_INTERVAL,
+  GST_ABSOLUTETIMESTAMPS_FLUSH_KEYFRAME
+} GstAbsolutetimestampsFlushPolicy;
+
+#define GST_TYPE_ABSOLUTETIMESTAMPS_SINK (gst_absolutetimestamps_sink_get_type())
+
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_SINK_FILE,
+  GST_ABSOLUTETIMESTAMPS_SINK_UDP,
+  GST_ABSOLUTETIMESTAMPS_SINK_UNIX,
+  GST_ABSOLUTETIMESTAMPS_SINK_SHM
+} GstAbsolutetimestampsSink;
+
+// Room for 170 seek index entries, i.e. nearly three minutes at one a second, between flushes.
+#define GST_ABSOLUTETIMESTAMPS_SEEK_INDEX_BUFFER_SIZE 4096
+
+typedef struct _GstAbsolutetimestampsOutput GstAbsolutetimestampsOutput;
+
+// The timestamp mapping file. Encoded records are accumulated in an owned buffer and handed to the
+// kernel with a single write() per batch - when the buffer fills up, when the flush policy says so
+// and when the output is closed.
+//
+// The output can also be split across a sequence of files - if filename contains a printf-style
+// integer conversion, e.g. "timestamps-%05d.log", it's formatted with the index of each file. A new
+// file is started when the current one would grow beyond max_size bytes, when it spans more than
+// max_duration of pts or when a record carries GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE.
+//
+// With fields, each sample carries more of its buffer than the pts: in binary and blocks as extra
+// u64s after every record (see gstabstsformat.h), in text as " name=value" pairs at the end of its
+// line. Columnar and the other sinks leave them out.
+//
+// With seek_index, each file gets a "<file>.idx" seek index too, see gstabstsformat.h. Its entries are
+// written after the records they point at, so an index never points past the end of its log.
+//
+// Instead of a file, sink can send the records live over a socket or publish them in shared memory,
+// always in the binary encoding and without rotation or seek index (see gstabstsformat.h):
+//  - udp and unix batch records into datagrams sent to filename, "host:port" or a socket path. A
+//    datagram is sent when it's full, when the flush policy says so and at the end of every batch
+//    handed over at once, e.g. every drain of the ring by the writer thread.
+//  - shm writes each record straight into a ring of shm_capacity slots in the POSIX shared memory
+//    object named filename, where consumers can pick it up without any system calls.
+//
+// Instead of one record at a time, rows of records from several streams sharing a wallclock can be
+// written with gst_absolutetimestamps_output_write_row - as one line per row in text, see
+// gst_absolutetimestamps_text_formatter_format_row, and as a run of records in binary, see
+// GST_ABSTS_HEADER_FLAG_ROWS. A row is never split across files.
+//
+// The settings fields are filled in by the owner before gst_absolutetimestamps_output_open; the
+// rest is private. An output is only ever used from one thread at a time.
+struct _GstAbsolutetimestampsOutput
+{
+  /* settings */
+  GstAbsolutetimestampsSink sink;
+  gchar *filename;
+  guint64 max_size;             /* 0 = unlimited */
+  GstClockTime max_duration;    /* 0 = unlimited */
+  GstAbsolutetimestampsFormat format;
+  GstAbsolutetimestampsPrecision precision;
+  GstAbsolutetimestampsClockSource clock_source;
+  gsize buffer_size;
+  GstAbsolutetimestampsFlushPolicy flush_policy;
+  guint flush_records;
+  GstClockTime flush_interval;
+  gboolean stream_ids;          /* records from several streams, tag each with its stream_id */
+  gboolean rows;                /* written with write_row rather than write_record, implies stream_ids */
+  GstAbstsMode mode;            /* recorded in the header, the output itself writes what it's given */
+  gboolean models;              /* model snapshots are interleaved with the samples */
+  gboolean markers;             /* segment and flush markers are interleaved with the samples */
+  gboolean modes;               /* mode records may change the mode along the way */
+  gboolean clock_sync;          /* clock-sync reports are interleaved with the samples */
+  guint32 pts_domain;           /* GST_ABSTS_HEADER_FLAG_RUNNING_TIME, _STREAM_TIME or 0 for raw pts */
+  gboolean seek_index;
+  GstClockTime seek_index_interval;     /* of wallclock between index entries */
+  guint shm_capacity;           /* records, rounded up to a power of two */
+  gboolean append;              /* blocks: resume an existing log rather than truncate it */
+  gboolean sync_writes;         /* fdatasync after every write to a file */
+  gboolean direct_io;           /* blocks: open the file O_DIRECT */
+  guint fields;                 /* GstAbsolutetimestampsFields to write after each sample, file only */
+
+  /* state */
+  gint fd;
+  gchar *current;
+  guint index;
+  guint64 file_size;
+  guint file_records;           /* written to the current file by this run */
+  gboolean file_resumed;        /* blocks: the current file already held records of an earlier run */
+  GstClockTime file_first_pts;
+  gsize record_size;            /* binary and blocks: of each record, with its fields */
+  GstAbsolutetimestampsIo *io;  /* writes the buffer to the file, NULL for the other sinks */
+  guint8 *buffer;
+  gsize buffer_start;           /* room kept in front of the records for a datagram header */
+  gsize buffer_used;
+  guint pending_records;
+  gint64 last_flush;
+  GstAbsolutetimestampsTextFormatter formatter;
+
+  gint seek_index_fd;
+  gchar *seek_index_current;
+  gint64 next_seek_index_wallclock;
+  gsize seek_index_used;
+  guint8 seek_index_buffer[GST_ABSOLUTETIMESTAMPS_SEEK_INDEX_BUFFER_SIZE];
+
+  gpointer address;             /* the struct sockaddr datagrams are sent to */
+  gsize address_length;
+  guint64 datagram_sequence;
+
+  guint8 *shm;
+  gsize shm_size;
+  gchar *shm_name;
+  guint32 shm_mask;
+  guint32 shm_head;
+
+  GstAbsolutetimestampsRecord *group_records;   /* columnar: the records of the row group being built */
+  guint group_used;
+  GByteArray *footer;           /* columnar: an entry for each row group written to the current file */
+
+  gsize block_start;            /* blocks: offset in the buffer of the open block */
+  guint32 block_count;          /* records in the open block, 0 if there isn't one */
+  guint32 block_sequence;       /* of the next block */
+};
+
+GType gst_absolutetimestamps_flush_policy_get_type (void);
+GType gst_absolutetimestamps_sink_get_type (void);
+
+GstAbsolutetimestampsOutput *gst_absolutetimestamps_output_new (void);
+void gst_absolutetimestamps_output_free (GstAbsolutetimestampsOutput * output);
+
+gboolean gst_absolutetimestamps_output_open (GstAbsolutetimestampsOutput * output,
+    GError ** error);
+gboolean gst_absolutetimestamps_output_write_record (GstAbsolutetimestampsOutput * output,
+    const GstAbsolutetimestampsRecord * record, GError ** error);
+gboolean gst_absolutetimestamps_output_write_row (GstAbsolutetimestampsOutput * output,
+    gint64 wallclock, const GstAbsolutetimestampsRecord * columns, guint n_columns, GError ** error);
+gboolean gst_absolutetimestamps_output_flush_if_due (GstAbsolutetimestampsOutput * output,
+    GError ** error);
+gboolean gst_absolutetimestamps_output_flush (GstAbsolutetimestampsOutput * output,
+    GError ** error);
+gboolean gst_absolutetimestamps_output_rotate (GstAbsolutetimestampsOutput * output,
+    GError ** error);
+gboolean gst_absolutetimestamps_output_close (GstAbsolutetimestampsOutput * output,
+    GError ** error);
+
+G_END_DECLS
+
+#endif
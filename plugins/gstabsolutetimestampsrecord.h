@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_RECORD_H_
+#define _GST_ABSOLUTETIMESTAMPS_RECORD_H_
+
+#include <gst/gst.h>
+
+#include "gstabstsformat.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstAbsolutetimestampsRecord GstAbsolutetimestampsRecord;
+
+// A single entry of the timestamp mapping, captured on the streaming thread and
+// formatted later by whoever writes it out. Keep this fixed-size and free of
+// pointers so that it can be copied by value into the writer ring.
+struct _GstAbsolutetimestampsRecord
+{
+  GstClockTime pts;
+  gint64 wallclock;             /* nanoseconds since the epoch */
+  guint32 flags;                /* GST_ABSTS_RECORD_FLAG_* */
+  guint32 stream_id;            /* only meaningful within a writer group */
+  // Indexed by GstAbstsField. Only filled in for samples, and only those the output was asked for.
+  guint64 fields[GST_ABSTS_N_FIELDS];
+};
+
+// Internal to the element and never written out: asks the writer to start a new file with this
+// record, so that a rotation stays in order with the records around it however they're queued.
+#define GST_ABSOLUTETIMESTAMPS_RECORD_FLAG_ROTATE (1 << 23)
+
+G_END_DECLS
+
+#endif
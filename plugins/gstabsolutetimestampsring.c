@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// A bounded single-producer/single-consumer queue of records. The streaming
+// thread is the only producer and the writer thread the only consumer, so the
+// two indices can be published with plain atomic loads and stores - no locks
+// are ever taken on either side.
+//
+// The indices run freely and are masked on access, which is why the capacity is
+// always a power of two. head and tail are kept on separate cache lines so that
+// the producer and consumer don't keep stealing the same line from each other.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstabsolutetimestampsring.h"
+
+#define CACHE_LINE_SIZE 64
+
+struct _GstAbsolutetimestampsRing
+{
+  volatile gint head;           /* next slot to write, owned by the producer */
+  gchar head_padding[CACHE_LINE_SIZE - sizeof (gint)];
+
+  volatile gint tail;           /* next slot to read, owned by the consumer */
+  gchar tail_padding[CACHE_LINE_SIZE - sizeof (gint)];
+
+  guint capacity;
+  guint mask;
+  GstAbsolutetimestampsRecord *slots;
+};
+
+GstAbsolutetimestampsRing *
+gst_absolutetimestamps_ring_new (guint capacity)
+{
+  GstAbsolutetimestampsRing *ring;
+  guint size = 2;
+
+  // Round up to the next power of two (G_MAXINT / 2 + 1 keeps head - tail representable).
+  capacity = CLAMP (capacity, 2, (guint) G_MAXINT / 2 + 1);
+  while (size < capacity)
+    size <<= 1;
+
+  ring = g_new0 (GstAbsolutetimestampsRing, 1);
+  ring->capacity = size;
+  ring->mask = size - 1;
+  ring->slots = g_new (GstAbsolutetimestampsRecord, size);
+
+  return ring;
+}
+
+void
+gst_absolutetimestamps_ring_free (GstAbsolutetimestampsRing * ring)
+{
+  g_free (ring->slots);
+  g_free (ring);
+}
+
+guint
+gst_absolutetimestamps_ring_get_capacity (GstAbsolutetimestampsRing * ring)
+{
+  return ring->capacity;
+}
+
+// How many records are queued. Only exact from the producer's side, where head can't move, and
+// even then the consumer may already be taking some.
+guint
+gst_absolutetimestamps_ring_get_length (GstAbsolutetimestampsRing * ring)
+{
+  guint head = (guint) g_atomic_int_get (&ring->head);
+  guint tail = (guint) g_atomic_int_get (&ring->tail);
+
+  return head - tail;
+}
+
+// Returns FALSE, without blocking, if the ring is full.
+gboolean
+gst_absolutetimestamps_ring_push (GstAbsolutetimestampsRing * ring,
+    const GstAbsolutetimestampsRecord * record)
+{
+  guint head = (guint) ring->head;
+  guint tail = (guint) g_atomic_int_get (&ring->tail);
+
+  if (head - tail >= ring->capacity)
+    return FALSE;
+
+  ring->slots[head & ring->mask] = *record;
+
+  // The store must not become visible before the slot has been filled in.
+  g_atomic_int_set (&ring->head, (gint) (head + 1));
+
+  return TRUE;
+}
+
+// Returns FALSE if the ring is empty.
+gboolean
+gst_absolutetimestamps_ring_pop (GstAbsolutetimestampsRing * ring,
+    GstAbsolutetimestampsRecord * record)
+{
+  guint tail = (guint) ring->tail;
+  guint head = (guint) g_atomic_int_get (&ring->head);
+
+  if (head == tail)
+    return FALSE;
+
+  *record = ring->slots[tail & ring->mask];
+
+  g_atomic_int_set (&ring->tail, (gint) (tail + 1));
+
+  return TRUE;
+}
+
+gboolean
+gst_absolutetimestamps_ring_is_empty (GstAbsolutetimestampsRing * ring)
+{
+  return g_atomic_int_get (&ring->head) == g_atomic_int_get (&ring->tail);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_RING_H_
+#define _GST_ABSOLUTETIMESTAMPS_RING_H_
+
+#include "gstabsolutetimestampsrecord.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstAbsolutetimestampsRing GstAbsolutetimestampsRing;
+
+GstAbsolutetimestampsRing *gst_absolutetimestamps_ring_new (guint capacity);
+void gst_absolutetimestamps_ring_free (GstAbsolutetimestampsRing * ring);
+
+guint gst_absolutetimestamps_ring_get_capacity (GstAbsolutetimestampsRing * ring);
+guint gst_absolutetimestamps_ring_get_length (GstAbsolutetimestampsRing * ring);
+
+gboolean gst_absolutetimestamps_ring_push (GstAbsolutetimestampsRing * ring,
+    const GstAbsolutetimestampsRecord * record);
+gboolean gst_absolutetimestamps_ring_pop (GstAbsolutetimestampsRing * ring,
+    GstAbsolutetimestampsRecord * record);
+gboolean gst_absolutetimestamps_ring_is_empty (GstAbsolutetimestampsRing * ring);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstabsolutetimestampsstats.h"
+
+static void
+histogram_reset (GstAbsolutetimestampsHistogram * histogram)
+{
+  gint i;
+
+  for (i = 0; i < GST_ABSOLUTETIMESTAMPS_HISTOGRAM_BUCKETS; i++)
+    g_atomic_int_set (&histogram->buckets[i], 0);
+
+  histogram->count = 0;
+  histogram->sum = 0;
+  histogram->min = G_MAXUINT64;
+  histogram->max = 0;
+}
+
+void
+gst_absolutetimestamps_histogram_add (GstAbsolutetimestampsHistogram * histogram, guint64 value)
+{
+  gint bucket = value == 0 ? 0 : 64 - __builtin_clzll (value);
+
+  g_atomic_int_inc (&histogram->buckets[bucket]);
+
+  histogram->count++;
+  histogram->sum += value;
+  if (value < histogram->min)
+    histogram->min = value;
+  if (value > histogram->max)
+    histogram->max = value;
+}
+
+// Returns the upper bound of the bucket containing the q'th quantile.
+static guint64
+histogram_quantile (GstAbsolutetimestampsHistogram * histogram, gdouble q)
+{
+  guint64 counts[GST_ABSOLUTETIMESTAMPS_HISTOGRAM_BUCKETS];
+  guint64 total = 0, target, seen = 0;
+  gint i;
+
+  for (i = 0; i < GST_ABSOLUTETIMESTAMPS_HISTOGRAM_BUCKETS; i++) {
+    counts[i] = (guint) g_atomic_int_get (&histogram->buckets[i]);
+    total += counts[i];
+  }
+
+  if (total == 0)
+    return 0;
+
+  target = (guint64) (q * total);
+  for (i = 0; i < GST_ABSOLUTETIMESTAMPS_HISTOGRAM_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen > target)
+      break;
+  }
+
+  if (i == 0)
+    return 0;
+
+  return i >= 64 ? G_MAXUINT64 : (G_GUINT64_CONSTANT (1) << i) - 1;
+}
+
+static void
+histogram_to_structure (GstAbsolutetimestampsHistogram * histogram, GstStructure * structure,
+    const gchar * prefix)
+{
+  gchar *count = g_strdup_printf ("%s-count", prefix);
+  gchar *min = g_strdup_printf ("%s-min", prefix);
+  gchar *max = g_strdup_printf ("%s-max", prefix);
+  gchar *mean = g_strdup_printf ("%s-mean", prefix);
+  gchar *p50 = g_strdup_printf ("%s-p50", prefix);
+  gchar *p99 = g_strdup_printf ("%s-p99", prefix);
+  gchar *p999 = g_strdup_printf ("%s-p999", prefix);
+  guint64 n = histogram->count;
+
+  gst_structure_set (structure,
+      count, G_TYPE_UINT64, n,
+      min, G_TYPE_UINT64, n > 0 ? histogram->min : (guint64) 0,
+      max, G_TYPE_UINT64, histogram->max,
+      mean, G_TYPE_UINT64, n > 0 ? histogram->sum / n : (guint64) 0,
+      p50, G_TYPE_UINT64, histogram_quantile (histogram, 0.5),
+      p99, G_TYPE_UINT64, histogram_quantile (histogram, 0.99),
+      p999, G_TYPE_UINT64, histogram_quantile (histogram, 0.999), NULL);
+
+  g_free (count);
+  g_free (min);
+  g_free (max);
+  g_free (mean);
+  g_free (p50);
+  g_free (p99);
+  g_free (p999);
+}
+
+void
+gst_absolutetimestamps_stats_reset (GstAbsolutetimestampsStats * stats)
+{
+  histogram_reset (&stats->self_time);
+  histogram_reset (&stats->late);
+  histogram_reset (&stats->early);
+  histogram_reset (&stats->jitter);
+
+  stats->previous_pts = GST_CLOCK_TIME_NONE;
+  stats->previous_arrival = 0;
+}
+
+// arrival is a monotonic time in nanoseconds. Returns the jitter recorded, 0 for the first buffer.
+guint64
+gst_absolutetimestamps_stats_add_arrival (GstAbsolutetimestampsStats * stats, GstClockTime pts,
+    gint64 arrival)
+{
+  guint64 jitter = 0;
+
+  if (GST_CLOCK_TIME_IS_VALID (stats->previous_pts)) {
+    gint64 delta = (arrival - stats->previous_arrival) - ((gint64) pts - (gint64) stats->previous_pts);
+
+    jitter = (guint64) ABS (delta);
+    gst_absolutetimestamps_histogram_add (&stats->jitter, jitter);
+  }
+
+  stats->previous_pts = pts;
+  stats->previous_arrival = arrival;
+
+  return jitter;
+}
+
+void
+gst_absolutetimestamps_stats_add_skew (GstAbsolutetimestampsStats * stats, GstClockTimeDiff skew)
+{
+  if (skew >= 0)
+    gst_absolutetimestamps_histogram_add (&stats->late, (guint64) skew);
+  else
+    gst_absolutetimestamps_histogram_add (&stats->early, (guint64) - skew);
+}
+
+// All values are in nanoseconds. The percentiles are the upper bounds of the buckets they fall in, so
+// they're accurate to within a factor of two.
+GstStructure *
+gst_absolutetimestamps_stats_to_structure (GstAbsolutetimestampsStats * stats, const gchar * name)
+{
+  GstStructure *structure = gst_structure_new_empty (name);
+
+  histogram_to_structure (&stats->self_time, structure, "self-time");
+  histogram_to_structure (&stats->late, structure, "late");
+  histogram_to_structure (&stats->early, structure, "early");
+  histogram_to_structure (&stats->jitter, structure, "jitter");
+
+  return structure;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_STATS_H_
+#define _GST_ABSOLUTETIMESTAMPS_STATS_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// Bucket i counts values needing i bits, i.e. in [2^(i-1), 2^i), with bucket 0 counting zero.
+#define GST_ABSOLUTETIMESTAMPS_HISTOGRAM_BUCKETS 65
+
+typedef struct _GstAbsolutetimestampsHistogram GstAbsolutetimestampsHistogram;
+typedef struct _GstAbsolutetimestampsStats GstAbsolutetimestampsStats;
+
+// A log2-bucketed histogram of nanosecond values. Only ever added to from the streaming thread, so
+// the buckets only need atomic stores (for readers on other threads) rather than locks.
+struct _GstAbsolutetimestampsHistogram
+{
+  volatile gint buckets[GST_ABSOLUTETIMESTAMPS_HISTOGRAM_BUCKETS];
+  guint64 count;
+  guint64 sum;
+  guint64 min;
+  guint64 max;
+};
+
+struct _GstAbsolutetimestampsStats
+{
+  GstAbsolutetimestampsHistogram self_time;     /* time spent in transform_ip */
+  GstAbsolutetimestampsHistogram late;          /* arrival after base_time + running_time */
+  GstAbsolutetimestampsHistogram early;         /* arrival before base_time + running_time */
+  GstAbsolutetimestampsHistogram jitter;        /* inter-arrival time minus pts delta */
+
+  GstClockTime previous_pts;
+  gint64 previous_arrival;
+};
+
+void gst_absolutetimestamps_stats_reset (GstAbsolutetimestampsStats * stats);
+
+guint64 gst_absolutetimestamps_stats_add_arrival (GstAbsolutetimestampsStats * stats,
+    GstClockTime pts, gint64 arrival);
+void gst_absolutetimestamps_stats_add_skew (GstAbsolutetimestampsStats * stats,
+    GstClockTimeDiff skew);
+
+GstStructure *gst_absolutetimestamps_stats_to_structure (GstAbsolutetimestampsStats * stats,
+    const gchar * name);
+
+void gst_absolutetimestamps_histogram_add (GstAbsolutetimestampsHistogram * histogram,
+    guint64 value);
+
+G_END_DECLS
+
+#endif
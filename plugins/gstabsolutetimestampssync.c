@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Samples how well the host's clock is synchronised, every clock-sync-interval, on a thread of its
+// own so that the streaming thread never makes the syscall or waits for the PTP statistics. The
+// latest report is left for the streaming thread to pick up and log with its next sample, and is
+// posted on the bus as an absolutetimestamps-clock-sync message.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#ifdef HAVE_SYS_TIMEX_H
+#include <sys/timex.h>
+#endif
+
+#include <gst/net/gstptpclock.h>
+
+#include "gstabsolutetimestampssync.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gst_absolutetimestamps_debug_category);
+#define GST_CAT_DEFAULT gst_absolutetimestamps_debug_category
+
+struct _GstAbsolutetimestampsSyncSampler
+{
+  // Not reffed, the element stops the sampler before it goes away.
+  GstElement *element;
+  GstAbstsSyncSource source;
+  GstClockTime interval;
+  guint domain;
+
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+  gboolean stopping;
+
+  // The latest report (guarded by lock), taken by the streaming thread when pending is raised.
+  GstAbstsSync latest;
+  volatile gint pending;
+
+  // For GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_PTP: what the latest statistics of domain said (guarded by
+  // lock), if there have been any yet.
+  gulong ptp_callback;
+  gboolean ptp_seen;
+  gboolean ptp_synced;
+  gint64 ptp_offset;
+  GstClockTime ptp_path_delay;
+};
+
+GType
+gst_absolutetimestamps_clock_sync_get_type (void)
+{
+  static gsize clock_sync_type = 0;
+
+  if (g_once_init_enter (&clock_sync_type)) {
+    static const GEnumValue clock_syncs[] = {
+      {GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_NONE, "Don't report on the clock", "none"},
+#ifdef HAVE_SYS_TIMEX_H
+      {GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_KERNEL, "The kernel's NTP state, as kept by e.g. chrony or ntpd (adjtimex)", "kernel"},
+#endif
+      {GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_PTP, "The statistics of GStreamer's PTP clock for clock-sync-domain", "ptp"},
+      {0, NULL, NULL}
+    };
+    GType type = g_enum_register_static ("GstAbsolutetimestampsClockSync", clock_syncs);
+
+    g_once_init_leave (&clock_sync_type, type);
+  }
+
+  return clock_sync_type;
+}
+
+#ifdef HAVE_SYS_TIMEX_H
+// Reading with modes 0 changes nothing. The kernel's offset is the correction it has yet to apply,
+// i.e. how far behind its reference the clock is, and maxerror grows from the last update by the
+// tolerance of the oscillator until the daemon brings it back down.
+static gboolean
+sample_kernel (GstAbstsSync * sync)
+{
+  struct timex tx = { 0 };
+  gint state = adjtimex (&tx);
+
+  if (state == -1) {
+    GST_WARNING ("adjtimex failed: %s", g_strerror (errno));
+    return FALSE;
+  }
+
+  sync->offset = -(gint64) tx.offset * (tx.status & STA_NANO ? 1 : 1000);
+  sync->max_error = state == TIME_ERROR || (tx.status & STA_UNSYNC) ? G_MAXUINT64 :
+      (guint64) tx.maxerror * 1000;
+  sync->source = GST_ABSTS_SYNC_SOURCE_KERNEL;
+
+  return TRUE;
+}
+#else
+// Never called, clock-sync=kernel isn't a value of the property without adjtimex.
+static gboolean
+sample_kernel (GstAbstsSync * sync)
+{
+  return FALSE;
+}
+#endif
+
+// Called on the PTP thread on every update of every domain, so only notes what's needed. The
+// discontinuity is the correction just applied to the clock, and the mean path delay bounds what an
+// asymmetric path can have hidden from it.
+static gboolean
+on_ptp_statistics (guint8 domain, const GstStructure * stats, gpointer user_data)
+{
+  GstAbsolutetimestampsSyncSampler *sampler = user_data;
+  gint64 discontinuity = 0;
+  GstClockTime path_delay = GST_CLOCK_TIME_NONE;
+  gboolean synced = FALSE;
+
+  if (domain != sampler->domain ||
+      !gst_structure_has_name (stats, GST_PTP_STATISTICS_TIME_UPDATED))
+    return TRUE;
+
+  gst_structure_get_int64 (stats, "discontinuity", &discontinuity);
+  gst_structure_get_clock_time (stats, "mean-path-delay-avg", &path_delay);
+  gst_structure_get_boolean (stats, "synced", &synced);
+
+  g_mutex_lock (&sampler->lock);
+  sampler->ptp_seen = TRUE;
+  sampler->ptp_synced = synced && GST_CLOCK_TIME_IS_VALID (path_delay);
+  sampler->ptp_offset = -discontinuity;
+  sampler->ptp_path_delay = path_delay;
+  g_mutex_unlock (&sampler->lock);
+
+  return TRUE;
+}
+
+// Called with lock held.
+static void
+sample_ptp (GstAbsolutetimestampsSyncSampler * sampler, GstAbstsSync * sync)
+{
+  sync->offset = sampler->ptp_seen ? sampler->ptp_offset : 0;
+  sync->max_error = sampler->ptp_seen && sampler->ptp_synced ? sampler->ptp_path_delay : G_MAXUINT64;
+  sync->source = GST_ABSTS_SYNC_SOURCE_PTP;
+}
+
+static void
+post_report (GstAbsolutetimestampsSyncSampler * sampler, const GstAbstsSync * sync)
+{
+  gst_element_post_message (sampler->element,
+      gst_message_new_element (GST_OBJECT (sampler->element),
+          gst_structure_new ("absolutetimestamps-clock-sync",
+              "source", G_TYPE_STRING,
+              sync->source == GST_ABSTS_SYNC_SOURCE_PTP ? "ptp" : "kernel",
+              "synchronised", G_TYPE_BOOLEAN, sync->max_error != G_MAXUINT64,
+              "offset", G_TYPE_INT64, sync->offset,
+              "max-error", G_TYPE_UINT64, sync->max_error, NULL)));
+}
+
+static gpointer
+sampler_thread (gpointer data)
+{
+  GstAbsolutetimestampsSyncSampler *sampler = data;
+
+  g_mutex_lock (&sampler->lock);
+  while (!sampler->stopping) {
+    GstAbstsSync sync = { 0 };
+    gboolean sampled = TRUE;
+    gint64 end;
+
+    if (sampler->source == GST_ABSTS_SYNC_SOURCE_PTP)
+      sample_ptp (sampler, &sync);
+    else
+      sampled = sample_kernel (&sync);
+
+    if (sampled) {
+      sampler->latest = sync;
+      g_atomic_int_set (&sampler->pending, 1);
+
+      g_mutex_unlock (&sampler->lock);
+      GST_LOG_OBJECT (sampler->element, "clock off by %" G_GINT64_FORMAT "ns, max error %"
+          G_GUINT64_FORMAT "ns", sync.offset, sync.max_error);
+      post_report (sampler, &sync);
+      g_mutex_lock (&sampler->lock);
+    }
+
+    end = g_get_monotonic_time () + (gint64) (sampler->interval / GST_USECOND);
+    // g_cond_wait_until only returns FALSE once end has passed.
+    while (!sampler->stopping && g_cond_wait_until (&sampler->cond, &sampler->lock, end))
+      continue;
+  }
+  g_mutex_unlock (&sampler->lock);
+
+  return NULL;
+}
+
+// Starts sampling at once, and then every interval.
+GstAbsolutetimestampsSyncSampler *
+gst_absolutetimestamps_sync_sampler_new (GstElement * element,
+    GstAbsolutetimestampsClockSync source, GstClockTime interval, guint domain, GError ** error)
+{
+  GstAbsolutetimestampsSyncSampler *sampler;
+
+  g_return_val_if_fail (source != GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_NONE, NULL);
+
+  sampler = g_new0 (GstAbsolutetimestampsSyncSampler, 1);
+  sampler->element = element;
+  sampler->source = source == GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_PTP ? GST_ABSTS_SYNC_SOURCE_PTP :
+      GST_ABSTS_SYNC_SOURCE_KERNEL;
+  sampler->interval = MAX (interval, GST_MSECOND);
+  sampler->domain = domain;
+  g_mutex_init (&sampler->lock);
+  g_cond_init (&sampler->cond);
+
+  if (sampler->source == GST_ABSTS_SYNC_SOURCE_PTP) {
+    // Whoever creates the pipeline's GstPtpClock initializes PTP, until then there's nothing to report.
+    if (!gst_ptp_is_initialized ())
+      GST_WARNING_OBJECT (element, "PTP isn't initialized, the clock will show as unsynchronised");
+    sampler->ptp_callback = gst_ptp_statistics_callback_add (on_ptp_statistics, sampler, NULL);
+  }
+
+  sampler->thread = g_thread_try_new ("absts-sync", sampler_thread, sampler, error);
+  if (sampler->thread == NULL) {
+    gst_absolutetimestamps_sync_sampler_free (sampler);
+    return NULL;
+  }
+
+  return sampler;
+}
+
+void
+gst_absolutetimestamps_sync_sampler_free (GstAbsolutetimestampsSyncSampler * sampler)
+{
+  if (sampler->ptp_callback != 0)
+    gst_ptp_statistics_callback_remove (sampler->ptp_callback);
+
+  if (sampler->thread) {
+    g_mutex_lock (&sampler->lock);
+    sampler->stopping = TRUE;
+    g_cond_signal (&sampler->cond);
+    g_mutex_unlock (&sampler->lock);
+    g_thread_join (sampler->thread);
+  }
+
+  g_mutex_clear (&sampler->lock);
+  g_cond_clear (&sampler->cond);
+  g_free (sampler);
+}
+
+// Called by the streaming thread for every sample, so it's a single atomic read unless there's a new
+// report. Returns TRUE, and the report, once for each one.
+gboolean
+gst_absolutetimestamps_sync_sampler_take (GstAbsolutetimestampsSyncSampler * sampler,
+    GstAbstsSync * sync)
+{
+  if (!g_atomic_int_get (&sampler->pending))
+    return FALSE;
+
+  g_mutex_lock (&sampler->lock);
+  *sync = sampler->latest;
+  g_atomic_int_set (&sampler->pending, 0);
+  g_mutex_unlock (&sampler->lock);
+
+  return TRUE;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_SYNC_H_
+#define _GST_ABSOLUTETIMESTAMPS_SYNC_H_
+
+#include <gst/gst.h>
+
+#include "gstabstsformat.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ABSOLUTETIMESTAMPS_CLOCK_SYNC (gst_absolutetimestamps_clock_sync_get_type())
+
+// Where clock-sync takes its estimates of how well the host's clock is synchronised from.
+typedef enum
+{
+  GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_NONE,
+  GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_KERNEL,
+  GST_ABSOLUTETIMESTAMPS_CLOCK_SYNC_PTP
+} GstAbsolutetimestampsClockSync;
+
+typedef struct _GstAbsolutetimestampsSyncSampler GstAbsolutetimestampsSyncSampler;
+
+GType gst_absolutetimestamps_clock_sync_get_type (void);
+
+GstAbsolutetimestampsSyncSampler *gst_absolutetimestamps_sync_sampler_new (GstElement * element,
+    GstAbsolutetimestampsClockSync source, GstClockTime interval, guint domain, GError ** error);
+void gst_absolutetimestamps_sync_sampler_free (GstAbsolutetimestampsSyncSampler * sampler);
+
+gboolean gst_absolutetimestamps_sync_sampler_take (GstAbsolutetimestampsSyncSampler * sampler,
+    GstAbstsSync * sync);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstabsolutetimestampstracer.h"
+
+// The tracer doesn't hook anything itself - the elements do the measuring, it just switches them on
+// and owns the record they log with.
+static volatile gint active_tracers = 0;
+static GstTracerRecord *tr_buffer;
+
+G_DEFINE_TYPE (GstAbsolutetimestampsTracer, gst_absolutetimestamps_tracer, GST_TYPE_TRACER);
+
+static void
+gst_absolutetimestamps_tracer_finalize (GObject * object)
+{
+  g_atomic_int_add (&active_tracers, -1);
+
+  G_OBJECT_CLASS (gst_absolutetimestamps_tracer_parent_class)->finalize (object);
+}
+
+static void
+gst_absolutetimestamps_tracer_class_init (GstAbsolutetimestampsTracerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gst_absolutetimestamps_tracer_finalize;
+
+  tr_buffer = gst_tracer_record_new ("absolutetimestamps.class",
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related-to", GST_TYPE_TRACER_VALUE_SCOPE, GST_TRACER_VALUE_SCOPE_ELEMENT,
+          NULL),
+      "pts", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "pts of the buffer",
+          NULL),
+      "self-time", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "time spent recording the buffer in ns",
+          "min", G_TYPE_UINT64, G_GUINT64_CONSTANT (0),
+          "max", G_TYPE_UINT64, G_MAXUINT64,
+          NULL),
+      "skew", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_INT64,
+          "description", G_TYPE_STRING,
+          "how late (or early if negative) the buffer arrived relative to base_time + running_time in ns",
+          "min", G_TYPE_INT64, G_MININT64,
+          "max", G_TYPE_INT64, G_MAXINT64,
+          NULL),
+      "jitter", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING,
+          "difference between the inter-arrival time and the pts delta in ns",
+          "min", G_TYPE_UINT64, G_GUINT64_CONSTANT (0),
+          "max", G_TYPE_UINT64, G_MAXUINT64,
+          NULL),
+      NULL);
+  GST_OBJECT_FLAG_SET (tr_buffer, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+}
+
+static void
+gst_absolutetimestamps_tracer_init (GstAbsolutetimestampsTracer * tracer)
+{
+  g_atomic_int_inc (&active_tracers);
+}
+
+gboolean
+gst_absolutetimestamps_tracer_is_active (void)
+{
+  return g_atomic_int_get (&active_tracers) > 0;
+}
+
+void
+gst_absolutetimestamps_tracer_log_buffer (GstElement * element, GstClockTime pts,
+    guint64 self_time, GstClockTimeDiff skew, guint64 jitter)
+{
+  gst_tracer_record_log (tr_buffer, GST_OBJECT_NAME (element), pts, self_time, skew, jitter);
+}
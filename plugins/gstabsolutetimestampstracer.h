@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_TRACER_H_
+#define _GST_ABSOLUTETIMESTAMPS_TRACER_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ABSOLUTETIMESTAMPS_TRACER   (gst_absolutetimestamps_tracer_get_type())
+#define GST_ABSOLUTETIMESTAMPS_TRACER(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_ABSOLUTETIMESTAMPS_TRACER,GstAbsolutetimestampsTracer))
+
+typedef struct _GstAbsolutetimestampsTracer GstAbsolutetimestampsTracer;
+typedef struct _GstAbsolutetimestampsTracerClass GstAbsolutetimestampsTracerClass;
+
+// Enabled with GST_TRACERS=absolutetimestamps (alongside e.g. the latency tracer). While an instance
+// exists every absolutetimestamps element measures each buffer and logs it as an
+// "absolutetimestamps" tracer record.
+struct _GstAbsolutetimestampsTracer
+{
+  GstTracer parent;
+};
+
+struct _GstAbsolutetimestampsTracerClass
+{
+  GstTracerClass parent_class;
+};
+
+GType gst_absolutetimestamps_tracer_get_type (void);
+
+gboolean gst_absolutetimestamps_tracer_is_active (void);
+
+void gst_absolutetimestamps_tracer_log_buffer (GstElement * element, GstClockTime pts,
+    guint64 self_time, GstClockTimeDiff skew, guint64 jitter);
+
+G_END_DECLS
+
+#endif
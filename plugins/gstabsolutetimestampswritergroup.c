@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstabsolutetimestampswritergroup.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gst_absolutetimestamps_debug_category);
+#define GST_CAT_DEFAULT gst_absolutetimestamps_debug_category
+
+// How long the writer thread sleeps before re-checking the rings if it's not woken explicitly.
+#define WRITER_WAIT_USEC (10 * G_TIME_SPAN_MILLISECOND)
+
+// Groups by name. registry_lock is always taken before a group's lock.
+static GMutex registry_lock;
+static GHashTable *groups;
+
+// After a write error the group keeps draining the rings, so that members never see them fill up,
+// but stops writing.
+static void
+write_record_locked (GstAbsolutetimestampsWriterGroup * group,
+    const GstAbsolutetimestampsRecord * record)
+{
+  GError *error = NULL;
+  guint i;
+
+  if (group->failed)
+    return;
+
+  if (gst_absolutetimestamps_output_write_record (group->output, record, &error))
+    return;
+
+  group->failed = TRUE;
+  for (i = 0; i < group->members->len; i++) {
+    GstAbsolutetimestampsWriterGroupMember *member = g_ptr_array_index (group->members, i);
+
+    GST_ELEMENT_ERROR (member->element, RESOURCE, WRITE,
+        ("Could not write to file \"%s\" of writer group \"%s\".", group->output->filename,
+            group->name), ("%s", error->message));
+  }
+  g_error_free (error);
+}
+
+static void
+drain_member_locked (GstAbsolutetimestampsWriterGroup * group,
+    GstAbsolutetimestampsWriterGroupMember * member)
+{
+  GstAbsolutetimestampsRecord record;
+
+  while (gst_absolutetimestamps_ring_pop (member->ring, &record))
+    write_record_locked (group, &record);
+}
+
+static gboolean
+is_empty_locked (GstAbsolutetimestampsWriterGroup * group)
+{
+  guint i;
+
+  for (i = 0; i < group->members->len; i++) {
+    GstAbsolutetimestampsWriterGroupMember *member = g_ptr_array_index (group->members, i);
+
+    if (!gst_absolutetimestamps_ring_is_empty (member->ring))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+// The same protocol as an element's own writer thread, but across all the members' rings. As the
+// lock is only released while sleeping, members can only join or leave between drains.
+static gpointer
+writer_thread (gpointer data)
+{
+  GstAbsolutetimestampsWriterGroup *group = data;
+  GError *error = NULL;
+  guint i;
+
+  GST_DEBUG ("writer group \"%s\" started", group->name);
+
+  g_mutex_lock (&group->lock);
+  while (!group->stopping) {
+    for (i = 0; i < group->members->len; i++)
+      drain_member_locked (group, g_ptr_array_index (group->members, i));
+
+    if (!group->failed && !gst_absolutetimestamps_output_flush_if_due (group->output, &error)) {
+      GST_WARNING ("writer group \"%s\": %s", group->name, error->message);
+      g_clear_error (&error);
+      group->failed = TRUE;
+    }
+
+    g_atomic_int_set (&group->waiting, 1);
+    if (is_empty_locked (group) && !group->stopping)
+      g_cond_wait_until (&group->cond, &group->lock, g_get_monotonic_time () + WRITER_WAIT_USEC);
+    g_atomic_int_set (&group->waiting, 0);
+  }
+  g_mutex_unlock (&group->lock);
+
+  GST_DEBUG ("writer group \"%s\" stopped", group->name);
+
+  return NULL;
+}
+
+void
+gst_absolutetimestamps_writer_group_wake (GstAbsolutetimestampsWriterGroup * group)
+{
+  if (!g_atomic_int_get (&group->waiting))
+    return;
+
+  g_mutex_lock (&group->lock);
+  g_cond_signal (&group->cond);
+  g_mutex_unlock (&group->lock);
+}
+
+static void
+group_free (GstAbsolutetimestampsWriterGroup * group)
+{
+  g_ptr_array_free (group->members, TRUE);
+  g_mutex_clear (&group->lock);
+  g_cond_clear (&group->cond);
+  g_free (group->name);
+  g_free (group);
+}
+
+static GstAbsolutetimestampsWriterGroup *
+group_new (const gchar * name, GstAbsolutetimestampsOutput * output, GError ** error)
+{
+  GstAbsolutetimestampsWriterGroup *group = g_new0 (GstAbsolutetimestampsWriterGroup, 1);
+
+  group->name = g_strdup (name);
+  group->members = g_ptr_array_new ();
+  g_mutex_init (&group->lock);
+  g_cond_init (&group->cond);
+
+  output->stream_ids = TRUE;
+  if (!gst_absolutetimestamps_output_open (output, error)) {
+    gst_absolutetimestamps_output_free (output);
+    group_free (group);
+    return NULL;
+  }
+  group->output = output;
+
+  group->thread = g_thread_try_new ("absts-group", writer_thread, group, error);
+  if (group->thread == NULL) {
+    gst_absolutetimestamps_output_free (group->output);
+    group_free (group);
+    return NULL;
+  }
+
+  return group;
+}
+
+static gboolean
+stream_id_in_use_locked (GstAbsolutetimestampsWriterGroup * group, guint32 stream_id)
+{
+  guint i;
+
+  for (i = 0; i < group->members->len; i++) {
+    GstAbsolutetimestampsWriterGroupMember *member = g_ptr_array_index (group->members, i);
+
+    if (member->stream_id == stream_id)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+// Joins (creating if need be) the group called name. If the group is created it takes output, which
+// must be configured but not yet opened, otherwise output is freed as the group's own is used.
+// A negative stream_id picks the next unused one.
+GstAbsolutetimestampsWriterGroupMember *
+gst_absolutetimestamps_writer_group_join (const gchar * name, GstElement * element,
+    GstAbsolutetimestampsOutput * output, guint ring_capacity, gint stream_id, GError ** error)
+{
+  GstAbsolutetimestampsWriterGroup *group;
+  GstAbsolutetimestampsWriterGroupMember *member;
+
+  g_mutex_lock (&registry_lock);
+
+  if (groups == NULL)
+    groups = g_hash_table_new (g_str_hash, g_str_equal);
+
+  group = g_hash_table_lookup (groups, name);
+  if (group == NULL) {
+    group = group_new (name, output, error);
+    if (group == NULL) {
+      g_mutex_unlock (&registry_lock);
+      return NULL;
+    }
+    g_hash_table_insert (groups, group->name, group);
+  } else {
+    if (g_strcmp0 (output->filename, group->output->filename) != 0)
+      GST_WARNING_OBJECT (element, "writer group \"%s\" is already writing to \"%s\"", name,
+          group->output->filename);
+    gst_absolutetimestamps_output_free (output);
+  }
+
+  g_mutex_lock (&group->lock);
+
+  if (stream_id < 0) {
+    while (stream_id_in_use_locked (group, group->next_stream_id))
+      group->next_stream_id++;
+    stream_id = group->next_stream_id++;
+  } else if (stream_id_in_use_locked (group, stream_id)) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_EXIST,
+        "Stream id %d is already in use in writer group \"%s\"", stream_id, name);
+    g_mutex_unlock (&group->lock);
+    g_mutex_unlock (&registry_lock);
+    return NULL;
+  }
+
+  member = g_new0 (GstAbsolutetimestampsWriterGroupMember, 1);
+  member->group = group;
+  member->element = element;
+  member->ring = gst_absolutetimestamps_ring_new (ring_capacity);
+  member->stream_id = stream_id;
+  member->fields = group->output->fields;
+  g_ptr_array_add (group->members, member);
+
+  GST_DEBUG_OBJECT (element, "joined writer group \"%s\" as stream %u", name, member->stream_id);
+
+  g_mutex_unlock (&group->lock);
+  g_mutex_unlock (&registry_lock);
+
+  return member;
+}
+
+// The member's streaming thread must have stopped. Anything left in its ring is written out before
+// it leaves, and the last member to leave closes the output.
+gboolean
+gst_absolutetimestamps_writer_group_leave (GstAbsolutetimestampsWriterGroupMember * member,
+    GError ** error)
+{
+  GstAbsolutetimestampsWriterGroup *group = member->group;
+  gboolean result = TRUE;
+
+  g_mutex_lock (&registry_lock);
+  g_mutex_lock (&group->lock);
+
+  drain_member_locked (group, member);
+  g_ptr_array_remove (group->members, member);
+
+  if (group->members->len > 0) {
+    g_mutex_unlock (&group->lock);
+  } else {
+    g_hash_table_remove (groups, group->name);
+
+    group->stopping = TRUE;
+    g_cond_signal (&group->cond);
+    g_mutex_unlock (&group->lock);
+    g_thread_join (group->thread);
+
+    result = gst_absolutetimestamps_output_close (group->output, error);
+    gst_absolutetimestamps_output_free (group->output);
+    group_free (group);
+  }
+
+  g_mutex_unlock (&registry_lock);
+
+  gst_absolutetimestamps_ring_free (member->ring);
+  g_free (member);
+
+  return result;
+}
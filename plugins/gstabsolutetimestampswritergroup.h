@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSOLUTETIMESTAMPS_WRITER_GROUP_H_
+#define _GST_ABSOLUTETIMESTAMPS_WRITER_GROUP_H_
+
+#include <gst/gst.h>
+
+#include "gstabsolutetimestampsoutput.h"
+#include "gstabsolutetimestampsring.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstAbsolutetimestampsWriterGroup GstAbsolutetimestampsWriterGroup;
+typedef struct _GstAbsolutetimestampsWriterGroupMember GstAbsolutetimestampsWriterGroupMember;
+
+// A process-wide writer shared by every element with the same writer-group name: one thread and one
+// output, into which the records of all members are interleaved and tagged with their stream_id.
+// Each member feeds the writer through its own ring, so members never contend with each other.
+//
+// The fields are private, lock guards everything but the rings and waiting.
+struct _GstAbsolutetimestampsWriterGroup
+{
+  gchar *name;
+  GstAbsolutetimestampsOutput *output;
+  GPtrArray *members;
+  guint32 next_stream_id;
+  gboolean failed;
+
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+  volatile gint waiting;
+  gboolean stopping;
+};
+
+struct _GstAbsolutetimestampsWriterGroupMember
+{
+  GstAbsolutetimestampsWriterGroup *group;
+  GstElement *element;
+  GstAbsolutetimestampsRing *ring;
+  guint32 stream_id;
+  guint fields;                 /* that the group's output writes, whatever the member asked for */
+};
+
+GstAbsolutetimestampsWriterGroupMember *gst_absolutetimestamps_writer_group_join (const gchar * name,
+    GstElement * element, GstAbsolutetimestampsOutput * output, guint ring_capacity,
+    gint stream_id, GError ** error);
+gboolean gst_absolutetimestamps_writer_group_leave (GstAbsolutetimestampsWriterGroupMember * member,
+    GError ** error);
+
+void gst_absolutetimestamps_writer_group_wake (GstAbsolutetimestampsWriterGroup * group);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,788 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:element-gstmultiabsolutetimestamps
+ *
+ * The multiabsolutetimestamps element passes buffers through unchanged, from each requested
+ * sink_%u pad to the matching src_%u pad, and writes the pts of all the streams against shared
+ * readings of the clock to a single file - one row per reading, one column per pad - so that how
+ * the streams line up comes straight out of capture.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 multiabsolutetimestamps name=m location=sync.log \
+ *     v4l2src device=/dev/video0 ! m.sink_0  m.src_0 ! queue ! fakesink \
+ *     v4l2src device=/dev/video1 ! m.sink_1  m.src_1 ! queue ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include <gst/gst.h>
+#include "gstmultiabsolutetimestamps.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_multiabsolutetimestamps_debug_category);
+#define GST_CAT_DEFAULT gst_multiabsolutetimestamps_debug_category
+
+#define DEFAULT_FILENAME "timestamps.log"
+#define DEFAULT_FORMAT GST_ABSOLUTETIMESTAMPS_FORMAT_TEXT
+#define DEFAULT_PRECISION GST_ABSOLUTETIMESTAMPS_PRECISION_MICROSECONDS
+#define DEFAULT_CLOCK_SOURCE GST_ABSOLUTETIMESTAMPS_CLOCK_SOURCE_REALTIME
+#define DEFAULT_BUFFER_SIZE 65536
+#define DEFAULT_FLUSH_POLICY GST_ABSOLUTETIMESTAMPS_FLUSH_NONE
+#define DEFAULT_FLUSH_RECORDS 100
+#define DEFAULT_FLUSH_INTERVAL 1000
+#define DEFAULT_SINK GST_ABSOLUTETIMESTAMPS_SINK_FILE
+#define DEFAULT_SHM_CAPACITY 16384
+#define DEFAULT_APPEND FALSE
+#define DEFAULT_SYNC_WRITES FALSE
+#define DEFAULT_DIRECT_IO FALSE
+
+/* prototypes */
+
+
+static void gst_multiabsolutetimestamps_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_multiabsolutetimestamps_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_multiabsolutetimestamps_dispose (GObject * object);
+static void gst_multiabsolutetimestamps_finalize (GObject * object);
+
+static GstPad *gst_multiabsolutetimestamps_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_multiabsolutetimestamps_release_pad (GstElement * element, GstPad * pad);
+static GstStateChangeReturn gst_multiabsolutetimestamps_change_state (GstElement * element,
+    GstStateChange transition);
+
+static GstFlowReturn gst_multiabsolutetimestamps_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf);
+static gboolean gst_multiabsolutetimestamps_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static gboolean gst_multiabsolutetimestamps_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static gboolean gst_multiabsolutetimestamps_query (GstPad * pad, GstObject * parent,
+    GstQuery * query);
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_FORMAT,
+  PROP_PRECISION,
+  PROP_CLOCK_SOURCE,
+  PROP_BUFFER_SIZE,
+  PROP_FLUSH_POLICY,
+  PROP_FLUSH_RECORDS,
+  PROP_FLUSH_INTERVAL,
+  PROP_SINK,
+  PROP_SHM_CAPACITY,
+  PROP_APPEND,
+  PROP_SYNC_WRITES,
+  PROP_DIRECT_IO,
+  PROP_ROWS
+};
+
+/* pad templates */
+
+static GstStaticPadTemplate gst_multiabsolutetimestamps_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS_ANY
+    );
+
+static GstStaticPadTemplate gst_multiabsolutetimestamps_src_template =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS_ANY
+    );
+
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstMultiabsolutetimestamps, gst_multiabsolutetimestamps,
+    GST_TYPE_ELEMENT,
+    GST_DEBUG_CATEGORY_INIT (gst_multiabsolutetimestamps_debug_category,
+        "multiabsolutetimestamps", 0,
+        "debug category for multiabsolutetimestamps element"));
+
+static void
+gst_multiabsolutetimestamps_class_init (GstMultiabsolutetimestampsClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_multiabsolutetimestamps_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_multiabsolutetimestamps_src_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "Multiabsolutetimestamps", "Generic",
+      "Generate one mapping from the relative timestamps of several streams to shared absolute timestamps",
+      "George Hawkins <https://github.com/george-hawkins>");
+
+  gobject_class->set_property = gst_multiabsolutetimestamps_set_property;
+  gobject_class->get_property = gst_multiabsolutetimestamps_get_property;
+  gobject_class->dispose = gst_multiabsolutetimestamps_dispose;
+  gobject_class->finalize = gst_multiabsolutetimestamps_finalize;
+
+  element_class->request_new_pad = GST_DEBUG_FUNCPTR (gst_multiabsolutetimestamps_request_new_pad);
+  element_class->release_pad = GST_DEBUG_FUNCPTR (gst_multiabsolutetimestamps_release_pad);
+  element_class->change_state = GST_DEBUG_FUNCPTR (gst_multiabsolutetimestamps_change_state);
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "File Location",
+          "Location of the timestamp mapping file to write", DEFAULT_FILENAME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FORMAT,
+      g_param_spec_enum ("format", "Format",
+          "Format of the timestamp mapping file", GST_TYPE_ABSOLUTETIMESTAMPS_FORMAT,
+          DEFAULT_FORMAT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PRECISION,
+      g_param_spec_enum ("precision", "Precision",
+          "Precision of the wallclock written in the text format", GST_TYPE_ABSOLUTETIMESTAMPS_PRECISION,
+          DEFAULT_PRECISION, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CLOCK_SOURCE,
+      g_param_spec_enum ("clock-source", "Clock source",
+          "Clock that the absolute time of each row is taken from",
+          GST_TYPE_ABSOLUTETIMESTAMPS_CLOCK_SOURCE, DEFAULT_CLOCK_SOURCE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BUFFER_SIZE,
+      g_param_spec_uint ("buffer-size", "Buffer size",
+          "Size in bytes of the buffer rows are accumulated in before being written to the file",
+          4096, G_MAXINT, DEFAULT_BUFFER_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FLUSH_POLICY,
+      g_param_spec_enum ("flush-policy", "Flush policy",
+          "When to write buffered rows to the file, other than when the buffer is full",
+          GST_TYPE_ABSOLUTETIMESTAMPS_FLUSH_POLICY, DEFAULT_FLUSH_POLICY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FLUSH_RECORDS,
+      g_param_spec_uint ("flush-records", "Flush records",
+          "Number of rows (records in binary) between writes when flush-policy=every-n-records",
+          1, G_MAXUINT, DEFAULT_FLUSH_RECORDS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FLUSH_INTERVAL,
+      g_param_spec_uint ("flush-interval", "Flush interval",
+          "Milliseconds between writes when flush-policy=every-t-ms, checked when a row is written",
+          1, G_MAXUINT, DEFAULT_FLUSH_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SINK,
+      g_param_spec_enum ("sink", "Sink",
+          "Where the rows go, anything but a file always gets the binary encoding",
+          GST_TYPE_ABSOLUTETIMESTAMPS_SINK, DEFAULT_SINK,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SHM_CAPACITY,
+      g_param_spec_uint ("shm-capacity", "Shared memory capacity",
+          "Number of records kept in the shared memory ring when sink=shm (rounded up to a power of two)",
+          2, 1 << 30, DEFAULT_SHM_CAPACITY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_APPEND,
+      g_param_spec_boolean ("append", "Append",
+          "Resume an existing log, dropping any torn blocks at its end, rather than truncate it (format=blocks only)",
+          DEFAULT_APPEND, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SYNC_WRITES,
+      g_param_spec_boolean ("sync-writes", "Sync writes",
+          "Call fdatasync after each write to the file, so that flushed rows survive a power loss",
+          DEFAULT_SYNC_WRITES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DIRECT_IO,
+      g_param_spec_boolean ("direct-io", "Direct I/O",
+          "Open the file O_DIRECT, bypassing the page cache, where the filesystem allows it (format=blocks only)",
+          DEFAULT_DIRECT_IO, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ROWS,
+      g_param_spec_uint64 ("rows", "Rows",
+          "Number of rows written since the element was last started",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_multiabsolutetimestamps_init (GstMultiabsolutetimestamps * multiabsolutetimestamps)
+{
+  multiabsolutetimestamps->filename = g_strdup (DEFAULT_FILENAME);
+  multiabsolutetimestamps->format = DEFAULT_FORMAT;
+  multiabsolutetimestamps->precision = DEFAULT_PRECISION;
+  multiabsolutetimestamps->clock_source = DEFAULT_CLOCK_SOURCE;
+  multiabsolutetimestamps->buffer_size = DEFAULT_BUFFER_SIZE;
+  multiabsolutetimestamps->flush_policy = DEFAULT_FLUSH_POLICY;
+  multiabsolutetimestamps->flush_records = DEFAULT_FLUSH_RECORDS;
+  multiabsolutetimestamps->flush_interval = DEFAULT_FLUSH_INTERVAL;
+  multiabsolutetimestamps->sink = DEFAULT_SINK;
+  multiabsolutetimestamps->shm_capacity = DEFAULT_SHM_CAPACITY;
+  multiabsolutetimestamps->append = DEFAULT_APPEND;
+  multiabsolutetimestamps->sync_writes = DEFAULT_SYNC_WRITES;
+  multiabsolutetimestamps->direct_io = DEFAULT_DIRECT_IO;
+
+  g_mutex_init (&multiabsolutetimestamps->lock);
+  multiabsolutetimestamps->streams = g_ptr_array_new ();
+  gst_absolutetimestamps_clock_init (&multiabsolutetimestamps->clock,
+      multiabsolutetimestamps->clock_source);
+}
+
+void
+gst_multiabsolutetimestamps_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstMultiabsolutetimestamps *multiabsolutetimestamps = GST_MULTIABSOLUTETIMESTAMPS (object);
+
+  GST_DEBUG_OBJECT (multiabsolutetimestamps, "set_property");
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      g_free (multiabsolutetimestamps->filename);
+      multiabsolutetimestamps->filename = g_value_dup_string (value);
+      break;
+    case PROP_FORMAT:
+      multiabsolutetimestamps->format = g_value_get_enum (value);
+      break;
+    case PROP_PRECISION:
+      multiabsolutetimestamps->precision = g_value_get_enum (value);
+      break;
+    case PROP_CLOCK_SOURCE:
+      multiabsolutetimestamps->clock_source = g_value_get_enum (value);
+      break;
+    case PROP_BUFFER_SIZE:
+      multiabsolutetimestamps->buffer_size = g_value_get_uint (value);
+      break;
+    case PROP_FLUSH_POLICY:
+      multiabsolutetimestamps->flush_policy = g_value_get_enum (value);
+      break;
+    case PROP_FLUSH_RECORDS:
+      multiabsolutetimestamps->flush_records = g_value_get_uint (value);
+      break;
+    case PROP_FLUSH_INTERVAL:
+      multiabsolutetimestamps->flush_interval = g_value_get_uint (value);
+      break;
+    case PROP_SINK:
+      multiabsolutetimestamps->sink = g_value_get_enum (value);
+      break;
+    case PROP_SHM_CAPACITY:
+      multiabsolutetimestamps->shm_capacity = g_value_get_uint (value);
+      break;
+    case PROP_APPEND:
+      multiabsolutetimestamps->append = g_value_get_boolean (value);
+      break;
+    case PROP_SYNC_WRITES:
+      multiabsolutetimestamps->sync_writes = g_value_get_boolean (value);
+      break;
+    case PROP_DIRECT_IO:
+      multiabsolutetimestamps->direct_io = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_multiabsolutetimestamps_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstMultiabsolutetimestamps *multiabsolutetimestamps = GST_MULTIABSOLUTETIMESTAMPS (object);
+
+  GST_DEBUG_OBJECT (multiabsolutetimestamps, "get_property");
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      g_value_set_string (value, multiabsolutetimestamps->filename);
+      break;
+    case PROP_FORMAT:
+      g_value_set_enum (value, multiabsolutetimestamps->format);
+      break;
+    case PROP_PRECISION:
+      g_value_set_enum (value, multiabsolutetimestamps->precision);
+      break;
+    case PROP_CLOCK_SOURCE:
+      g_value_set_enum (value, multiabsolutetimestamps->clock_source);
+      break;
+    case PROP_BUFFER_SIZE:
+      g_value_set_uint (value, multiabsolutetimestamps->buffer_size);
+      break;
+    case PROP_FLUSH_POLICY:
+      g_value_set_enum (value, multiabsolutetimestamps->flush_policy);
+      break;
+    case PROP_FLUSH_RECORDS:
+      g_value_set_uint (value, multiabsolutetimestamps->flush_records);
+      break;
+    case PROP_FLUSH_INTERVAL:
+      g_value_set_uint (value, multiabsolutetimestamps->flush_interval);
+      break;
+    case PROP_SINK:
+      g_value_set_enum (value, multiabsolutetimestamps->sink);
+      break;
+    case PROP_SHM_CAPACITY:
+      g_value_set_uint (value, multiabsolutetimestamps->shm_capacity);
+      break;
+    case PROP_APPEND:
+      g_value_set_boolean (value, multiabsolutetimestamps->append);
+      break;
+    case PROP_SYNC_WRITES:
+      g_value_set_boolean (value, multiabsolutetimestamps->sync_writes);
+      break;
+    case PROP_DIRECT_IO:
+      g_value_set_boolean (value, multiabsolutetimestamps->direct_io);
+      break;
+    case PROP_ROWS:
+      g_mutex_lock (&multiabsolutetimestamps->lock);
+      g_value_set_uint64 (value, multiabsolutetimestamps->rows);
+      g_mutex_unlock (&multiabsolutetimestamps->lock);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_multiabsolutetimestamps_dispose (GObject * object)
+{
+  GstMultiabsolutetimestamps *multiabsolutetimestamps = GST_MULTIABSOLUTETIMESTAMPS (object);
+
+  GST_DEBUG_OBJECT (multiabsolutetimestamps, "dispose");
+
+  G_OBJECT_CLASS (gst_multiabsolutetimestamps_parent_class)->dispose (object);
+
+  g_free (multiabsolutetimestamps->filename);
+  multiabsolutetimestamps->filename = NULL;
+}
+
+void
+gst_multiabsolutetimestamps_finalize (GObject * object)
+{
+  GstMultiabsolutetimestamps *multiabsolutetimestamps = GST_MULTIABSOLUTETIMESTAMPS (object);
+  guint i;
+
+  GST_DEBUG_OBJECT (multiabsolutetimestamps, "finalize");
+
+  // GstElement's dispose has released any pads that were still requested.
+  for (i = 0; i < multiabsolutetimestamps->streams->len; i++)
+    g_free (g_ptr_array_index (multiabsolutetimestamps->streams, i));
+  g_ptr_array_free (multiabsolutetimestamps->streams, TRUE);
+  g_free (multiabsolutetimestamps->row);
+  g_mutex_clear (&multiabsolutetimestamps->lock);
+
+  G_OBJECT_CLASS (gst_multiabsolutetimestamps_parent_class)->finalize (object);
+}
+
+/* rows */
+
+// Ends the open row, writing it out if there's an output. Called with the lock held.
+static gboolean
+gst_multiabsolutetimestamps_close_row (GstMultiabsolutetimestamps * multiabsolutetimestamps)
+{
+  GError *error = NULL;
+  gboolean result = TRUE;
+  guint i;
+
+  if (multiabsolutetimestamps->row_filled == 0)
+    return TRUE;
+
+  if (multiabsolutetimestamps->output != NULL &&
+      (!gst_absolutetimestamps_output_write_row (multiabsolutetimestamps->output,
+              multiabsolutetimestamps->row_wallclock, multiabsolutetimestamps->row,
+              multiabsolutetimestamps->row_columns, &error) ||
+          !gst_absolutetimestamps_output_flush_if_due (multiabsolutetimestamps->output, &error))) {
+    GST_ELEMENT_ERROR (multiabsolutetimestamps, RESOURCE, WRITE,
+        ("Could not write to file \"%s\".", multiabsolutetimestamps->filename),
+        ("%s", error->message));
+    g_error_free (error);
+    multiabsolutetimestamps->failed = TRUE;
+    result = FALSE;
+  }
+
+  for (i = 0; i < multiabsolutetimestamps->row_columns; i++) {
+    multiabsolutetimestamps->row[i].pts = GST_CLOCK_TIME_NONE;
+    multiabsolutetimestamps->row[i].flags = 0;
+  }
+  multiabsolutetimestamps->row_filled = 0;
+  multiabsolutetimestamps->rows++;
+
+  return result;
+}
+
+// Streams that are expected to contribute to every row. Called with the lock held.
+static guint
+gst_multiabsolutetimestamps_count_active (GstMultiabsolutetimestamps * multiabsolutetimestamps)
+{
+  guint i, active = 0;
+
+  for (i = 0; i < multiabsolutetimestamps->streams->len; i++) {
+    GstMultiabsolutetimestampsStream *stream =
+        g_ptr_array_index (multiabsolutetimestamps->streams, i);
+
+    if (stream != NULL && !stream->eos)
+      active++;
+  }
+
+  return active;
+}
+
+// Writes out the open row if no stream that's still missing from it can contribute any more, e.g.
+// after a stream went EOS or its pad was released. Called with the lock held.
+static gboolean
+gst_multiabsolutetimestamps_close_row_if_complete (GstMultiabsolutetimestamps *
+    multiabsolutetimestamps)
+{
+  if (multiabsolutetimestamps->row_filled == 0 ||
+      multiabsolutetimestamps->row_filled <
+      gst_multiabsolutetimestamps_count_active (multiabsolutetimestamps))
+    return TRUE;
+
+  return gst_multiabsolutetimestamps_close_row (multiabsolutetimestamps);
+}
+
+// Adds buf to the open row as its stream's column, starting a new row first if the stream already
+// has one there. Only the buffer that starts a row reads the clock. Called with the lock held.
+static gboolean
+gst_multiabsolutetimestamps_add (GstMultiabsolutetimestamps * multiabsolutetimestamps,
+    GstMultiabsolutetimestampsStream * stream, GstBuffer * buf)
+{
+  GstAbsolutetimestampsRecord *column;
+
+  // A buffer without a pts has nothing to line up.
+  if (!GST_BUFFER_PTS_IS_VALID (buf))
+    return TRUE;
+
+  column = &multiabsolutetimestamps->row[stream->index];
+  if (GST_CLOCK_TIME_IS_VALID (column->pts) &&
+      !gst_multiabsolutetimestamps_close_row (multiabsolutetimestamps))
+    return FALSE;
+
+  if (multiabsolutetimestamps->row_filled == 0)
+    multiabsolutetimestamps->row_wallclock =
+        gst_absolutetimestamps_clock_sample (&multiabsolutetimestamps->clock,
+        GST_ELEMENT (multiabsolutetimestamps), &stream->segment, GST_BUFFER_PTS (buf));
+
+  column->pts = GST_BUFFER_PTS (buf);
+  column->wallclock = multiabsolutetimestamps->row_wallclock;
+  column->flags = 0;
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DISCONT))
+    column->flags |= GST_ABSTS_RECORD_FLAG_DISCONT;
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT))
+    column->flags |= GST_ABSTS_RECORD_FLAG_DELTA_UNIT;
+  multiabsolutetimestamps->row_filled++;
+
+  return gst_multiabsolutetimestamps_close_row_if_complete (multiabsolutetimestamps);
+}
+
+/* pads */
+
+static GstFlowReturn
+gst_multiabsolutetimestamps_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstMultiabsolutetimestamps *multiabsolutetimestamps = GST_MULTIABSOLUTETIMESTAMPS (parent);
+  GstMultiabsolutetimestampsStream *stream = gst_pad_get_element_private (pad);
+  gboolean ok;
+
+  g_mutex_lock (&multiabsolutetimestamps->lock);
+  ok = !multiabsolutetimestamps->failed &&
+      gst_multiabsolutetimestamps_add (multiabsolutetimestamps, stream, buf);
+  g_mutex_unlock (&multiabsolutetimestamps->lock);
+
+  if (!ok) {
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+
+  return gst_pad_push (stream->srcpad, buf);
+}
+
+static gboolean
+gst_multiabsolutetimestamps_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstMultiabsolutetimestamps *multiabsolutetimestamps = GST_MULTIABSOLUTETIMESTAMPS (parent);
+  GstMultiabsolutetimestampsStream *stream = gst_pad_get_element_private (pad);
+  gboolean ok = TRUE;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_STREAM_START:
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&multiabsolutetimestamps->lock);
+      stream->eos = FALSE;
+      if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+        gst_segment_init (&stream->segment, GST_FORMAT_TIME);
+      g_mutex_unlock (&multiabsolutetimestamps->lock);
+      break;
+    case GST_EVENT_SEGMENT:
+      g_mutex_lock (&multiabsolutetimestamps->lock);
+      gst_event_copy_segment (event, &stream->segment);
+      g_mutex_unlock (&multiabsolutetimestamps->lock);
+      break;
+    case GST_EVENT_EOS:
+      // The other streams no longer wait for this one.
+      g_mutex_lock (&multiabsolutetimestamps->lock);
+      stream->eos = TRUE;
+      ok = gst_multiabsolutetimestamps_close_row_if_complete (multiabsolutetimestamps);
+      g_mutex_unlock (&multiabsolutetimestamps->lock);
+      break;
+    default:
+      break;
+  }
+
+  if (!ok) {
+    gst_event_unref (event);
+    return FALSE;
+  }
+
+  return gst_pad_push_event (stream->srcpad, event);
+}
+
+static gboolean
+gst_multiabsolutetimestamps_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstMultiabsolutetimestampsStream *stream = gst_pad_get_element_private (pad);
+
+  return gst_pad_push_event (stream->sinkpad, event);
+}
+
+// Each stream is an identity on its own, so everything is answered by the other side of that stream.
+static gboolean
+gst_multiabsolutetimestamps_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstMultiabsolutetimestampsStream *stream = gst_pad_get_element_private (pad);
+
+  return gst_pad_peer_query (pad == stream->sinkpad ? stream->srcpad : stream->sinkpad, query);
+}
+
+static GstPad *
+gst_multiabsolutetimestamps_request_new_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps)
+{
+  GstMultiabsolutetimestamps *multiabsolutetimestamps = GST_MULTIABSOLUTETIMESTAMPS (element);
+  GstMultiabsolutetimestampsStream *stream;
+  GPtrArray *streams = multiabsolutetimestamps->streams;
+  gchar *pad_name;
+  guint index, i;
+
+  g_mutex_lock (&multiabsolutetimestamps->lock);
+
+  // A new pad always gets a new column. A released pad's column is never handed on, as a reader
+  // couldn't tell where in the file it changed owner.
+  if (name != NULL && sscanf (name, "sink_%u", &index) == 1) {
+    if (index < streams->len) {
+      g_mutex_unlock (&multiabsolutetimestamps->lock);
+      GST_WARNING_OBJECT (multiabsolutetimestamps,
+          "pad %s: column %u is already taken, the first free one is %u", name, index,
+          streams->len);
+      return NULL;
+    }
+  } else {
+    index = streams->len;
+  }
+
+  g_ptr_array_set_size (streams, index + 1);
+  multiabsolutetimestamps->row = g_renew (GstAbsolutetimestampsRecord,
+      multiabsolutetimestamps->row, streams->len);
+  for (i = multiabsolutetimestamps->row_columns; i < streams->len; i++) {
+    multiabsolutetimestamps->row[i].pts = GST_CLOCK_TIME_NONE;
+    multiabsolutetimestamps->row[i].wallclock = 0;
+    multiabsolutetimestamps->row[i].flags = 0;
+    multiabsolutetimestamps->row[i].stream_id = i;
+  }
+  multiabsolutetimestamps->row_columns = streams->len;
+
+  stream = g_new0 (GstMultiabsolutetimestampsStream, 1);
+  stream->index = index;
+  gst_segment_init (&stream->segment, GST_FORMAT_TIME);
+
+  pad_name = g_strdup_printf ("sink_%u", index);
+  stream->sinkpad = gst_pad_new_from_template (templ, pad_name);
+  g_free (pad_name);
+  gst_pad_set_chain_function (stream->sinkpad, GST_DEBUG_FUNCPTR (gst_multiabsolutetimestamps_chain));
+  gst_pad_set_event_function (stream->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_multiabsolutetimestamps_sink_event));
+  gst_pad_set_query_function (stream->sinkpad, GST_DEBUG_FUNCPTR (gst_multiabsolutetimestamps_query));
+  GST_PAD_SET_PROXY_CAPS (stream->sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION (stream->sinkpad);
+  gst_pad_set_element_private (stream->sinkpad, stream);
+
+  pad_name = g_strdup_printf ("src_%u", index);
+  stream->srcpad = gst_pad_new_from_static_template (&gst_multiabsolutetimestamps_src_template,
+      pad_name);
+  g_free (pad_name);
+  gst_pad_set_event_function (stream->srcpad,
+      GST_DEBUG_FUNCPTR (gst_multiabsolutetimestamps_src_event));
+  gst_pad_set_query_function (stream->srcpad, GST_DEBUG_FUNCPTR (gst_multiabsolutetimestamps_query));
+  GST_PAD_SET_PROXY_CAPS (stream->srcpad);
+  gst_pad_set_element_private (stream->srcpad, stream);
+
+  g_ptr_array_index (streams, index) = stream;
+
+  g_mutex_unlock (&multiabsolutetimestamps->lock);
+
+  GST_DEBUG_OBJECT (multiabsolutetimestamps, "new stream %u", index);
+
+  // Pads added while running have to be activated by hand.
+  if (GST_STATE (element) > GST_STATE_READY || GST_STATE_TARGET (element) > GST_STATE_READY) {
+    gst_pad_set_active (stream->srcpad, TRUE);
+    gst_pad_set_active (stream->sinkpad, TRUE);
+  }
+  gst_element_add_pad (element, stream->srcpad);
+  gst_element_add_pad (element, stream->sinkpad);
+
+  return stream->sinkpad;
+}
+
+// The stream's column stays in the table, blank from now on, so that the other columns keep their
+// positions. It isn't given to any later pad.
+static void
+gst_multiabsolutetimestamps_release_pad (GstElement * element, GstPad * pad)
+{
+  GstMultiabsolutetimestamps *multiabsolutetimestamps = GST_MULTIABSOLUTETIMESTAMPS (element);
+  GstMultiabsolutetimestampsStream *stream = gst_pad_get_element_private (pad);
+
+  GST_DEBUG_OBJECT (multiabsolutetimestamps, "releasing stream %u", stream->index);
+
+  gst_pad_set_active (stream->sinkpad, FALSE);
+  gst_pad_set_active (stream->srcpad, FALSE);
+
+  g_mutex_lock (&multiabsolutetimestamps->lock);
+  g_ptr_array_index (multiabsolutetimestamps->streams, stream->index) = NULL;
+  // Its last buffer stays in the open row, which need no longer wait for it.
+  gst_multiabsolutetimestamps_close_row_if_complete (multiabsolutetimestamps);
+  g_mutex_unlock (&multiabsolutetimestamps->lock);
+
+  gst_element_remove_pad (element, stream->srcpad);
+  gst_element_remove_pad (element, stream->sinkpad);
+  g_free (stream);
+}
+
+/* states */
+
+static gboolean
+gst_multiabsolutetimestamps_start (GstMultiabsolutetimestamps * multiabsolutetimestamps)
+{
+  GstAbsolutetimestampsOutput *output = gst_absolutetimestamps_output_new ();
+  GError *error = NULL;
+  guint i;
+
+  GST_DEBUG_OBJECT (multiabsolutetimestamps, "start");
+
+  output->filename = g_strdup (multiabsolutetimestamps->filename);
+  output->format = multiabsolutetimestamps->format;
+  output->precision = multiabsolutetimestamps->precision;
+  output->clock_source = multiabsolutetimestamps->clock_source;
+  output->buffer_size = multiabsolutetimestamps->buffer_size;
+  output->flush_policy = multiabsolutetimestamps->flush_policy;
+  output->flush_records = multiabsolutetimestamps->flush_records;
+  output->flush_interval = multiabsolutetimestamps->flush_interval * GST_MSECOND;
+  output->mode = GST_ABSTS_MODE_EVERY_BUFFER;
+  output->rows = TRUE;
+  output->sink = multiabsolutetimestamps->sink;
+  output->shm_capacity = multiabsolutetimestamps->shm_capacity;
+  output->append = multiabsolutetimestamps->append;
+  output->sync_writes = multiabsolutetimestamps->sync_writes;
+  output->direct_io = multiabsolutetimestamps->direct_io;
+
+  if (!gst_absolutetimestamps_output_open (output, &error)) {
+    GST_ELEMENT_ERROR (multiabsolutetimestamps, RESOURCE, OPEN_WRITE,
+        ("Could not open \"%s\" for writing.", multiabsolutetimestamps->filename),
+        ("%s", error->message));
+    g_error_free (error);
+    gst_absolutetimestamps_output_free (output);
+    return FALSE;
+  }
+
+  g_mutex_lock (&multiabsolutetimestamps->lock);
+  multiabsolutetimestamps->output = output;
+  multiabsolutetimestamps->failed = FALSE;
+  multiabsolutetimestamps->rows = 0;
+  gst_absolutetimestamps_clock_init (&multiabsolutetimestamps->clock,
+      multiabsolutetimestamps->clock_source);
+  for (i = 0; i < multiabsolutetimestamps->row_columns; i++)
+    multiabsolutetimestamps->row[i].pts = GST_CLOCK_TIME_NONE;
+  multiabsolutetimestamps->row_filled = 0;
+  for (i = 0; i < multiabsolutetimestamps->streams->len; i++) {
+    GstMultiabsolutetimestampsStream *stream =
+        g_ptr_array_index (multiabsolutetimestamps->streams, i);
+
+    if (stream != NULL) {
+      stream->eos = FALSE;
+      gst_segment_init (&stream->segment, GST_FORMAT_TIME);
+    }
+  }
+  g_mutex_unlock (&multiabsolutetimestamps->lock);
+
+  return TRUE;
+}
+
+// The pads are inactive by now, so no streaming thread can still be adding to the row.
+static void
+gst_multiabsolutetimestamps_stop (GstMultiabsolutetimestamps * multiabsolutetimestamps)
+{
+  GError *error = NULL;
+
+  GST_DEBUG_OBJECT (multiabsolutetimestamps, "stop");
+
+  g_mutex_lock (&multiabsolutetimestamps->lock);
+
+  if (!multiabsolutetimestamps->failed)
+    gst_multiabsolutetimestamps_close_row (multiabsolutetimestamps);
+
+  if (multiabsolutetimestamps->output) {
+    if (!gst_absolutetimestamps_output_close (multiabsolutetimestamps->output, &error)) {
+      GST_ELEMENT_ERROR (multiabsolutetimestamps, RESOURCE, CLOSE,
+          ("Error closing file \"%s\".", multiabsolutetimestamps->filename),
+          ("%s", error->message));
+      g_error_free (error);
+    }
+
+    gst_absolutetimestamps_output_free (multiabsolutetimestamps->output);
+    multiabsolutetimestamps->output = NULL;
+  }
+
+  gst_absolutetimestamps_clock_clear (&multiabsolutetimestamps->clock);
+
+  g_mutex_unlock (&multiabsolutetimestamps->lock);
+}
+
+static GstStateChangeReturn
+gst_multiabsolutetimestamps_change_state (GstElement * element, GstStateChange transition)
+{
+  GstMultiabsolutetimestamps *multiabsolutetimestamps = GST_MULTIABSOLUTETIMESTAMPS (element);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED &&
+      !gst_multiabsolutetimestamps_start (multiabsolutetimestamps))
+    return GST_STATE_CHANGE_FAILURE;
+
+  ret = GST_ELEMENT_CLASS (gst_multiabsolutetimestamps_parent_class)->change_state (element,
+      transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY ||
+      (transition == GST_STATE_CHANGE_READY_TO_PAUSED && ret == GST_STATE_CHANGE_FAILURE))
+    gst_multiabsolutetimestamps_stop (multiabsolutetimestamps);
+
+  return ret;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_MULTIABSOLUTETIMESTAMPS_H_
+#define _GST_MULTIABSOLUTETIMESTAMPS_H_
+
+#include <gst/gst.h>
+
+#include "gstabsolutetimestampsclock.h"
+#include "gstabsolutetimestampsoutput.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_MULTIABSOLUTETIMESTAMPS   (gst_multiabsolutetimestamps_get_type())
+#define GST_MULTIABSOLUTETIMESTAMPS(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_MULTIABSOLUTETIMESTAMPS,GstMultiabsolutetimestamps))
+#define GST_MULTIABSOLUTETIMESTAMPS_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_MULTIABSOLUTETIMESTAMPS,GstMultiabsolutetimestampsClass))
+#define GST_IS_MULTIABSOLUTETIMESTAMPS(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_MULTIABSOLUTETIMESTAMPS))
+#define GST_IS_MULTIABSOLUTETIMESTAMPS_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_MULTIABSOLUTETIMESTAMPS))
+
+typedef struct _GstMultiabsolutetimestamps GstMultiabsolutetimestamps;
+typedef struct _GstMultiabsolutetimestampsClass GstMultiabsolutetimestampsClass;
+typedef struct _GstMultiabsolutetimestampsStream GstMultiabsolutetimestampsStream;
+
+// One requested sink_%u pad and the src_%u pad its buffers are passed through to.
+struct _GstMultiabsolutetimestampsStream
+{
+  guint index;
+  GstPad *sinkpad;
+  GstPad *srcpad;
+  GstSegment segment;
+  gboolean eos;
+};
+
+// Records several streams against shared clock readings: a row is started, and the clock read, by
+// the first buffer after the previous row and holds the pts of one buffer from each stream. It's
+// written out once every stream that isn't at EOS has a buffer in it, or as soon as a stream has a
+// second buffer for it, in which case the streams still missing are left blank.
+struct _GstMultiabsolutetimestamps
+{
+  GstElement base_multiabsolutetimestamps;
+
+  gchar *filename;
+  GstAbsolutetimestampsFormat format;
+  GstAbsolutetimestampsPrecision precision;
+  GstAbsolutetimestampsClockSource clock_source;
+  guint buffer_size;
+  GstAbsolutetimestampsFlushPolicy flush_policy;
+  guint flush_records;
+  guint flush_interval;
+  GstAbsolutetimestampsSink sink;
+  guint shm_capacity;
+  gboolean append;
+  gboolean sync_writes;
+  gboolean direct_io;
+
+  // Guards everything below. Every stream's streaming thread takes it for each buffer, and rows are
+  // written out while holding it.
+  GMutex lock;
+  GPtrArray *streams;           /* by pad index, NULL where a pad was released or never requested */
+  GstAbsolutetimestampsClock clock;
+  GstAbsolutetimestampsOutput *output;
+  gboolean failed;
+
+  // The open row, one column per entry of streams. A column's pts is GST_CLOCK_TIME_NONE until its
+  // stream has a buffer in the row.
+  GstAbsolutetimestampsRecord *row;
+  guint row_columns;
+  guint row_filled;
+  gint64 row_wallclock;
+  guint64 rows;
+};
+
+struct _GstMultiabsolutetimestampsClass
+{
+  GstElementClass base_multiabsolutetimestamps_class;
+};
+
+GType gst_multiabsolutetimestamps_get_type (void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Drives absolutetimestamps through a GstHarness with synthetic buffers and reports what each
+// buffer costs on the streaming thread, so changes to the element can be compared run-to-run:
+//
+//   $ make bench BENCH_ARGS="--buffers 5000000 --threads 4 --mode binary,async"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+
+#define BASELINE_BUFFERS 10000
+#define KEYFRAME_INTERVAL 30
+#define FRAME_DURATION (GST_SECOND / 30)
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *properties;
+} BenchMode;
+
+static const BenchMode modes[] = {
+  {"text", "format=text"},
+  {"binary", "format=binary"},
+  {"async", "format=binary async-write=true ring-capacity=65536"},
+  {"meta", "output=meta"},
+  {NULL, NULL}
+};
+
+typedef struct
+{
+  const BenchMode *mode;
+  gchar *location;
+  guint64 n_buffers;
+
+  GThread *thread;
+  gboolean ok;
+  gint64 elapsed;               /* ns spent pushing */
+  gdouble baseline_allocations; /* per buffer, for creating the buffer itself */
+  guint64 allocations;
+  guint64 bytes;
+  guint64 dropped;
+} BenchJob;
+
+// All jobs of a run set up their harness and then wait here, so that they push concurrently.
+static GMutex start_lock;
+static GCond start_cond;
+static guint n_waiting;
+static guint n_jobs;
+static gboolean started;
+
+/* allocation counting */
+
+// Counted per thread so that the counters themselves don't add contention. Only the streaming
+// thread is measured - an async writer thread's allocations aren't included.
+static __thread guint64 thread_allocations;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+void *
+malloc (size_t size)
+{
+  thread_allocations++;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  thread_allocations++;
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  thread_allocations++;
+  return __libc_realloc (ptr, size);
+}
+#endif
+
+static GstBuffer *
+bench_buffer_new (guint64 index)
+{
+  GstBuffer *buffer = gst_buffer_new ();
+
+  GST_BUFFER_PTS (buffer) = index * FRAME_DURATION;
+  GST_BUFFER_DURATION (buffer) = FRAME_DURATION;
+  if (index % KEYFRAME_INTERVAL != 0)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return buffer;
+}
+
+static gint64
+bench_get_time (void)
+{
+  return g_get_monotonic_time () * 1000;
+}
+
+static void
+bench_wait_for_start (void)
+{
+  g_mutex_lock (&start_lock);
+  if (++n_waiting == n_jobs) {
+    started = TRUE;
+    g_cond_broadcast (&start_cond);
+  }
+  while (!started)
+    g_cond_wait (&start_cond, &start_lock);
+  g_mutex_unlock (&start_lock);
+}
+
+static gpointer
+bench_job_run (gpointer data)
+{
+  BenchJob *job = data;
+  GstHarness *harness;
+  gchar *description;
+  guint64 i, allocations;
+  gint64 start;
+  GStatBuf st;
+
+  description = g_strdup_printf ("absolutetimestamps location=\"%s\" %s", job->location,
+      job->mode->properties);
+  harness = gst_harness_new_parse (description);
+  g_free (description);
+
+  gst_harness_set_src_caps_str (harness, "application/x-absts-bench");
+  gst_harness_set_drop_buffers (harness, TRUE);
+  gst_harness_play (harness);
+
+  // What creating and freeing a buffer costs by itself, so that it can be taken out of the totals.
+  allocations = thread_allocations;
+  for (i = 0; i < BASELINE_BUFFERS; i++)
+    gst_buffer_unref (bench_buffer_new (i));
+  job->baseline_allocations = (gdouble) (thread_allocations - allocations) / BASELINE_BUFFERS;
+
+  bench_wait_for_start ();
+
+  job->ok = TRUE;
+  allocations = thread_allocations;
+  start = bench_get_time ();
+  for (i = 0; i < job->n_buffers; i++) {
+    if (gst_harness_push (harness, bench_buffer_new (i)) != GST_FLOW_OK) {
+      job->ok = FALSE;
+      break;
+    }
+  }
+  job->elapsed = bench_get_time () - start;
+  job->allocations = thread_allocations - allocations;
+
+  g_object_get (harness->element, "dropped", &job->dropped, NULL);
+
+  // Tearing down stops the element, which writes out anything still buffered.
+  gst_harness_teardown (harness);
+
+  if (g_stat (job->location, &st) == 0)
+    job->bytes = st.st_size;
+
+  return NULL;
+}
+
+static const BenchMode *
+bench_find_mode (const gchar * name)
+{
+  const BenchMode *mode;
+
+  for (mode = modes; mode->name != NULL; mode++)
+    if (g_strcmp0 (mode->name, name) == 0)
+      return mode;
+
+  return NULL;
+}
+
+static gboolean
+bench_run_mode (const BenchMode * mode, const gchar * directory, guint threads,
+    guint64 n_buffers, gboolean keep)
+{
+  BenchJob *jobs = g_new0 (BenchJob, threads);
+  gdouble ns_per_buffer = 0, allocations = 0, bytes = 0, seconds = 0;
+  guint64 dropped = 0;
+  gboolean ok = TRUE;
+  guint i;
+
+  n_jobs = threads;
+  n_waiting = 0;
+  started = FALSE;
+
+  for (i = 0; i < threads; i++) {
+    gchar *name = g_strdup_printf ("%s-%u.log", mode->name, i);
+
+    jobs[i].mode = mode;
+    jobs[i].location = g_build_filename (directory, name, NULL);
+    jobs[i].n_buffers = n_buffers;
+    jobs[i].thread = g_thread_new ("absts-bench", bench_job_run, &jobs[i]);
+    g_free (name);
+  }
+
+  for (i = 0; i < threads; i++) {
+    BenchJob *job = &jobs[i];
+    guint64 pushed = job->n_buffers;
+
+    g_thread_join (job->thread);
+
+    ok = ok && job->ok;
+    ns_per_buffer += (gdouble) job->elapsed / pushed;
+    allocations += (gdouble) job->allocations / pushed - job->baseline_allocations;
+    bytes += (gdouble) job->bytes / pushed;
+    seconds = MAX (seconds, job->elapsed / (gdouble) GST_SECOND);
+    dropped += job->dropped;
+
+    if (!keep)
+      g_unlink (job->location);
+    g_free (job->location);
+  }
+
+  g_print ("%-8s %8u %14" G_GUINT64_FORMAT " %12.1f %14.2f %14.1f %12.2f %10" G_GUINT64_FORMAT
+      "%s\n", mode->name, threads, n_buffers, ns_per_buffer / threads, allocations / threads,
+      bytes / threads, (gdouble) n_buffers * threads / seconds / 1e6, dropped,
+      ok ? "" : "  FAILED");
+
+  g_free (jobs);
+
+  return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint64 n_buffers = 1000000;
+  gint threads = 1;
+  gchar *mode_names = NULL;
+  gchar *plugin_path = NULL;
+  gboolean keep = FALSE;
+  GOptionEntry entries[] = {
+    {"buffers", 'n', 0, G_OPTION_ARG_INT64, &n_buffers, "Buffers to push per pipeline (default 1000000)", "N"},
+    {"threads", 't', 0, G_OPTION_ARG_INT, &threads, "Pipelines to run in parallel (default 1)", "N"},
+    {"mode", 'm', 0, G_OPTION_ARG_STRING, &mode_names, "Comma-separated modes: text, binary, async, meta (default all)", "MODES"},
+    {"plugin-path", 'p', 0, G_OPTION_ARG_FILENAME, &plugin_path, "Directory to load the plugin from", "DIR"},
+    {"keep", 'k', 0, G_OPTION_ARG_NONE, &keep, "Keep the files written", NULL},
+    {NULL}
+  };
+  GOptionContext *context;
+  GError *error = NULL;
+  gchar *directory;
+  gchar **names;
+  gboolean ok = TRUE;
+  guint i;
+
+  context = g_option_context_new ("- benchmark the absolutetimestamps element");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gst_init_get_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+  g_option_context_free (context);
+
+  if (n_buffers <= 0 || threads <= 0) {
+    g_printerr ("--buffers and --threads must be positive\n");
+    return 2;
+  }
+
+  // Default to the plugin in the build tree, so the benchmark doesn't need it to be installed.
+#ifdef BENCH_PLUGIN_PATH
+  if (plugin_path == NULL)
+    plugin_path = g_strdup (BENCH_PLUGIN_PATH);
+#endif
+  if (plugin_path != NULL)
+    gst_registry_scan_path (gst_registry_get (), plugin_path);
+
+  if (gst_registry_find_plugin (gst_registry_get (), "absolutetimestamps") == NULL) {
+    g_printerr ("Could not find the absolutetimestamps plugin, try --plugin-path\n");
+    return 2;
+  }
+
+  directory = g_dir_make_tmp ("absts-bench-XXXXXX", &error);
+  if (directory == NULL) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+
+  names = g_strsplit (mode_names ? mode_names : "text,binary,async,meta", ",", -1);
+
+  g_print ("%-8s %8s %14s %12s %14s %14s %12s %10s\n", "mode", "threads", "buffers",
+      "ns/buffer", "allocs/buffer", "bytes/buffer", "Mbuffers/s", "dropped");
+
+  for (i = 0; names[i] != NULL; i++) {
+    const BenchMode *mode = bench_find_mode (names[i]);
+
+    if (mode == NULL) {
+      g_printerr ("Unknown mode \"%s\"\n", names[i]);
+      ok = FALSE;
+      continue;
+    }
+
+    ok = bench_run_mode (mode, directory, threads, n_buffers, keep) && ok;
+  }
+
+  if (keep)
+    g_print ("Files kept in %s\n", directory);
+  else
+    g_rmdir (directory);
+
+  g_strfreev (names);
+  g_free (directory);
+  g_free (mode_names);
+  g_free (plugin_path);
+
+  return ok ? 0 : 1;
+}
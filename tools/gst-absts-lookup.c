@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Resolves wallclock or pts queries against a timestamp log, text or binary, without reading it all:
+//
+//   $ gst-absts-lookup timestamps.log 14:03:22.5 2019-05-01T14:03:23Z
+//   $ gst-absts-lookup --pts timestamps.bin 0:01:02.500000000
+//
+// For each query it prints the last record at or before it, i.e. the frame that was showing then.
+// A binary log is searched directly. A text log is entered at the nearest entry of its seek index
+// (<log>.idx, see absolutetimestamps seek-index=true) and only read from there, which without an
+// index means from the start.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gstabstsindex.h"
+#include "gstabstsreader.h"
+#include "gst-absts-text.h"
+
+typedef struct
+{
+  gboolean by_pts;
+  gint stream;                  /* -1 for any */
+  gint64 reference_day;         /* start of the day of the first record, for time-of-day queries */
+  GstAbstsTextParser parser;
+} Lookup;
+
+typedef struct
+{
+  const gchar *line;
+  gsize length;
+  guint64 pts;
+  gint64 wallclock;
+} TextRecord;
+
+/* parsing */
+
+static gboolean
+parse_query (const Lookup * lookup, const gchar * query, guint64 * key)
+{
+  const gchar *p = query, *end = query + strlen (query);
+  gchar *number_end;
+  guint64 time;
+  gint64 wallclock;
+
+  // A plain number is nanoseconds, of pts or since the epoch.
+  *key = g_ascii_strtoull (query, &number_end, 10);
+  if (number_end != query && *number_end == '\0')
+    return TRUE;
+
+  if (lookup->by_pts)
+    return gst_absts_text_parse_clock_time (&p, end, key) && p == end;
+
+  if (gst_absts_text_parse_iso8601 (&p, end, &wallclock) && p == end) {
+    *key = (guint64) wallclock;
+    return TRUE;
+  }
+
+  // Otherwise it's a time of day on the day the log starts.
+  p = query;
+  if (!gst_absts_text_parse_clock_time (&p, end, &time) || p != end || time >= (guint64) NS_PER_DAY)
+    return FALSE;
+
+  *key = (guint64) (lookup->reference_day + (gint64) time);
+
+  return TRUE;
+}
+
+/* output */
+
+static void
+print_record (guint64 pts, gint64 wallclock)
+{
+  gchar line[GST_ABSTS_TEXT_LINE_SIZE];
+
+  fwrite (line, 1, gst_absts_text_format_record (line, pts, wallclock), stdout);
+}
+
+/* binary logs */
+
+static gboolean
+lookup_binary (Lookup * lookup, const gchar * filename, gchar ** queries)
+{
+  GError *error = NULL;
+  GstAbstsReader *reader = gst_absts_reader_open (filename, &error);
+  GstAbstsRecord record;
+  gboolean ok = TRUE;
+  guint i;
+
+  if (reader == NULL) {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
+  if (lookup->stream >= 0)
+    gst_absts_reader_select_stream (reader, (guint32) lookup->stream);
+
+  if (gst_absts_reader_get_record (reader, 0, &record))
+    lookup->reference_day = record.wallclock - record.wallclock % NS_PER_DAY;
+
+  for (i = 0; queries[i] != NULL; i++) {
+    guint64 key;
+    gssize found;
+
+    if (!parse_query (lookup, queries[i], &key)) {
+      g_printerr ("Could not parse \"%s\"\n", queries[i]);
+      ok = FALSE;
+      continue;
+    }
+
+    found = lookup->by_pts ? gst_absts_reader_find_pts (reader, key) :
+        gst_absts_reader_find_wallclock (reader, (gint64) key);
+
+    if (found < 0) {
+      g_printerr ("No record at or before \"%s\"\n", queries[i]);
+      ok = FALSE;
+      continue;
+    }
+
+    gst_absts_reader_get_record (reader, found, &record);
+    print_record (record.pts, record.wallclock);
+  }
+
+  gst_absts_reader_close (reader);
+
+  return ok;
+}
+
+/* text logs */
+
+// Reads forward from offset to the last record at or before key, stopping at the first one after it.
+static gboolean
+scan_text (Lookup * lookup, const gchar * contents, gsize length, guint64 offset, guint64 key,
+    TextRecord * found)
+{
+  const gchar *p = contents + MIN (offset, length), *end = contents + length;
+  gboolean any = FALSE;
+
+  while (p < end) {
+    const gchar *eol = memchr (p, '\n', end - p);
+    TextRecord record;
+    gint stream;
+
+    if (eol == NULL)
+      break;                    // a torn final line
+
+    if (gst_absts_text_parse_record (&lookup->parser, p, eol, &stream, &record.pts,
+            &record.wallclock) &&
+        (lookup->stream < 0 || stream == lookup->stream)) {
+      if ((lookup->by_pts ? record.pts : (guint64) record.wallclock) > key)
+        break;
+
+      record.line = p;
+      record.length = eol - p;
+      *found = record;
+      any = TRUE;
+    }
+
+    p = eol + 1;
+  }
+
+  return any;
+}
+
+static gboolean
+first_text_record (Lookup * lookup, const gchar * contents, gsize length, TextRecord * first)
+{
+  const gchar *p = contents, *end = contents + length, *eol;
+  gint stream;
+
+  for (; p < end && (eol = memchr (p, '\n', end - p)) != NULL; p = eol + 1) {
+    if (gst_absts_text_parse_record (&lookup->parser, p, eol, &stream, &first->pts,
+            &first->wallclock) &&
+        (lookup->stream < 0 || stream == lookup->stream))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gboolean
+lookup_text (Lookup * lookup, const gchar * filename, const gchar * index_filename,
+    GMappedFile * mapped_file, gchar ** queries)
+{
+  const gchar *contents = g_mapped_file_get_contents (mapped_file);
+  gsize length = g_mapped_file_get_length (mapped_file);
+  GstAbstsIndex *index = NULL;
+  GError *error = NULL;
+  TextRecord first;
+  gboolean ok = TRUE;
+  guint i;
+
+  if (g_file_test (index_filename, G_FILE_TEST_EXISTS)) {
+    index = gst_absts_index_open (index_filename, &error);
+    if (index == NULL) {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+  } else {
+    g_printerr ("No seek index \"%s\", reading \"%s\" from the start\n", index_filename, filename);
+  }
+
+  if (first_text_record (lookup, contents, length, &first))
+    lookup->reference_day = first.wallclock - first.wallclock % NS_PER_DAY;
+
+  for (i = 0; queries[i] != NULL; i++) {
+    guint64 key, offset = 0;
+    TextRecord record;
+    gssize entry = -1;
+
+    if (!parse_query (lookup, queries[i], &key)) {
+      g_printerr ("Could not parse \"%s\"\n", queries[i]);
+      ok = FALSE;
+      continue;
+    }
+
+    if (index != NULL) {
+      GstAbstsIndexEntry found;
+
+      entry = lookup->by_pts ? gst_absts_index_find_pts (index, key) :
+          gst_absts_index_find_wallclock (index, (gint64) key);
+      if (entry >= 0 && gst_absts_index_get_entry (index, entry, &found))
+        offset = found.offset;
+    }
+
+    if (!scan_text (lookup, contents, length, offset, key, &record)) {
+      g_printerr ("No record at or before \"%s\"\n", queries[i]);
+      ok = FALSE;
+      continue;
+    }
+
+    g_print ("%.*s\n", (gint) record.length, record.line);
+  }
+
+  if (index != NULL)
+    gst_absts_index_close (index);
+
+  return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+  Lookup lookup = { FALSE, -1, 0 };
+  gchar *index_filename = NULL;
+  GOptionEntry entries[] = {
+    {"pts", 'p', 0, G_OPTION_ARG_NONE, &lookup.by_pts, "Queries are pts rather than wallclocks", NULL},
+    {"stream", 's', 0, G_OPTION_ARG_INT, &lookup.stream, "Only consider this stream of a writer group's log", "ID"},
+    {"index", 'i', 0, G_OPTION_ARG_FILENAME, &index_filename, "Seek index of a text log (default LOG.idx)", "FILE"},
+    {NULL}
+  };
+  GOptionContext *context;
+  GMappedFile *mapped_file;
+  GError *error = NULL;
+  gboolean ok;
+
+  context = g_option_context_new ("LOG QUERY... - look up the records of a timestamp log");
+  g_option_context_set_description (context,
+      "A wallclock QUERY is YYYY-MM-DDTHH:MM:SS.fffZ, a time of day HH:MM:SS.fff (on the day the\n"
+      "log starts) or nanoseconds since the epoch. With --pts, a QUERY is H:MM:SS.fff or nanoseconds.\n");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+  g_option_context_free (context);
+
+  gst_absts_text_parser_init (&lookup.parser);
+
+  if (argc < 3) {
+    g_printerr ("Usage: %s [--pts] [--stream ID] LOG QUERY...\n", argv[0]);
+    return 2;
+  }
+
+  mapped_file = g_mapped_file_new (argv[1], FALSE, &error);
+  if (mapped_file == NULL) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+
+  if (g_mapped_file_get_length (mapped_file) >= GST_ABSTS_MAGIC_SIZE &&
+      memcmp (g_mapped_file_get_contents (mapped_file), GST_ABSTS_MAGIC, GST_ABSTS_MAGIC_SIZE) == 0) {
+    ok = lookup_binary (&lookup, argv[1], argv + 2);
+  } else {
+    if (index_filename == NULL)
+      index_filename = g_strconcat (argv[1], ".idx", NULL);
+    ok = lookup_text (&lookup, argv[1], index_filename, mapped_file, argv + 2);
+  }
+
+  g_mapped_file_unref (mapped_file);
+  g_free (index_filename);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,641 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Bulk queries over timestamp logs, text or binary, e.g. over a day's worth of rotated files:
+//
+//   $ gst-absts-query range --from 2019-05-01T14:00:00Z --to 2019-05-01T14:05:00Z timestamps-*.log
+//   $ gst-absts-query jitter --bucket 60 timestamps-*.bin
+//   $ gst-absts-query gaps --frames 2.5 timestamps-*.bin
+//
+// Each log is memory-mapped and split into one chunk per thread on record boundaries - any multiple
+// of the record size in binary, the start of a line in text. The chunks are scanned in parallel and
+// their results merged in order, with the pair of records straddling each boundary handled during
+// the merge. Text is parsed with gst_absts_text_parse_record, which reads the fixed-width digits a
+// word at a time.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gstabstsindex.h"
+#include "gstabstsreader.h"
+#include "gst-absts-text.h"
+
+// Below this, splitting a text log up costs more than it saves.
+#define MIN_CHUNK_SIZE (1024 * 1024)
+#define FRAME_DURATION_SAMPLES 1001
+
+typedef enum
+{
+  COMMAND_RANGE,
+  COMMAND_JITTER,
+  COMMAND_GAPS
+} Command;
+
+typedef struct
+{
+  Command command;
+  gint stream;                  /* -1 for any */
+  gint64 from;                  /* range, inclusive */
+  gint64 to;
+  gint64 bucket;                /* jitter, ns of wallclock per summary line */
+  gdouble frames;               /* gaps, in frame durations */
+  guint64 frame_duration;
+} Query;
+
+// The jitter of a record is how much more (or less) wallclock than pts has passed since the
+// previous one.
+typedef struct
+{
+  gint64 start;
+  guint64 count;
+  gint64 min;
+  gint64 max;
+  gdouble sum;
+} Bucket;
+
+typedef struct
+{
+  gboolean valid;
+  guint64 pts;
+  gint64 wallclock;
+} Sample;
+
+typedef struct _Chunk Chunk;
+
+// Returns FALSE to stop iterating. A discontinuity, i.e. a DISCONT buffer or a segment or flush
+// marker, means the sample isn't comparable with the one before it.
+typedef gboolean (*SampleFunc) (Chunk * chunk, const Sample * sample, gboolean discont);
+
+struct _Chunk
+{
+  const Query *query;
+
+  // Either a range of records of a binary log or a range of bytes of a text one.
+  GstAbstsReader *reader;
+  gsize begin;
+  gsize end;
+  const gchar *text;
+  const gchar *text_end;
+
+  GThread *thread;
+
+  Sample first;
+  gboolean first_discont;
+  Sample last;
+  gboolean last_discont;        /* a marker follows the last sample */
+  GString *out;
+  GHashTable *buckets;          /* bucket start -> Bucket */
+  GArray *deltas;               /* for estimating the frame duration */
+};
+
+/* results */
+
+static void
+add_jitter (GHashTable * buckets, gint64 bucket_size, gint64 wallclock, gint64 jitter)
+{
+  gint64 start = wallclock - ((wallclock % bucket_size) + bucket_size) % bucket_size;
+  Bucket *bucket = g_hash_table_lookup (buckets, &start);
+
+  if (bucket == NULL) {
+    bucket = g_new0 (Bucket, 1);
+    bucket->start = start;
+    bucket->min = G_MAXINT64;
+    bucket->max = G_MININT64;
+    g_hash_table_insert (buckets, &bucket->start, bucket);
+  }
+
+  bucket->count++;
+  bucket->sum += (gdouble) jitter;
+  bucket->min = MIN (bucket->min, jitter);
+  bucket->max = MAX (bucket->max, jitter);
+}
+
+static void
+merge_bucket (GHashTable * buckets, const Bucket * from)
+{
+  Bucket *bucket = g_hash_table_lookup (buckets, &from->start);
+
+  if (bucket == NULL) {
+    bucket = g_new (Bucket, 1);
+    *bucket = *from;
+    g_hash_table_insert (buckets, &bucket->start, bucket);
+    return;
+  }
+
+  bucket->count += from->count;
+  bucket->sum += from->sum;
+  bucket->min = MIN (bucket->min, from->min);
+  bucket->max = MAX (bucket->max, from->max);
+}
+
+// Handles two consecutive samples of the same segment.
+static void
+add_pair (const Query * query, GString * out, GHashTable * buckets, const Sample * previous,
+    const Sample * sample)
+{
+  gchar pts[GST_ABSTS_TEXT_LINE_SIZE], previous_pts[GST_ABSTS_TEXT_LINE_SIZE];
+  gchar wallclock[GST_ABSTS_TEXT_LINE_SIZE];
+
+  switch (query->command) {
+    case COMMAND_JITTER:
+      add_jitter (buckets, query->bucket, sample->wallclock,
+          (sample->wallclock - previous->wallclock) - (gint64) (sample->pts - previous->pts));
+      break;
+    case COMMAND_GAPS:
+      if (sample->pts > previous->pts &&
+          (gdouble) (sample->pts - previous->pts) > query->frames * query->frame_duration) {
+        gst_absts_text_format_pts (previous_pts, previous->pts);
+        gst_absts_text_format_pts (pts, sample->pts);
+        gst_absts_text_format_wallclock (wallclock, sample->wallclock);
+        g_string_append_printf (out, "%s -> %s at %s: %.1f frames\n", previous_pts, pts, wallclock,
+            (gdouble) (sample->pts - previous->pts) / query->frame_duration);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static gboolean
+chunk_add_sample (Chunk * chunk, const Sample * sample, gboolean discont)
+{
+  const Query *query = chunk->query;
+
+  if (!chunk->first.valid) {
+    chunk->first = *sample;
+    chunk->first_discont = discont;
+  } else if (!discont && chunk->last.valid) {
+    add_pair (query, chunk->out, chunk->buckets, &chunk->last, sample);
+  }
+
+  if (query->command == COMMAND_RANGE && sample->wallclock >= query->from &&
+      sample->wallclock <= query->to) {
+    gchar line[GST_ABSTS_TEXT_LINE_SIZE];
+
+    g_string_append_len (chunk->out, line, gst_absts_text_format_record (line, sample->pts,
+            sample->wallclock));
+  }
+
+  chunk->last = *sample;
+
+  return TRUE;
+}
+
+static gboolean
+chunk_add_delta (Chunk * chunk, const Sample * sample, gboolean discont)
+{
+  if (chunk->last.valid && !discont && sample->pts > chunk->last.pts) {
+    guint64 delta = sample->pts - chunk->last.pts;
+
+    g_array_append_val (chunk->deltas, delta);
+  }
+
+  chunk->last = *sample;
+
+  return chunk->deltas->len < FRAME_DURATION_SAMPLES;
+}
+
+/* scanning */
+
+static void
+chunk_scan (Chunk * chunk, SampleFunc func)
+{
+  Sample sample = { TRUE, 0, 0 };
+
+  if (chunk->reader != NULL) {
+    GstAbstsRecord record;
+    gsize i;
+
+    for (i = chunk->begin; i < chunk->end; i++) {
+      gst_absts_reader_get_record (chunk->reader, i, &record);
+      sample.pts = record.pts;
+      sample.wallclock = record.wallclock;
+      if (!func (chunk, &sample, (record.flags & GST_ABSTS_RECORD_FLAG_DISCONT) != 0))
+        return;
+    }
+  } else {
+    const gchar *p = chunk->text, *eol;
+    GstAbstsTextParser parser;
+    gboolean discont = FALSE;
+    gint stream;
+
+    gst_absts_text_parser_init (&parser);
+
+    for (; p < chunk->text_end && (eol = memchr (p, '\n', chunk->text_end - p)) != NULL; p = eol + 1) {
+      if (!gst_absts_text_parse_record (&parser, p, eol, &stream, &sample.pts, &sample.wallclock)) {
+        // Segment and flush markers, the text log has no DISCONT flags.
+        if (*p == '#' && (g_str_has_prefix (p, "# segment") || g_str_has_prefix (p, "# flush")))
+          discont = TRUE;
+        continue;
+      }
+
+      if (chunk->query->stream >= 0 && stream != chunk->query->stream)
+        continue;
+
+      if (!func (chunk, &sample, discont))
+        return;
+      discont = FALSE;
+    }
+
+    chunk->last_discont = discont;
+  }
+}
+
+static gpointer
+chunk_thread (gpointer data)
+{
+  chunk_scan ((Chunk *) data, chunk_add_sample);
+
+  return NULL;
+}
+
+static void
+chunk_init (Chunk * chunk, const Query * query)
+{
+  memset (chunk, 0, sizeof (Chunk));
+  chunk->query = query;
+  chunk->out = g_string_new (NULL);
+  chunk->buckets = g_hash_table_new (g_int64_hash, g_int64_equal);
+}
+
+static void
+chunk_clear (Chunk * chunk)
+{
+  g_string_free (chunk->out, TRUE);
+  g_hash_table_unref (chunk->buckets);
+}
+
+/* logs */
+
+typedef struct
+{
+  const Query *query;
+  guint threads;
+
+  // Carried from one log to the next, which is usually the next file of a rotated sequence.
+  Sample previous;
+  GHashTable *buckets;
+} Scan;
+
+static gint
+compare_deltas (gconstpointer a, gconstpointer b)
+{
+  guint64 x = *(const guint64 *) a, y = *(const guint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+// The median pts delta near the start of the log, which for video is almost always a frame.
+static guint64
+estimate_frame_duration (Chunk * whole)
+{
+  Chunk chunk = *whole;
+  guint64 duration = 0;
+
+  chunk.last.valid = FALSE;
+  chunk.deltas = g_array_new (FALSE, FALSE, sizeof (guint64));
+  chunk_scan (&chunk, chunk_add_delta);
+
+  if (chunk.deltas->len > 0) {
+    g_array_sort (chunk.deltas, compare_deltas);
+    duration = g_array_index (chunk.deltas, guint64, chunk.deltas->len / 2);
+  }
+
+  g_array_free (chunk.deltas, TRUE);
+
+  return duration;
+}
+
+// Splits whole into n chunks on record boundaries and scans them in parallel, then merges the
+// results in order.
+static void
+scan_chunks (Scan * scan, Chunk * whole)
+{
+  guint i, n = scan->threads;
+  Chunk *chunks;
+
+  if (whole->reader != NULL)
+    n = MIN (n, MAX ((whole->end - whole->begin) / (MIN_CHUNK_SIZE / GST_ABSTS_RECORD_SIZE), 1));
+  else
+    n = MIN (n, MAX ((gsize) (whole->text_end - whole->text) / MIN_CHUNK_SIZE, 1));
+
+  chunks = g_new (Chunk, n);
+
+  for (i = 0; i < n; i++) {
+    Chunk *chunk = &chunks[i];
+
+    chunk_init (chunk, scan->query);
+    chunk->reader = whole->reader;
+
+    if (whole->reader != NULL) {
+      gsize length = whole->end - whole->begin;
+
+      chunk->begin = whole->begin + length * i / n;
+      chunk->end = whole->begin + length * (i + 1) / n;
+    } else {
+      gsize length = whole->text_end - whole->text;
+
+      // Each chunk starts at the first line that starts in its share of the bytes.
+      chunk->text = whole->text + length * i / n;
+      if (i > 0) {
+        const gchar *eol = memchr (chunk->text - 1, '\n', whole->text_end - (chunk->text - 1));
+
+        chunk->text = eol ? eol + 1 : whole->text_end;
+      }
+      if (i > 0)
+        chunks[i - 1].text_end = chunk->text;
+      chunk->text_end = whole->text_end;
+    }
+  }
+
+  for (i = 0; i < n; i++)
+    chunks[i].thread = g_thread_new ("absts-query", chunk_thread, &chunks[i]);
+
+  for (i = 0; i < n; i++) {
+    Chunk *chunk = &chunks[i];
+    GHashTableIter iter;
+    gpointer bucket;
+
+    g_thread_join (chunk->thread);
+
+    // The pair straddling the boundary with the previous chunk, or log, comes before this chunk's own.
+    if (chunk->first.valid && scan->previous.valid && !chunk->first_discont) {
+      GString *out = g_string_new (NULL);
+
+      add_pair (scan->query, out, scan->buckets, &scan->previous, &chunk->first);
+      fwrite (out->str, 1, out->len, stdout);
+      g_string_free (out, TRUE);
+    }
+    if (chunk->last.valid)
+      scan->previous = chunk->last;
+    if (chunk->last_discont)
+      scan->previous.valid = FALSE;
+
+    fwrite (chunk->out->str, 1, chunk->out->len, stdout);
+
+    g_hash_table_iter_init (&iter, chunk->buckets);
+    while (g_hash_table_iter_next (&iter, NULL, &bucket)) {
+      merge_bucket (scan->buckets, bucket);
+      g_free (bucket);
+    }
+
+    chunk_clear (chunk);
+  }
+
+  g_free (chunks);
+}
+
+static gboolean
+scan_binary (Scan * scan, Query * query, const gchar * filename)
+{
+  GError *error = NULL;
+  GstAbstsReader *reader = gst_absts_reader_open (filename, &error);
+  gsize segment, n_segments;
+
+  if (reader == NULL) {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
+  if (query->stream >= 0)
+    gst_absts_reader_select_stream (reader, (guint32) query->stream);
+
+  // Pairs never straddle a segment or flush marker, which the reader's segments are split on. A log's
+  // first segment does continue the previous log though.
+  n_segments = gst_absts_reader_get_n_segments (reader);
+  for (segment = 0; segment < n_segments; segment++) {
+    Chunk whole;
+
+    chunk_init (&whole, query);
+    whole.reader = reader;
+    whole.begin = 0;
+    whole.end = gst_absts_reader_select_segment (reader, n_segments > 1 ? (gssize) segment : -1);
+
+    if (segment > 0)
+      scan->previous.valid = FALSE;
+
+    // Wallclocks only grow, so a range is a pair of binary searches away.
+    if (query->command == COMMAND_RANGE) {
+      whole.begin = query->from == G_MININT64 ? 0 :
+          (gsize) (gst_absts_reader_find_wallclock (reader, query->from - 1) + 1);
+      whole.end = (gsize) (gst_absts_reader_find_wallclock (reader, query->to) + 1);
+      whole.end = MAX (whole.end, whole.begin);
+    }
+
+    if (query->command == COMMAND_GAPS && query->frame_duration == 0)
+      query->frame_duration = estimate_frame_duration (&whole);
+
+    scan_chunks (scan, &whole);
+    chunk_clear (&whole);
+  }
+
+  gst_absts_reader_close (reader);
+
+  return TRUE;
+}
+
+static gboolean
+scan_text (Scan * scan, Query * query, const gchar * filename, GMappedFile * mapped_file)
+{
+  gchar *index_filename = g_strconcat (filename, ".idx", NULL);
+  GstAbstsIndex *index = NULL;
+  Chunk whole;
+
+  chunk_init (&whole, query);
+  whole.text = g_mapped_file_get_contents (mapped_file);
+  whole.text_end = whole.text + g_mapped_file_get_length (mapped_file);
+
+  // With a seek index, a range only needs the lines between the entries either side of it.
+  if (query->command == COMMAND_RANGE && g_file_test (index_filename, G_FILE_TEST_EXISTS))
+    index = gst_absts_index_open (index_filename, NULL);
+
+  if (index != NULL) {
+    GstAbstsIndexEntry entry;
+    gssize first = gst_absts_index_find_wallclock (index, query->from);
+    gssize last = gst_absts_index_find_wallclock (index, query->to);
+    const gchar *begin = whole.text, *end = whole.text_end;
+
+    if (first >= 0 && gst_absts_index_get_entry (index, first, &entry))
+      begin = whole.text + MIN (entry.offset, (guint64) (end - begin));
+    if (gst_absts_index_get_entry (index, last + 1, &entry))
+      end = whole.text + MIN (entry.offset, (guint64) (end - whole.text));
+
+    whole.text = begin;
+    whole.text_end = MAX (end, begin);
+    gst_absts_index_close (index);
+  }
+
+  if (query->command == COMMAND_GAPS && query->frame_duration == 0)
+    query->frame_duration = estimate_frame_duration (&whole);
+
+  scan_chunks (scan, &whole);
+
+  chunk_clear (&whole);
+  g_free (index_filename);
+
+  return TRUE;
+}
+
+static gint
+compare_buckets (gconstpointer a, gconstpointer b)
+{
+  const Bucket *x = *(const Bucket * const *) a, *y = *(const Bucket * const *) b;
+
+  return x->start < y->start ? -1 : x->start > y->start;
+}
+
+static void
+print_buckets (GHashTable * buckets)
+{
+  GPtrArray *sorted = g_ptr_array_new ();
+  GHashTableIter iter;
+  gpointer bucket;
+  guint i;
+
+  g_hash_table_iter_init (&iter, buckets);
+  while (g_hash_table_iter_next (&iter, NULL, &bucket))
+    g_ptr_array_add (sorted, bucket);
+  g_ptr_array_sort (sorted, compare_buckets);
+
+  g_print ("%-30s %10s %12s %12s %12s\n", "bucket", "count", "min-ns", "mean-ns", "max-ns");
+  for (i = 0; i < sorted->len; i++) {
+    const Bucket *b = g_ptr_array_index (sorted, i);
+    gchar start[GST_ABSTS_TEXT_LINE_SIZE];
+
+    gst_absts_text_format_wallclock (start, b->start);
+    g_print ("%-30s %10" G_GUINT64_FORMAT " %12" G_GINT64_FORMAT " %12.0f %12" G_GINT64_FORMAT "\n",
+        start, b->count, b->min, b->sum / b->count, b->max);
+  }
+
+  g_ptr_array_free (sorted, TRUE);
+}
+
+static gboolean
+parse_wallclock (const gchar * value, gint64 * wallclock)
+{
+  const gchar *p = value;
+  gchar *end;
+
+  *wallclock = g_ascii_strtoll (value, &end, 10);
+  if (end != value && *end == '\0')
+    return TRUE;
+
+  return gst_absts_text_parse_iso8601 (&p, value + strlen (value), wallclock) && *p == '\0';
+}
+
+int
+main (int argc, char *argv[])
+{
+  Query query = { COMMAND_RANGE, -1, G_MININT64, G_MAXINT64, 60 * NS_PER_SECOND, 2.0, 0 };
+  gint threads = (gint) g_get_num_processors ();
+  gchar *from = NULL, *to = NULL;
+  gdouble bucket = 60;
+  gint64 frame_duration = 0;
+  GOptionEntry entries[] = {
+    {"threads", 't', 0, G_OPTION_ARG_INT, &threads, "Worker threads (default one per processor)", "N"},
+    {"stream", 's', 0, G_OPTION_ARG_INT, &query.stream, "Only consider this stream of a writer group's log", "ID"},
+    {"from", 0, 0, G_OPTION_ARG_STRING, &from, "range: first wallclock, ISO 8601 or ns (default the start)", "TIME"},
+    {"to", 0, 0, G_OPTION_ARG_STRING, &to, "range: last wallclock, ISO 8601 or ns (default the end)", "TIME"},
+    {"bucket", 'b', 0, G_OPTION_ARG_DOUBLE, &bucket, "jitter: seconds of wallclock per summary line (default 60)", "S"},
+    {"frames", 'f', 0, G_OPTION_ARG_DOUBLE, &query.frames, "gaps: report pts gaps longer than this many frames (default 2)", "N"},
+    {"frame-duration", 'd', 0, G_OPTION_ARG_INT64, &frame_duration, "gaps: ns per frame (default the median pts delta)", "NS"},
+    {NULL}
+  };
+  GOptionContext *context;
+  GError *error = NULL;
+  Scan scan;
+  gboolean ok = TRUE;
+  gint i;
+
+  context = g_option_context_new ("range|jitter|gaps LOG... - query timestamp logs");
+  g_option_context_set_description (context,
+      "range   prints every record with a wallclock between --from and --to\n"
+      "jitter  summarizes, per --bucket, how much wallclock and pts deltas differ\n"
+      "gaps    prints every pts gap longer than --frames frames\n");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+  g_option_context_free (context);
+
+  if (argc < 3) {
+    g_printerr ("Usage: %s range|jitter|gaps [OPTION...] LOG...\n", argv[0]);
+    return 2;
+  }
+
+  if (g_str_equal (argv[1], "range")) {
+    query.command = COMMAND_RANGE;
+  } else if (g_str_equal (argv[1], "jitter")) {
+    query.command = COMMAND_JITTER;
+  } else if (g_str_equal (argv[1], "gaps")) {
+    query.command = COMMAND_GAPS;
+  } else {
+    g_printerr ("Unknown query \"%s\"\n", argv[1]);
+    return 2;
+  }
+
+  if ((from && !parse_wallclock (from, &query.from)) || (to && !parse_wallclock (to, &query.to))) {
+    g_printerr ("Could not parse --from or --to\n");
+    return 2;
+  }
+
+  if (threads <= 0 || bucket <= 0 || query.frames <= 0 || frame_duration < 0) {
+    g_printerr ("--threads, --bucket, --frames and --frame-duration must be positive\n");
+    return 2;
+  }
+  query.bucket = (gint64) (bucket * NS_PER_SECOND);
+  query.frame_duration = (guint64) frame_duration;
+
+  scan.query = &query;
+  scan.threads = (guint) threads;
+  scan.previous.valid = FALSE;
+  scan.buckets = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, g_free);
+
+  for (i = 2; i < argc; i++) {
+    GMappedFile *mapped_file = g_mapped_file_new (argv[i], FALSE, &error);
+
+    if (mapped_file == NULL) {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      ok = FALSE;
+      continue;
+    }
+
+    if (g_mapped_file_get_length (mapped_file) >= GST_ABSTS_MAGIC_SIZE &&
+        memcmp (g_mapped_file_get_contents (mapped_file), GST_ABSTS_MAGIC, GST_ABSTS_MAGIC_SIZE) == 0)
+      ok = scan_binary (&scan, &query, argv[i]) && ok;
+    else
+      ok = scan_text (&scan, &query, argv[i], mapped_file) && ok;
+
+    g_mapped_file_unref (mapped_file);
+  }
+
+  if (query.command == COMMAND_JITTER)
+    print_buckets (scan.buckets);
+
+  g_hash_table_unref (scan.buckets);
+  g_free (from);
+  g_free (to);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,590 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Runs 1 to 256 pipelines at once, each an absolutetimestamps in a GstHarness pushed from a thread
+// pinned to a CPU of its own (round-robin once there are more pipelines than CPUs), and reports how
+// the per-buffer latency tail, context switches and cache misses of the streaming threads change as
+// they're added. This is what the shared writer and the lock-free ring have to hold up under:
+//
+//   $ make stress STRESS_ARGS="--pipelines 1,16,256 --mode async,group --baseline stress.ini"
+//
+// With --baseline, each p99 is compared against the one stored for the same mode and number of
+// pipelines, and the run fails if it's more than --tolerance percent worse. --update-baseline stores
+// this run's instead.
+
+// For CPU_SET and pthread_setaffinity_np.
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+
+#define KEYFRAME_INTERVAL 30
+#define FRAME_DURATION (GST_SECOND / 30)
+
+// Latencies are counted in a log-linear histogram: exact below 2^SUB_BITS ns, and above that in
+// 2^SUB_BITS buckets per power of two, i.e. to within about 3%.
+#define SUB_BITS 5
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define N_BUCKETS ((64 - SUB_BITS + 1) * SUB_BUCKETS)
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *properties;
+} StressMode;
+
+static const StressMode modes[] = {
+  {"text", "format=text"},
+  {"binary", "format=binary"},
+  {"async", "format=binary async-write=true ring-capacity=65536"},
+  {"group", "format=binary writer-group=absts-stress ring-capacity=65536"},
+  {"adaptive", "format=binary async-write=true ring-capacity=4096 adaptive=true"},
+  {NULL, NULL}
+};
+
+typedef struct
+{
+  const StressMode *mode;
+  gchar *location;
+  guint64 n_buffers;
+  gint cpu;                     /* to pin the thread to, -1 for none */
+
+  GThread *thread;
+  gboolean ok;
+  guint64 histogram[N_BUCKETS];
+  guint64 max;
+  gint64 context_switches;      /* -1 if they couldn't be counted */
+  gint64 cache_misses;          /* -1 if they couldn't be counted */
+  guint64 dropped;
+} StressJob;
+
+// All jobs of a run set up their harness and then wait here, so that they push concurrently.
+static GMutex start_lock;
+static GCond start_cond;
+static guint n_waiting;
+static guint n_jobs;
+static gboolean started;
+
+/* histogram */
+
+static inline guint
+stress_bucket (guint64 ns)
+{
+  guint msb;
+
+  if (ns < SUB_BUCKETS)
+    return (guint) ns;
+
+  msb = 63 - __builtin_clzll (ns);
+
+  return (msb - SUB_BITS + 1) * SUB_BUCKETS + (guint) ((ns >> (msb - SUB_BITS)) - SUB_BUCKETS);
+}
+
+// The largest latency counted in bucket, so that the percentiles err on the slow side.
+static guint64
+stress_bucket_limit (guint bucket)
+{
+  guint group = bucket / SUB_BUCKETS, sub = bucket % SUB_BUCKETS;
+
+  if (group == 0)
+    return sub;
+
+  return ((guint64) (SUB_BUCKETS + sub + 1) << (group - 1)) - 1;
+}
+
+static guint64
+stress_percentile (const guint64 * histogram, guint64 count, gdouble percentile)
+{
+  guint64 rank = (guint64) (count * percentile / 100.0), seen = 0;
+  guint i;
+
+  for (i = 0; i < N_BUCKETS; i++) {
+    seen += histogram[i];
+    if (seen > rank)
+      return stress_bucket_limit (i);
+  }
+
+  return stress_bucket_limit (N_BUCKETS - 1);
+}
+
+/* counters */
+
+static void
+stress_pin (gint cpu)
+{
+#ifdef __linux__
+  cpu_set_t set;
+
+  if (cpu < 0)
+    return;
+
+  CPU_ZERO (&set);
+  CPU_SET (cpu, &set);
+  if (pthread_setaffinity_np (pthread_self (), sizeof (set), &set) != 0)
+    g_printerr ("Could not pin a pipeline to CPU %d\n", cpu);
+#endif
+}
+
+// The CPUs this process may run on, in order.
+static GArray *
+stress_get_cpus (void)
+{
+  GArray *cpus = g_array_new (FALSE, FALSE, sizeof (gint));
+#ifdef __linux__
+  cpu_set_t set;
+  gint cpu;
+
+  if (sched_getaffinity (0, sizeof (set), &set) == 0)
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET (cpu, &set))
+        g_array_append_val (cpus, cpu);
+#endif
+
+  return cpus;
+}
+
+// A counter of this thread's cache misses, -1 where perf_event_open isn't available or allowed,
+// e.g. in most containers or with a kernel.perf_event_paranoid that's too strict.
+static gint
+stress_open_cache_misses (void)
+{
+#ifdef __linux__
+  struct perf_event_attr attr;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.size = sizeof (attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_hv = 1;
+
+  return (gint) syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  return -1;
+#endif
+}
+
+static void
+stress_start_counter (gint fd)
+{
+#ifdef __linux__
+  if (fd < 0)
+    return;
+
+  ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+  ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+// Stops and closes the counter, returning what it counted or -1.
+static gint64
+stress_stop_counter (gint fd)
+{
+  gint64 count = -1;
+#ifdef __linux__
+  guint64 value;
+
+  if (fd < 0)
+    return -1;
+
+  ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+  if (read (fd, &value, sizeof (value)) == sizeof (value))
+    count = (gint64) value;
+  close (fd);
+#endif
+
+  return count;
+}
+
+static gint64
+stress_get_context_switches (void)
+{
+#if defined (__linux__) && defined (RUSAGE_THREAD)
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_THREAD, &usage) == 0)
+    return (gint64) usage.ru_nvcsw + usage.ru_nivcsw;
+#endif
+
+  return -1;
+}
+
+/* jobs */
+
+static GstBuffer *
+stress_buffer_new (guint64 index)
+{
+  GstBuffer *buffer = gst_buffer_new ();
+
+  GST_BUFFER_PTS (buffer) = index * FRAME_DURATION;
+  GST_BUFFER_DURATION (buffer) = FRAME_DURATION;
+  if (index % KEYFRAME_INTERVAL != 0)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return buffer;
+}
+
+static inline guint64
+stress_get_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (guint64) ts.tv_sec * GST_SECOND + ts.tv_nsec;
+}
+
+static void
+stress_wait_for_start (void)
+{
+  g_mutex_lock (&start_lock);
+  if (++n_waiting == n_jobs) {
+    started = TRUE;
+    g_cond_broadcast (&start_cond);
+  }
+  while (!started)
+    g_cond_wait (&start_cond, &start_lock);
+  g_mutex_unlock (&start_lock);
+}
+
+// Each push runs the element's transform_ip on this thread, so timing the push times the element,
+// plus the harness handing the buffer on to a sink that drops it. The buffer is created outside of
+// the measurement.
+static gpointer
+stress_job_run (gpointer data)
+{
+  StressJob *job = data;
+  GstHarness *harness;
+  gchar *description;
+  gint64 context_switches;
+  gint perf_fd;
+  guint64 i;
+
+  stress_pin (job->cpu);
+
+  description = g_strdup_printf ("absolutetimestamps location=\"%s\" %s", job->location,
+      job->mode->properties);
+  harness = gst_harness_new_parse (description);
+  g_free (description);
+
+  gst_harness_set_src_caps_str (harness, "application/x-absts-stress");
+  gst_harness_set_drop_buffers (harness, TRUE);
+  gst_harness_play (harness);
+
+  perf_fd = stress_open_cache_misses ();
+
+  stress_wait_for_start ();
+
+  job->ok = TRUE;
+  context_switches = stress_get_context_switches ();
+  stress_start_counter (perf_fd);
+
+  for (i = 0; i < job->n_buffers; i++) {
+    GstBuffer *buffer = stress_buffer_new (i);
+    guint64 start, latency;
+    GstFlowReturn ret;
+
+    start = stress_get_time ();
+    ret = gst_harness_push (harness, buffer);
+    latency = stress_get_time () - start;
+
+    job->histogram[stress_bucket (latency)]++;
+    job->max = MAX (job->max, latency);
+
+    if (ret != GST_FLOW_OK) {
+      job->ok = FALSE;
+      break;
+    }
+  }
+
+  job->cache_misses = stress_stop_counter (perf_fd);
+  job->context_switches = context_switches < 0 ? -1 :
+      stress_get_context_switches () - context_switches;
+
+  g_object_get (harness->element, "dropped", &job->dropped, NULL);
+
+  gst_harness_teardown (harness);
+
+  return NULL;
+}
+
+typedef struct
+{
+  guint64 p50, p99, p999, max;
+  guint64 count;
+  gdouble context_switches;     /* per pipeline, < 0 if unknown */
+  gdouble cache_misses;         /* per buffer, < 0 if unknown */
+  guint64 dropped;
+  gboolean ok;
+} StressResult;
+
+static void
+stress_run (const StressMode * mode, const gchar * directory, guint pipelines, guint64 n_buffers,
+    GArray * cpus, StressResult * result)
+{
+  StressJob *jobs = g_new0 (StressJob, pipelines);
+  guint64 *histogram = g_new0 (guint64, N_BUCKETS);
+  gint64 context_switches = 0, cache_misses = 0;
+  guint i, j;
+
+  n_jobs = pipelines;
+  n_waiting = 0;
+  started = FALSE;
+
+  for (i = 0; i < pipelines; i++) {
+    gchar *name = g_strdup_printf ("%s-%u-%u.log", mode->name, pipelines, i);
+
+    jobs[i].mode = mode;
+    jobs[i].location = g_build_filename (directory, name, NULL);
+    jobs[i].n_buffers = n_buffers;
+    jobs[i].cpu = cpus->len > 0 ? g_array_index (cpus, gint, i % cpus->len) : -1;
+    jobs[i].thread = g_thread_new ("absts-stress", stress_job_run, &jobs[i]);
+    g_free (name);
+  }
+
+  memset (result, 0, sizeof (*result));
+  result->ok = TRUE;
+
+  for (i = 0; i < pipelines; i++) {
+    StressJob *job = &jobs[i];
+
+    g_thread_join (job->thread);
+
+    for (j = 0; j < N_BUCKETS; j++) {
+      histogram[j] += job->histogram[j];
+      result->count += job->histogram[j];
+    }
+    result->max = MAX (result->max, job->max);
+    result->dropped += job->dropped;
+    result->ok = result->ok && job->ok;
+
+    if (context_switches >= 0)
+      context_switches = job->context_switches < 0 ? -1 : context_switches + job->context_switches;
+    if (cache_misses >= 0)
+      cache_misses = job->cache_misses < 0 ? -1 : cache_misses + job->cache_misses;
+
+    g_unlink (job->location);
+    g_free (job->location);
+  }
+
+  result->p50 = stress_percentile (histogram, result->count, 50);
+  result->p99 = stress_percentile (histogram, result->count, 99);
+  result->p999 = stress_percentile (histogram, result->count, 99.9);
+  result->context_switches = context_switches < 0 ? -1 : (gdouble) context_switches / pipelines;
+  result->cache_misses = cache_misses < 0 || result->count == 0 ? -1 :
+      (gdouble) cache_misses / result->count;
+
+  g_free (histogram);
+  g_free (jobs);
+}
+
+static const StressMode *
+stress_find_mode (const gchar * name)
+{
+  const StressMode *mode;
+
+  for (mode = modes; mode->name != NULL; mode++)
+    if (g_strcmp0 (mode->name, name) == 0)
+      return mode;
+
+  return NULL;
+}
+
+static gchar *
+stress_format_count (gdouble value, const gchar * format)
+{
+  return value < 0 ? g_strdup ("-") : g_strdup_printf (format, value);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint64 n_buffers = 100000;
+  gchar *pipeline_counts = NULL;
+  gchar *mode_names = NULL;
+  gchar *plugin_path = NULL;
+  gchar *baseline_path = NULL;
+  gboolean update_baseline = FALSE;
+  gint tolerance = 25;
+  gint64 max_p99 = 0;
+  gboolean pin = TRUE;
+  GOptionEntry entries[] = {
+    {"buffers", 'n', 0, G_OPTION_ARG_INT64, &n_buffers, "Buffers to push per pipeline (default 100000)", "N"},
+    {"pipelines", 'P', 0, G_OPTION_ARG_STRING, &pipeline_counts, "Comma-separated numbers of pipelines to run at once, 1 to 256 (default 1,4,16,64,256)", "COUNTS"},
+    {"mode", 'm', 0, G_OPTION_ARG_STRING, &mode_names, "Comma-separated modes: text, binary, async, group, adaptive (default binary,async,group)", "MODES"},
+    {"plugin-path", 'p', 0, G_OPTION_ARG_FILENAME, &plugin_path, "Directory to load the plugin from", "DIR"},
+    {"baseline", 'b', 0, G_OPTION_ARG_FILENAME, &baseline_path, "Key file of the p99s to compare against", "FILE"},
+    {"update-baseline", 'u', 0, G_OPTION_ARG_NONE, &update_baseline, "Store this run's p99s in the baseline instead", NULL},
+    {"tolerance", 't', 0, G_OPTION_ARG_INT, &tolerance, "Percent by which a p99 may exceed the baseline's (default 25)", "PERCENT"},
+    {"max-p99", 0, 0, G_OPTION_ARG_INT64, &max_p99, "Fail if any p99 exceeds this many ns (default no limit)", "NS"},
+    {"no-pin", 0, G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &pin, "Leave the pipelines' threads to the scheduler", NULL},
+    {NULL}
+  };
+  GOptionContext *context;
+  GError *error = NULL;
+  GKeyFile *baseline;
+  GArray *cpus;
+  gchar *directory;
+  gchar **names, **counts;
+  gboolean ok = TRUE;
+  guint i, j;
+
+  context = g_option_context_new ("- measure how the absolutetimestamps element scales");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gst_init_get_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+  g_option_context_free (context);
+
+  if (n_buffers <= 0 || tolerance < 0 || max_p99 < 0) {
+    g_printerr ("--buffers must be positive, --tolerance and --max-p99 can't be negative\n");
+    return 2;
+  }
+
+  if (update_baseline && baseline_path == NULL) {
+    g_printerr ("--update-baseline needs --baseline\n");
+    return 2;
+  }
+
+  // Default to the plugin in the build tree, so the stress test doesn't need it to be installed.
+#ifdef STRESS_PLUGIN_PATH
+  if (plugin_path == NULL)
+    plugin_path = g_strdup (STRESS_PLUGIN_PATH);
+#endif
+  if (plugin_path != NULL)
+    gst_registry_scan_path (gst_registry_get (), plugin_path);
+
+  if (gst_registry_find_plugin (gst_registry_get (), "absolutetimestamps") == NULL) {
+    g_printerr ("Could not find the absolutetimestamps plugin, try --plugin-path\n");
+    return 2;
+  }
+
+  // A baseline that doesn't exist yet is just empty.
+  baseline = g_key_file_new ();
+  if (baseline_path != NULL && !g_key_file_load_from_file (baseline, baseline_path,
+          G_KEY_FILE_NONE, &error)) {
+    if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+      g_printerr ("%s\n", error->message);
+      return 2;
+    }
+    g_clear_error (&error);
+  }
+
+  directory = g_dir_make_tmp ("absts-stress-XXXXXX", &error);
+  if (directory == NULL) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+
+  cpus = pin ? stress_get_cpus () : g_array_new (FALSE, FALSE, sizeof (gint));
+  names = g_strsplit (mode_names ? mode_names : "binary,async,group", ",", -1);
+  counts = g_strsplit (pipeline_counts ? pipeline_counts : "1,4,16,64,256", ",", -1);
+
+  g_print ("%-9s %9s %12s %9s %9s %9s %11s %12s %12s %10s\n", "mode", "pipelines", "buffers",
+      "p50 ns", "p99 ns", "p999 ns", "max ns", "csw/pipeline", "misses/buf", "dropped");
+
+  for (i = 0; names[i] != NULL; i++) {
+    const StressMode *mode = stress_find_mode (names[i]);
+
+    if (mode == NULL) {
+      g_printerr ("Unknown mode \"%s\"\n", names[i]);
+      ok = FALSE;
+      continue;
+    }
+
+    for (j = 0; counts[j] != NULL; j++) {
+      guint64 pipelines;
+      StressResult result;
+      gchar *key, *context_switches, *cache_misses;
+      const gchar *verdict = "";
+
+      if (!g_ascii_string_to_unsigned (counts[j], 10, 1, 256, &pipelines, NULL)) {
+        g_printerr ("Can't run \"%s\" pipelines, the count must be 1 to 256\n", counts[j]);
+        ok = FALSE;
+        continue;
+      }
+
+      stress_run (mode, directory, (guint) pipelines, (guint64) n_buffers, cpus, &result);
+
+      key = g_strdup_printf ("p99-%u", (guint) pipelines);
+      if (!result.ok) {
+        verdict = "  FAILED";
+      } else if (max_p99 > 0 && result.p99 > (guint64) max_p99) {
+        verdict = "  OVER LIMIT";
+      } else if (update_baseline) {
+        g_key_file_set_uint64 (baseline, mode->name, key, result.p99);
+      } else if (g_key_file_has_key (baseline, mode->name, key, NULL)) {
+        guint64 limit = g_key_file_get_uint64 (baseline, mode->name, key, NULL);
+
+        if (result.p99 * 100 > limit * (100 + tolerance))
+          verdict = "  REGRESSED";
+      }
+      ok = ok && verdict[0] == '\0';
+
+      context_switches = stress_format_count (result.context_switches, "%.1f");
+      cache_misses = stress_format_count (result.cache_misses, "%.2f");
+      g_print ("%-9s %9u %12" G_GUINT64_FORMAT " %9" G_GUINT64_FORMAT " %9" G_GUINT64_FORMAT
+          " %9" G_GUINT64_FORMAT " %11" G_GUINT64_FORMAT " %12s %12s %10" G_GUINT64_FORMAT "%s\n",
+          mode->name, (guint) pipelines, result.count, result.p50, result.p99, result.p999,
+          result.max, context_switches, cache_misses, result.dropped, verdict);
+      g_free (context_switches);
+      g_free (cache_misses);
+      g_free (key);
+    }
+  }
+
+  if (update_baseline && !g_key_file_save_to_file (baseline, baseline_path, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    ok = FALSE;
+  }
+
+  g_rmdir (directory);
+
+  g_strfreev (counts);
+  g_strfreev (names);
+  g_array_unref (cpus);
+  g_key_file_free (baseline);
+  g_free (directory);
+  g_free (baseline_path);
+  g_free (mode_names);
+  g_free (pipeline_counts);
+  g_free (plugin_path);
+
+  return ok ? 0 : 1;
+}
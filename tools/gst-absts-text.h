@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2019 George Hawkins <https://github.com/george-hawkins>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GST_ABSTS_TEXT_H_
+#define _GST_ABSTS_TEXT_H_
+
+// Parsing and formatting of the text written by absolutetimestamps format=text, shared by the tools:
+//
+//   [stream ]H:MM:SS.nnnnnnnnn YYYY-MM-DDTHH:MM:SS.uuuuuu[nnn]Z
+//
+// Apart from the hours, every field has a fixed width and position, so the record parser reads the
+// digits eight at a time as a single 64-bit word (SWAR) rather than one by one, and only converts
+// the date to days when it differs from that of the previous line.
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define NS_PER_SECOND G_GINT64_CONSTANT (1000000000)
+#define NS_PER_DAY (86400 * NS_PER_SECOND)
+
+// Long enough for any record formatted by gst_absts_text_format_record.
+#define GST_ABSTS_TEXT_LINE_SIZE 96
+
+typedef struct
+{
+  gchar date[10];               /* "YYYY-MM-DD" of the last line parsed */
+  gint64 days;                  /* and its days since the epoch */
+} GstAbstsTextParser;
+
+// Days since the epoch of a proleptic Gregorian date, see http://howardhinnant.github.io/date_algorithms.html
+static inline gint64
+gst_absts_text_days_from_civil (gint64 y, guint m, guint d)
+{
+  gint64 era, yoe, doy, doe;
+
+  y -= m <= 2;
+  era = (y >= 0 ? y : y - 399) / 400;
+  yoe = y - era * 400;
+  doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+  return era * 146097 + doe - 719468;
+}
+
+static inline gboolean
+gst_absts_text_parse_digits (const gchar ** p, const gchar * end, gint width, guint * value)
+{
+  *value = 0;
+
+  while (width-- > 0) {
+    if (*p >= end || !g_ascii_isdigit (**p))
+      return FALSE;
+    *value = *value * 10 + (**p - '0');
+    (*p)++;
+  }
+
+  return TRUE;
+}
+
+// Parses the eight ASCII digits at src, returning FALSE if any of them isn't one. The digits are
+// loaded as one little-endian word, so the first is in the lowest byte, and combined pairwise: 8
+// digits to 4 two-digit values, to 2 four-digit values, to one.
+static inline gboolean
+gst_absts_text_parse_eight_digits (const gchar * src, guint32 * value)
+{
+  guint64 v;
+
+  memcpy (&v, src, sizeof (v));
+  v = GUINT64_FROM_LE (v);
+
+  // Bytes below '0' borrow into their top bit when subtracted from, bytes above '9' carry into it
+  // when 0x46 is added.
+  if ((((v + G_GUINT64_CONSTANT (0x4646464646464646)) |
+              (v - G_GUINT64_CONSTANT (0x3030303030303030))) &
+          G_GUINT64_CONSTANT (0x8080808080808080)) != 0)
+    return FALSE;
+
+  v -= G_GUINT64_CONSTANT (0x3030303030303030);
+  v = (v * 10) + (v >> 8);
+  v = (((v & G_GUINT64_CONSTANT (0x000000FF000000FF)) * (100 + (G_GUINT64_CONSTANT (1000000) << 32))) +
+      (((v >> 16) & G_GUINT64_CONSTANT (0x000000FF000000FF)) * (1 + (G_GUINT64_CONSTANT (10000) << 32))))
+      >> 32;
+  *value = (guint32) v;
+
+  return TRUE;
+}
+
+// Parses an optional fraction of a second, ".5" or ".500000000", into nanoseconds.
+static inline gint64
+gst_absts_text_parse_fraction (const gchar ** p, const gchar * end)
+{
+  gint64 scale = NS_PER_SECOND / 10, nanos = 0;
+
+  if (*p >= end || **p != '.')
+    return 0;
+
+  for ((*p)++; *p < end && g_ascii_isdigit (**p); (*p)++) {
+    nanos += (**p - '0') * scale;
+    scale /= 10;
+  }
+
+  return nanos;
+}
+
+// Parses "H:MM:SS[.fff]", with any number of hours, into nanoseconds.
+static inline gboolean
+gst_absts_text_parse_clock_time (const gchar ** p, const gchar * end, guint64 * time)
+{
+  guint64 hours = 0;
+  guint minutes, seconds;
+
+  if (*p >= end || !g_ascii_isdigit (**p))
+    return FALSE;
+
+  while (*p < end && g_ascii_isdigit (**p))
+    hours = hours * 10 + (*(*p)++ - '0');
+
+  if (*p >= end || *(*p)++ != ':' || !gst_absts_text_parse_digits (p, end, 2, &minutes) ||
+      *p >= end || *(*p)++ != ':' || !gst_absts_text_parse_digits (p, end, 2, &seconds))
+    return FALSE;
+
+  *time = ((hours * 60 + minutes) * 60 + seconds) * NS_PER_SECOND +
+      gst_absts_text_parse_fraction (p, end);
+
+  return TRUE;
+}
+
+// Parses "YYYY-MM-DDTHH:MM:SS[.fff][Z]" into nanoseconds since the epoch.
+static inline gboolean
+gst_absts_text_parse_iso8601 (const gchar ** p, const gchar * end, gint64 * wallclock)
+{
+  guint year, month, day, hour, minute, second;
+
+  if (!gst_absts_text_parse_digits (p, end, 4, &year) || *p >= end || *(*p)++ != '-' ||
+      !gst_absts_text_parse_digits (p, end, 2, &month) || *p >= end || *(*p)++ != '-' ||
+      !gst_absts_text_parse_digits (p, end, 2, &day) || *p >= end || *(*p)++ != 'T' ||
+      !gst_absts_text_parse_digits (p, end, 2, &hour) || *p >= end || *(*p)++ != ':' ||
+      !gst_absts_text_parse_digits (p, end, 2, &minute) || *p >= end || *(*p)++ != ':' ||
+      !gst_absts_text_parse_digits (p, end, 2, &second))
+    return FALSE;
+
+  *wallclock = ((gst_absts_text_days_from_civil (year, month, day) * 24 + hour) * 60 + minute) * 60 *
+      NS_PER_SECOND + second * NS_PER_SECOND + gst_absts_text_parse_fraction (p, end);
+
+  if (*p < end && **p == 'Z')
+    (*p)++;
+
+  return TRUE;
+}
+
+static inline guint
+gst_absts_text_two_digits (const gchar * src)
+{
+  return (guint) (src[0] - '0') * 10 + (guint) (src[1] - '0');
+}
+
+static inline void
+gst_absts_text_parser_init (GstAbstsTextParser * parser)
+{
+  memset (parser->date, 0, sizeof (parser->date));
+  parser->days = 0;
+}
+
+// Parses one line, without its newline, of a text log: comments, such as segment markers, and
+// malformed lines return FALSE. stream is set to -1 unless the line starts with one, as a writer
+// group's lines do.
+static inline gboolean
+gst_absts_text_parse_record (GstAbstsTextParser * parser, const gchar * line, const gchar * end,
+    gint * stream, guint64 * pts, gint64 * wallclock)
+{
+  const gchar *p = line, *colon;
+  guint64 hours = 0;
+  guint32 nanos, fraction;
+  gint64 seconds;
+
+  if (p >= end || *p == '#')
+    return FALSE;
+
+  colon = memchr (p, ':', end - p);
+  if (colon == NULL)
+    return FALSE;
+
+  // A writer group's log has the stream as its first column, a pts always has a ':' in it.
+  *stream = -1;
+  if (memchr (p, ' ', colon - p) != NULL) {
+    *stream = (gint) g_ascii_strtoll (p, NULL, 10);
+    p = (const gchar *) memchr (p, ' ', colon - p) + 1;
+  }
+
+  for (; p < colon; p++) {
+    if (!g_ascii_isdigit (*p))
+      return FALSE;
+    hours = hours * 10 + (*p - '0');
+  }
+
+  // From the colon on: ":MM:SS.nnnnnnnnn YYYY-MM-DDTHH:MM:SS.uuuuuuZ" - shorter lines are malformed.
+  if (end - colon < 44 || colon[3] != ':' || colon[6] != '.' || colon[16] != ' ' ||
+      colon[21] != '-' || colon[24] != '-' || colon[27] != 'T' || colon[36] != '.')
+    return FALSE;
+
+  // A nanosecond pts has 9 digits: the first on its own and the rest as a word.
+  if (!g_ascii_isdigit (colon[7]) || !gst_absts_text_parse_eight_digits (colon + 8, &nanos))
+    return FALSE;
+  *pts = ((hours * 60 + gst_absts_text_two_digits (colon + 1)) * 60 +
+      gst_absts_text_two_digits (colon + 4)) * NS_PER_SECOND + (guint64) (colon[7] - '0') * 100000000 +
+      nanos;
+
+  p = colon + 17;
+  if (memcmp (parser->date, p, sizeof (parser->date)) != 0) {
+    memcpy (parser->date, p, sizeof (parser->date));
+    parser->days = gst_absts_text_days_from_civil ((gint64) gst_absts_text_two_digits (p) * 100 +
+        gst_absts_text_two_digits (p + 2), gst_absts_text_two_digits (p + 5),
+        gst_absts_text_two_digits (p + 8));
+  }
+  seconds = ((parser->days * 24 + gst_absts_text_two_digits (p + 11)) * 60 +
+      gst_absts_text_two_digits (p + 14)) * 60 + gst_absts_text_two_digits (p + 17);
+
+  // Microsecond or nanosecond precision, i.e. 6 or 9 digits, either way the word holds the first 8
+  // of them or 6 and the "Z" after them.
+  p += 20;
+  if (end - p >= 10 && p[9] == 'Z' && gst_absts_text_parse_eight_digits (p, &fraction) &&
+      g_ascii_isdigit (p[8])) {
+    fraction = fraction * 10 + (p[8] - '0');
+  } else if (p[6] == 'Z') {
+    guint value;
+    const gchar *q = p;
+
+    if (!gst_absts_text_parse_digits (&q, end, 6, &value))
+      return FALSE;
+    fraction = value * 1000;
+  } else {
+    return FALSE;
+  }
+
+  *wallclock = seconds * NS_PER_SECOND + fraction;
+
+  return TRUE;
+}
+
+// Formats wallclock as "YYYY-MM-DDTHH:MM:SS.nnnnnnnnnZ" and returns the length. dest must have room
+// for GST_ABSTS_TEXT_LINE_SIZE bytes.
+static inline gsize
+gst_absts_text_format_wallclock (gchar * dest, gint64 wallclock)
+{
+  time_t second = (time_t) (wallclock / NS_PER_SECOND);
+  struct tm tm;
+
+  gmtime_r (&second, &tm);
+
+  return g_snprintf (dest, GST_ABSTS_TEXT_LINE_SIZE, "%04d-%02d-%02dT%02d:%02d:%02d.%09uZ",
+      tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+      (guint) (wallclock % NS_PER_SECOND));
+}
+
+// Formats pts as "H:MM:SS.nnnnnnnnn" and returns the length. dest must have room for
+// GST_ABSTS_TEXT_LINE_SIZE bytes.
+static inline gsize
+gst_absts_text_format_pts (gchar * dest, guint64 pts)
+{
+  return g_snprintf (dest, GST_ABSTS_TEXT_LINE_SIZE, "%u:%02u:%02u.%09u",
+      (guint) (pts / (3600 * NS_PER_SECOND)), (guint) (pts / (60 * NS_PER_SECOND) % 60),
+      (guint) (pts / NS_PER_SECOND % 60), (guint) (pts % NS_PER_SECOND));
+}
+
+// Formats a record as absolutetimestamps format=text precision=nanoseconds would, including the
+// newline, and returns the length. dest must have room for GST_ABSTS_TEXT_LINE_SIZE bytes.
+static inline gsize
+gst_absts_text_format_record (gchar * dest, guint64 pts, gint64 wallclock)
+{
+  gsize length = gst_absts_text_format_pts (dest, pts);
+
+  dest[length++] = ' ';
+  length += gst_absts_text_format_wallclock (dest + length, wallclock);
+  dest[length++] = '\n';
+
+  return length;
+}
+
+G_END_DECLS
+
+#endif